@@ -0,0 +1,119 @@
+// -------------------------------------------------------------------------
+// Sean Janis
+// spjanis@gmail.com
+// Water Simulations
+//
+// CAlignedBuffer
+//       Heap array whose first element is aligned to ALIGNED_BUFFER_ALIGNMENT
+//       bytes, which is a cache line and covers every SIMD load width the
+//       kernels use. It is meant for plain data such as floats and ints:
+//       elements are zero-filled, not constructed.
+// -------------------------------------------------------------------------
+#pragma once
+
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#define ALIGNED_BUFFER_ALIGNMENT       64
+
+template <class T>
+class CAlignedBuffer
+{
+public:
+   CAlignedBuffer()
+   {
+      m_pData = NULL;
+      m_nCount = 0;
+   }
+
+   virtual ~CAlignedBuffer()
+   {
+      Free();
+   }
+
+   // -------------------------------------------------------------------------
+   // Replaces the contents with nCount zeroed elements. Returns false, and
+   // leaves the buffer empty, if the memory cannot be allocated.
+   // -------------------------------------------------------------------------
+   bool Allocate(int nCount)
+   {
+      Free();
+
+      if (nCount <= 0)
+      {
+         return true;
+      }
+
+      size_t nBytes = (size_t)nCount * sizeof(T);
+
+#ifdef _WIN32
+      m_pData = (T*)_aligned_malloc(nBytes, ALIGNED_BUFFER_ALIGNMENT);
+#else
+      void* pMemory = NULL;
+      if (posix_memalign(&pMemory, ALIGNED_BUFFER_ALIGNMENT, nBytes) == 0)
+      {
+         m_pData = (T*)pMemory;
+      }
+#endif
+
+      if (m_pData == NULL)
+      {
+         return false;
+      }
+
+      memset(m_pData, 0, nBytes);
+      m_nCount = nCount;
+      return true;
+   }
+
+   void Free()
+   {
+      if (m_pData != NULL)
+      {
+#ifdef _WIN32
+         _aligned_free(m_pData);
+#else
+         free(m_pData);
+#endif
+         m_pData = NULL;
+      }
+
+      m_nCount = 0;
+   }
+
+   int GetCount() const
+   {
+      return m_nCount;
+   }
+
+   T* GetData()
+   {
+      return m_pData;
+   }
+
+   const T* GetData() const
+   {
+      return m_pData;
+   }
+
+   T& operator[](int i)
+   {
+      return m_pData[i];
+   }
+
+   const T& operator[](int i) const
+   {
+      return m_pData[i];
+   }
+
+protected:
+   T* m_pData;
+   int m_nCount;
+
+private:
+   CAlignedBuffer(const CAlignedBuffer&);
+   CAlignedBuffer& operator=(const CAlignedBuffer&);
+};
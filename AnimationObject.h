@@ -17,7 +17,7 @@ public:
    // Main Rendering Methods
    //
 
-   virtual void Update(float fCurrentTime, bool blMoveObject = false) = 0;
+   virtual void Update(double dCurrentTime, bool blMoveObject = false) = 0;
    virtual void Draw(D3DXMATRIX& projectionMatrix, D3DXMATRIX& viewMatrix) = 0;
 
    //
@@ -0,0 +1,238 @@
+// -------------------------------------------------------------------------
+// Sean Janis
+// spjanis@gmail.com
+// Water Simulations
+//
+// FFTBenchmark
+//       Console benchmark for CFFT2D. It times the strided, the blocked and
+//       the Stockham column pass on one thread, and the blocked and Stockham
+//       passes on the thread pool, at each grid size. It reports the time per transform, the time per
+//       point and the effective memory bandwidth. Once the working set no
+//       longer fits in cache, the strided pass slows down far more than the
+//       blocked one.
+//
+//       Usage: fft_benchmark [-threads N] [-fields F] [-nofixed] [size ...]
+//              N = 0 (the default) uses one thread per hardware thread.
+//              F fields are transformed together in each call, as the water
+//              surface does for its height, slope and displacement fields.
+//              -nofixed runs the generic kernels for every size.
+// -------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+
+#include "FFT2D.h"
+#include "CpuFeatures.h"
+#include "ThreadPool.h"
+#include "Field2D.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+using namespace std;
+
+static double GetSeconds()
+{
+#ifdef _WIN32
+   LARGE_INTEGER frequency, counter;
+   QueryPerformanceFrequency(&frequency);
+   QueryPerformanceCounter(&counter);
+   return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+   timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return now.tv_sec + now.tv_nsec * 1e-9;
+#endif
+}
+
+static double TimeTransform(
+   CFFT2D& fft,
+   int nFields,
+   const float* const* ppSpectraReal,
+   const float* const* ppSpectraImaginary,
+   int nSpectrumPitch,
+   float* const* ppOutputs)
+{
+   int nHeight = fft.GetHeight();
+
+   // -------------------------------------------------------------------------
+   // Warm up, then grow the repetition count until one timing run takes at
+   // least a quarter of a second.
+   // -------------------------------------------------------------------------
+   fft.InverseRealFields(nFields, ppSpectraReal, ppSpectraImaginary, nSpectrumPitch, ppOutputs, nHeight);
+
+   int nRepetitions = 1;
+   for (;;)
+   {
+      double dStart = GetSeconds();
+      for (int r = 0; r < nRepetitions; r++)
+      {
+         fft.InverseRealFields(nFields, ppSpectraReal, ppSpectraImaginary, nSpectrumPitch, ppOutputs, nHeight);
+      }
+      double dElapsed = GetSeconds() - dStart;
+
+      if (dElapsed >= 0.25)
+      {
+         return dElapsed / nRepetitions;
+      }
+      nRepetitions *= 2;
+   }
+}
+
+int main(int argc, char* argv[])
+{
+   vector<int> sizes;
+   int nThreads = 0;
+   int nFields = 1;
+
+   for (int i = 1; i < argc; i++)
+   {
+      if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc)
+      {
+         nThreads = atoi(argv[++i]);
+      }
+      else if (strcmp(argv[i], "-fields") == 0 && i + 1 < argc)
+      {
+         nFields = atoi(argv[++i]);
+         if (nFields < 1 || nFields > FFT2D_MAX_FIELDS)
+         {
+            printf("fields must be 1 to %d\n", FFT2D_MAX_FIELDS);
+            return 1;
+         }
+      }
+      else if (strcmp(argv[i], "-nofixed") == 0)
+      {
+         SetFixedFFTKernelsEnabled(false);
+      }
+      else
+      {
+         sizes.push_back(atoi(argv[i]));
+      }
+   }
+
+   CThreadPool threadPool;
+   threadPool.Init(nThreads);
+
+   if (sizes.empty())
+   {
+      for (int n = 64; n <= 1024; n *= 2)
+      {
+         sizes.push_back(n);
+      }
+   }
+
+   printf("simd: %s, threads: %d, fields: %d, fixed-size kernels: %s\n", 
+      GetSimdLevelName(GetSimdLevel()), 
+      threadPool.GetThreadCount(),
+      nFields,
+      GetFixedFFTKernelsEnabled() ? "on" : "off");
+   printf("%6s %8s %8s %12s %10s %10s %12s\n", "size", "columns", "threads", "us/fft", "ns/point", "GB/s", "max |diff|");
+
+   for (size_t s = 0; s < sizes.size(); s++)
+   {
+      int nSize = sizes[s];
+
+      CFFT2D fft;
+      if (!fft.Init(nSize, nSize, nFields))
+      {
+         printf("%6d unsupported size\n", nSize);
+         continue;
+      }
+
+      // ----------------------------------------------------------------------
+      // The fields are stored one after another in the same arrays, the
+      // spectra as the padded rows of one complex field.
+      // ----------------------------------------------------------------------
+      int nSpectrumHeight = fft.GetSpectrumHeight();
+      int nSpectrumSize = nSize * nSpectrumHeight;
+      int nOutputSize = nSize * nSize;
+
+      CComplexField2D spectrum;
+      if (!spectrum.Allocate(nSize * nFields, nSpectrumHeight))
+      {
+         printf("%6d out of memory\n", nSize);
+         continue;
+      }
+
+      for (int x = 0; x < nSize * nFields; x++)
+      {
+         for (int z = 0; z < nSpectrumHeight; z++)
+         {
+            spectrum.GetRealRow(x)[z] = (float)rand() / RAND_MAX - 0.5f;
+            spectrum.GetImaginaryRow(x)[z] = (float)rand() / RAND_MAX - 0.5f;
+         }
+      }
+
+      vector<float> reference(nOutputSize * nFields);
+      vector<float> output(nOutputSize * nFields);
+
+      const float* apSpectraReal[FFT2D_MAX_FIELDS];
+      const float* apSpectraImaginary[FFT2D_MAX_FIELDS];
+      float* apOutputs[FFT2D_MAX_FIELDS];
+      for (int f = 0; f < nFields; f++)
+      {
+         apSpectraReal[f] = spectrum.GetRealRow(f * nSize);
+         apSpectraImaginary[f] = spectrum.GetImaginaryRow(f * nSize);
+         apOutputs[f] = &output[f * nOutputSize];
+      }
+
+      // ----------------------------------------------------------------------
+      // Bytes touched per transform: each spectrum is read once, the
+      // intermediate planes are written and read once, and the outputs are
+      // written once.
+      // ----------------------------------------------------------------------
+      double dBytes = nFields * (
+         3.0 * nSpectrumSize * 2.0 * sizeof(float) +
+         (double)nOutputSize * sizeof(float));
+
+      const char* modeNames[] = { "strided", "blocked", "stockham", "blocked", "stockham" };
+      int modes[] = 
+      { 
+         FFT2D_COLUMNS_STRIDED, 
+         FFT2D_COLUMNS_BLOCKED, 
+         FFT2D_COLUMNS_STOCKHAM, 
+         FFT2D_COLUMNS_BLOCKED, 
+         FFT2D_COLUMNS_STOCKHAM 
+      };
+      CThreadPool* pools[] = { NULL, NULL, NULL, &threadPool, &threadPool };
+
+      for (int m = 0; m < 5; m++)
+      {
+         fft.SetColumnPassMode(modes[m]);
+         fft.SetThreadPool(pools[m]);
+         double dSeconds = TimeTransform(
+            fft, nFields, apSpectraReal, apSpectraImaginary, spectrum.GetPitch(), apOutputs);
+
+         if (m == 0)
+         {
+            reference = output;
+         }
+
+         double dMaxDiff = 0.0;
+         for (size_t i = 0; i < output.size(); i++)
+         {
+            double dDiff = fabs((double)output[i] - reference[i]);
+            if (dDiff > dMaxDiff)
+            {
+               dMaxDiff = dDiff;
+            }
+         }
+
+         printf("%6d %8s %8d %12.2f %10.3f %10.2f %12.3g\n",
+            nSize,
+            modeNames[m],
+            (pools[m] != NULL) ? pools[m]->GetThreadCount() : 1,
+            dSeconds * 1e6,
+            dSeconds * 1e9 / ((double)nOutputSize * nFields),
+            dBytes / dSeconds * 1e-9,
+            dMaxDiff);
+      }
+   }
+
+   return 0;
+}
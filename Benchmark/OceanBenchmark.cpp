@@ -0,0 +1,559 @@
+// -------------------------------------------------------------------------
+// Sean Janis
+// spjanis@gmail.com
+// Water Simulations
+//
+// OceanBenchmark
+//       Console benchmark for a whole simulation frame of COceanSimulation:
+//       the spectrum update and the scaled inverse FFT of every active
+//       field. It sweeps grid sizes, thread counts and FFT backends
+//       and reports the time per frame, the throughput and the bytes moved.
+//
+//       GFLOP/s counts the nominal 2.5 * N * log2(N) flops of a real
+//       inverse transform of N points per field, so the figures are
+//       comparable across sizes and backends. The byte count is the
+//       minimum traffic of one frame: each spectrum input read once, the
+//       phasors read and written once, each intermediate plane written and
+//       read once and each output map written once. The unfused backend
+//       also stores and reloads the spectra on top of that. Played back
+//       from a frame cache, a frame does no transform, and the bytes are
+//       the two cached frames read and the maps written.
+//
+//       Usage: ocean_benchmark [-threads N] [-choppiness C] [-time S]
+//                              [-evolution absolute|incremental]
+//                              [-jitter J] [-loop T] [-cache F] [-quantize]
+//                              [-json FILE] [-csv FILE] [size ...]
+//              N is the largest thread count tried; every power of two
+//              below it is also run. 0 (the default) uses the hardware
+//              thread count.
+//              C = 0 leaves out the two displacement fields.
+//              S is the minimum seconds spent timing each case.
+//              -evolution picks how the spectrum phases are advanced,
+//              incremental by default.
+//              J is the most a frame's time step strays from 1/60 s, in
+//              milliseconds, 0.25 by default; 0 gives a perfectly steady
+//              clock.
+//              T is a loop period in seconds, and F the frames of it
+//              played back from the frame cache, stored as 16 bit
+//              samples with -quantize.
+//              The sizes default to 32 through 2048.
+//              -h or --help prints this summary. An unknown option, or a
+//              size or value that is not a number, exits with 1.
+// -------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+
+#include "OceanSimulation.h"
+#include "CpuFeatures.h"
+#include "FFTKernels.h"
+#include "Threading.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+using namespace std;
+
+// -------------------------------------------------------------------------
+// One way of running the FFT: the SIMD level the plans are built for,
+// whether the fixed-size transforms are used, and the column pass.
+// -------------------------------------------------------------------------
+struct OceanBackend
+{
+   char csName[32];
+   int nSimdLevel;
+   bool blFixedKernels;
+   int nColumnPassMode;
+   bool blFusedTransform;
+};
+
+struct OceanResult
+{
+   int nSize;
+   const char* pBackendName;
+   int nThreads;
+   int nFields;
+   double dSecondsPerFrame;
+   double dFlops;
+   double dBytes;
+};
+
+static double GetSeconds()
+{
+#ifdef _WIN32
+   LARGE_INTEGER frequency, counter;
+   QueryPerformanceFrequency(&frequency);
+   QueryPerformanceCounter(&counter);
+   return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+   timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return now.tv_sec + now.tv_nsec * 1e-9;
+#endif
+}
+
+static double TimeFrames(COceanSimulation& ocean, double dMinSeconds, double dJitter)
+{
+   // -------------------------------------------------------------------------
+   // Warm up, then grow the frame count until one timing run takes at least
+   // dMinSeconds. The time advances every frame as it would when rendering:
+   // by 1/60 s, give or take up to dJitter seconds, as a real frame clock
+   // does. The jitter comes from a fixed sequence so runs compare.
+   // -------------------------------------------------------------------------
+   double dTime = 0.0;
+   unsigned int nRandom = 12345;
+   ocean.Update(dTime);
+
+   int nFrames = 1;
+   for (;;)
+   {
+      double dStart = GetSeconds();
+      for (int f = 0; f < nFrames; f++)
+      {
+         nRandom = nRandom * 1664525u + 1013904223u;
+         dTime += 1.0 / 60.0 + dJitter * ((nRandom >> 8) * (2.0 / 16777216.0) - 1.0);
+         ocean.Update(dTime);
+      }
+      double dElapsed = GetSeconds() - dStart;
+
+      if (dElapsed >= dMinSeconds)
+      {
+         return dElapsed / nFrames;
+      }
+      nFrames *= 2;
+   }
+}
+
+static void BuildBackends(vector<OceanBackend>& backends)
+{
+   // -------------------------------------------------------------------------
+   // Every SIMD level this processor runs, then the best level without the
+   // fixed-size transforms, with the spectrum stored before the transform,
+   // with the strided column pass (which reads a stored spectrum) and with
+   // the Stockham column pass.
+   // -------------------------------------------------------------------------
+   int nCpuLevel = GetCpuSimdLevel();
+   OceanBackend backend;
+
+   for (int nLevel = SIMD_LEVEL_SCALAR; nLevel <= nCpuLevel; nLevel++)
+   {
+      sprintf(backend.csName, "%s", GetSimdLevelName(nLevel));
+      backend.nSimdLevel = nLevel;
+      backend.blFixedKernels = true;
+      backend.nColumnPassMode = FFT2D_COLUMNS_BLOCKED;
+      backend.blFusedTransform = true;
+      backends.push_back(backend);
+   }
+
+   sprintf(backend.csName, "%s-nofixed", GetSimdLevelName(nCpuLevel));
+   backend.nSimdLevel = nCpuLevel;
+   backend.blFixedKernels = false;
+   backend.nColumnPassMode = FFT2D_COLUMNS_BLOCKED;
+   backend.blFusedTransform = true;
+   backends.push_back(backend);
+
+   sprintf(backend.csName, "%s-unfused", GetSimdLevelName(nCpuLevel));
+   backend.nSimdLevel = nCpuLevel;
+   backend.blFixedKernels = true;
+   backend.nColumnPassMode = FFT2D_COLUMNS_BLOCKED;
+   backend.blFusedTransform = false;
+   backends.push_back(backend);
+
+   sprintf(backend.csName, "%s-strided", GetSimdLevelName(nCpuLevel));
+   backend.nSimdLevel = nCpuLevel;
+   backend.blFixedKernels = true;
+   backend.nColumnPassMode = FFT2D_COLUMNS_STRIDED;
+   backend.blFusedTransform = false;
+   backends.push_back(backend);
+
+   sprintf(backend.csName, "%s-stockham", GetSimdLevelName(nCpuLevel));
+   backend.nSimdLevel = nCpuLevel;
+   backend.blFixedKernels = true;
+   backend.nColumnPassMode = FFT2D_COLUMNS_STOCKHAM;
+   backend.blFusedTransform = true;
+   backends.push_back(backend);
+}
+
+static void GetFrameCost(int nSize, int nFields, int nCacheFormat, double& dFlops, double& dBytes)
+{
+   double dPoints = (double)nSize * nSize;
+   double dSpectrumBins = (double)nSize * (nSize / 2 + 1);
+
+   if (nCacheFormat >= 0)
+   {
+      double dSampleBytes = (nCacheFormat == OCEAN_FRAME_CACHE_INT16) ? sizeof(short) : sizeof(float);
+      dFlops = 0.0;
+      dBytes = nFields * dPoints * (2.0 * dSampleBytes + sizeof(float));
+      return;
+   }
+
+   dFlops = nFields * 2.5 * dPoints * (log(dPoints) / log(2.0));
+
+   // -------------------------------------------------------------------------
+   // Spectrum update: h0(k), h0(-k), k and the phasor step in, the phasor
+   // read and written, each complex value two floats. Transform: the planes
+   // written and read, the output written already scaled.
+   // -------------------------------------------------------------------------
+   double dUpdateBytes = dSpectrumBins * (
+      5.0 * 2.0 * sizeof(float) +
+      2.0 * sizeof(float));
+   double dTransformBytes = nFields * (
+      2.0 * dSpectrumBins * 2.0 * sizeof(float) +
+      dPoints * sizeof(float));
+
+   dBytes = dUpdateBytes + dTransformBytes;
+}
+
+static void WriteJson(FILE* pFile, const vector<OceanResult>& results)
+{
+   fprintf(pFile, "{\n");
+   fprintf(pFile, "  \"simd\": \"%s\",\n", GetSimdLevelName(GetCpuSimdLevel()));
+   fprintf(pFile, "  \"hardware_threads\": %d,\n", GetHardwareThreadCount());
+   fprintf(pFile, "  \"results\": [\n");
+
+   for (size_t i = 0; i < results.size(); i++)
+   {
+      const OceanResult& result = results[i];
+      fprintf(pFile,
+         "    { \"size\": %d, \"backend\": \"%s\", \"threads\": %d, \"fields\": %d, "
+         "\"ns_per_frame\": %.0f, \"gflops\": %.3f, \"bytes_per_frame\": %.0f, \"gb_per_s\": %.3f }%s\n",
+         result.nSize,
+         result.pBackendName,
+         result.nThreads,
+         result.nFields,
+         result.dSecondsPerFrame * 1e9,
+         result.dFlops / result.dSecondsPerFrame * 1e-9,
+         result.dBytes,
+         result.dBytes / result.dSecondsPerFrame * 1e-9,
+         (i + 1 < results.size()) ? "," : "");
+   }
+
+   fprintf(pFile, "  ]\n");
+   fprintf(pFile, "}\n");
+}
+
+static void WriteCsv(FILE* pFile, const vector<OceanResult>& results)
+{
+   fprintf(pFile, "size,backend,threads,fields,ns_per_frame,gflops,bytes_per_frame,gb_per_s\n");
+
+   for (size_t i = 0; i < results.size(); i++)
+   {
+      const OceanResult& result = results[i];
+      fprintf(pFile, "%d,%s,%d,%d,%.0f,%.3f,%.0f,%.3f\n",
+         result.nSize,
+         result.pBackendName,
+         result.nThreads,
+         result.nFields,
+         result.dSecondsPerFrame * 1e9,
+         result.dFlops / result.dSecondsPerFrame * 1e-9,
+         result.dBytes,
+         result.dBytes / result.dSecondsPerFrame * 1e-9);
+   }
+}
+
+static bool WriteFile(const char* pPath, bool blJson, const vector<OceanResult>& results)
+{
+   FILE* pFile = fopen(pPath, "w");
+   if (pFile == NULL)
+   {
+      printf("cannot write %s\n", pPath);
+      return false;
+   }
+
+   if (blJson)
+   {
+      WriteJson(pFile, results);
+   }
+   else
+   {
+      WriteCsv(pFile, results);
+   }
+
+   fclose(pFile);
+   return true;
+}
+
+static void PrintUsage(FILE* pFile)
+{
+   fprintf(pFile,
+      "usage: ocean_benchmark [-threads N] [-choppiness C] [-time S]\n"
+      "                       [-evolution absolute|incremental]\n"
+      "                       [-jitter J] [-loop T] [-cache F] [-quantize]\n"
+      "                       [-json FILE] [-csv FILE] [size ...]\n"
+      "  -threads N     largest thread count, and every power of two below it;\n"
+      "                 0 (the default) uses the hardware thread count\n"
+      "  -choppiness C  0 leaves out the two displacement fields\n"
+      "  -time S        minimum seconds spent timing each case\n"
+      "  -evolution     how the spectrum phases advance, incremental by default\n"
+      "  -jitter J      most a frame's time step strays from 1/60 s, in ms\n"
+      "  -loop T        loop period in seconds\n"
+      "  -cache F       frames of the loop played back from the frame cache\n"
+      "  -quantize      store the cached frames as 16 bit samples\n"
+      "  -json, -csv    also write the results to FILE\n"
+      "  size           FFT sizes to run, 32 through 2048 by default\n");
+}
+
+// -------------------------------------------------------------------------
+// Whole-string conversions; a partial number such as "64x" is rejected.
+// -------------------------------------------------------------------------
+static bool ParseInt(const char* pText, int& nValue)
+{
+   char* pEnd = NULL;
+   long lValue = strtol(pText, &pEnd, 10);
+
+   if (pEnd == pText || *pEnd != '\0' || lValue < -2147483647L || lValue > 2147483647L)
+   {
+      return false;
+   }
+
+   nValue = (int)lValue;
+   return true;
+}
+
+static bool ParseDouble(const char* pText, double& dValue)
+{
+   char* pEnd = NULL;
+   dValue = strtod(pText, &pEnd);
+   return pEnd != pText && *pEnd == '\0';
+}
+
+static bool IsValueOption(const char* pOption)
+{
+   static const char* s_apOptions[] =
+   {
+      "-threads", "-choppiness", "-time", "-evolution", "-jitter", "-loop", "-cache", "-json", "-csv"
+   };
+
+   for (int o = 0; o < (int)(sizeof(s_apOptions) / sizeof(s_apOptions[0])); o++)
+   {
+      if (strcmp(pOption, s_apOptions[o]) == 0)
+      {
+         return true;
+      }
+   }
+
+   return false;
+}
+
+int main(int argc, char* argv[])
+{
+   vector<int> sizes;
+   int nMaxThreads = 0;
+   float fChoppiness = OCEAN_CHOPPINESS;
+   double dMinSeconds = 0.25;
+   double dJitter = 0.25e-3;
+   int nEvolutionMode = OCEAN_EVOLUTION_INCREMENTAL;
+   float fLoopPeriod = 0.0f;
+   int nCacheFrames = 0;
+   int nCacheFormat = OCEAN_FRAME_CACHE_FLOAT;
+   const char* pJsonPath = NULL;
+   const char* pCsvPath = NULL;
+
+   for (int i = 1; i < argc; i++)
+   {
+      const char* pOption = argv[i];
+      const char* pValue = (i + 1 < argc) ? argv[i + 1] : NULL;
+      bool blValid = true;
+      double dValue = 0.0;
+
+      if (strcmp(pOption, "-h") == 0 || strcmp(pOption, "--help") == 0)
+      {
+         PrintUsage(stdout);
+         return 0;
+      }
+      else if (strcmp(pOption, "-quantize") == 0)
+      {
+         nCacheFormat = OCEAN_FRAME_CACHE_INT16;
+         continue;
+      }
+      else if (pOption[0] != '-')
+      {
+         int nSize = 0;
+         blValid = ParseInt(pOption, nSize) && nSize > 0;
+         sizes.push_back(nSize);
+      }
+      else if (!IsValueOption(pOption))
+      {
+         fprintf(stderr, "ocean_benchmark: unknown option %s\n", pOption);
+         PrintUsage(stderr);
+         return 1;
+      }
+      else if (pValue == NULL)
+      {
+         fprintf(stderr, "ocean_benchmark: %s needs a value\n", pOption);
+         PrintUsage(stderr);
+         return 1;
+      }
+      else if (strcmp(pOption, "-threads") == 0)
+      {
+         blValid = ParseInt(pValue, nMaxThreads);
+      }
+      else if (strcmp(pOption, "-choppiness") == 0)
+      {
+         blValid = ParseDouble(pValue, dValue);
+         fChoppiness = (float)dValue;
+      }
+      else if (strcmp(pOption, "-time") == 0)
+      {
+         blValid = ParseDouble(pValue, dMinSeconds);
+      }
+      else if (strcmp(pOption, "-evolution") == 0)
+      {
+         blValid = (strcmp(pValue, "absolute") == 0 || strcmp(pValue, "incremental") == 0);
+         nEvolutionMode = (strcmp(pValue, "absolute") == 0) ?
+            OCEAN_EVOLUTION_ABSOLUTE : OCEAN_EVOLUTION_INCREMENTAL;
+      }
+      else if (strcmp(pOption, "-jitter") == 0)
+      {
+         blValid = ParseDouble(pValue, dValue);
+         dJitter = dValue * 1e-3;
+      }
+      else if (strcmp(pOption, "-loop") == 0)
+      {
+         blValid = ParseDouble(pValue, dValue);
+         fLoopPeriod = (float)dValue;
+      }
+      else if (strcmp(pOption, "-cache") == 0)
+      {
+         blValid = ParseInt(pValue, nCacheFrames);
+      }
+      else if (strcmp(pOption, "-json") == 0)
+      {
+         pJsonPath = pValue;
+      }
+      else
+      {
+         pCsvPath = pValue;
+      }
+
+      if (pOption[0] != '-')
+      {
+         if (!blValid)
+         {
+            fprintf(stderr, "ocean_benchmark: invalid size %s\n", pOption);
+            PrintUsage(stderr);
+            return 1;
+         }
+
+         continue;
+      }
+
+      if (!blValid)
+      {
+         fprintf(stderr, "ocean_benchmark: invalid value for %s: %s\n", pOption, pValue);
+         PrintUsage(stderr);
+         return 1;
+      }
+
+      i++;
+   }
+
+   if (sizes.empty())
+   {
+      for (int n = 32; n <= 2048; n *= 2)
+      {
+         sizes.push_back(n);
+      }
+   }
+
+   if (nMaxThreads <= 0)
+   {
+      nMaxThreads = GetHardwareThreadCount();
+   }
+
+   vector<int> threadCounts;
+   for (int n = 1; n < nMaxThreads; n *= 2)
+   {
+      threadCounts.push_back(n);
+   }
+   threadCounts.push_back(nMaxThreads);
+
+   vector<OceanBackend> backends;
+   BuildBackends(backends);
+
+   printf("cpu simd: %s, hardware threads: %d, frame jitter: %.3f ms\n",
+      GetSimdLevelName(GetCpuSimdLevel()),
+      GetHardwareThreadCount(),
+      dJitter * 1e3);
+   printf("%6s %14s %8s %7s %12s %10s %10s %10s\n",
+      "size", "backend", "threads", "fields", "us/frame", "ns/point", "GFLOP/s", "GB/s");
+
+   vector<OceanResult> results;
+
+   for (size_t s = 0; s < sizes.size(); s++)
+   {
+      for (size_t b = 0; b < backends.size(); b++)
+      {
+         const OceanBackend& backend = backends[b];
+
+         // -------------------------------------------------------------------
+         // The plans pick their kernels when they are built, so the backend
+         // settings go in before Init().
+         // -------------------------------------------------------------------
+         SetSimdLevelLimit(backend.nSimdLevel);
+         SetFixedFFTKernelsEnabled(backend.blFixedKernels);
+
+         COceanSimulation ocean;
+         ocean.SetChoppiness(fChoppiness);
+         ocean.SetEvolutionMode(nEvolutionMode);
+         ocean.SetFusedTransform(backend.blFusedTransform);
+         ocean.SetFFTThreadCount(threadCounts[0]);
+         ocean.SetLoopPeriod(fLoopPeriod);
+         ocean.SetFrameCache(nCacheFrames, nCacheFormat);
+
+         if (!ocean.SetFFTSize(sizes[s]) || !ocean.Init())
+         {
+            printf("%6d unsupported size\n", sizes[s]);
+            break;
+         }
+         ocean.GetFFT().SetColumnPassMode(backend.nColumnPassMode);
+
+         for (size_t t = 0; t < threadCounts.size(); t++)
+         {
+            ocean.SetFFTThreadCount(threadCounts[t]);
+
+            OceanResult result;
+            result.nSize = sizes[s];
+            result.pBackendName = backend.csName;
+            result.nThreads = ocean.GetFFTThreadCount();
+            result.nFields = ocean.GetActiveFieldCount();
+            result.dSecondsPerFrame = TimeFrames(ocean, dMinSeconds, dJitter);
+            GetFrameCost(
+               result.nSize,
+               result.nFields,
+               (fLoopPeriod > 0.0f && nCacheFrames > 0) ? nCacheFormat : -1,
+               result.dFlops,
+               result.dBytes);
+            results.push_back(result);
+
+            printf("%6d %14s %8d %7d %12.2f %10.3f %10.2f %10.2f\n",
+               result.nSize,
+               result.pBackendName,
+               result.nThreads,
+               result.nFields,
+               result.dSecondsPerFrame * 1e6,
+               result.dSecondsPerFrame * 1e9 / ((double)result.nSize * result.nSize),
+               result.dFlops / result.dSecondsPerFrame * 1e-9,
+               result.dBytes / result.dSecondsPerFrame * 1e-9);
+            fflush(stdout);
+         }
+      }
+   }
+
+   if (pJsonPath != NULL && !WriteFile(pJsonPath, true, results))
+   {
+      return 1;
+   }
+
+   if (pCsvPath != NULL && !WriteFile(pCsvPath, false, results))
+   {
+      return 1;
+   }
+
+   return 0;
+}
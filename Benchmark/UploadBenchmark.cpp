@@ -0,0 +1,196 @@
+// -------------------------------------------------------------------------
+// Sean Janis
+// spjanis@gmail.com
+// Water Simulations
+//
+// UploadBenchmark
+//       Console benchmark for CUploadRing on a CCpuUploadSink. Each frame
+//       uploads a grid's dynamic vertices, copying a packed frame into the
+//       span the ring locks, as the water surface does every Update. It
+//       sweeps grid sizes, ring capacities and how many frames the
+//       simulated GPU runs behind, and reports the share of locks that
+//       discard, the wraps per frame, the most frames in flight, the time
+//       per frame and the bytes uploaded per second.
+//
+//       The hazards column counts no-overwrite locks over a span the GPU
+//       could still be reading, and should always be 0. Discards are what
+//       a real driver answers with fresh memory, so they grow with the GPU
+//       latency once the ring holds fewer frames than are in flight.
+//
+//       Usage: upload_benchmark [-stride B] [-latency L] [-time S]
+//                               [size ...]
+//              B is the bytes per vertex, 12 by default, see the layouts
+//              in WaterVertexStreams.h.
+//              L is the largest GPU latency tried, in frames; every one
+//              from 0 up is run. 3 by default.
+//              S is the minimum seconds spent timing each case.
+//              The grid sizes default to 64 through 1024.
+// -------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "AlignedBuffer.h"
+#include "UploadRing.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+using namespace std;
+
+static double GetSeconds()
+{
+#ifdef _WIN32
+   LARGE_INTEGER frequency, counter;
+   QueryPerformanceFrequency(&frequency);
+   QueryPerformanceCounter(&counter);
+   return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+   timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return now.tv_sec + now.tv_nsec * 1e-9;
+#endif
+}
+
+static bool UploadFrame(CUploadRing& ring, const unsigned char* pFrame, int nBytes)
+{
+   int nOffset = 0;
+   void* pData = ring.Lock(nBytes, nOffset);
+
+   if (pData == NULL)
+   {
+      return false;
+   }
+
+   memcpy(pData, pFrame, nBytes);
+   ring.Unlock();
+   ring.EndFrame();
+   return true;
+}
+
+static double TimeFrames(
+   CUploadRing& ring,
+   const unsigned char* pFrame,
+   int nBytes,
+   double dMinSeconds)
+{
+   // -------------------------------------------------------------------------
+   // Warm up, then grow the frame count until one timing run takes at least
+   // dMinSeconds. The statistics cover the last run only.
+   // -------------------------------------------------------------------------
+   UploadFrame(ring, pFrame, nBytes);
+
+   int nFrames = 1;
+   for (;;)
+   {
+      ring.ResetStats();
+
+      double dStart = GetSeconds();
+      for (int f = 0; f < nFrames; f++)
+      {
+         UploadFrame(ring, pFrame, nBytes);
+      }
+      double dElapsed = GetSeconds() - dStart;
+
+      if (dElapsed >= dMinSeconds)
+      {
+         return dElapsed / nFrames;
+      }
+      nFrames *= 2;
+   }
+}
+
+int main(int argc, char* argv[])
+{
+   int nStride = 12;
+   int nMaxLatency = 3;
+   double dMinSeconds = 0.1;
+   vector<int> sizes;
+
+   for (int i = 1; i < argc; i++)
+   {
+      if (strcmp(argv[i], "-stride") == 0 && i + 1 < argc)
+      {
+         nStride = atoi(argv[++i]);
+      }
+      else if (strcmp(argv[i], "-latency") == 0 && i + 1 < argc)
+      {
+         nMaxLatency = atoi(argv[++i]);
+      }
+      else if (strcmp(argv[i], "-time") == 0 && i + 1 < argc)
+      {
+         dMinSeconds = atof(argv[++i]);
+      }
+      else
+      {
+         sizes.push_back(atoi(argv[i]));
+      }
+   }
+
+   if (sizes.empty())
+   {
+      for (int n = 64; n <= 1024; n *= 2)
+      {
+         sizes.push_back(n);
+      }
+   }
+
+   printf("stride: %d bytes\n", nStride);
+   printf("%6s %7s %8s %9s %10s %10s %8s %10s %8s\n",
+      "size", "frames", "latency", "discard%", "wraps/f", "in flight", "hazards", "us/frame", "GB/s");
+
+   for (size_t s = 0; s < sizes.size(); s++)
+   {
+      int nBytes = sizes[s] * sizes[s] * nStride;
+      CAlignedBuffer<unsigned char> frame;
+
+      if (!frame.Allocate(nBytes))
+      {
+         printf("%6d out of memory\n", sizes[s]);
+         break;
+      }
+
+      for (int b = 0; b < nBytes; b++)
+      {
+         frame[b] = (unsigned char)b;
+      }
+
+      for (int nRingFrames = 1; nRingFrames <= 4; nRingFrames++)
+      {
+         for (int nLatency = 0; nLatency <= nMaxLatency; nLatency++)
+         {
+            CCpuUploadSink sink;
+            sink.SetLatency(nLatency);
+
+            CUploadRing ring;
+
+            if (!ring.Init(&sink, nRingFrames * nBytes))
+            {
+               printf("%6d out of memory\n", sizes[s]);
+               break;
+            }
+
+            double dSeconds = TimeFrames(ring, frame.GetData(), nBytes, dMinSeconds);
+            const UploadRingStats& stats = ring.GetStats();
+
+            printf("%6d %7d %8d %9.1f %10.3f %10d %8d %10.2f %8.2f\n",
+               sizes[s],
+               nRingFrames,
+               nLatency,
+               100.0 * stats.nDiscardLocks / stats.nLocks,
+               (double)stats.nWraps / stats.nFrames,
+               stats.nMaxFramesInFlight,
+               sink.GetHazardCount(),
+               dSeconds * 1e6,
+               stats.dBytes / stats.nFrames / dSeconds * 1e-9);
+            fflush(stdout);
+         }
+      }
+   }
+
+   return 0;
+}
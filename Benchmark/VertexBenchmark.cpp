@@ -0,0 +1,226 @@
+// -------------------------------------------------------------------------
+// Sean Janis
+// spjanis@gmail.com
+// Water Simulations
+//
+// VertexBenchmark
+//       Console benchmark for CWaterVertexPacker. It packs the dynamic
+//       vertex stream of a render grid from the fields of a live ocean
+//       frame in every encoding, see WaterVertexStreams.h, at each SIMD
+//       level, and reports the bytes per vertex, the bytes uploaded per
+//       frame, the time to pack a frame and how far the decoded vertices
+//       are from the floats: the largest and RMS height error and the
+//       largest offset error in world units, and the largest normal error
+//       in degrees.
+//
+//       Usage: vertex_benchmark [-fft N] [-choppiness C] [-time S]
+//                               [size ...]
+//              N is the resolution of the ocean, 256 by default.
+//              C = 0 leaves out the two displacement fields, and with them
+//              the choppy layouts.
+//              S is the minimum seconds spent timing each case.
+//              The grid sizes default to 64 through 1024.
+// -------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "OceanSimulation.h"
+#include "CpuFeatures.h"
+#include "AlignedBuffer.h"
+#include "WaterVertexStreams.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+using namespace std;
+
+static const char* s_apWaveFormatNames[WATER_WAVE_FORMAT_COUNT] = { "float32", "float16", "int16" };
+static const char* s_apNormalFormatNames[WATER_NORMAL_FORMAT_COUNT] = { "color", "oct16", "oct8" };
+
+static double GetSeconds()
+{
+#ifdef _WIN32
+   LARGE_INTEGER frequency, counter;
+   QueryPerformanceFrequency(&frequency);
+   QueryPerformanceCounter(&counter);
+   return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+   timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return now.tv_sec + now.tv_nsec * 1e-9;
+#endif
+}
+
+static double TimePack(
+   CWaterVertexPacker& packer,
+   const WaterFieldFrame& frame,
+   void* pOutput,
+   double dMinSeconds)
+{
+   // -------------------------------------------------------------------------
+   // Warm up, then grow the frame count until one timing run takes at least
+   // dMinSeconds.
+   // -------------------------------------------------------------------------
+   WaterDynamicConstants constants;
+   packer.Pack(frame, pOutput, constants);
+
+   int nFrames = 1;
+   for (;;)
+   {
+      double dStart = GetSeconds();
+      for (int f = 0; f < nFrames; f++)
+      {
+         packer.Pack(frame, pOutput, constants);
+      }
+      double dElapsed = GetSeconds() - dStart;
+
+      if (dElapsed >= dMinSeconds)
+      {
+         return dElapsed / nFrames;
+      }
+      nFrames *= 2;
+   }
+}
+
+int main(int argc, char* argv[])
+{
+   int nFFTSize = 256;
+   float fChoppiness = 1.0f;
+   double dMinSeconds = 0.1;
+   vector<int> sizes;
+
+   for (int i = 1; i < argc; i++)
+   {
+      if (strcmp(argv[i], "-fft") == 0 && i + 1 < argc)
+      {
+         nFFTSize = atoi(argv[++i]);
+      }
+      else if (strcmp(argv[i], "-choppiness") == 0 && i + 1 < argc)
+      {
+         fChoppiness = (float)atof(argv[++i]);
+      }
+      else if (strcmp(argv[i], "-time") == 0 && i + 1 < argc)
+      {
+         dMinSeconds = atof(argv[++i]);
+      }
+      else
+      {
+         sizes.push_back(atoi(argv[i]));
+      }
+   }
+
+   if (sizes.empty())
+   {
+      for (int n = 64; n <= 1024; n *= 2)
+      {
+         sizes.push_back(n);
+      }
+   }
+
+   // -------------------------------------------------------------------------
+   // One ocean frame a second in, packed over and over.
+   // -------------------------------------------------------------------------
+   COceanSimulation ocean;
+   ocean.SetChoppiness(fChoppiness);
+
+   if (!ocean.SetFFTSize(nFFTSize) || !ocean.Init())
+   {
+      printf("unsupported ocean size %d\n", nFFTSize);
+      return 1;
+   }
+   ocean.Update(1.0);
+
+   WaterFieldFrame frame;
+   memset(&frame, 0, sizeof(frame));
+   frame.nWidth = nFFTSize;
+   frame.nHeight = nFFTSize;
+   frame.nFields = ocean.GetActiveFieldCount();
+   frame.fChoppiness = ocean.GetChoppiness();
+
+   for (int f = 0; f < frame.nFields; f++)
+   {
+      frame.apMaps[f] = ocean.GetField(f);
+   }
+
+   printf("cpu simd: %s, ocean: %d, choppy: %s\n",
+      GetSimdLevelName(GetCpuSimdLevel()),
+      nFFTSize,
+      IsWaterFrameChoppy(frame) ? "yes" : "no");
+   printf("%6s %8s %8s %7s %7s %9s %10s %8s %10s %10s %10s %9s\n",
+      "size", "simd", "wave", "normal", "B/vert", "MB/frame", "us/frame", "GB/s",
+      "max h", "rms h", "max xz", "max deg");
+
+   for (size_t s = 0; s < sizes.size(); s++)
+   {
+      WaterGridLayout grid;
+      grid.nRows = sizes[s];
+      grid.nColumns = sizes[s];
+      grid.fXSpacing = 1.0f;
+      grid.fZSpacing = 1.0f;
+      grid.fXOffset = -0.5f * (sizes[s] - 1);
+      grid.fZOffset = 0.5f * (sizes[s] - 1);
+
+      int nVertices = grid.nRows * grid.nColumns;
+      CAlignedBuffer<unsigned char> output;
+
+      if (!output.Allocate(nVertices * WATER_DYNAMIC_VERTEX_MAX_SIZE))
+      {
+         printf("%6d out of memory\n", sizes[s]);
+         break;
+      }
+
+      for (int nLevel = SIMD_LEVEL_SCALAR; nLevel <= GetCpuSimdLevel(); nLevel++)
+      {
+         // -------------------------------------------------------------------
+         // The packer picks its kernels in Init().
+         // -------------------------------------------------------------------
+         SetSimdLevelLimit(nLevel);
+
+         CWaterVertexPacker packer;
+
+         if (!packer.Init(grid))
+         {
+            printf("%6d out of memory\n", sizes[s]);
+            break;
+         }
+
+         for (int w = 0; w < WATER_WAVE_FORMAT_COUNT; w++)
+         {
+            for (int n = 0; n < WATER_NORMAL_FORMAT_COUNT; n++)
+            {
+               packer.SetFormat(w, n);
+
+               double dSeconds = TimePack(packer, frame, output.GetData(), dMinSeconds);
+
+               WaterDynamicConstants constants;
+               int nBytes = packer.Pack(frame, output.GetData(), constants);
+
+               WaterPackingError error;
+               packer.MeasureError(frame, output.GetData(), constants, error);
+
+               printf("%6d %8s %8s %7s %7d %9.3f %10.2f %8.2f %10.2e %10.2e %10.2e %9.3f\n",
+                  sizes[s],
+                  GetSimdLevelName(nLevel),
+                  s_apWaveFormatNames[w],
+                  s_apNormalFormatNames[n],
+                  nBytes / nVertices,
+                  nBytes / (1024.0 * 1024.0),
+                  dSeconds * 1e6,
+                  nBytes / dSeconds * 1e-9,
+                  error.fMaxHeightError,
+                  error.fRmsHeightError,
+                  error.fMaxOffsetError,
+                  error.fMaxNormalDegrees);
+               fflush(stdout);
+            }
+         }
+      }
+   }
+
+   return 0;
+}
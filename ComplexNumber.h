@@ -1,7 +0,0 @@
-#pragma once
-
-struct ComplexNumber
-{
-   float fReal;
-   float fImaginary;
-};
\ No newline at end of file
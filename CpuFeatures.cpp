@@ -0,0 +1,126 @@
+#include "CpuFeatures.h"
+
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#define CPU_FEATURES_X86
+#elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#include <cpuid.h>
+#define CPU_FEATURES_X86
+#endif
+
+static int s_nSimdLevelLimit = SIMD_LEVEL_AVX2;
+
+#ifdef CPU_FEATURES_X86
+static void GetCpuId(int nLeaf, int nSubLeaf, int registers[4])
+{
+#if defined(_MSC_VER)
+#if _MSC_VER >= 1600
+   __cpuidex(registers, nLeaf, nSubLeaf);
+#else
+   (void)nSubLeaf;
+   __cpuid(registers, nLeaf);
+#endif
+#else
+   unsigned int a, b, c, d;
+   __cpuid_count(nLeaf, nSubLeaf, a, b, c, d);
+   registers[0] = (int)a;
+   registers[1] = (int)b;
+   registers[2] = (int)c;
+   registers[3] = (int)d;
+#endif
+}
+
+static unsigned long long GetXCR0()
+{
+#if defined(_MSC_VER)
+#if _MSC_VER >= 1600
+   return _xgetbv(0);
+#else
+   return 0;
+#endif
+#else
+   unsigned int nLow, nHigh;
+   __asm__ __volatile__ ("xgetbv" : "=a"(nLow), "=d"(nHigh) : "c"(0));
+   return ((unsigned long long)nHigh << 32) | nLow;
+#endif
+}
+#endif
+
+static int DetectCpuSimdLevel()
+{
+   int nLevel = SIMD_LEVEL_SCALAR;
+
+#ifdef CPU_FEATURES_X86
+   int registers[4];
+   GetCpuId(0, 0, registers);
+   int nMaxLeaf = registers[0];
+
+   GetCpuId(1, 0, registers);
+   if ((registers[3] & (1 << 26)) == 0)
+   {
+      return nLevel;
+   }
+   nLevel = SIMD_LEVEL_SSE2;
+
+   // -------------------------------------------------------------------------
+   // AVX2 also needs the OS to save the YMM registers (OSXSAVE + XCR0). The
+   // level includes F16C, which every AVX2 processor has.
+   // -------------------------------------------------------------------------
+   bool blOSXSave = (registers[2] & (1 << 27)) != 0;
+   bool blAVX = (registers[2] & (1 << 28)) != 0;
+   bool blF16C = (registers[2] & (1 << 29)) != 0;
+   if (!blOSXSave || !blAVX || !blF16C || nMaxLeaf < 7)
+   {
+      return nLevel;
+   }
+
+   if ((GetXCR0() & 0x6) != 0x6)
+   {
+      return nLevel;
+   }
+
+   GetCpuId(7, 0, registers);
+   if ((registers[1] & (1 << 5)) != 0)
+   {
+      nLevel = SIMD_LEVEL_AVX2;
+   }
+#endif
+
+   return nLevel;
+}
+
+int GetCpuSimdLevel()
+{
+   static int s_nCpuSimdLevel = -1;
+   if (s_nCpuSimdLevel < 0)
+   {
+      s_nCpuSimdLevel = DetectCpuSimdLevel();
+   }
+
+   return s_nCpuSimdLevel;
+}
+
+int GetSimdLevel()
+{
+   int nLevel = GetCpuSimdLevel();
+   return (nLevel < s_nSimdLevelLimit) ? nLevel : s_nSimdLevelLimit;
+}
+
+void SetSimdLevelLimit(int nLevel)
+{
+   s_nSimdLevelLimit = nLevel;
+}
+
+const char* GetSimdLevelName(int nLevel)
+{
+   switch (nLevel)
+   {
+      case SIMD_LEVEL_SSE2:
+         return "sse2";
+
+      case SIMD_LEVEL_AVX2:
+         return "avx2";
+   }
+
+   return "scalar";
+}
@@ -0,0 +1,28 @@
+// -------------------------------------------------------------------------
+// Sean Janis
+// spjanis@gmail.com
+// Water Simulations
+//
+// CpuFeatures
+//       Runtime detection of the SIMD instruction sets used by the
+//       simulation kernels. The detected level can be capped so slower code
+//       paths can be forced for comparison.
+// -------------------------------------------------------------------------
+#pragma once
+
+#define SIMD_LEVEL_SCALAR              0
+#define SIMD_LEVEL_SSE2                1
+#define SIMD_LEVEL_AVX2                2     // AVX2 and F16C
+
+// -------------------------------------------------------------------------
+// Highest level supported by both the processor and the operating system.
+// -------------------------------------------------------------------------
+int GetCpuSimdLevel();
+
+// -------------------------------------------------------------------------
+// Level the kernels should use: the CPU level, capped by SetSimdLevelLimit.
+// -------------------------------------------------------------------------
+int GetSimdLevel();
+void SetSimdLevelLimit(int nLevel);
+
+const char* GetSimdLevelName(int nLevel);
@@ -0,0 +1,109 @@
+#include "DXUT.h"
+#include "D3DUploadSink.h"
+
+CD3DUploadSink::CD3DUploadSink(IDirect3DDevice9* pDirect3D9Device)
+{
+   m_pDirect3D9Device = pDirect3D9Device;
+   m_pVertexBuffer = NULL;
+
+   for (int f = 0; f < UPLOAD_RING_MAX_FRAMES; f++)
+   {
+      m_apFences[f] = NULL;
+   }
+}
+
+CD3DUploadSink::~CD3DUploadSink()
+{
+   Destroy();
+}
+
+bool CD3DUploadSink::Create(int nBytes)
+{
+   Destroy();
+
+   if (S_OK != m_pDirect3D9Device->CreateVertexBuffer(
+      nBytes, 
+      D3DUSAGE_DYNAMIC | D3DUSAGE_WRITEONLY, 
+      0, 
+      D3DPOOL_DEFAULT, 
+      &m_pVertexBuffer, 
+      0))
+   {
+      m_pVertexBuffer = NULL;
+      return false;
+   }
+
+   // -------------------------------------------------------------------------
+   // A fence left NULL never completes.
+   // -------------------------------------------------------------------------
+   for (int f = 0; f < UPLOAD_RING_MAX_FRAMES; f++)
+   {
+      if (FAILED(m_pDirect3D9Device->CreateQuery(D3DQUERYTYPE_EVENT, &m_apFences[f])))
+      {
+         m_apFences[f] = NULL;
+      }
+   }
+
+   return true;
+}
+
+void CD3DUploadSink::Destroy()
+{
+   if (m_pVertexBuffer != NULL)
+   {
+      m_pVertexBuffer->Release();
+      m_pVertexBuffer = NULL;
+   }
+
+   for (int f = 0; f < UPLOAD_RING_MAX_FRAMES; f++)
+   {
+      if (m_apFences[f] != NULL)
+      {
+         m_apFences[f]->Release();
+         m_apFences[f] = NULL;
+      }
+   }
+}
+
+void* CD3DUploadSink::Lock(int nOffset, int nBytes, bool blDiscard)
+{
+   void* pData = NULL;
+
+   if (m_pVertexBuffer == NULL || 
+       FAILED(m_pVertexBuffer->Lock(nOffset, nBytes, &pData, blDiscard ? D3DLOCK_DISCARD : D3DLOCK_NOOVERWRITE)))
+   {
+      return NULL;
+   }
+
+   return pData;
+}
+
+void CD3DUploadSink::Unlock()
+{
+   if (m_pVertexBuffer != NULL)
+   {
+      m_pVertexBuffer->Unlock();
+   }
+}
+
+void CD3DUploadSink::IssueFence(int nFence)
+{
+   if (m_apFences[nFence] != NULL)
+   {
+      m_apFences[nFence]->Issue(D3DISSUE_END);
+   }
+}
+
+bool CD3DUploadSink::IsFenceComplete(int nFence)
+{
+   // -------------------------------------------------------------------------
+   // S_FALSE while the GPU has yet to get there. No flush: the frame's
+   // Present sends the commands on soon enough.
+   // -------------------------------------------------------------------------
+   return m_apFences[nFence] != NULL && m_apFences[nFence]->GetData(NULL, 0, 0) == S_OK;
+}
+
+IDirect3DVertexBuffer9* CD3DUploadSink::GetBuffer()
+{
+   return m_pVertexBuffer;
+}
@@ -0,0 +1,43 @@
+// -------------------------------------------------------------------------
+// Sean Janis
+// spjanis@gmail.com
+// Water Simulations
+//
+// CD3DUploadSink
+//       CUploadSink over a dynamic, write-only vertex buffer in the default
+//       pool, with an event query for each fence. Without event queries no
+//       fence ever completes, so the ring discards whenever it would have
+//       wrapped, which costs driver memory rather than a stall.
+//
+//       Default pool buffers do not survive a lost device: Destroy before
+//       the device is reset and Create again after.
+// -------------------------------------------------------------------------
+#pragma once
+
+#include <d3d9.h>
+#include "UploadRing.h"
+
+class CD3DUploadSink : public CUploadSink
+{
+public:
+   CD3DUploadSink(IDirect3DDevice9* pDirect3D9Device);
+   virtual ~CD3DUploadSink();
+
+   virtual bool Create(int nBytes);
+   virtual void Destroy();
+   virtual void* Lock(int nOffset, int nBytes, bool blDiscard);
+   virtual void Unlock();
+   virtual void IssueFence(int nFence);
+   virtual bool IsFenceComplete(int nFence);
+
+   IDirect3DVertexBuffer9* GetBuffer();
+
+protected:
+   IDirect3DDevice9* m_pDirect3D9Device;
+   IDirect3DVertexBuffer9* m_pVertexBuffer;
+   IDirect3DQuery9* m_apFences[UPLOAD_RING_MAX_FRAMES];
+
+private:
+   CD3DUploadSink(const CD3DUploadSink&);
+   CD3DUploadSink& operator=(const CD3DUploadSink&);
+};
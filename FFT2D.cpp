@@ -0,0 +1,582 @@
+#include "FFT2D.h"
+
+CFFT2D::CFFT2D()
+{
+   m_nWidth = 0;
+   m_nHeight = 0;
+   m_nSpectrumHeight = 0;
+   m_nPlanePitch = 0;
+   m_nMaxFields = 0;
+   m_nColumnPassMode = FFT2D_COLUMNS_BLOCKED;
+   m_fOutputScale = 1.0f;
+   m_pThreadPool = NULL;
+}
+
+CFFT2D::~CFFT2D()
+{
+}
+
+bool CFFT2D::Init(int nWidth, int nHeight, int nMaxFields)
+{
+   m_nWidth = 0;
+   m_nHeight = 0;
+   m_nSpectrumHeight = 0;
+   m_nMaxFields = 0;
+
+   if (nMaxFields < 1 || nMaxFields > FFT2D_MAX_FIELDS)
+   {
+      return false;
+   }
+
+   if (!m_ColumnPlan.Init(nWidth))
+   {
+      return false;
+   }
+
+   if (!m_RowPlan.Init(nHeight))
+   {
+      return false;
+   }
+
+   m_nWidth = nWidth;
+   m_nHeight = nHeight;
+   m_nSpectrumHeight = nHeight / 2 + 1;
+   m_nMaxFields = nMaxFields;
+
+   // -------------------------------------------------------------------------
+   // Round the plane rows up to whole blocks so the blocked pass never has
+   // to special-case the last, partial block when writing back.
+   // -------------------------------------------------------------------------
+   if (!m_Planes.Allocate(m_nMaxFields * m_nWidth, m_nSpectrumHeight, FFT2D_BLOCK_COLUMNS))
+   {
+      m_nWidth = 0;
+      return false;
+   }
+
+   m_nPlanePitch = m_Planes.GetPitch();
+
+   AllocateScratch();
+   return true;
+}
+
+void CFFT2D::AllocateScratch()
+{
+   int nThreads = (m_pThreadPool != NULL) ? m_pThreadPool->GetThreadCount() : 1;
+   m_Scratch.resize(nThreads);
+
+   // -------------------------------------------------------------------------
+   // The tiles hold one block of one stored spectrum, or one narrower block
+   // of every field of a source.
+   // -------------------------------------------------------------------------
+   int nTileColumns = FFT2D_BLOCK_COLUMNS;
+   if (m_nMaxFields * FFT2D_SOURCE_BLOCK_COLUMNS > nTileColumns)
+   {
+      nTileColumns = m_nMaxFields * FFT2D_SOURCE_BLOCK_COLUMNS;
+   }
+
+   // -------------------------------------------------------------------------
+   // A thread runs one pass at a time, so the column and row plans share
+   // the work arrays.
+   // -------------------------------------------------------------------------
+   int nWorkSize = m_RowPlan.GetWorkSize();
+   if (m_ColumnPlan.GetWorkSize() > nWorkSize)
+   {
+      nWorkSize = m_ColumnPlan.GetWorkSize();
+   }
+
+   for (int t = 0; t < nThreads; t++)
+   {
+      ThreadScratch& scratch = m_Scratch[t];
+      scratch.tileReal.resize(m_nWidth * nTileColumns);
+      scratch.tileImaginary.resize(m_nWidth * nTileColumns);
+      scratch.tileWorkReal.resize(m_nWidth * FFT_BATCH_LANES);
+      scratch.tileWorkImaginary.resize(m_nWidth * FFT_BATCH_LANES);
+      scratch.lineReal.resize(m_nWidth);
+      scratch.lineImaginary.resize(m_nWidth);
+      scratch.binReal.resize(m_nMaxFields * FFT2D_SOURCE_BLOCK_COLUMNS);
+      scratch.binImaginary.resize(m_nMaxFields * FFT2D_SOURCE_BLOCK_COLUMNS);
+      scratch.workReal.resize(nWorkSize);
+      scratch.workImaginary.resize(nWorkSize);
+   }
+}
+
+bool CFFT2D::IsValid()
+{
+   return m_nWidth > 0;
+}
+
+int CFFT2D::GetWidth()
+{
+   return m_nWidth;
+}
+
+int CFFT2D::GetHeight()
+{
+   return m_nHeight;
+}
+
+int CFFT2D::GetSpectrumHeight()
+{
+   return m_nSpectrumHeight;
+}
+
+int CFFT2D::GetMaxFields()
+{
+   return m_nMaxFields;
+}
+
+void CFFT2D::SetColumnPassMode(int nMode)
+{
+   m_nColumnPassMode = nMode;
+}
+
+int CFFT2D::GetColumnPassMode()
+{
+   return m_nColumnPassMode;
+}
+
+void CFFT2D::SetThreadPool(CThreadPool* pPool)
+{
+   m_pThreadPool = pPool;
+   AllocateScratch();
+}
+
+CThreadPool* CFFT2D::GetThreadPool()
+{
+   return m_pThreadPool;
+}
+
+void CFFT2D::SetOutputScale(float fScale)
+{
+   m_fOutputScale = fScale;
+}
+
+float CFFT2D::GetOutputScale()
+{
+   return m_fOutputScale;
+}
+
+// -------------------------------------------------------------------------
+// Column pass: one column (strided) or one block of columns (blocked) of
+// one field per index. The fields are laid end to end.
+// -------------------------------------------------------------------------
+class CFFT2D::CColumnTask : public CParallelTask
+{
+public:
+   CColumnTask(CFFT2D* pFFT,
+               const float* const* ppSpectraReal,
+               const float* const* ppSpectraImaginary,
+               int nSpectrumPitch,
+               int nColumns)
+   {
+      m_pFFT = pFFT;
+      m_ppSpectraReal = ppSpectraReal;
+      m_ppSpectraImaginary = ppSpectraImaginary;
+      m_nSpectrumPitch = nSpectrumPitch;
+      m_nColumns = nColumns;
+   }
+
+   virtual void Run(int nBegin, int nEnd, int nThread)
+   {
+      ThreadScratch& scratch = m_pFFT->m_Scratch[nThread];
+
+      for (int i = nBegin; i < nEnd; i++)
+      {
+         int nField = i / m_nColumns;
+         int nColumn = i % m_nColumns;
+
+         if (m_pFFT->m_nColumnPassMode == FFT2D_COLUMNS_STRIDED)
+         {
+            m_pFFT->ColumnStrided(
+               m_ppSpectraReal[nField],
+               m_ppSpectraImaginary[nField],
+               m_nSpectrumPitch,
+               nField,
+               nColumn,
+               scratch);
+         }
+         else
+         {
+            m_pFFT->ColumnBlock(
+               m_ppSpectraReal[nField],
+               m_ppSpectraImaginary[nField],
+               m_nSpectrumPitch,
+               nField,
+               nColumn * FFT2D_BLOCK_COLUMNS,
+               scratch);
+         }
+      }
+   }
+
+protected:
+   CFFT2D* m_pFFT;
+   const float* const* m_ppSpectraReal;
+   const float* const* m_ppSpectraImaginary;
+   int m_nSpectrumPitch;
+   int m_nColumns;
+};
+
+// -------------------------------------------------------------------------
+// Column pass over a source: one block of every field per index.
+// -------------------------------------------------------------------------
+class CFFT2D::CSourceColumnTask : public CParallelTask
+{
+public:
+   CSourceColumnTask(CFFT2D* pFFT, CFFT2DSource* pSource, int nFields)
+   {
+      m_pFFT = pFFT;
+      m_pSource = pSource;
+      m_nFields = nFields;
+   }
+
+   virtual void Run(int nBegin, int nEnd, int nThread)
+   {
+      ThreadScratch& scratch = m_pFFT->m_Scratch[nThread];
+
+      for (int i = nBegin; i < nEnd; i++)
+      {
+         m_pFFT->ColumnSourceBlock(m_pSource, m_nFields, i * FFT2D_SOURCE_BLOCK_COLUMNS, scratch);
+      }
+   }
+
+protected:
+   CFFT2D* m_pFFT;
+   CFFT2DSource* m_pSource;
+   int m_nFields;
+};
+
+// -------------------------------------------------------------------------
+// Row pass: one complex-to-real transform per index. The rows of all fields
+// are numbered end to end.
+// -------------------------------------------------------------------------
+class CFFT2D::CRowTask : public CParallelTask
+{
+public:
+   CRowTask(CFFT2D* pFFT, float* const* ppOutputs, int nOutputPitch)
+   {
+      m_pFFT = pFFT;
+      m_ppOutputs = ppOutputs;
+      m_nOutputPitch = nOutputPitch;
+   }
+
+   virtual void Run(int nBegin, int nEnd, int nThread)
+   {
+      ThreadScratch& scratch = m_pFFT->m_Scratch[nThread];
+
+      for (int i = nBegin; i < nEnd; i++)
+      {
+         int nField = i / m_pFFT->m_nWidth;
+         int x = i % m_pFFT->m_nWidth;
+
+         m_pFFT->Row(nField, x, m_ppOutputs[nField], m_nOutputPitch, scratch);
+      }
+   }
+
+protected:
+   CFFT2D* m_pFFT;
+   float* const* m_ppOutputs;
+   int m_nOutputPitch;
+};
+
+bool CFFT2D::InverseReal(const float* pSpectrumReal,
+                         const float* pSpectrumImaginary,
+                         int nSpectrumPitch,
+                         float* pOutput,
+                         int nOutputPitch)
+{
+   return InverseRealFields(1, &pSpectrumReal, &pSpectrumImaginary, nSpectrumPitch, &pOutput, nOutputPitch);
+}
+
+bool CFFT2D::InverseRealFields(int nFields,
+                               const float* const* ppSpectraReal,
+                               const float* const* ppSpectraImaginary,
+                               int nSpectrumPitch,
+                               float* const* ppOutputs,
+                               int nOutputPitch)
+{
+   if (!IsValid() || nFields < 1 || nFields > m_nMaxFields)
+   {
+      return false;
+   }
+
+   int nColumns = m_nSpectrumHeight;
+   if (m_nColumnPassMode != FFT2D_COLUMNS_STRIDED)
+   {
+      nColumns = (m_nSpectrumHeight + FFT2D_BLOCK_COLUMNS - 1) / FFT2D_BLOCK_COLUMNS;
+   }
+
+   int nRows = nFields * m_nWidth;
+
+   CColumnTask columnTask(this, ppSpectraReal, ppSpectraImaginary, nSpectrumPitch, nColumns);
+   CRowTask rowTask(this, ppOutputs, nOutputPitch);
+
+   return RunPasses(&columnTask, nFields * nColumns, &rowTask, nRows);
+}
+
+bool CFFT2D::InverseRealSource(int nFields,
+                               CFFT2DSource* pSource,
+                               float* const* ppOutputs,
+                               int nOutputPitch)
+{
+   if (!IsValid() || nFields < 1 || nFields > m_nMaxFields || pSource == NULL)
+   {
+      return false;
+   }
+
+   int nBlocks = (m_nSpectrumHeight + FFT2D_SOURCE_BLOCK_COLUMNS - 1) / FFT2D_SOURCE_BLOCK_COLUMNS;
+   int nRows = nFields * m_nWidth;
+
+   CSourceColumnTask columnTask(this, pSource, nFields);
+   CRowTask rowTask(this, ppOutputs, nOutputPitch);
+
+   return RunPasses(&columnTask, nBlocks, &rowTask, nRows);
+}
+
+bool CFFT2D::RunPasses(CParallelTask* pColumnTask,
+                       int nColumnTasks,
+                       CParallelTask* pRowTask,
+                       int nRows)
+{
+   bool blParallel =
+      m_pThreadPool != NULL &&
+      m_pThreadPool->GetThreadCount() > 1 &&
+      nRows * m_nHeight >= FFT2D_PARALLEL_MIN_POINTS;
+
+   if (!blParallel)
+   {
+      pColumnTask->Run(0, nColumnTasks, 0);
+      pRowTask->Run(0, nRows, 0);
+      return true;
+   }
+
+   // -------------------------------------------------------------------------
+   // Several rows per chunk keep the queue traffic low, while leaving a few
+   // chunks per thread for stealing to even out. Each ParallelFor returns
+   // only when its pass is complete, which is the barrier between them, so
+   // all fields share the same two barriers.
+   // -------------------------------------------------------------------------
+   int nRowGrain = nRows / (m_pThreadPool->GetThreadCount() * 4);
+   if (nRowGrain < 1)
+   {
+      nRowGrain = 1;
+   }
+
+   m_pThreadPool->ParallelFor(nColumnTasks, 1, pColumnTask);
+   m_pThreadPool->ParallelFor(nRows, nRowGrain, pRowTask);
+   return true;
+}
+
+void CFFT2D::ColumnStrided(const float* pSpectrumReal,
+                           const float* pSpectrumImaginary,
+                           int nSpectrumPitch,
+                           int nField,
+                           int z,
+                           ThreadScratch& scratch)
+{
+   float* pLineReal = &scratch.lineReal[0];
+   float* pLineImaginary = &scratch.lineImaginary[0];
+   float* pPlaneReal = m_Planes.GetRealRow(nField * m_nWidth);
+   float* pPlaneImaginary = m_Planes.GetImaginaryRow(nField * m_nWidth);
+
+   for (int x = 0; x < m_nWidth; x++)
+   {
+      pLineReal[x] = pSpectrumReal[x * nSpectrumPitch + z];
+      pLineImaginary[x] = pSpectrumImaginary[x * nSpectrumPitch + z];
+   }
+
+   m_ColumnPlan.Execute(
+      FFT_DIRECTION_INVERSE,
+      pLineReal,
+      pLineImaginary,
+      &scratch.workReal[0],
+      &scratch.workImaginary[0]);
+
+   for (int x = 0; x < m_nWidth; x++)
+   {
+      pPlaneReal[x * m_nPlanePitch + z] = pLineReal[x];
+      pPlaneImaginary[x * m_nPlanePitch + z] = pLineImaginary[x];
+   }
+}
+
+void CFFT2D::ColumnBlock(const float* pSpectrumReal,
+                         const float* pSpectrumImaginary,
+                         int nSpectrumPitch,
+                         int nField,
+                         int z0,
+                         ThreadScratch& scratch)
+{
+   int nTileSize = m_nWidth * FFT_BATCH_LANES;
+   float* pTileReal = &scratch.tileReal[0];
+   float* pTileImaginary = &scratch.tileImaginary[0];
+
+   int nColumns = m_nSpectrumHeight - z0;
+   if (nColumns > FFT2D_BLOCK_COLUMNS)
+   {
+      nColumns = FFT2D_BLOCK_COLUMNS;
+   }
+   int nTiles = (nColumns + FFT_BATCH_LANES - 1) / FFT_BATCH_LANES;
+
+   // -------------------------------------------------------------------------
+   // Each x contributes one contiguous run of bins, which is spread over the
+   // same row of every tile. Columns past the end of the spectrum are zeroed.
+   // -------------------------------------------------------------------------
+   for (int x = 0; x < m_nWidth; x++)
+   {
+      const float* pSourceReal = pSpectrumReal + x * nSpectrumPitch + z0;
+      const float* pSourceImaginary = pSpectrumImaginary + x * nSpectrumPitch + z0;
+
+      for (int c = 0; c < nTiles * FFT_BATCH_LANES; c++)
+      {
+         int nTile = c / FFT_BATCH_LANES;
+         int nIndex = nTile * nTileSize + x * FFT_BATCH_LANES + (c % FFT_BATCH_LANES);
+
+         if (c < nColumns)
+         {
+            pTileReal[nIndex] = pSourceReal[c];
+            pTileImaginary[nIndex] = pSourceImaginary[c];
+         }
+         else
+         {
+            pTileReal[nIndex] = 0.0f;
+            pTileImaginary[nIndex] = 0.0f;
+         }
+      }
+   }
+
+   TransformTiles(nField, z0, nTiles, pTileReal, pTileImaginary, scratch);
+}
+
+void CFFT2D::ColumnSourceBlock(CFFT2DSource* pSource,
+                               int nFields,
+                               int z0,
+                               ThreadScratch& scratch)
+{
+   int nTileSize = m_nWidth * FFT_BATCH_LANES;
+   int nFieldTiles = FFT2D_SOURCE_BLOCK_COLUMNS / FFT_BATCH_LANES;
+   float* pTileReal = &scratch.tileReal[0];
+   float* pTileImaginary = &scratch.tileImaginary[0];
+
+   int nColumns = m_nSpectrumHeight - z0;
+   if (nColumns > FFT2D_SOURCE_BLOCK_COLUMNS)
+   {
+      nColumns = FFT2D_SOURCE_BLOCK_COLUMNS;
+   }
+   int nTiles = (nColumns + FFT_BATCH_LANES - 1) / FFT_BATCH_LANES;
+
+   float* apBinReal[FFT2D_MAX_FIELDS];
+   float* apBinImaginary[FFT2D_MAX_FIELDS];
+
+   for (int f = 0; f < nFields; f++)
+   {
+      apBinReal[f] = &scratch.binReal[f * FFT2D_SOURCE_BLOCK_COLUMNS];
+      apBinImaginary[f] = &scratch.binImaginary[f * FFT2D_SOURCE_BLOCK_COLUMNS];
+   }
+
+   // -------------------------------------------------------------------------
+   // Each row's bins are produced into a few cache lines and spread over the
+   // tiles at once, the same way ColumnBlock spreads a stored row. Field f
+   // uses tiles f * nFieldTiles onwards.
+   // -------------------------------------------------------------------------
+   for (int x = 0; x < m_nWidth; x++)
+   {
+      pSource->GetBins(x, z0, nColumns, apBinReal, apBinImaginary);
+
+      for (int f = 0; f < nFields; f++)
+      {
+         float* pFieldReal = pTileReal + f * nFieldTiles * nTileSize;
+         float* pFieldImaginary = pTileImaginary + f * nFieldTiles * nTileSize;
+
+         for (int c = 0; c < nTiles * FFT_BATCH_LANES; c++)
+         {
+            int nTile = c / FFT_BATCH_LANES;
+            int nIndex = nTile * nTileSize + x * FFT_BATCH_LANES + (c % FFT_BATCH_LANES);
+
+            if (c < nColumns)
+            {
+               pFieldReal[nIndex] = apBinReal[f][c];
+               pFieldImaginary[nIndex] = apBinImaginary[f][c];
+            }
+            else
+            {
+               pFieldReal[nIndex] = 0.0f;
+               pFieldImaginary[nIndex] = 0.0f;
+            }
+         }
+      }
+   }
+
+   for (int f = 0; f < nFields; f++)
+   {
+      TransformTiles(
+         f,
+         z0,
+         nTiles,
+         pTileReal + f * nFieldTiles * nTileSize,
+         pTileImaginary + f * nFieldTiles * nTileSize,
+         scratch);
+   }
+}
+
+void CFFT2D::TransformTiles(int nField,
+                            int z0,
+                            int nTiles,
+                            float* pTileReal,
+                            float* pTileImaginary,
+                            ThreadScratch& scratch)
+{
+   int nTileSize = m_nWidth * FFT_BATCH_LANES;
+
+   for (int t = 0; t < nTiles; t++)
+   {
+      if (m_nColumnPassMode == FFT2D_COLUMNS_STOCKHAM)
+      {
+         m_ColumnPlan.ExecuteBatchStockham(
+            FFT_DIRECTION_INVERSE,
+            pTileReal + t * nTileSize,
+            pTileImaginary + t * nTileSize,
+            &scratch.tileWorkReal[0],
+            &scratch.tileWorkImaginary[0]);
+      }
+      else
+      {
+         m_ColumnPlan.ExecuteBatch(
+            FFT_DIRECTION_INVERSE,
+            pTileReal + t * nTileSize,
+            pTileImaginary + t * nTileSize,
+            &scratch.workReal[0],
+            &scratch.workImaginary[0]);
+      }
+   }
+
+   float* pPlaneReal = m_Planes.GetRealRow(nField * m_nWidth);
+   float* pPlaneImaginary = m_Planes.GetImaginaryRow(nField * m_nWidth);
+
+   for (int x = 0; x < m_nWidth; x++)
+   {
+      float* pDestReal = pPlaneReal + x * m_nPlanePitch + z0;
+      float* pDestImaginary = pPlaneImaginary + x * m_nPlanePitch + z0;
+
+      for (int t = 0; t < nTiles; t++)
+      {
+         const float* pRe = pTileReal + t * nTileSize + x * FFT_BATCH_LANES;
+         const float* pIm = pTileImaginary + t * nTileSize + x * FFT_BATCH_LANES;
+
+         for (int l = 0; l < FFT_BATCH_LANES; l++)
+         {
+            pDestReal[t * FFT_BATCH_LANES + l] = pRe[l];
+            pDestImaginary[t * FFT_BATCH_LANES + l] = pIm[l];
+         }
+      }
+   }
+}
+
+void CFFT2D::Row(int nField, int x, float* pOutput, int nOutputPitch, ThreadScratch& scratch)
+{
+   m_RowPlan.ExecuteInverse(
+      m_Planes.GetRealRow(nField * m_nWidth + x),
+      m_Planes.GetImaginaryRow(nField * m_nWidth + x),
+      pOutput + x * nOutputPitch,
+      &scratch.workReal[0],
+      &scratch.workImaginary[0],
+      m_fOutputScale);
+}
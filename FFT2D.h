@@ -0,0 +1,239 @@
+// -------------------------------------------------------------------------
+// Sean Janis
+// spjanis@gmail.com
+// Water Simulations
+//
+// CFFT2D
+//       Two dimensional inverse transform of a Hermitian spectrum to a real
+//       height field. The spectrum is stored as nWidth rows of
+//       nHeight / 2 + 1 bins. The column pass runs along x for every stored
+//       bin and the row pass finishes each row with a complex-to-real
+//       transform.
+//
+//       The column pass copies a block of FFT2D_BLOCK_COLUMNS neighbouring
+//       columns at a time into lane-interleaved tiles of FFT_BATCH_LANES
+//       columns each. This is a blocked transpose of the spectrum. Each
+//       tile is then transformed with one SIMD butterfly per point across
+//       its lanes. Every memory access in both passes therefore reads or
+//       writes whole cache lines, instead of one strided element per line.
+//
+//       Several fields, such as a height field and its slopes, can be
+//       transformed in one call. They share the plans and twiddles, and each
+//       pass walks the columns or rows of all of them in one loop.
+//
+//       A stored spectrum is read as separate real and imaginary planes,
+//       such as those of a CComplexField2D, so a row of bins is two
+//       contiguous runs of floats that go into the tiles without shuffles.
+//
+//       The spectra can also be generated on demand by a CFFT2DSource. Its
+//       bins are written straight into the column tiles a few rows at a
+//       time, so the spectrum is never stored and read back. The row pass
+//       can scale its output as it writes it.
+//
+//       Given a thread pool, each pass is split across its threads: column
+//       blocks in the first pass, rows in the second. Every thread
+//       has its own tiles and line buffers. The pool waits for the column
+//       pass to finish before the row pass starts.
+// -------------------------------------------------------------------------
+#pragma once
+
+#include <vector>
+#include "FFTPlan.h"
+#include "ThreadPool.h"
+#include "Field2D.h"
+using namespace std;
+
+#define FFT2D_COLUMNS_STRIDED          0
+#define FFT2D_COLUMNS_BLOCKED          1
+#define FFT2D_COLUMNS_STOCKHAM         2
+
+#define FFT2D_BLOCK_COLUMNS            32
+#define FFT2D_MAX_FIELDS               8
+
+// -------------------------------------------------------------------------
+// Columns per block when the spectrum comes from a CFFT2DSource. The tiles
+// of every field of a block are in flight at once, and each block visits
+// every row of the source, so wider blocks trade tile footprint for fewer
+// strided walks over the source.
+// -------------------------------------------------------------------------
+#define FFT2D_SOURCE_BLOCK_COLUMNS     32
+
+// -------------------------------------------------------------------------
+// Smaller grids finish faster on one thread than it takes to wake the pool.
+// -------------------------------------------------------------------------
+#define FFT2D_PARALLEL_MIN_POINTS      (128 * 128)
+
+// -------------------------------------------------------------------------
+// Supplies the spectrum bins for CFFT2D::InverseRealSource.
+// -------------------------------------------------------------------------
+class CFFT2DSource
+{
+public:
+   virtual ~CFFT2DSource() {}
+
+   // -------------------------------------------------------------------------
+   // Writes bins z0 .. z0 + nColumns - 1 of spectrum row x for every field:
+   // bin z0 + c of field f goes to ppReal[f][c] and ppImaginary[f][c]. Every
+   // bin is asked for exactly once per transform. Calls for different
+   // blocks can come from different threads at the same time.
+   // -------------------------------------------------------------------------
+   virtual void GetBins(
+      int x,
+      int z0,
+      int nColumns,
+      float* const* ppReal,
+      float* const* ppImaginary) = 0;
+};
+
+class CFFT2D
+{
+public:
+   CFFT2D();
+   virtual ~CFFT2D();
+
+   // -------------------------------------------------------------------------
+   // nMaxFields is the most fields InverseRealFields will be given, up to
+   // FFT2D_MAX_FIELDS. Each field needs its own intermediate planes.
+   // -------------------------------------------------------------------------
+   bool Init(int nWidth, int nHeight, int nMaxFields = 1);
+   bool IsValid();
+   int GetWidth();
+   int GetHeight();
+   int GetSpectrumHeight();
+   int GetMaxFields();
+
+   // -------------------------------------------------------------------------
+   // Selects how the column pass reads the spectrum. The strided mode gathers
+   // one column at a time and is kept for comparison. The Stockham mode
+   // copies the same tiles as the blocked mode but transforms them with
+   // Stockham autosort passes, which need no bit-reversal of the tile.
+   // -------------------------------------------------------------------------
+   void SetColumnPassMode(int nMode);
+   int GetColumnPassMode();
+
+   // -------------------------------------------------------------------------
+   // Runs both passes on pPool, or on the calling thread when pPool is NULL.
+   // The pool is not owned and must outlive its use here. Call again if the
+   // pool's thread count changes.
+   // -------------------------------------------------------------------------
+   void SetThreadPool(CThreadPool* pPool);
+   CThreadPool* GetThreadPool();
+
+   // -------------------------------------------------------------------------
+   // Factor applied to every output sample, 1 by default. It is folded into
+   // the row pass, so scaling costs no extra trip through the outputs.
+   // -------------------------------------------------------------------------
+   void SetOutputScale(float fScale);
+   float GetOutputScale();
+
+   // -------------------------------------------------------------------------
+   // pSpectrumReal and pSpectrumImaginary hold the real and imaginary parts
+   // of nWidth rows of GetSpectrumHeight() bins, nSpectrumPitch floats
+   // apart. pOutput receives nWidth rows of nHeight heights,
+   // nOutputPitch floats apart, multiplied by GetOutputScale(). The spectrum
+   // is not modified.
+   // -------------------------------------------------------------------------
+   bool InverseReal(
+      const float* pSpectrumReal,
+      const float* pSpectrumImaginary,
+      int nSpectrumPitch,
+      float* pOutput,
+      int nOutputPitch);
+
+   // -------------------------------------------------------------------------
+   // Transforms nFields spectra of the same size together. The spectrum in
+   // ppSpectraReal[f] and ppSpectraImaginary[f] is transformed into
+   // ppOutputs[f]; all use the same pitches.
+   // -------------------------------------------------------------------------
+   bool InverseRealFields(
+      int nFields,
+      const float* const* ppSpectraReal,
+      const float* const* ppSpectraImaginary,
+      int nSpectrumPitch,
+      float* const* ppOutputs,
+      int nOutputPitch);
+
+   // -------------------------------------------------------------------------
+   // Transforms nFields spectra produced by pSource, which is called from
+   // the column pass. The column pass mode picks the tile transform; the
+   // source is always read in blocks.
+   // -------------------------------------------------------------------------
+   bool InverseRealSource(
+      int nFields,
+      CFFT2DSource* pSource,
+      float* const* ppOutputs,
+      int nOutputPitch);
+
+protected:
+   class CColumnTask;
+   class CSourceColumnTask;
+   class CRowTask;
+
+   // -------------------------------------------------------------------------
+   // Scratch memory used by one thread.
+   // -------------------------------------------------------------------------
+   struct ThreadScratch
+   {
+      vector<float> tileReal;
+      vector<float> tileImaginary;
+      vector<float> tileWorkReal;
+      vector<float> tileWorkImaginary;
+      vector<float> lineReal;
+      vector<float> lineImaginary;
+      vector<float> binReal;
+      vector<float> binImaginary;
+      vector<float> workReal;
+      vector<float> workImaginary;
+   };
+
+   void AllocateScratch();
+   void ColumnStrided(
+      const float* pSpectrumReal,
+      const float* pSpectrumImaginary,
+      int nSpectrumPitch,
+      int nField, 
+      int z, 
+      ThreadScratch& scratch);
+   void ColumnBlock(
+      const float* pSpectrumReal,
+      const float* pSpectrumImaginary,
+      int nSpectrumPitch,
+      int nField, 
+      int z0, 
+      ThreadScratch& scratch);
+   void ColumnSourceBlock(
+      CFFT2DSource* pSource,
+      int nFields,
+      int z0,
+      ThreadScratch& scratch);
+   void TransformTiles(
+      int nField,
+      int z0,
+      int nTiles,
+      float* pTileReal,
+      float* pTileImaginary,
+      ThreadScratch& scratch);
+   bool RunPasses(CParallelTask* pColumnTask, int nColumnTasks, CParallelTask* pRowTask, int nRows);
+   void Row(int nField, int x, float* pOutput, int nOutputPitch, ThreadScratch& scratch);
+
+protected:
+   int m_nWidth;
+   int m_nHeight;
+   int m_nSpectrumHeight;
+   int m_nColumnPassMode;
+   int m_nMaxFields;
+   float m_fOutputScale;
+
+   CFFTPlan m_ColumnPlan;
+   CRealFFTPlan m_RowPlan;
+
+   // -------------------------------------------------------------------------
+   // Result of the column pass, nWidth rows per field with the fields one
+   // after another.
+   // -------------------------------------------------------------------------
+   int m_nPlanePitch;
+   CComplexField2D m_Planes;
+
+   CThreadPool* m_pThreadPool;
+   vector<ThreadScratch> m_Scratch;
+};
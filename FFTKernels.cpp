@@ -0,0 +1,1450 @@
+#include "FFTKernels.h"
+#include "CpuFeatures.h"
+
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#define FFT_KERNELS_SSE2
+#if _MSC_VER >= 1700
+#define FFT_KERNELS_AVX2
+#endif
+#define FFT_TARGET_AVX2
+#elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define FFT_KERNELS_SSE2
+#define FFT_KERNELS_AVX2
+#define FFT_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+// -------------------------------------------------------------------------
+// The stage kernels are also inlined into the fixed-size transforms below,
+// where the sizes are compile-time constants.
+// -------------------------------------------------------------------------
+#if defined(_MSC_VER)
+#define FFT_FORCEINLINE __forceinline
+#else
+#define FFT_FORCEINLINE inline __attribute__((always_inline))
+#endif
+
+#ifdef FFT_KERNELS_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef FFT_KERNELS_AVX2
+#include <immintrin.h>
+#endif
+
+#include <stddef.h>
+
+static bool s_blFixedKernelsEnabled = true;
+
+// -------------------------------------------------------------------------
+// Scalar Kernels
+// -------------------------------------------------------------------------
+static void Radix4FirstStage_Scalar(float* pReal, float* pImaginary, int nSize, float fRotate)
+{
+   for (int g = 0; g < nSize; g += 4)
+   {
+      float fB0Re = pReal[g] + pReal[g + 1];
+      float fB0Im = pImaginary[g] + pImaginary[g + 1];
+      float fB1Re = pReal[g] - pReal[g + 1];
+      float fB1Im = pImaginary[g] - pImaginary[g + 1];
+      float fB2Re = pReal[g + 2] + pReal[g + 3];
+      float fB2Im = pImaginary[g + 2] + pImaginary[g + 3];
+      float fB3Re = pReal[g + 2] - pReal[g + 3];
+      float fB3Im = pImaginary[g + 2] - pImaginary[g + 3];
+
+      float fRRe = -fB3Im * fRotate;
+      float fRIm = fB3Re * fRotate;
+
+      pReal[g] = fB0Re + fB2Re;
+      pImaginary[g] = fB0Im + fB2Im;
+      pReal[g + 1] = fB1Re + fRRe;
+      pImaginary[g + 1] = fB1Im + fRIm;
+      pReal[g + 2] = fB0Re - fB2Re;
+      pImaginary[g + 2] = fB0Im - fB2Im;
+      pReal[g + 3] = fB1Re - fRRe;
+      pImaginary[g + 3] = fB1Im - fRIm;
+   }
+}
+
+static void Radix4Stage_Scalar(float* pReal, float* pImaginary, int nSize, int nQuarter,
+                               const float* pCos1, const float* pSin1,
+                               const float* pCos2, const float* pSin2,
+                               float fRotate)
+{
+   int nSpan = nQuarter * 4;
+
+   for (int g = 0; g < nSize; g += nSpan)
+   {
+      float* pRe0 = pReal + g;
+      float* pIm0 = pImaginary + g;
+      float* pRe1 = pRe0 + nQuarter;
+      float* pIm1 = pIm0 + nQuarter;
+      float* pRe2 = pRe1 + nQuarter;
+      float* pIm2 = pIm1 + nQuarter;
+      float* pRe3 = pRe2 + nQuarter;
+      float* pIm3 = pIm2 + nQuarter;
+
+      for (int j = 0; j < nQuarter; j++)
+      {
+         float c1 = pCos1[j];
+         float s1 = pSin1[j];
+         float c2 = pCos2[j];
+         float s2 = pSin2[j];
+
+         // ----------------------------------------------------------------------
+         // First stage: (0, 1) and (2, 3) with twiddle w1.
+         // ----------------------------------------------------------------------
+         float fT1Re = c1 * pRe1[j] - s1 * pIm1[j];
+         float fT1Im = c1 * pIm1[j] + s1 * pRe1[j];
+         float fT3Re = c1 * pRe3[j] - s1 * pIm3[j];
+         float fT3Im = c1 * pIm3[j] + s1 * pRe3[j];
+
+         float fB0Re = pRe0[j] + fT1Re;
+         float fB0Im = pIm0[j] + fT1Im;
+         float fB1Re = pRe0[j] - fT1Re;
+         float fB1Im = pIm0[j] - fT1Im;
+         float fB2Re = pRe2[j] + fT3Re;
+         float fB2Im = pIm2[j] + fT3Im;
+         float fB3Re = pRe2[j] - fT3Re;
+         float fB3Im = pIm2[j] - fT3Im;
+
+         // ----------------------------------------------------------------------
+         // Second stage: (0, 2) with twiddle w2, (1, 3) with w2 rotated by a
+         // quarter turn.
+         // ----------------------------------------------------------------------
+         float fT2Re = c2 * fB2Re - s2 * fB2Im;
+         float fT2Im = c2 * fB2Im + s2 * fB2Re;
+         float fU3Re = c2 * fB3Re - s2 * fB3Im;
+         float fU3Im = c2 * fB3Im + s2 * fB3Re;
+         float fRRe = -fU3Im * fRotate;
+         float fRIm = fU3Re * fRotate;
+
+         pRe0[j] = fB0Re + fT2Re;
+         pIm0[j] = fB0Im + fT2Im;
+         pRe2[j] = fB0Re - fT2Re;
+         pIm2[j] = fB0Im - fT2Im;
+         pRe1[j] = fB1Re + fRRe;
+         pIm1[j] = fB1Im + fRIm;
+         pRe3[j] = fB1Re - fRRe;
+         pIm3[j] = fB1Im - fRIm;
+      }
+   }
+}
+
+static void Radix2Stage_Scalar(float* pReal, float* pImaginary, int nSize, int nHalf,
+                               const float* pCos, const float* pSin)
+{
+   int nSpan = nHalf * 2;
+
+   for (int g = 0; g < nSize; g += nSpan)
+   {
+      float* pRe0 = pReal + g;
+      float* pIm0 = pImaginary + g;
+      float* pRe1 = pRe0 + nHalf;
+      float* pIm1 = pIm0 + nHalf;
+
+      for (int j = 0; j < nHalf; j++)
+      {
+         float fTRe = pCos[j] * pRe1[j] - pSin[j] * pIm1[j];
+         float fTIm = pCos[j] * pIm1[j] + pSin[j] * pRe1[j];
+         pRe1[j] = pRe0[j] - fTRe;
+         pIm1[j] = pIm0[j] - fTIm;
+         pRe0[j] = pRe0[j] + fTRe;
+         pIm0[j] = pIm0[j] + fTIm;
+      }
+   }
+}
+
+static void BatchRadix4Stage_Scalar(float* pReal, float* pImaginary, int nSize, int nQuarter,
+                                    const float* pCos1, const float* pSin1,
+                                    const float* pCos2, const float* pSin2,
+                                    float fRotate)
+{
+   int nSpan = nQuarter * 4;
+   int nStride = nQuarter * FFT_BATCH_LANES;
+
+   for (int g = 0; g < nSize; g += nSpan)
+   {
+      for (int j = 0; j < nQuarter; j++)
+      {
+         float c1 = pCos1[j];
+         float s1 = pSin1[j];
+         float c2 = pCos2[j];
+         float s2 = pSin2[j];
+
+         float* pRe0 = pReal + (g + j) * FFT_BATCH_LANES;
+         float* pIm0 = pImaginary + (g + j) * FFT_BATCH_LANES;
+         float* pRe1 = pRe0 + nStride;
+         float* pIm1 = pIm0 + nStride;
+         float* pRe2 = pRe1 + nStride;
+         float* pIm2 = pIm1 + nStride;
+         float* pRe3 = pRe2 + nStride;
+         float* pIm3 = pIm2 + nStride;
+
+         for (int l = 0; l < FFT_BATCH_LANES; l++)
+         {
+            float fT1Re = c1 * pRe1[l] - s1 * pIm1[l];
+            float fT1Im = c1 * pIm1[l] + s1 * pRe1[l];
+            float fT3Re = c1 * pRe3[l] - s1 * pIm3[l];
+            float fT3Im = c1 * pIm3[l] + s1 * pRe3[l];
+
+            float fB0Re = pRe0[l] + fT1Re;
+            float fB0Im = pIm0[l] + fT1Im;
+            float fB1Re = pRe0[l] - fT1Re;
+            float fB1Im = pIm0[l] - fT1Im;
+            float fB2Re = pRe2[l] + fT3Re;
+            float fB2Im = pIm2[l] + fT3Im;
+            float fB3Re = pRe2[l] - fT3Re;
+            float fB3Im = pIm2[l] - fT3Im;
+
+            float fT2Re = c2 * fB2Re - s2 * fB2Im;
+            float fT2Im = c2 * fB2Im + s2 * fB2Re;
+            float fU3Re = c2 * fB3Re - s2 * fB3Im;
+            float fU3Im = c2 * fB3Im + s2 * fB3Re;
+            float fRRe = -fU3Im * fRotate;
+            float fRIm = fU3Re * fRotate;
+
+            pRe0[l] = fB0Re + fT2Re;
+            pIm0[l] = fB0Im + fT2Im;
+            pRe2[l] = fB0Re - fT2Re;
+            pIm2[l] = fB0Im - fT2Im;
+            pRe1[l] = fB1Re + fRRe;
+            pIm1[l] = fB1Im + fRIm;
+            pRe3[l] = fB1Re - fRRe;
+            pIm3[l] = fB1Im - fRIm;
+         }
+      }
+   }
+}
+
+static void BatchRadix2Stage_Scalar(float* pReal, float* pImaginary, int nSize, int nHalf,
+                                    const float* pCos, const float* pSin)
+{
+   int nSpan = nHalf * 2;
+   int nStride = nHalf * FFT_BATCH_LANES;
+
+   for (int g = 0; g < nSize; g += nSpan)
+   {
+      for (int j = 0; j < nHalf; j++)
+      {
+         float c = pCos[j];
+         float s = pSin[j];
+
+         float* pRe0 = pReal + (g + j) * FFT_BATCH_LANES;
+         float* pIm0 = pImaginary + (g + j) * FFT_BATCH_LANES;
+         float* pRe1 = pRe0 + nStride;
+         float* pIm1 = pIm0 + nStride;
+
+         for (int l = 0; l < FFT_BATCH_LANES; l++)
+         {
+            float fTRe = c * pRe1[l] - s * pIm1[l];
+            float fTIm = c * pIm1[l] + s * pRe1[l];
+            pRe1[l] = pRe0[l] - fTRe;
+            pIm1[l] = pIm0[l] - fTIm;
+            pRe0[l] = pRe0[l] + fTRe;
+            pIm0[l] = pIm0[l] + fTIm;
+         }
+      }
+   }
+}
+
+static void BatchStockham4Stage_Scalar(const float* pInReal, const float* pInImaginary,
+                                       float* pOutReal, float* pOutImaginary,
+                                       int nSize, int nStride,
+                                       const float* pCos, const float* pSin,
+                                       float fRotate)
+{
+   int nQuarter = nSize / nStride / 4;
+   int nBlock = nStride * FFT_BATCH_LANES;
+
+   for (int p = 0; p < nQuarter; p++)
+   {
+      float c1 = pCos[p];
+      float s1 = pSin[p];
+      float c2 = pCos[nQuarter + p];
+      float s2 = pSin[nQuarter + p];
+      float c3 = pCos[2 * nQuarter + p];
+      float s3 = pSin[2 * nQuarter + p];
+
+      const float* pRe0 = pInReal + p * nBlock;
+      const float* pIm0 = pInImaginary + p * nBlock;
+      const float* pRe1 = pRe0 + nQuarter * nBlock;
+      const float* pIm1 = pIm0 + nQuarter * nBlock;
+      const float* pRe2 = pRe1 + nQuarter * nBlock;
+      const float* pIm2 = pIm1 + nQuarter * nBlock;
+      const float* pRe3 = pRe2 + nQuarter * nBlock;
+      const float* pIm3 = pIm2 + nQuarter * nBlock;
+
+      float* pOutRe0 = pOutReal + 4 * p * nBlock;
+      float* pOutIm0 = pOutImaginary + 4 * p * nBlock;
+      float* pOutRe1 = pOutRe0 + nBlock;
+      float* pOutIm1 = pOutIm0 + nBlock;
+      float* pOutRe2 = pOutRe1 + nBlock;
+      float* pOutIm2 = pOutIm1 + nBlock;
+      float* pOutRe3 = pOutRe2 + nBlock;
+      float* pOutIm3 = pOutIm2 + nBlock;
+
+      for (int k = 0; k < nBlock; k++)
+      {
+         float fApcRe = pRe0[k] + pRe2[k];
+         float fApcIm = pIm0[k] + pIm2[k];
+         float fAmcRe = pRe0[k] - pRe2[k];
+         float fAmcIm = pIm0[k] - pIm2[k];
+         float fBpdRe = pRe1[k] + pRe3[k];
+         float fBpdIm = pIm1[k] + pIm3[k];
+         float fBmdRe = pRe1[k] - pRe3[k];
+         float fBmdIm = pIm1[k] - pIm3[k];
+         float fJRe = -fBmdIm * fRotate;
+         float fJIm = fBmdRe * fRotate;
+
+         float fY1Re = fAmcRe + fJRe;
+         float fY1Im = fAmcIm + fJIm;
+         float fY2Re = fApcRe - fBpdRe;
+         float fY2Im = fApcIm - fBpdIm;
+         float fY3Re = fAmcRe - fJRe;
+         float fY3Im = fAmcIm - fJIm;
+
+         pOutRe0[k] = fApcRe + fBpdRe;
+         pOutIm0[k] = fApcIm + fBpdIm;
+         pOutRe1[k] = c1 * fY1Re - s1 * fY1Im;
+         pOutIm1[k] = c1 * fY1Im + s1 * fY1Re;
+         pOutRe2[k] = c2 * fY2Re - s2 * fY2Im;
+         pOutIm2[k] = c2 * fY2Im + s2 * fY2Re;
+         pOutRe3[k] = c3 * fY3Re - s3 * fY3Im;
+         pOutIm3[k] = c3 * fY3Im + s3 * fY3Re;
+      }
+   }
+}
+
+static void BatchStockham2Stage_Scalar(const float* pInReal, const float* pInImaginary,
+                                       float* pOutReal, float* pOutImaginary,
+                                       int nSize)
+{
+   int nBlock = (nSize / 2) * FFT_BATCH_LANES;
+
+   for (int k = 0; k < nBlock; k++)
+   {
+      float fARe = pInReal[k];
+      float fAIm = pInImaginary[k];
+      float fBRe = pInReal[nBlock + k];
+      float fBIm = pInImaginary[nBlock + k];
+
+      pOutReal[k] = fARe + fBRe;
+      pOutImaginary[k] = fAIm + fBIm;
+      pOutReal[nBlock + k] = fARe - fBRe;
+      pOutImaginary[nBlock + k] = fAIm - fBIm;
+   }
+}
+
+#ifdef FFT_KERNELS_SSE2
+// -------------------------------------------------------------------------
+// SSE2 Kernels (4 lanes)
+// -------------------------------------------------------------------------
+static void Radix4FirstStage_SSE2(float* pReal, float* pImaginary, int nSize, float fRotate)
+{
+   if (nSize < 16)
+   {
+      Radix4FirstStage_Scalar(pReal, pImaginary, nSize, fRotate);
+      return;
+   }
+
+   __m128 vRotate = _mm_set1_ps(fRotate);
+   __m128 vNegRotate = _mm_set1_ps(-fRotate);
+
+   // -------------------------------------------------------------------------
+   // Four groups of four points at a time. The 4x4 transpose puts point n of
+   // every group into lane n so the butterflies run across groups.
+   // -------------------------------------------------------------------------
+   for (int g = 0; g < nSize; g += 16)
+   {
+      __m128 a0Re = _mm_loadu_ps(pReal + g);
+      __m128 a1Re = _mm_loadu_ps(pReal + g + 4);
+      __m128 a2Re = _mm_loadu_ps(pReal + g + 8);
+      __m128 a3Re = _mm_loadu_ps(pReal + g + 12);
+      __m128 a0Im = _mm_loadu_ps(pImaginary + g);
+      __m128 a1Im = _mm_loadu_ps(pImaginary + g + 4);
+      __m128 a2Im = _mm_loadu_ps(pImaginary + g + 8);
+      __m128 a3Im = _mm_loadu_ps(pImaginary + g + 12);
+      _MM_TRANSPOSE4_PS(a0Re, a1Re, a2Re, a3Re);
+      _MM_TRANSPOSE4_PS(a0Im, a1Im, a2Im, a3Im);
+
+      __m128 b0Re = _mm_add_ps(a0Re, a1Re);
+      __m128 b0Im = _mm_add_ps(a0Im, a1Im);
+      __m128 b1Re = _mm_sub_ps(a0Re, a1Re);
+      __m128 b1Im = _mm_sub_ps(a0Im, a1Im);
+      __m128 b2Re = _mm_add_ps(a2Re, a3Re);
+      __m128 b2Im = _mm_add_ps(a2Im, a3Im);
+      __m128 b3Re = _mm_sub_ps(a2Re, a3Re);
+      __m128 b3Im = _mm_sub_ps(a2Im, a3Im);
+
+      __m128 rRe = _mm_mul_ps(b3Im, vNegRotate);
+      __m128 rIm = _mm_mul_ps(b3Re, vRotate);
+
+      __m128 c0Re = _mm_add_ps(b0Re, b2Re);
+      __m128 c0Im = _mm_add_ps(b0Im, b2Im);
+      __m128 c1Re = _mm_add_ps(b1Re, rRe);
+      __m128 c1Im = _mm_add_ps(b1Im, rIm);
+      __m128 c2Re = _mm_sub_ps(b0Re, b2Re);
+      __m128 c2Im = _mm_sub_ps(b0Im, b2Im);
+      __m128 c3Re = _mm_sub_ps(b1Re, rRe);
+      __m128 c3Im = _mm_sub_ps(b1Im, rIm);
+
+      _MM_TRANSPOSE4_PS(c0Re, c1Re, c2Re, c3Re);
+      _MM_TRANSPOSE4_PS(c0Im, c1Im, c2Im, c3Im);
+      _mm_storeu_ps(pReal + g, c0Re);
+      _mm_storeu_ps(pReal + g + 4, c1Re);
+      _mm_storeu_ps(pReal + g + 8, c2Re);
+      _mm_storeu_ps(pReal + g + 12, c3Re);
+      _mm_storeu_ps(pImaginary + g, c0Im);
+      _mm_storeu_ps(pImaginary + g + 4, c1Im);
+      _mm_storeu_ps(pImaginary + g + 8, c2Im);
+      _mm_storeu_ps(pImaginary + g + 12, c3Im);
+   }
+}
+
+static FFT_FORCEINLINE void Radix4Stage_SSE2(float* pReal, float* pImaginary, int nSize, int nQuarter,
+                             const float* pCos1, const float* pSin1,
+                             const float* pCos2, const float* pSin2,
+                             float fRotate)
+{
+   if (nQuarter < 4)
+   {
+      Radix4Stage_Scalar(pReal, pImaginary, nSize, nQuarter, pCos1, pSin1, pCos2, pSin2, fRotate);
+      return;
+   }
+
+   __m128 vRotate = _mm_set1_ps(fRotate);
+   __m128 vNegRotate = _mm_set1_ps(-fRotate);
+   int nSpan = nQuarter * 4;
+
+   for (int g = 0; g < nSize; g += nSpan)
+   {
+      float* pRe0 = pReal + g;
+      float* pIm0 = pImaginary + g;
+      float* pRe1 = pRe0 + nQuarter;
+      float* pIm1 = pIm0 + nQuarter;
+      float* pRe2 = pRe1 + nQuarter;
+      float* pIm2 = pIm1 + nQuarter;
+      float* pRe3 = pRe2 + nQuarter;
+      float* pIm3 = pIm2 + nQuarter;
+
+      for (int j = 0; j < nQuarter; j += 4)
+      {
+         __m128 c1 = _mm_loadu_ps(pCos1 + j);
+         __m128 s1 = _mm_loadu_ps(pSin1 + j);
+         __m128 c2 = _mm_loadu_ps(pCos2 + j);
+         __m128 s2 = _mm_loadu_ps(pSin2 + j);
+
+         __m128 a0Re = _mm_loadu_ps(pRe0 + j);
+         __m128 a0Im = _mm_loadu_ps(pIm0 + j);
+         __m128 a1Re = _mm_loadu_ps(pRe1 + j);
+         __m128 a1Im = _mm_loadu_ps(pIm1 + j);
+         __m128 a2Re = _mm_loadu_ps(pRe2 + j);
+         __m128 a2Im = _mm_loadu_ps(pIm2 + j);
+         __m128 a3Re = _mm_loadu_ps(pRe3 + j);
+         __m128 a3Im = _mm_loadu_ps(pIm3 + j);
+
+         __m128 t1Re = _mm_sub_ps(_mm_mul_ps(c1, a1Re), _mm_mul_ps(s1, a1Im));
+         __m128 t1Im = _mm_add_ps(_mm_mul_ps(c1, a1Im), _mm_mul_ps(s1, a1Re));
+         __m128 t3Re = _mm_sub_ps(_mm_mul_ps(c1, a3Re), _mm_mul_ps(s1, a3Im));
+         __m128 t3Im = _mm_add_ps(_mm_mul_ps(c1, a3Im), _mm_mul_ps(s1, a3Re));
+
+         __m128 b0Re = _mm_add_ps(a0Re, t1Re);
+         __m128 b0Im = _mm_add_ps(a0Im, t1Im);
+         __m128 b1Re = _mm_sub_ps(a0Re, t1Re);
+         __m128 b1Im = _mm_sub_ps(a0Im, t1Im);
+         __m128 b2Re = _mm_add_ps(a2Re, t3Re);
+         __m128 b2Im = _mm_add_ps(a2Im, t3Im);
+         __m128 b3Re = _mm_sub_ps(a2Re, t3Re);
+         __m128 b3Im = _mm_sub_ps(a2Im, t3Im);
+
+         __m128 t2Re = _mm_sub_ps(_mm_mul_ps(c2, b2Re), _mm_mul_ps(s2, b2Im));
+         __m128 t2Im = _mm_add_ps(_mm_mul_ps(c2, b2Im), _mm_mul_ps(s2, b2Re));
+         __m128 u3Re = _mm_sub_ps(_mm_mul_ps(c2, b3Re), _mm_mul_ps(s2, b3Im));
+         __m128 u3Im = _mm_add_ps(_mm_mul_ps(c2, b3Im), _mm_mul_ps(s2, b3Re));
+         __m128 rRe = _mm_mul_ps(u3Im, vNegRotate);
+         __m128 rIm = _mm_mul_ps(u3Re, vRotate);
+
+         _mm_storeu_ps(pRe0 + j, _mm_add_ps(b0Re, t2Re));
+         _mm_storeu_ps(pIm0 + j, _mm_add_ps(b0Im, t2Im));
+         _mm_storeu_ps(pRe2 + j, _mm_sub_ps(b0Re, t2Re));
+         _mm_storeu_ps(pIm2 + j, _mm_sub_ps(b0Im, t2Im));
+         _mm_storeu_ps(pRe1 + j, _mm_add_ps(b1Re, rRe));
+         _mm_storeu_ps(pIm1 + j, _mm_add_ps(b1Im, rIm));
+         _mm_storeu_ps(pRe3 + j, _mm_sub_ps(b1Re, rRe));
+         _mm_storeu_ps(pIm3 + j, _mm_sub_ps(b1Im, rIm));
+      }
+   }
+}
+
+static FFT_FORCEINLINE void Radix2Stage_SSE2(float* pReal, float* pImaginary, int nSize, int nHalf,
+                             const float* pCos, const float* pSin)
+{
+   if (nHalf < 4)
+   {
+      Radix2Stage_Scalar(pReal, pImaginary, nSize, nHalf, pCos, pSin);
+      return;
+   }
+
+   int nSpan = nHalf * 2;
+
+   for (int g = 0; g < nSize; g += nSpan)
+   {
+      float* pRe0 = pReal + g;
+      float* pIm0 = pImaginary + g;
+      float* pRe1 = pRe0 + nHalf;
+      float* pIm1 = pIm0 + nHalf;
+
+      for (int j = 0; j < nHalf; j += 4)
+      {
+         __m128 c = _mm_loadu_ps(pCos + j);
+         __m128 s = _mm_loadu_ps(pSin + j);
+         __m128 a0Re = _mm_loadu_ps(pRe0 + j);
+         __m128 a0Im = _mm_loadu_ps(pIm0 + j);
+         __m128 a1Re = _mm_loadu_ps(pRe1 + j);
+         __m128 a1Im = _mm_loadu_ps(pIm1 + j);
+
+         __m128 tRe = _mm_sub_ps(_mm_mul_ps(c, a1Re), _mm_mul_ps(s, a1Im));
+         __m128 tIm = _mm_add_ps(_mm_mul_ps(c, a1Im), _mm_mul_ps(s, a1Re));
+
+         _mm_storeu_ps(pRe1 + j, _mm_sub_ps(a0Re, tRe));
+         _mm_storeu_ps(pIm1 + j, _mm_sub_ps(a0Im, tIm));
+         _mm_storeu_ps(pRe0 + j, _mm_add_ps(a0Re, tRe));
+         _mm_storeu_ps(pIm0 + j, _mm_add_ps(a0Im, tIm));
+      }
+   }
+}
+
+static void BatchRadix4Stage_SSE2(float* pReal, float* pImaginary, int nSize, int nQuarter,
+                                  const float* pCos1, const float* pSin1,
+                                  const float* pCos2, const float* pSin2,
+                                  float fRotate)
+{
+   __m128 vRotate = _mm_set1_ps(fRotate);
+   __m128 vNegRotate = _mm_set1_ps(-fRotate);
+   int nSpan = nQuarter * 4;
+   int nStride = nQuarter * FFT_BATCH_LANES;
+
+   for (int g = 0; g < nSize; g += nSpan)
+   {
+      for (int j = 0; j < nQuarter; j++)
+      {
+         __m128 c1 = _mm_set1_ps(pCos1[j]);
+         __m128 s1 = _mm_set1_ps(pSin1[j]);
+         __m128 c2 = _mm_set1_ps(pCos2[j]);
+         __m128 s2 = _mm_set1_ps(pSin2[j]);
+
+         float* pRe0 = pReal + (g + j) * FFT_BATCH_LANES;
+         float* pIm0 = pImaginary + (g + j) * FFT_BATCH_LANES;
+         float* pRe1 = pRe0 + nStride;
+         float* pIm1 = pIm0 + nStride;
+         float* pRe2 = pRe1 + nStride;
+         float* pIm2 = pIm1 + nStride;
+         float* pRe3 = pRe2 + nStride;
+         float* pIm3 = pIm2 + nStride;
+
+         for (int l = 0; l < FFT_BATCH_LANES; l += 4)
+         {
+            __m128 a0Re = _mm_loadu_ps(pRe0 + l);
+            __m128 a0Im = _mm_loadu_ps(pIm0 + l);
+            __m128 a1Re = _mm_loadu_ps(pRe1 + l);
+            __m128 a1Im = _mm_loadu_ps(pIm1 + l);
+            __m128 a2Re = _mm_loadu_ps(pRe2 + l);
+            __m128 a2Im = _mm_loadu_ps(pIm2 + l);
+            __m128 a3Re = _mm_loadu_ps(pRe3 + l);
+            __m128 a3Im = _mm_loadu_ps(pIm3 + l);
+
+            __m128 t1Re = _mm_sub_ps(_mm_mul_ps(c1, a1Re), _mm_mul_ps(s1, a1Im));
+            __m128 t1Im = _mm_add_ps(_mm_mul_ps(c1, a1Im), _mm_mul_ps(s1, a1Re));
+            __m128 t3Re = _mm_sub_ps(_mm_mul_ps(c1, a3Re), _mm_mul_ps(s1, a3Im));
+            __m128 t3Im = _mm_add_ps(_mm_mul_ps(c1, a3Im), _mm_mul_ps(s1, a3Re));
+
+            __m128 b0Re = _mm_add_ps(a0Re, t1Re);
+            __m128 b0Im = _mm_add_ps(a0Im, t1Im);
+            __m128 b1Re = _mm_sub_ps(a0Re, t1Re);
+            __m128 b1Im = _mm_sub_ps(a0Im, t1Im);
+            __m128 b2Re = _mm_add_ps(a2Re, t3Re);
+            __m128 b2Im = _mm_add_ps(a2Im, t3Im);
+            __m128 b3Re = _mm_sub_ps(a2Re, t3Re);
+            __m128 b3Im = _mm_sub_ps(a2Im, t3Im);
+
+            __m128 t2Re = _mm_sub_ps(_mm_mul_ps(c2, b2Re), _mm_mul_ps(s2, b2Im));
+            __m128 t2Im = _mm_add_ps(_mm_mul_ps(c2, b2Im), _mm_mul_ps(s2, b2Re));
+            __m128 u3Re = _mm_sub_ps(_mm_mul_ps(c2, b3Re), _mm_mul_ps(s2, b3Im));
+            __m128 u3Im = _mm_add_ps(_mm_mul_ps(c2, b3Im), _mm_mul_ps(s2, b3Re));
+            __m128 rRe = _mm_mul_ps(u3Im, vNegRotate);
+            __m128 rIm = _mm_mul_ps(u3Re, vRotate);
+
+            _mm_storeu_ps(pRe0 + l, _mm_add_ps(b0Re, t2Re));
+            _mm_storeu_ps(pIm0 + l, _mm_add_ps(b0Im, t2Im));
+            _mm_storeu_ps(pRe2 + l, _mm_sub_ps(b0Re, t2Re));
+            _mm_storeu_ps(pIm2 + l, _mm_sub_ps(b0Im, t2Im));
+            _mm_storeu_ps(pRe1 + l, _mm_add_ps(b1Re, rRe));
+            _mm_storeu_ps(pIm1 + l, _mm_add_ps(b1Im, rIm));
+            _mm_storeu_ps(pRe3 + l, _mm_sub_ps(b1Re, rRe));
+            _mm_storeu_ps(pIm3 + l, _mm_sub_ps(b1Im, rIm));
+         }
+      }
+   }
+}
+
+static void BatchRadix2Stage_SSE2(float* pReal, float* pImaginary, int nSize, int nHalf,
+                                  const float* pCos, const float* pSin)
+{
+   int nSpan = nHalf * 2;
+   int nStride = nHalf * FFT_BATCH_LANES;
+
+   for (int g = 0; g < nSize; g += nSpan)
+   {
+      for (int j = 0; j < nHalf; j++)
+      {
+         __m128 c = _mm_set1_ps(pCos[j]);
+         __m128 s = _mm_set1_ps(pSin[j]);
+
+         float* pRe0 = pReal + (g + j) * FFT_BATCH_LANES;
+         float* pIm0 = pImaginary + (g + j) * FFT_BATCH_LANES;
+         float* pRe1 = pRe0 + nStride;
+         float* pIm1 = pIm0 + nStride;
+
+         for (int l = 0; l < FFT_BATCH_LANES; l += 4)
+         {
+            __m128 a0Re = _mm_loadu_ps(pRe0 + l);
+            __m128 a0Im = _mm_loadu_ps(pIm0 + l);
+            __m128 a1Re = _mm_loadu_ps(pRe1 + l);
+            __m128 a1Im = _mm_loadu_ps(pIm1 + l);
+
+            __m128 tRe = _mm_sub_ps(_mm_mul_ps(c, a1Re), _mm_mul_ps(s, a1Im));
+            __m128 tIm = _mm_add_ps(_mm_mul_ps(c, a1Im), _mm_mul_ps(s, a1Re));
+
+            _mm_storeu_ps(pRe1 + l, _mm_sub_ps(a0Re, tRe));
+            _mm_storeu_ps(pIm1 + l, _mm_sub_ps(a0Im, tIm));
+            _mm_storeu_ps(pRe0 + l, _mm_add_ps(a0Re, tRe));
+            _mm_storeu_ps(pIm0 + l, _mm_add_ps(a0Im, tIm));
+         }
+      }
+   }
+}
+
+static void BatchStockham4Stage_SSE2(const float* pInReal, const float* pInImaginary,
+                                     float* pOutReal, float* pOutImaginary,
+                                     int nSize, int nStride,
+                                     const float* pCos, const float* pSin,
+                                     float fRotate)
+{
+   __m128 vRotate = _mm_set1_ps(fRotate);
+   __m128 vNegRotate = _mm_set1_ps(-fRotate);
+   int nQuarter = nSize / nStride / 4;
+   int nBlock = nStride * FFT_BATCH_LANES;
+
+   for (int p = 0; p < nQuarter; p++)
+   {
+      __m128 c1 = _mm_set1_ps(pCos[p]);
+      __m128 s1 = _mm_set1_ps(pSin[p]);
+      __m128 c2 = _mm_set1_ps(pCos[nQuarter + p]);
+      __m128 s2 = _mm_set1_ps(pSin[nQuarter + p]);
+      __m128 c3 = _mm_set1_ps(pCos[2 * nQuarter + p]);
+      __m128 s3 = _mm_set1_ps(pSin[2 * nQuarter + p]);
+
+      const float* pRe0 = pInReal + p * nBlock;
+      const float* pIm0 = pInImaginary + p * nBlock;
+      const float* pRe1 = pRe0 + nQuarter * nBlock;
+      const float* pIm1 = pIm0 + nQuarter * nBlock;
+      const float* pRe2 = pRe1 + nQuarter * nBlock;
+      const float* pIm2 = pIm1 + nQuarter * nBlock;
+      const float* pRe3 = pRe2 + nQuarter * nBlock;
+      const float* pIm3 = pIm2 + nQuarter * nBlock;
+
+      float* pOutRe0 = pOutReal + 4 * p * nBlock;
+      float* pOutIm0 = pOutImaginary + 4 * p * nBlock;
+      float* pOutRe1 = pOutRe0 + nBlock;
+      float* pOutIm1 = pOutIm0 + nBlock;
+      float* pOutRe2 = pOutRe1 + nBlock;
+      float* pOutIm2 = pOutIm1 + nBlock;
+      float* pOutRe3 = pOutRe2 + nBlock;
+      float* pOutIm3 = pOutIm2 + nBlock;
+
+      for (int k = 0; k < nBlock; k += 4)
+      {
+         __m128 a0Re = _mm_loadu_ps(pRe0 + k);
+         __m128 a0Im = _mm_loadu_ps(pIm0 + k);
+         __m128 a1Re = _mm_loadu_ps(pRe1 + k);
+         __m128 a1Im = _mm_loadu_ps(pIm1 + k);
+         __m128 a2Re = _mm_loadu_ps(pRe2 + k);
+         __m128 a2Im = _mm_loadu_ps(pIm2 + k);
+         __m128 a3Re = _mm_loadu_ps(pRe3 + k);
+         __m128 a3Im = _mm_loadu_ps(pIm3 + k);
+
+         __m128 apcRe = _mm_add_ps(a0Re, a2Re);
+         __m128 apcIm = _mm_add_ps(a0Im, a2Im);
+         __m128 amcRe = _mm_sub_ps(a0Re, a2Re);
+         __m128 amcIm = _mm_sub_ps(a0Im, a2Im);
+         __m128 bpdRe = _mm_add_ps(a1Re, a3Re);
+         __m128 bpdIm = _mm_add_ps(a1Im, a3Im);
+         __m128 bmdRe = _mm_sub_ps(a1Re, a3Re);
+         __m128 bmdIm = _mm_sub_ps(a1Im, a3Im);
+         __m128 jRe = _mm_mul_ps(bmdIm, vNegRotate);
+         __m128 jIm = _mm_mul_ps(bmdRe, vRotate);
+
+         __m128 y1Re = _mm_add_ps(amcRe, jRe);
+         __m128 y1Im = _mm_add_ps(amcIm, jIm);
+         __m128 y2Re = _mm_sub_ps(apcRe, bpdRe);
+         __m128 y2Im = _mm_sub_ps(apcIm, bpdIm);
+         __m128 y3Re = _mm_sub_ps(amcRe, jRe);
+         __m128 y3Im = _mm_sub_ps(amcIm, jIm);
+
+         _mm_storeu_ps(pOutRe0 + k, _mm_add_ps(apcRe, bpdRe));
+         _mm_storeu_ps(pOutIm0 + k, _mm_add_ps(apcIm, bpdIm));
+         _mm_storeu_ps(pOutRe1 + k, _mm_sub_ps(_mm_mul_ps(c1, y1Re), _mm_mul_ps(s1, y1Im)));
+         _mm_storeu_ps(pOutIm1 + k, _mm_add_ps(_mm_mul_ps(c1, y1Im), _mm_mul_ps(s1, y1Re)));
+         _mm_storeu_ps(pOutRe2 + k, _mm_sub_ps(_mm_mul_ps(c2, y2Re), _mm_mul_ps(s2, y2Im)));
+         _mm_storeu_ps(pOutIm2 + k, _mm_add_ps(_mm_mul_ps(c2, y2Im), _mm_mul_ps(s2, y2Re)));
+         _mm_storeu_ps(pOutRe3 + k, _mm_sub_ps(_mm_mul_ps(c3, y3Re), _mm_mul_ps(s3, y3Im)));
+         _mm_storeu_ps(pOutIm3 + k, _mm_add_ps(_mm_mul_ps(c3, y3Im), _mm_mul_ps(s3, y3Re)));
+      }
+   }
+}
+
+static void BatchStockham2Stage_SSE2(const float* pInReal, const float* pInImaginary,
+                                     float* pOutReal, float* pOutImaginary,
+                                     int nSize)
+{
+   int nBlock = (nSize / 2) * FFT_BATCH_LANES;
+
+   for (int k = 0; k < nBlock; k += 4)
+   {
+      __m128 aRe = _mm_loadu_ps(pInReal + k);
+      __m128 aIm = _mm_loadu_ps(pInImaginary + k);
+      __m128 bRe = _mm_loadu_ps(pInReal + nBlock + k);
+      __m128 bIm = _mm_loadu_ps(pInImaginary + nBlock + k);
+
+      _mm_storeu_ps(pOutReal + k, _mm_add_ps(aRe, bRe));
+      _mm_storeu_ps(pOutImaginary + k, _mm_add_ps(aIm, bIm));
+      _mm_storeu_ps(pOutReal + nBlock + k, _mm_sub_ps(aRe, bRe));
+      _mm_storeu_ps(pOutImaginary + nBlock + k, _mm_sub_ps(aIm, bIm));
+   }
+}
+#endif
+
+#ifdef FFT_KERNELS_AVX2
+// -------------------------------------------------------------------------
+// AVX2 Kernels (8 lanes). Spans shorter than 8 points fall back to SSE2.
+// -------------------------------------------------------------------------
+FFT_TARGET_AVX2
+static FFT_FORCEINLINE void Radix4Stage_AVX2(float* pReal, float* pImaginary, int nSize, int nQuarter,
+                             const float* pCos1, const float* pSin1,
+                             const float* pCos2, const float* pSin2,
+                             float fRotate)
+{
+   if (nQuarter < 8)
+   {
+      Radix4Stage_SSE2(pReal, pImaginary, nSize, nQuarter, pCos1, pSin1, pCos2, pSin2, fRotate);
+      return;
+   }
+
+   __m256 vRotate = _mm256_set1_ps(fRotate);
+   __m256 vNegRotate = _mm256_set1_ps(-fRotate);
+   int nSpan = nQuarter * 4;
+
+   for (int g = 0; g < nSize; g += nSpan)
+   {
+      float* pRe0 = pReal + g;
+      float* pIm0 = pImaginary + g;
+      float* pRe1 = pRe0 + nQuarter;
+      float* pIm1 = pIm0 + nQuarter;
+      float* pRe2 = pRe1 + nQuarter;
+      float* pIm2 = pIm1 + nQuarter;
+      float* pRe3 = pRe2 + nQuarter;
+      float* pIm3 = pIm2 + nQuarter;
+
+      for (int j = 0; j < nQuarter; j += 8)
+      {
+         __m256 c1 = _mm256_loadu_ps(pCos1 + j);
+         __m256 s1 = _mm256_loadu_ps(pSin1 + j);
+         __m256 c2 = _mm256_loadu_ps(pCos2 + j);
+         __m256 s2 = _mm256_loadu_ps(pSin2 + j);
+
+         __m256 a0Re = _mm256_loadu_ps(pRe0 + j);
+         __m256 a0Im = _mm256_loadu_ps(pIm0 + j);
+         __m256 a1Re = _mm256_loadu_ps(pRe1 + j);
+         __m256 a1Im = _mm256_loadu_ps(pIm1 + j);
+         __m256 a2Re = _mm256_loadu_ps(pRe2 + j);
+         __m256 a2Im = _mm256_loadu_ps(pIm2 + j);
+         __m256 a3Re = _mm256_loadu_ps(pRe3 + j);
+         __m256 a3Im = _mm256_loadu_ps(pIm3 + j);
+
+         __m256 t1Re = _mm256_sub_ps(_mm256_mul_ps(c1, a1Re), _mm256_mul_ps(s1, a1Im));
+         __m256 t1Im = _mm256_add_ps(_mm256_mul_ps(c1, a1Im), _mm256_mul_ps(s1, a1Re));
+         __m256 t3Re = _mm256_sub_ps(_mm256_mul_ps(c1, a3Re), _mm256_mul_ps(s1, a3Im));
+         __m256 t3Im = _mm256_add_ps(_mm256_mul_ps(c1, a3Im), _mm256_mul_ps(s1, a3Re));
+
+         __m256 b0Re = _mm256_add_ps(a0Re, t1Re);
+         __m256 b0Im = _mm256_add_ps(a0Im, t1Im);
+         __m256 b1Re = _mm256_sub_ps(a0Re, t1Re);
+         __m256 b1Im = _mm256_sub_ps(a0Im, t1Im);
+         __m256 b2Re = _mm256_add_ps(a2Re, t3Re);
+         __m256 b2Im = _mm256_add_ps(a2Im, t3Im);
+         __m256 b3Re = _mm256_sub_ps(a2Re, t3Re);
+         __m256 b3Im = _mm256_sub_ps(a2Im, t3Im);
+
+         __m256 t2Re = _mm256_sub_ps(_mm256_mul_ps(c2, b2Re), _mm256_mul_ps(s2, b2Im));
+         __m256 t2Im = _mm256_add_ps(_mm256_mul_ps(c2, b2Im), _mm256_mul_ps(s2, b2Re));
+         __m256 u3Re = _mm256_sub_ps(_mm256_mul_ps(c2, b3Re), _mm256_mul_ps(s2, b3Im));
+         __m256 u3Im = _mm256_add_ps(_mm256_mul_ps(c2, b3Im), _mm256_mul_ps(s2, b3Re));
+         __m256 rRe = _mm256_mul_ps(u3Im, vNegRotate);
+         __m256 rIm = _mm256_mul_ps(u3Re, vRotate);
+
+         _mm256_storeu_ps(pRe0 + j, _mm256_add_ps(b0Re, t2Re));
+         _mm256_storeu_ps(pIm0 + j, _mm256_add_ps(b0Im, t2Im));
+         _mm256_storeu_ps(pRe2 + j, _mm256_sub_ps(b0Re, t2Re));
+         _mm256_storeu_ps(pIm2 + j, _mm256_sub_ps(b0Im, t2Im));
+         _mm256_storeu_ps(pRe1 + j, _mm256_add_ps(b1Re, rRe));
+         _mm256_storeu_ps(pIm1 + j, _mm256_add_ps(b1Im, rIm));
+         _mm256_storeu_ps(pRe3 + j, _mm256_sub_ps(b1Re, rRe));
+         _mm256_storeu_ps(pIm3 + j, _mm256_sub_ps(b1Im, rIm));
+      }
+   }
+}
+
+FFT_TARGET_AVX2
+static FFT_FORCEINLINE void Radix2Stage_AVX2(float* pReal, float* pImaginary, int nSize, int nHalf,
+                             const float* pCos, const float* pSin)
+{
+   if (nHalf < 8)
+   {
+      Radix2Stage_SSE2(pReal, pImaginary, nSize, nHalf, pCos, pSin);
+      return;
+   }
+
+   int nSpan = nHalf * 2;
+
+   for (int g = 0; g < nSize; g += nSpan)
+   {
+      float* pRe0 = pReal + g;
+      float* pIm0 = pImaginary + g;
+      float* pRe1 = pRe0 + nHalf;
+      float* pIm1 = pIm0 + nHalf;
+
+      for (int j = 0; j < nHalf; j += 8)
+      {
+         __m256 c = _mm256_loadu_ps(pCos + j);
+         __m256 s = _mm256_loadu_ps(pSin + j);
+         __m256 a0Re = _mm256_loadu_ps(pRe0 + j);
+         __m256 a0Im = _mm256_loadu_ps(pIm0 + j);
+         __m256 a1Re = _mm256_loadu_ps(pRe1 + j);
+         __m256 a1Im = _mm256_loadu_ps(pIm1 + j);
+
+         __m256 tRe = _mm256_sub_ps(_mm256_mul_ps(c, a1Re), _mm256_mul_ps(s, a1Im));
+         __m256 tIm = _mm256_add_ps(_mm256_mul_ps(c, a1Im), _mm256_mul_ps(s, a1Re));
+
+         _mm256_storeu_ps(pRe1 + j, _mm256_sub_ps(a0Re, tRe));
+         _mm256_storeu_ps(pIm1 + j, _mm256_sub_ps(a0Im, tIm));
+         _mm256_storeu_ps(pRe0 + j, _mm256_add_ps(a0Re, tRe));
+         _mm256_storeu_ps(pIm0 + j, _mm256_add_ps(a0Im, tIm));
+      }
+   }
+}
+
+FFT_TARGET_AVX2
+static void BatchRadix4Stage_AVX2(float* pReal, float* pImaginary, int nSize, int nQuarter,
+                                  const float* pCos1, const float* pSin1,
+                                  const float* pCos2, const float* pSin2,
+                                  float fRotate)
+{
+   __m256 vRotate = _mm256_set1_ps(fRotate);
+   __m256 vNegRotate = _mm256_set1_ps(-fRotate);
+   int nSpan = nQuarter * 4;
+   int nStride = nQuarter * FFT_BATCH_LANES;
+
+   for (int g = 0; g < nSize; g += nSpan)
+   {
+      for (int j = 0; j < nQuarter; j++)
+      {
+         __m256 c1 = _mm256_set1_ps(pCos1[j]);
+         __m256 s1 = _mm256_set1_ps(pSin1[j]);
+         __m256 c2 = _mm256_set1_ps(pCos2[j]);
+         __m256 s2 = _mm256_set1_ps(pSin2[j]);
+
+         float* pRe0 = pReal + (g + j) * FFT_BATCH_LANES;
+         float* pIm0 = pImaginary + (g + j) * FFT_BATCH_LANES;
+         float* pRe1 = pRe0 + nStride;
+         float* pIm1 = pIm0 + nStride;
+         float* pRe2 = pRe1 + nStride;
+         float* pIm2 = pIm1 + nStride;
+         float* pRe3 = pRe2 + nStride;
+         float* pIm3 = pIm2 + nStride;
+
+         __m256 a0Re = _mm256_loadu_ps(pRe0);
+         __m256 a0Im = _mm256_loadu_ps(pIm0);
+         __m256 a1Re = _mm256_loadu_ps(pRe1);
+         __m256 a1Im = _mm256_loadu_ps(pIm1);
+         __m256 a2Re = _mm256_loadu_ps(pRe2);
+         __m256 a2Im = _mm256_loadu_ps(pIm2);
+         __m256 a3Re = _mm256_loadu_ps(pRe3);
+         __m256 a3Im = _mm256_loadu_ps(pIm3);
+
+         __m256 t1Re = _mm256_sub_ps(_mm256_mul_ps(c1, a1Re), _mm256_mul_ps(s1, a1Im));
+         __m256 t1Im = _mm256_add_ps(_mm256_mul_ps(c1, a1Im), _mm256_mul_ps(s1, a1Re));
+         __m256 t3Re = _mm256_sub_ps(_mm256_mul_ps(c1, a3Re), _mm256_mul_ps(s1, a3Im));
+         __m256 t3Im = _mm256_add_ps(_mm256_mul_ps(c1, a3Im), _mm256_mul_ps(s1, a3Re));
+
+         __m256 b0Re = _mm256_add_ps(a0Re, t1Re);
+         __m256 b0Im = _mm256_add_ps(a0Im, t1Im);
+         __m256 b1Re = _mm256_sub_ps(a0Re, t1Re);
+         __m256 b1Im = _mm256_sub_ps(a0Im, t1Im);
+         __m256 b2Re = _mm256_add_ps(a2Re, t3Re);
+         __m256 b2Im = _mm256_add_ps(a2Im, t3Im);
+         __m256 b3Re = _mm256_sub_ps(a2Re, t3Re);
+         __m256 b3Im = _mm256_sub_ps(a2Im, t3Im);
+
+         __m256 t2Re = _mm256_sub_ps(_mm256_mul_ps(c2, b2Re), _mm256_mul_ps(s2, b2Im));
+         __m256 t2Im = _mm256_add_ps(_mm256_mul_ps(c2, b2Im), _mm256_mul_ps(s2, b2Re));
+         __m256 u3Re = _mm256_sub_ps(_mm256_mul_ps(c2, b3Re), _mm256_mul_ps(s2, b3Im));
+         __m256 u3Im = _mm256_add_ps(_mm256_mul_ps(c2, b3Im), _mm256_mul_ps(s2, b3Re));
+         __m256 rRe = _mm256_mul_ps(u3Im, vNegRotate);
+         __m256 rIm = _mm256_mul_ps(u3Re, vRotate);
+
+         _mm256_storeu_ps(pRe0, _mm256_add_ps(b0Re, t2Re));
+         _mm256_storeu_ps(pIm0, _mm256_add_ps(b0Im, t2Im));
+         _mm256_storeu_ps(pRe2, _mm256_sub_ps(b0Re, t2Re));
+         _mm256_storeu_ps(pIm2, _mm256_sub_ps(b0Im, t2Im));
+         _mm256_storeu_ps(pRe1, _mm256_add_ps(b1Re, rRe));
+         _mm256_storeu_ps(pIm1, _mm256_add_ps(b1Im, rIm));
+         _mm256_storeu_ps(pRe3, _mm256_sub_ps(b1Re, rRe));
+         _mm256_storeu_ps(pIm3, _mm256_sub_ps(b1Im, rIm));
+      }
+   }
+}
+
+FFT_TARGET_AVX2
+static void BatchRadix2Stage_AVX2(float* pReal, float* pImaginary, int nSize, int nHalf,
+                                  const float* pCos, const float* pSin)
+{
+   int nSpan = nHalf * 2;
+   int nStride = nHalf * FFT_BATCH_LANES;
+
+   for (int g = 0; g < nSize; g += nSpan)
+   {
+      for (int j = 0; j < nHalf; j++)
+      {
+         __m256 c = _mm256_set1_ps(pCos[j]);
+         __m256 s = _mm256_set1_ps(pSin[j]);
+
+         float* pRe0 = pReal + (g + j) * FFT_BATCH_LANES;
+         float* pIm0 = pImaginary + (g + j) * FFT_BATCH_LANES;
+         float* pRe1 = pRe0 + nStride;
+         float* pIm1 = pIm0 + nStride;
+
+         __m256 a0Re = _mm256_loadu_ps(pRe0);
+         __m256 a0Im = _mm256_loadu_ps(pIm0);
+         __m256 a1Re = _mm256_loadu_ps(pRe1);
+         __m256 a1Im = _mm256_loadu_ps(pIm1);
+
+         __m256 tRe = _mm256_sub_ps(_mm256_mul_ps(c, a1Re), _mm256_mul_ps(s, a1Im));
+         __m256 tIm = _mm256_add_ps(_mm256_mul_ps(c, a1Im), _mm256_mul_ps(s, a1Re));
+
+         _mm256_storeu_ps(pRe1, _mm256_sub_ps(a0Re, tRe));
+         _mm256_storeu_ps(pIm1, _mm256_sub_ps(a0Im, tIm));
+         _mm256_storeu_ps(pRe0, _mm256_add_ps(a0Re, tRe));
+         _mm256_storeu_ps(pIm0, _mm256_add_ps(a0Im, tIm));
+      }
+   }
+}
+
+FFT_TARGET_AVX2
+static void BatchStockham4Stage_AVX2(const float* pInReal, const float* pInImaginary,
+                                     float* pOutReal, float* pOutImaginary,
+                                     int nSize, int nStride,
+                                     const float* pCos, const float* pSin,
+                                     float fRotate)
+{
+   __m256 vRotate = _mm256_set1_ps(fRotate);
+   __m256 vNegRotate = _mm256_set1_ps(-fRotate);
+   int nQuarter = nSize / nStride / 4;
+   int nBlock = nStride * FFT_BATCH_LANES;
+
+   for (int p = 0; p < nQuarter; p++)
+   {
+      __m256 c1 = _mm256_set1_ps(pCos[p]);
+      __m256 s1 = _mm256_set1_ps(pSin[p]);
+      __m256 c2 = _mm256_set1_ps(pCos[nQuarter + p]);
+      __m256 s2 = _mm256_set1_ps(pSin[nQuarter + p]);
+      __m256 c3 = _mm256_set1_ps(pCos[2 * nQuarter + p]);
+      __m256 s3 = _mm256_set1_ps(pSin[2 * nQuarter + p]);
+
+      const float* pRe0 = pInReal + p * nBlock;
+      const float* pIm0 = pInImaginary + p * nBlock;
+      const float* pRe1 = pRe0 + nQuarter * nBlock;
+      const float* pIm1 = pIm0 + nQuarter * nBlock;
+      const float* pRe2 = pRe1 + nQuarter * nBlock;
+      const float* pIm2 = pIm1 + nQuarter * nBlock;
+      const float* pRe3 = pRe2 + nQuarter * nBlock;
+      const float* pIm3 = pIm2 + nQuarter * nBlock;
+
+      float* pOutRe0 = pOutReal + 4 * p * nBlock;
+      float* pOutIm0 = pOutImaginary + 4 * p * nBlock;
+      float* pOutRe1 = pOutRe0 + nBlock;
+      float* pOutIm1 = pOutIm0 + nBlock;
+      float* pOutRe2 = pOutRe1 + nBlock;
+      float* pOutIm2 = pOutIm1 + nBlock;
+      float* pOutRe3 = pOutRe2 + nBlock;
+      float* pOutIm3 = pOutIm2 + nBlock;
+
+      for (int k = 0; k < nBlock; k += 8)
+      {
+         __m256 a0Re = _mm256_loadu_ps(pRe0 + k);
+         __m256 a0Im = _mm256_loadu_ps(pIm0 + k);
+         __m256 a1Re = _mm256_loadu_ps(pRe1 + k);
+         __m256 a1Im = _mm256_loadu_ps(pIm1 + k);
+         __m256 a2Re = _mm256_loadu_ps(pRe2 + k);
+         __m256 a2Im = _mm256_loadu_ps(pIm2 + k);
+         __m256 a3Re = _mm256_loadu_ps(pRe3 + k);
+         __m256 a3Im = _mm256_loadu_ps(pIm3 + k);
+
+         __m256 apcRe = _mm256_add_ps(a0Re, a2Re);
+         __m256 apcIm = _mm256_add_ps(a0Im, a2Im);
+         __m256 amcRe = _mm256_sub_ps(a0Re, a2Re);
+         __m256 amcIm = _mm256_sub_ps(a0Im, a2Im);
+         __m256 bpdRe = _mm256_add_ps(a1Re, a3Re);
+         __m256 bpdIm = _mm256_add_ps(a1Im, a3Im);
+         __m256 bmdRe = _mm256_sub_ps(a1Re, a3Re);
+         __m256 bmdIm = _mm256_sub_ps(a1Im, a3Im);
+         __m256 jRe = _mm256_mul_ps(bmdIm, vNegRotate);
+         __m256 jIm = _mm256_mul_ps(bmdRe, vRotate);
+
+         __m256 y1Re = _mm256_add_ps(amcRe, jRe);
+         __m256 y1Im = _mm256_add_ps(amcIm, jIm);
+         __m256 y2Re = _mm256_sub_ps(apcRe, bpdRe);
+         __m256 y2Im = _mm256_sub_ps(apcIm, bpdIm);
+         __m256 y3Re = _mm256_sub_ps(amcRe, jRe);
+         __m256 y3Im = _mm256_sub_ps(amcIm, jIm);
+
+         _mm256_storeu_ps(pOutRe0 + k, _mm256_add_ps(apcRe, bpdRe));
+         _mm256_storeu_ps(pOutIm0 + k, _mm256_add_ps(apcIm, bpdIm));
+         _mm256_storeu_ps(pOutRe1 + k, _mm256_sub_ps(_mm256_mul_ps(c1, y1Re), _mm256_mul_ps(s1, y1Im)));
+         _mm256_storeu_ps(pOutIm1 + k, _mm256_add_ps(_mm256_mul_ps(c1, y1Im), _mm256_mul_ps(s1, y1Re)));
+         _mm256_storeu_ps(pOutRe2 + k, _mm256_sub_ps(_mm256_mul_ps(c2, y2Re), _mm256_mul_ps(s2, y2Im)));
+         _mm256_storeu_ps(pOutIm2 + k, _mm256_add_ps(_mm256_mul_ps(c2, y2Im), _mm256_mul_ps(s2, y2Re)));
+         _mm256_storeu_ps(pOutRe3 + k, _mm256_sub_ps(_mm256_mul_ps(c3, y3Re), _mm256_mul_ps(s3, y3Im)));
+         _mm256_storeu_ps(pOutIm3 + k, _mm256_add_ps(_mm256_mul_ps(c3, y3Im), _mm256_mul_ps(s3, y3Re)));
+      }
+   }
+}
+
+FFT_TARGET_AVX2
+static void BatchStockham2Stage_AVX2(const float* pInReal, const float* pInImaginary,
+                                     float* pOutReal, float* pOutImaginary,
+                                     int nSize)
+{
+   int nBlock = (nSize / 2) * FFT_BATCH_LANES;
+
+   for (int k = 0; k < nBlock; k += 8)
+   {
+      __m256 aRe = _mm256_loadu_ps(pInReal + k);
+      __m256 aIm = _mm256_loadu_ps(pInImaginary + k);
+      __m256 bRe = _mm256_loadu_ps(pInReal + nBlock + k);
+      __m256 bIm = _mm256_loadu_ps(pInImaginary + nBlock + k);
+
+      _mm256_storeu_ps(pOutReal + k, _mm256_add_ps(aRe, bRe));
+      _mm256_storeu_ps(pOutImaginary + k, _mm256_add_ps(aIm, bIm));
+      _mm256_storeu_ps(pOutReal + nBlock + k, _mm256_sub_ps(aRe, bRe));
+      _mm256_storeu_ps(pOutImaginary + nBlock + k, _mm256_sub_ps(aIm, bIm));
+   }
+}
+#endif
+
+// -------------------------------------------------------------------------
+// Fixed-size transforms. The first four stages, whose twiddles are the
+// same for every size, run as one 16-point codelet that keeps each block
+// in registers and uses constant twiddles. The remaining stages are
+// unrolled by template recursion, so every loop bound and table offset is
+// a compile-time constant of the specialization.
+// -------------------------------------------------------------------------
+#if defined(FFT_KERNELS_SSE2)
+
+// -------------------------------------------------------------------------
+// Twiddles of the stages spanning 4 and 8 points, exp{i*PI*j/4} and
+// exp{i*PI*j/8} for j = 0..3, rounded exactly as CFFTPlan rounds its tables
+// so the fixed and the generic transforms give identical results.
+// -------------------------------------------------------------------------
+static const float s_Codelet16Cos1[4] = { 1.0f, 0.707106769f, 6.12323426e-17f, -0.707106769f };
+static const float s_Codelet16Sin1[4] = { 0.0f, 0.707106769f, 1.0f, 0.707106769f };
+static const float s_Codelet16Cos2[4] = { 1.0f, 0.923879504f, 0.707106769f, 0.382683426f };
+static const float s_Codelet16Sin2[4] = { 0.0f, 0.382683426f, 0.707106769f, 0.923879504f };
+
+// -------------------------------------------------------------------------
+// Selects the next pass from the span l1 reached so far: 2 for a radix-4
+// pass, 1 for the trailing radix-2 pass, 0 when the transform is complete.
+// -------------------------------------------------------------------------
+#define FFT_FIXED_NEXT_PASS(N, L1)     (((L1) * 4 <= (N)) ? 2 : (((L1) < (N)) ? 1 : 0))
+
+static void Codelet16_SSE2(float* pReal, float* pImaginary, int nSize, float fRotate)
+{
+   __m128 vRotate = _mm_set1_ps(fRotate);
+   __m128 vNegRotate = _mm_set1_ps(-fRotate);
+
+   __m128 c1 = _mm_loadu_ps(s_Codelet16Cos1);
+   __m128 s1 = _mm_mul_ps(_mm_loadu_ps(s_Codelet16Sin1), vRotate);
+   __m128 c2 = _mm_loadu_ps(s_Codelet16Cos2);
+   __m128 s2 = _mm_mul_ps(_mm_loadu_ps(s_Codelet16Sin2), vRotate);
+
+   for (int g = 0; g < nSize; g += 16)
+   {
+      __m128 a0Re = _mm_loadu_ps(pReal + g);
+      __m128 a1Re = _mm_loadu_ps(pReal + g + 4);
+      __m128 a2Re = _mm_loadu_ps(pReal + g + 8);
+      __m128 a3Re = _mm_loadu_ps(pReal + g + 12);
+      __m128 a0Im = _mm_loadu_ps(pImaginary + g);
+      __m128 a1Im = _mm_loadu_ps(pImaginary + g + 4);
+      __m128 a2Im = _mm_loadu_ps(pImaginary + g + 8);
+      __m128 a3Im = _mm_loadu_ps(pImaginary + g + 12);
+
+      // ----------------------------------------------------------------------
+      // Stages spanning 1 and 2 points, across the four groups of four.
+      // ----------------------------------------------------------------------
+      _MM_TRANSPOSE4_PS(a0Re, a1Re, a2Re, a3Re);
+      _MM_TRANSPOSE4_PS(a0Im, a1Im, a2Im, a3Im);
+
+      __m128 b0Re = _mm_add_ps(a0Re, a1Re);
+      __m128 b0Im = _mm_add_ps(a0Im, a1Im);
+      __m128 b1Re = _mm_sub_ps(a0Re, a1Re);
+      __m128 b1Im = _mm_sub_ps(a0Im, a1Im);
+      __m128 b2Re = _mm_add_ps(a2Re, a3Re);
+      __m128 b2Im = _mm_add_ps(a2Im, a3Im);
+      __m128 b3Re = _mm_sub_ps(a2Re, a3Re);
+      __m128 b3Im = _mm_sub_ps(a2Im, a3Im);
+
+      __m128 rRe = _mm_mul_ps(b3Im, vNegRotate);
+      __m128 rIm = _mm_mul_ps(b3Re, vRotate);
+
+      a0Re = _mm_add_ps(b0Re, b2Re);
+      a0Im = _mm_add_ps(b0Im, b2Im);
+      a1Re = _mm_add_ps(b1Re, rRe);
+      a1Im = _mm_add_ps(b1Im, rIm);
+      a2Re = _mm_sub_ps(b0Re, b2Re);
+      a2Im = _mm_sub_ps(b0Im, b2Im);
+      a3Re = _mm_sub_ps(b1Re, rRe);
+      a3Im = _mm_sub_ps(b1Im, rIm);
+
+      _MM_TRANSPOSE4_PS(a0Re, a1Re, a2Re, a3Re);
+      _MM_TRANSPOSE4_PS(a0Im, a1Im, a2Im, a3Im);
+
+      // ----------------------------------------------------------------------
+      // Stages spanning 4 and 8 points, with the constant twiddles.
+      // ----------------------------------------------------------------------
+      __m128 t1Re = _mm_sub_ps(_mm_mul_ps(c1, a1Re), _mm_mul_ps(s1, a1Im));
+      __m128 t1Im = _mm_add_ps(_mm_mul_ps(c1, a1Im), _mm_mul_ps(s1, a1Re));
+      __m128 t3Re = _mm_sub_ps(_mm_mul_ps(c1, a3Re), _mm_mul_ps(s1, a3Im));
+      __m128 t3Im = _mm_add_ps(_mm_mul_ps(c1, a3Im), _mm_mul_ps(s1, a3Re));
+
+      b0Re = _mm_add_ps(a0Re, t1Re);
+      b0Im = _mm_add_ps(a0Im, t1Im);
+      b1Re = _mm_sub_ps(a0Re, t1Re);
+      b1Im = _mm_sub_ps(a0Im, t1Im);
+      b2Re = _mm_add_ps(a2Re, t3Re);
+      b2Im = _mm_add_ps(a2Im, t3Im);
+      b3Re = _mm_sub_ps(a2Re, t3Re);
+      b3Im = _mm_sub_ps(a2Im, t3Im);
+
+      __m128 t2Re = _mm_sub_ps(_mm_mul_ps(c2, b2Re), _mm_mul_ps(s2, b2Im));
+      __m128 t2Im = _mm_add_ps(_mm_mul_ps(c2, b2Im), _mm_mul_ps(s2, b2Re));
+      __m128 u3Re = _mm_sub_ps(_mm_mul_ps(c2, b3Re), _mm_mul_ps(s2, b3Im));
+      __m128 u3Im = _mm_add_ps(_mm_mul_ps(c2, b3Im), _mm_mul_ps(s2, b3Re));
+      rRe = _mm_mul_ps(u3Im, vNegRotate);
+      rIm = _mm_mul_ps(u3Re, vRotate);
+
+      _mm_storeu_ps(pReal + g, _mm_add_ps(b0Re, t2Re));
+      _mm_storeu_ps(pImaginary + g, _mm_add_ps(b0Im, t2Im));
+      _mm_storeu_ps(pReal + g + 8, _mm_sub_ps(b0Re, t2Re));
+      _mm_storeu_ps(pImaginary + g + 8, _mm_sub_ps(b0Im, t2Im));
+      _mm_storeu_ps(pReal + g + 4, _mm_add_ps(b1Re, rRe));
+      _mm_storeu_ps(pImaginary + g + 4, _mm_add_ps(b1Im, rIm));
+      _mm_storeu_ps(pReal + g + 12, _mm_sub_ps(b1Re, rRe));
+      _mm_storeu_ps(pImaginary + g + 12, _mm_sub_ps(b1Im, rIm));
+   }
+}
+
+template <int N, int L1, int NEXT = FFT_FIXED_NEXT_PASS(N, L1)>
+struct CFixedPasses_SSE2
+{
+   static FFT_FORCEINLINE void Run(float* pReal, float* pImaginary, const float* pCos, const float* pSin, float fRotate)
+   {
+      Radix4Stage_SSE2(pReal, pImaginary, N, L1, 
+         pCos + L1 - 1, pSin + L1 - 1, pCos + 2 * L1 - 1, pSin + 2 * L1 - 1, fRotate);
+      CFixedPasses_SSE2<N, L1 * 4>::Run(pReal, pImaginary, pCos, pSin, fRotate);
+   }
+};
+
+template <int N, int L1>
+struct CFixedPasses_SSE2<N, L1, 1>
+{
+   static FFT_FORCEINLINE void Run(float* pReal, float* pImaginary, const float* pCos, const float* pSin, float)
+   {
+      Radix2Stage_SSE2(pReal, pImaginary, N, L1, pCos + L1 - 1, pSin + L1 - 1);
+   }
+};
+
+template <int N, int L1>
+struct CFixedPasses_SSE2<N, L1, 0>
+{
+   static FFT_FORCEINLINE void Run(float*, float*, const float*, const float*, float)
+   {
+   }
+};
+
+template <int N>
+static void FixedTransform_SSE2(float* pReal, float* pImaginary, const float* pCos, const float* pSin, float fRotate)
+{
+   Codelet16_SSE2(pReal, pImaginary, N, fRotate);
+   CFixedPasses_SSE2<N, 16>::Run(pReal, pImaginary, pCos, pSin, fRotate);
+}
+#endif
+
+#ifdef FFT_KERNELS_AVX2
+// -------------------------------------------------------------------------
+// 4x4 transpose within each 128-bit half, so one register pair holds two
+// 16-point blocks side by side.
+// -------------------------------------------------------------------------
+#define FFT_TRANSPOSE4_PS_256(r0, r1, r2, r3) \
+   { \
+      __m256 t0 = _mm256_unpacklo_ps(r0, r1); \
+      __m256 t1 = _mm256_unpackhi_ps(r0, r1); \
+      __m256 t2 = _mm256_unpacklo_ps(r2, r3); \
+      __m256 t3 = _mm256_unpackhi_ps(r2, r3); \
+      r0 = _mm256_castpd_ps(_mm256_unpacklo_pd(_mm256_castps_pd(t0), _mm256_castps_pd(t2))); \
+      r1 = _mm256_castpd_ps(_mm256_unpackhi_pd(_mm256_castps_pd(t0), _mm256_castps_pd(t2))); \
+      r2 = _mm256_castpd_ps(_mm256_unpacklo_pd(_mm256_castps_pd(t1), _mm256_castps_pd(t3))); \
+      r3 = _mm256_castpd_ps(_mm256_unpackhi_pd(_mm256_castps_pd(t1), _mm256_castps_pd(t3))); \
+   }
+
+FFT_TARGET_AVX2
+static FFT_FORCEINLINE __m256 LoadBlockPair_AVX2(const float* p)
+{
+   return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p)), _mm_loadu_ps(p + 16), 1);
+}
+
+FFT_TARGET_AVX2
+static FFT_FORCEINLINE void StoreBlockPair_AVX2(float* p, __m256 v)
+{
+   _mm_storeu_ps(p, _mm256_castps256_ps128(v));
+   _mm_storeu_ps(p + 16, _mm256_extractf128_ps(v, 1));
+}
+
+FFT_TARGET_AVX2
+static FFT_FORCEINLINE __m256 BroadcastBlock_AVX2(const float* p)
+{
+   __m128 v = _mm_loadu_ps(p);
+   return _mm256_insertf128_ps(_mm256_castps128_ps256(v), v, 1);
+}
+
+FFT_TARGET_AVX2
+static void Codelet16_AVX2(float* pReal, float* pImaginary, int nSize, float fRotate)
+{
+   __m256 vRotate = _mm256_set1_ps(fRotate);
+   __m256 vNegRotate = _mm256_set1_ps(-fRotate);
+
+   __m256 c1 = BroadcastBlock_AVX2(s_Codelet16Cos1);
+   __m256 s1 = _mm256_mul_ps(BroadcastBlock_AVX2(s_Codelet16Sin1), vRotate);
+   __m256 c2 = BroadcastBlock_AVX2(s_Codelet16Cos2);
+   __m256 s2 = _mm256_mul_ps(BroadcastBlock_AVX2(s_Codelet16Sin2), vRotate);
+
+   // -------------------------------------------------------------------------
+   // Two 16-point blocks per iteration, one in each 128-bit half.
+   // -------------------------------------------------------------------------
+   for (int g = 0; g < nSize; g += 32)
+   {
+      float* pRe = pReal + g;
+      float* pIm = pImaginary + g;
+
+      __m256 a0Re = LoadBlockPair_AVX2(pRe);
+      __m256 a1Re = LoadBlockPair_AVX2(pRe + 4);
+      __m256 a2Re = LoadBlockPair_AVX2(pRe + 8);
+      __m256 a3Re = LoadBlockPair_AVX2(pRe + 12);
+      __m256 a0Im = LoadBlockPair_AVX2(pIm);
+      __m256 a1Im = LoadBlockPair_AVX2(pIm + 4);
+      __m256 a2Im = LoadBlockPair_AVX2(pIm + 8);
+      __m256 a3Im = LoadBlockPair_AVX2(pIm + 12);
+
+      FFT_TRANSPOSE4_PS_256(a0Re, a1Re, a2Re, a3Re);
+      FFT_TRANSPOSE4_PS_256(a0Im, a1Im, a2Im, a3Im);
+
+      __m256 b0Re = _mm256_add_ps(a0Re, a1Re);
+      __m256 b0Im = _mm256_add_ps(a0Im, a1Im);
+      __m256 b1Re = _mm256_sub_ps(a0Re, a1Re);
+      __m256 b1Im = _mm256_sub_ps(a0Im, a1Im);
+      __m256 b2Re = _mm256_add_ps(a2Re, a3Re);
+      __m256 b2Im = _mm256_add_ps(a2Im, a3Im);
+      __m256 b3Re = _mm256_sub_ps(a2Re, a3Re);
+      __m256 b3Im = _mm256_sub_ps(a2Im, a3Im);
+
+      __m256 rRe = _mm256_mul_ps(b3Im, vNegRotate);
+      __m256 rIm = _mm256_mul_ps(b3Re, vRotate);
+
+      a0Re = _mm256_add_ps(b0Re, b2Re);
+      a0Im = _mm256_add_ps(b0Im, b2Im);
+      a1Re = _mm256_add_ps(b1Re, rRe);
+      a1Im = _mm256_add_ps(b1Im, rIm);
+      a2Re = _mm256_sub_ps(b0Re, b2Re);
+      a2Im = _mm256_sub_ps(b0Im, b2Im);
+      a3Re = _mm256_sub_ps(b1Re, rRe);
+      a3Im = _mm256_sub_ps(b1Im, rIm);
+
+      FFT_TRANSPOSE4_PS_256(a0Re, a1Re, a2Re, a3Re);
+      FFT_TRANSPOSE4_PS_256(a0Im, a1Im, a2Im, a3Im);
+
+      __m256 t1Re = _mm256_sub_ps(_mm256_mul_ps(c1, a1Re), _mm256_mul_ps(s1, a1Im));
+      __m256 t1Im = _mm256_add_ps(_mm256_mul_ps(c1, a1Im), _mm256_mul_ps(s1, a1Re));
+      __m256 t3Re = _mm256_sub_ps(_mm256_mul_ps(c1, a3Re), _mm256_mul_ps(s1, a3Im));
+      __m256 t3Im = _mm256_add_ps(_mm256_mul_ps(c1, a3Im), _mm256_mul_ps(s1, a3Re));
+
+      b0Re = _mm256_add_ps(a0Re, t1Re);
+      b0Im = _mm256_add_ps(a0Im, t1Im);
+      b1Re = _mm256_sub_ps(a0Re, t1Re);
+      b1Im = _mm256_sub_ps(a0Im, t1Im);
+      b2Re = _mm256_add_ps(a2Re, t3Re);
+      b2Im = _mm256_add_ps(a2Im, t3Im);
+      b3Re = _mm256_sub_ps(a2Re, t3Re);
+      b3Im = _mm256_sub_ps(a2Im, t3Im);
+
+      __m256 t2Re = _mm256_sub_ps(_mm256_mul_ps(c2, b2Re), _mm256_mul_ps(s2, b2Im));
+      __m256 t2Im = _mm256_add_ps(_mm256_mul_ps(c2, b2Im), _mm256_mul_ps(s2, b2Re));
+      __m256 u3Re = _mm256_sub_ps(_mm256_mul_ps(c2, b3Re), _mm256_mul_ps(s2, b3Im));
+      __m256 u3Im = _mm256_add_ps(_mm256_mul_ps(c2, b3Im), _mm256_mul_ps(s2, b3Re));
+      rRe = _mm256_mul_ps(u3Im, vNegRotate);
+      rIm = _mm256_mul_ps(u3Re, vRotate);
+
+      StoreBlockPair_AVX2(pRe, _mm256_add_ps(b0Re, t2Re));
+      StoreBlockPair_AVX2(pIm, _mm256_add_ps(b0Im, t2Im));
+      StoreBlockPair_AVX2(pRe + 8, _mm256_sub_ps(b0Re, t2Re));
+      StoreBlockPair_AVX2(pIm + 8, _mm256_sub_ps(b0Im, t2Im));
+      StoreBlockPair_AVX2(pRe + 4, _mm256_add_ps(b1Re, rRe));
+      StoreBlockPair_AVX2(pIm + 4, _mm256_add_ps(b1Im, rIm));
+      StoreBlockPair_AVX2(pRe + 12, _mm256_sub_ps(b1Re, rRe));
+      StoreBlockPair_AVX2(pIm + 12, _mm256_sub_ps(b1Im, rIm));
+   }
+}
+
+template <int N, int L1, int NEXT = FFT_FIXED_NEXT_PASS(N, L1)>
+struct CFixedPasses_AVX2
+{
+   FFT_TARGET_AVX2
+   static FFT_FORCEINLINE void Run(float* pReal, float* pImaginary, const float* pCos, const float* pSin, float fRotate)
+   {
+      Radix4Stage_AVX2(pReal, pImaginary, N, L1, 
+         pCos + L1 - 1, pSin + L1 - 1, pCos + 2 * L1 - 1, pSin + 2 * L1 - 1, fRotate);
+      CFixedPasses_AVX2<N, L1 * 4>::Run(pReal, pImaginary, pCos, pSin, fRotate);
+   }
+};
+
+template <int N, int L1>
+struct CFixedPasses_AVX2<N, L1, 1>
+{
+   FFT_TARGET_AVX2
+   static FFT_FORCEINLINE void Run(float* pReal, float* pImaginary, const float* pCos, const float* pSin, float)
+   {
+      Radix2Stage_AVX2(pReal, pImaginary, N, L1, pCos + L1 - 1, pSin + L1 - 1);
+   }
+};
+
+template <int N, int L1>
+struct CFixedPasses_AVX2<N, L1, 0>
+{
+   FFT_TARGET_AVX2
+   static FFT_FORCEINLINE void Run(float*, float*, const float*, const float*, float)
+   {
+   }
+};
+
+template <int N>
+FFT_TARGET_AVX2
+static void FixedTransform_AVX2(float* pReal, float* pImaginary, const float* pCos, const float* pSin, float fRotate)
+{
+   Codelet16_AVX2(pReal, pImaginary, N, fRotate);
+   CFixedPasses_AVX2<N, 16>::Run(pReal, pImaginary, pCos, pSin, fRotate);
+}
+#endif
+
+void GetFFTKernels(int nSimdLevel, FFTKernelTable& kernels)
+{
+   kernels.nSimdLevel = SIMD_LEVEL_SCALAR;
+   kernels.pfnRadix4FirstStage = Radix4FirstStage_Scalar;
+   kernels.pfnRadix4Stage = Radix4Stage_Scalar;
+   kernels.pfnRadix2Stage = Radix2Stage_Scalar;
+   kernels.pfnBatchRadix4Stage = BatchRadix4Stage_Scalar;
+   kernels.pfnBatchRadix2Stage = BatchRadix2Stage_Scalar;
+   kernels.pfnBatchStockham4Stage = BatchStockham4Stage_Scalar;
+   kernels.pfnBatchStockham2Stage = BatchStockham2Stage_Scalar;
+
+#ifdef FFT_KERNELS_SSE2
+   if (nSimdLevel >= SIMD_LEVEL_SSE2)
+   {
+      kernels.nSimdLevel = SIMD_LEVEL_SSE2;
+      kernels.pfnRadix4FirstStage = Radix4FirstStage_SSE2;
+      kernels.pfnRadix4Stage = Radix4Stage_SSE2;
+      kernels.pfnRadix2Stage = Radix2Stage_SSE2;
+      kernels.pfnBatchRadix4Stage = BatchRadix4Stage_SSE2;
+      kernels.pfnBatchRadix2Stage = BatchRadix2Stage_SSE2;
+      kernels.pfnBatchStockham4Stage = BatchStockham4Stage_SSE2;
+      kernels.pfnBatchStockham2Stage = BatchStockham2Stage_SSE2;
+   }
+#endif
+
+#ifdef FFT_KERNELS_AVX2
+   if (nSimdLevel >= SIMD_LEVEL_AVX2)
+   {
+      kernels.nSimdLevel = SIMD_LEVEL_AVX2;
+      kernels.pfnRadix4Stage = Radix4Stage_AVX2;
+      kernels.pfnRadix2Stage = Radix2Stage_AVX2;
+      kernels.pfnBatchRadix4Stage = BatchRadix4Stage_AVX2;
+      kernels.pfnBatchRadix2Stage = BatchRadix2Stage_AVX2;
+      kernels.pfnBatchStockham4Stage = BatchStockham4Stage_AVX2;
+      kernels.pfnBatchStockham2Stage = BatchStockham2Stage_AVX2;
+   }
+#endif
+}
+
+void SetFixedFFTKernelsEnabled(bool blEnabled)
+{
+   s_blFixedKernelsEnabled = blEnabled;
+}
+
+bool GetFixedFFTKernelsEnabled()
+{
+   return s_blFixedKernelsEnabled;
+}
+
+FFTFixedTransformFunc GetFixedFFTTransform(int nSimdLevel, int nSize)
+{
+   if (!s_blFixedKernelsEnabled)
+   {
+      return NULL;
+   }
+
+#ifdef FFT_KERNELS_AVX2
+   if (nSimdLevel >= SIMD_LEVEL_AVX2)
+   {
+      switch (nSize)
+      {
+         case 64:  return FixedTransform_AVX2<64>;
+         case 128: return FixedTransform_AVX2<128>;
+         case 256: return FixedTransform_AVX2<256>;
+         case 512: return FixedTransform_AVX2<512>;
+      }
+   }
+#endif
+
+#ifdef FFT_KERNELS_SSE2
+   if (nSimdLevel >= SIMD_LEVEL_SSE2)
+   {
+      switch (nSize)
+      {
+         case 64:  return FixedTransform_SSE2<64>;
+         case 128: return FixedTransform_SSE2<128>;
+         case 256: return FixedTransform_SSE2<256>;
+         case 512: return FixedTransform_SSE2<512>;
+      }
+   }
+#endif
+
+   (void)nSimdLevel;
+   (void)nSize;
+   return NULL;
+}
@@ -0,0 +1,136 @@
+// -------------------------------------------------------------------------
+// Sean Janis
+// spjanis@gmail.com
+// Water Simulations
+//
+// FFTKernels
+//       Butterfly kernels used by CFFTPlan. Two radix-2 stages are fused
+//       into one radix-4 pass so every point is loaded and stored once per
+//       two stages. Each kernel has a scalar, SSE2 and AVX2 version and the
+//       plan picks one set at runtime. All versions perform the same single
+//       precision operations in the same order, so they give identical
+//       results.
+//
+//       Data is split into separate real and imaginary arrays. fRotate is
+//       +1 for the inverse transform, where the quarter-turn twiddle is +i,
+//       and -1 for the forward transform, where it is -i.
+// -------------------------------------------------------------------------
+#pragma once
+
+// -------------------------------------------------------------------------
+// First radix-4 pass (quarter span 1), where every twiddle is 1.
+// -------------------------------------------------------------------------
+typedef void (*FFTRadix4FirstStageFunc)(
+   float* pReal,
+   float* pImaginary,
+   int nSize,
+   float fRotate);
+
+// -------------------------------------------------------------------------
+// Radix-4 pass fusing the stages that span nQuarter and 2*nQuarter points.
+// pCos1/pSin1 are the twiddles of the first stage, pCos2/pSin2 those of
+// the second.
+// -------------------------------------------------------------------------
+typedef void (*FFTRadix4StageFunc)(
+   float* pReal,
+   float* pImaginary,
+   int nSize,
+   int nQuarter,
+   const float* pCos1,
+   const float* pSin1,
+   const float* pCos2,
+   const float* pSin2,
+   float fRotate);
+
+// -------------------------------------------------------------------------
+// Trailing radix-2 pass spanning nHalf points, used when log2(N) is odd.
+// -------------------------------------------------------------------------
+typedef void (*FFTRadix2StageFunc)(
+   float* pReal,
+   float* pImaginary,
+   int nSize,
+   int nHalf,
+   const float* pCos,
+   const float* pSin);
+
+// -------------------------------------------------------------------------
+// Batched kernels transform FFT_BATCH_LANES sequences at once. Point i of
+// sequence l is stored at [i * FFT_BATCH_LANES + l], so every butterfly of
+// every stage, including the first, is a full-width vector operation with
+// a broadcast twiddle.
+// -------------------------------------------------------------------------
+#define FFT_BATCH_LANES                8
+
+typedef FFTRadix4StageFunc FFTBatchRadix4StageFunc;
+typedef FFTRadix2StageFunc FFTBatchRadix2StageFunc;
+
+// -------------------------------------------------------------------------
+// Stockham autosort passes over the batched layout. Each pass reads one
+// buffer and writes the other in natural order, so the input never needs a
+// bit-reversal permutation. A pass works on nStride interleaved
+// sub-transforms of n = nSize / nStride points: the radix-4 pass reads
+// points p, p + n/4, p + n/2 and p + 3n/4 and writes points 4p..4p+3, the
+// last three multiplied by exp{+-i*2*PI*k*p/n}, k = 1..3. pCos/pSin hold
+// those twiddles for k = 1, 2 and 3 one after another, n/4 of each.
+//
+// The radix-2 pass is only used as the final pass of an odd log2(N), where
+// n is 2 and there are no twiddles. A final pass, where each output point
+// depends only on input points at the same positions, may run in place.
+// -------------------------------------------------------------------------
+typedef void (*FFTBatchStockham4StageFunc)(
+   const float* pInReal,
+   const float* pInImaginary,
+   float* pOutReal,
+   float* pOutImaginary,
+   int nSize,
+   int nStride,
+   const float* pCos,
+   const float* pSin,
+   float fRotate);
+
+typedef void (*FFTBatchStockham2StageFunc)(
+   const float* pInReal,
+   const float* pInImaginary,
+   float* pOutReal,
+   float* pOutImaginary,
+   int nSize);
+
+struct FFTKernelTable
+{
+   int nSimdLevel;
+   FFTRadix4FirstStageFunc pfnRadix4FirstStage;
+   FFTRadix4StageFunc pfnRadix4Stage;
+   FFTRadix2StageFunc pfnRadix2Stage;
+
+   FFTBatchRadix4StageFunc pfnBatchRadix4Stage;
+   FFTBatchRadix2StageFunc pfnBatchRadix2Stage;
+
+   FFTBatchStockham4StageFunc pfnBatchStockham4Stage;
+   FFTBatchStockham2StageFunc pfnBatchStockham2Stage;
+};
+
+// -------------------------------------------------------------------------
+// Fills the table with the best kernels available at or below nSimdLevel.
+// -------------------------------------------------------------------------
+void GetFFTKernels(int nSimdLevel, FFTKernelTable& kernels);
+
+// -------------------------------------------------------------------------
+// Every butterfly stage of a transform whose size is fixed at compile time,
+// run on bit-reversed data. pCos/pSin are the plan's twiddle tables for the
+// direction. Results are identical to the generic stage kernels.
+// -------------------------------------------------------------------------
+typedef void (*FFTFixedTransformFunc)(
+   float* pReal,
+   float* pImaginary,
+   const float* pCos,
+   const float* pSin,
+   float fRotate);
+
+// -------------------------------------------------------------------------
+// Returns the specialization for nSize (64, 128, 256 or 512) at or below
+// nSimdLevel, or NULL if there is none, or if fixed kernels are disabled.
+// They are enabled by default and can be turned off for comparison.
+// -------------------------------------------------------------------------
+FFTFixedTransformFunc GetFixedFFTTransform(int nSimdLevel, int nSize);
+void SetFixedFFTKernelsEnabled(bool blEnabled);
+bool GetFixedFFTKernelsEnabled();
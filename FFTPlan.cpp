@@ -0,0 +1,1264 @@
+#include "FFTPlan.h"
+#include "CpuFeatures.h"
+
+#include <math.h>
+#include <algorithm>
+
+#define FFT_PI                                  3.14159265358979323846
+
+// -------------------------------------------------------------------------
+// sin(2*PI/3), cos(2*PI/5), cos(4*PI/5), sin(2*PI/5) and sin(4*PI/5) for
+// the radix 3 and radix 5 butterflies.
+// -------------------------------------------------------------------------
+#define FFT_SIN_2PI_3                           0.866025403784438647f
+#define FFT_COS_2PI_5                           0.309016994374947424f
+#define FFT_COS_4PI_5                           -0.809016994374947424f
+#define FFT_SIN_2PI_5                           0.951056516295153572f
+#define FFT_SIN_4PI_5                           0.587785252292473129f
+
+// -------------------------------------------------------------------------
+// Mixed-radix passes. Each takes every group of p points spaced l1 apart,
+// rotates point q of the group by its twiddle and replaces the group with
+// its p-point DFT. Point i of lane l lives at [i * LANES + l], so the plain
+// transform is the one-lane case and the lane loop is the inner loop.
+// -------------------------------------------------------------------------
+template <int LANES>
+static void MixedRadix2Pass(float* pReal,
+                            float* pImaginary,
+                            int nSize,
+                            int l1,
+                            const float* pCos,
+                            const float* pSin)
+{
+   for (int nBlock = 0; nBlock < nSize; nBlock += 2 * l1)
+   {
+      for (int j = 0; j < l1; j++)
+      {
+         float fCos = pCos[j];
+         float fSin = pSin[j];
+         float* pRe0 = pReal + (nBlock + j) * LANES;
+         float* pIm0 = pImaginary + (nBlock + j) * LANES;
+         float* pRe1 = pRe0 + l1 * LANES;
+         float* pIm1 = pIm0 + l1 * LANES;
+
+         for (int l = 0; l < LANES; l++)
+         {
+            float fRe1 = pRe1[l] * fCos - pIm1[l] * fSin;
+            float fIm1 = pRe1[l] * fSin + pIm1[l] * fCos;
+
+            pRe1[l] = pRe0[l] - fRe1;
+            pIm1[l] = pIm0[l] - fIm1;
+            pRe0[l] += fRe1;
+            pIm0[l] += fIm1;
+         }
+      }
+   }
+}
+
+template <int LANES>
+static void MixedRadix3Pass(float* pReal,
+                            float* pImaginary,
+                            int nSize,
+                            int l1,
+                            const float* pCos,
+                            const float* pSin,
+                            float fRotate)
+{
+   float fSin3 = fRotate * FFT_SIN_2PI_3;
+
+   for (int nBlock = 0; nBlock < nSize; nBlock += 3 * l1)
+   {
+      for (int j = 0; j < l1; j++)
+      {
+         const float* pW = pCos + j * 2;
+         const float* pV = pSin + j * 2;
+         float* pRe0 = pReal + (nBlock + j) * LANES;
+         float* pIm0 = pImaginary + (nBlock + j) * LANES;
+         float* pRe1 = pRe0 + l1 * LANES;
+         float* pIm1 = pIm0 + l1 * LANES;
+         float* pRe2 = pRe1 + l1 * LANES;
+         float* pIm2 = pIm1 + l1 * LANES;
+
+         for (int l = 0; l < LANES; l++)
+         {
+            float fRe1 = pRe1[l] * pW[0] - pIm1[l] * pV[0];
+            float fIm1 = pRe1[l] * pV[0] + pIm1[l] * pW[0];
+            float fRe2 = pRe2[l] * pW[1] - pIm2[l] * pV[1];
+            float fIm2 = pRe2[l] * pV[1] + pIm2[l] * pW[1];
+
+            // ----------------------------------------------------------------
+            // y1, y2 = x0 - (x1 + x2) / 2 +- i * sin(2*PI/3) * (x1 - x2)
+            // ----------------------------------------------------------------
+            float fSumRe = fRe1 + fRe2;
+            float fSumIm = fIm1 + fIm2;
+            float fMidRe = pRe0[l] - 0.5f * fSumRe;
+            float fMidIm = pIm0[l] - 0.5f * fSumIm;
+            float fRotRe = -fSin3 * (fIm1 - fIm2);
+            float fRotIm = fSin3 * (fRe1 - fRe2);
+
+            pRe0[l] += fSumRe;
+            pIm0[l] += fSumIm;
+            pRe1[l] = fMidRe + fRotRe;
+            pIm1[l] = fMidIm + fRotIm;
+            pRe2[l] = fMidRe - fRotRe;
+            pIm2[l] = fMidIm - fRotIm;
+         }
+      }
+   }
+}
+
+template <int LANES>
+static void MixedRadix4Pass(float* pReal,
+                            float* pImaginary,
+                            int nSize,
+                            int l1,
+                            const float* pCos,
+                            const float* pSin,
+                            float fRotate)
+{
+   for (int nBlock = 0; nBlock < nSize; nBlock += 4 * l1)
+   {
+      for (int j = 0; j < l1; j++)
+      {
+         const float* pW = pCos + j * 3;
+         const float* pV = pSin + j * 3;
+         float* pRe0 = pReal + (nBlock + j) * LANES;
+         float* pIm0 = pImaginary + (nBlock + j) * LANES;
+         float* pRe1 = pRe0 + l1 * LANES;
+         float* pIm1 = pIm0 + l1 * LANES;
+         float* pRe2 = pRe1 + l1 * LANES;
+         float* pIm2 = pIm1 + l1 * LANES;
+         float* pRe3 = pRe2 + l1 * LANES;
+         float* pIm3 = pIm2 + l1 * LANES;
+
+         for (int l = 0; l < LANES; l++)
+         {
+            float fRe1 = pRe1[l] * pW[0] - pIm1[l] * pV[0];
+            float fIm1 = pRe1[l] * pV[0] + pIm1[l] * pW[0];
+            float fRe2 = pRe2[l] * pW[1] - pIm2[l] * pV[1];
+            float fIm2 = pRe2[l] * pV[1] + pIm2[l] * pW[1];
+            float fRe3 = pRe3[l] * pW[2] - pIm3[l] * pV[2];
+            float fIm3 = pRe3[l] * pV[2] + pIm3[l] * pW[2];
+
+            // ----------------------------------------------------------------
+            // The quarter turn exp{+-i*PI/2} is a swap and a sign change.
+            // ----------------------------------------------------------------
+            float fARe = pRe0[l] + fRe2;
+            float fAIm = pIm0[l] + fIm2;
+            float fBRe = pRe0[l] - fRe2;
+            float fBIm = pIm0[l] - fIm2;
+            float fCRe = fRe1 + fRe3;
+            float fCIm = fIm1 + fIm3;
+            float fDRe = -fRotate * (fIm1 - fIm3);
+            float fDIm = fRotate * (fRe1 - fRe3);
+
+            pRe0[l] = fARe + fCRe;
+            pIm0[l] = fAIm + fCIm;
+            pRe1[l] = fBRe + fDRe;
+            pIm1[l] = fBIm + fDIm;
+            pRe2[l] = fARe - fCRe;
+            pIm2[l] = fAIm - fCIm;
+            pRe3[l] = fBRe - fDRe;
+            pIm3[l] = fBIm - fDIm;
+         }
+      }
+   }
+}
+
+template <int LANES>
+static void MixedRadix5Pass(float* pReal,
+                            float* pImaginary,
+                            int nSize,
+                            int l1,
+                            const float* pCos,
+                            const float* pSin,
+                            float fRotate)
+{
+   float fSin1 = fRotate * FFT_SIN_2PI_5;
+   float fSin2 = fRotate * FFT_SIN_4PI_5;
+
+   for (int nBlock = 0; nBlock < nSize; nBlock += 5 * l1)
+   {
+      for (int j = 0; j < l1; j++)
+      {
+         const float* pW = pCos + j * 4;
+         const float* pV = pSin + j * 4;
+         float* pRe[5];
+         float* pIm[5];
+
+         for (int q = 0; q < 5; q++)
+         {
+            pRe[q] = pReal + (nBlock + j + q * l1) * LANES;
+            pIm[q] = pImaginary + (nBlock + j + q * l1) * LANES;
+         }
+
+         for (int l = 0; l < LANES; l++)
+         {
+            float fRe1 = pRe[1][l] * pW[0] - pIm[1][l] * pV[0];
+            float fIm1 = pRe[1][l] * pV[0] + pIm[1][l] * pW[0];
+            float fRe2 = pRe[2][l] * pW[1] - pIm[2][l] * pV[1];
+            float fIm2 = pRe[2][l] * pV[1] + pIm[2][l] * pW[1];
+            float fRe3 = pRe[3][l] * pW[2] - pIm[3][l] * pV[2];
+            float fIm3 = pRe[3][l] * pV[2] + pIm[3][l] * pW[2];
+            float fRe4 = pRe[4][l] * pW[3] - pIm[4][l] * pV[3];
+            float fIm4 = pRe[4][l] * pV[3] + pIm[4][l] * pW[3];
+
+            // ----------------------------------------------------------------
+            // Pair the points that share a cosine:
+            //
+            //    y1, y4 = x0 + c1 * (x1 + x4) + c2 * (x2 + x3) +- i * u1
+            //    y2, y3 = x0 + c2 * (x1 + x4) + c1 * (x2 + x3) +- i * u2
+            //
+            // with u1 = s1 * (x1 - x4) + s2 * (x2 - x3) and
+            //      u2 = s2 * (x1 - x4) - s1 * (x2 - x3).
+            // ----------------------------------------------------------------
+            float fA1Re = fRe1 + fRe4;
+            float fA1Im = fIm1 + fIm4;
+            float fB1Re = fRe1 - fRe4;
+            float fB1Im = fIm1 - fIm4;
+            float fA2Re = fRe2 + fRe3;
+            float fA2Im = fIm2 + fIm3;
+            float fB2Re = fRe2 - fRe3;
+            float fB2Im = fIm2 - fIm3;
+
+            float fX0Re = pRe[0][l];
+            float fX0Im = pIm[0][l];
+
+            float fT1Re = fX0Re + FFT_COS_2PI_5 * fA1Re + FFT_COS_4PI_5 * fA2Re;
+            float fT1Im = fX0Im + FFT_COS_2PI_5 * fA1Im + FFT_COS_4PI_5 * fA2Im;
+            float fT2Re = fX0Re + FFT_COS_4PI_5 * fA1Re + FFT_COS_2PI_5 * fA2Re;
+            float fT2Im = fX0Im + FFT_COS_4PI_5 * fA1Im + FFT_COS_2PI_5 * fA2Im;
+
+            float fU1Re = fSin1 * fB1Re + fSin2 * fB2Re;
+            float fU1Im = fSin1 * fB1Im + fSin2 * fB2Im;
+            float fU2Re = fSin2 * fB1Re - fSin1 * fB2Re;
+            float fU2Im = fSin2 * fB1Im - fSin1 * fB2Im;
+
+            pRe[0][l] = fX0Re + fA1Re + fA2Re;
+            pIm[0][l] = fX0Im + fA1Im + fA2Im;
+            pRe[1][l] = fT1Re - fU1Im;
+            pIm[1][l] = fT1Im + fU1Re;
+            pRe[4][l] = fT1Re + fU1Im;
+            pIm[4][l] = fT1Im - fU1Re;
+            pRe[2][l] = fT2Re - fU2Im;
+            pIm[2][l] = fT2Im + fU2Re;
+            pRe[3][l] = fT2Re + fU2Im;
+            pIm[3][l] = fT2Im - fU2Re;
+         }
+      }
+   }
+}
+
+template <int LANES>
+static void MixedRadixPasses(float* pReal,
+                             float* pImaginary,
+                             int nSize,
+                             const vector<int>& factors,
+                             const vector<int>& offsets,
+                             const float* pCos,
+                             const float* pSin,
+                             float fRotate)
+{
+   int l1 = 1;
+
+   for (size_t s = 0; s < factors.size(); s++)
+   {
+      const float* pStageCos = pCos + offsets[s];
+      const float* pStageSin = pSin + offsets[s];
+
+      switch (factors[s])
+      {
+         case 2:
+            MixedRadix2Pass<LANES>(pReal, pImaginary, nSize, l1, pStageCos, pStageSin);
+            break;
+
+         case 3:
+            MixedRadix3Pass<LANES>(pReal, pImaginary, nSize, l1, pStageCos, pStageSin, fRotate);
+            break;
+
+         case 4:
+            MixedRadix4Pass<LANES>(pReal, pImaginary, nSize, l1, pStageCos, pStageSin, fRotate);
+            break;
+
+         case 5:
+            MixedRadix5Pass<LANES>(pReal, pImaginary, nSize, l1, pStageCos, pStageSin, fRotate);
+            break;
+      }
+
+      l1 *= factors[s];
+   }
+}
+
+CFFTPlan::CFFTPlan()
+{
+   m_nSize = 0;
+   m_nLog2Size = 0;
+   m_nPlanType = FFT_PLAN_POWER_OF_TWO;
+   GetFFTKernels(SIMD_LEVEL_SCALAR, m_Kernels);
+   m_pfnFixedTransform = NULL;
+   m_nBluesteinSize = 0;
+   m_pBluesteinPlan = NULL;
+}
+
+CFFTPlan::~CFFTPlan()
+{
+   Clear();
+}
+
+void CFFTPlan::Clear()
+{
+   m_nSize = 0;
+   m_nLog2Size = 0;
+   m_nPlanType = FFT_PLAN_POWER_OF_TWO;
+   m_pfnFixedTransform = NULL;
+   m_BitReversalSwaps.clear();
+   m_TwiddleCos.clear();
+   m_TwiddleSinInverse.clear();
+   m_TwiddleSinForward.clear();
+   m_StockhamCos.clear();
+   m_StockhamSinInverse.clear();
+   m_StockhamSinForward.clear();
+   m_Factors.clear();
+   m_StageOffsets.clear();
+
+   m_nBluesteinSize = 0;
+   if (m_pBluesteinPlan != NULL)
+   {
+      delete m_pBluesteinPlan;
+      m_pBluesteinPlan = NULL;
+   }
+   m_ChirpCos.clear();
+   m_ChirpSin.clear();
+   m_FilterInverseReal.clear();
+   m_FilterInverseImaginary.clear();
+   m_FilterForwardReal.clear();
+   m_FilterForwardImaginary.clear();
+   m_WorkReal.clear();
+   m_WorkImaginary.clear();
+}
+
+bool CFFTPlan::Init(int nSize)
+{
+   Clear();
+
+   if (nSize < 2)
+   {
+      return false;
+   }
+
+   m_nSize = nSize;
+   GetFFTKernels(::GetSimdLevel(), m_Kernels);
+
+   // -------------------------------------------------------------------------
+   // Powers of two run the radix-2/4 butterflies.
+   // -------------------------------------------------------------------------
+   if ((nSize & (nSize - 1)) == 0)
+   {
+      while ((1 << m_nLog2Size) < nSize)
+      {
+         m_nLog2Size++;
+      }
+
+      BuildBitReversal();
+      BuildTwiddles();
+      BuildStockhamTwiddles();
+      m_pfnFixedTransform = GetFixedFFTTransform(m_Kernels.nSimdLevel, m_nSize);
+      return true;
+   }
+
+   if (BuildMixedRadix())
+   {
+      m_nPlanType = FFT_PLAN_MIXED_RADIX;
+      return true;
+   }
+
+   if (BuildBluestein())
+   {
+      m_nPlanType = FFT_PLAN_BLUESTEIN;
+      m_WorkReal.resize(GetWorkSize());
+      m_WorkImaginary.resize(GetWorkSize());
+      return true;
+   }
+
+   Clear();
+   return false;
+}
+
+bool CFFTPlan::IsValid()
+{
+   return m_nSize > 0;
+}
+
+int CFFTPlan::GetSize()
+{
+   return m_nSize;
+}
+
+int CFFTPlan::GetLog2Size()
+{
+   return m_nLog2Size;
+}
+
+int CFFTPlan::GetPlanType()
+{
+   return m_nPlanType;
+}
+
+int CFFTPlan::GetWorkSize()
+{
+   // -------------------------------------------------------------------------
+   // Bluestein runs the convolution in the scratch; a batch also copies each
+   // lane out in front of it.
+   // -------------------------------------------------------------------------
+   if (m_nPlanType == FFT_PLAN_BLUESTEIN)
+   {
+      return m_nBluesteinSize + m_nSize;
+   }
+
+   return 0;
+}
+
+int CFFTPlan::GetSimdLevel()
+{
+   return m_Kernels.nSimdLevel;
+}
+
+bool CFFTPlan::IsFixedSize()
+{
+   return m_pfnFixedTransform != NULL;
+}
+
+void CFFTPlan::BuildBitReversal()
+{
+   // -------------------------------------------------------------------------
+   // Walk the same reversed counter the in-place transform used to compute
+   // on every call, but only remember the pairs that actually move.
+   // -------------------------------------------------------------------------
+   int i2 = m_nSize >> 1;
+   int j = 0;
+
+   for (int i = 0; i < m_nSize - 1; i++)
+   {
+      if (i < j)
+      {
+         m_BitReversalSwaps.push_back(i);
+         m_BitReversalSwaps.push_back(j);
+      }
+
+      int k = i2;
+      while (k <= j)
+      {
+         j -= k;
+         k >>= 1;
+      }
+      j += k;
+   }
+}
+
+void CFFTPlan::BuildTwiddles()
+{
+   // -------------------------------------------------------------------------
+   // Evaluate every twiddle directly in double precision rather than with
+   // the square root recurrence, so later stages do not accumulate error.
+   // -------------------------------------------------------------------------
+   m_TwiddleCos.resize(m_nSize - 1);
+   m_TwiddleSinInverse.resize(m_nSize - 1);
+   m_TwiddleSinForward.resize(m_nSize - 1);
+
+   for (int l1 = 1; l1 < m_nSize; l1 <<= 1)
+   {
+      for (int j = 0; j < l1; j++)
+      {
+         double dAngle = (FFT_PI * j) / l1;
+         m_TwiddleCos[l1 - 1 + j] = (float)cos(dAngle);
+         m_TwiddleSinInverse[l1 - 1 + j] = (float)sin(dAngle);
+         m_TwiddleSinForward[l1 - 1 + j] = -(float)sin(dAngle);
+      }
+   }
+}
+
+void CFFTPlan::BuildStockhamTwiddles()
+{
+   // -------------------------------------------------------------------------
+   // One block per radix-4 pass, for n = N, N/4, ... while n >= 4. Each
+   // block holds exp{i*2*PI*k*p/n} for k = 1, 2, 3 and p < n/4.
+   // -------------------------------------------------------------------------
+   for (int n = m_nSize; n >= 4; n /= 4)
+   {
+      int nQuarter = n / 4;
+
+      for (int k = 1; k <= 3; k++)
+      {
+         for (int p = 0; p < nQuarter; p++)
+         {
+            double dAngle = (2.0 * FFT_PI * k * p) / n;
+            m_StockhamCos.push_back((float)cos(dAngle));
+            m_StockhamSinInverse.push_back((float)sin(dAngle));
+            m_StockhamSinForward.push_back(-(float)sin(dAngle));
+         }
+      }
+   }
+}
+
+bool CFFTPlan::BuildMixedRadix()
+{
+   // -------------------------------------------------------------------------
+   // Radix 4 passes first, as they do the most work per load, then the
+   // leftover factor of 2, then 3s and 5s.
+   // -------------------------------------------------------------------------
+   int n = m_nSize;
+   int radixes[] = { 4, 2, 3, 5 };
+
+   for (int r = 0; r < 4; r++)
+   {
+      while (n % radixes[r] == 0)
+      {
+         m_Factors.push_back(radixes[r]);
+         n /= radixes[r];
+      }
+   }
+
+   if (n != 1)
+   {
+      m_Factors.clear();
+      return false;
+   }
+
+   BuildDigitReversal();
+
+   int l1 = 1;
+   for (size_t s = 0; s < m_Factors.size(); s++)
+   {
+      int p = m_Factors[s];
+      m_StageOffsets.push_back((int)m_TwiddleCos.size());
+
+      for (int j = 0; j < l1; j++)
+      {
+         for (int q = 1; q < p; q++)
+         {
+            double dAngle = (2.0 * FFT_PI * j * q) / (l1 * p);
+            m_TwiddleCos.push_back((float)cos(dAngle));
+            m_TwiddleSinInverse.push_back((float)sin(dAngle));
+            m_TwiddleSinForward.push_back(-(float)sin(dAngle));
+         }
+      }
+
+      l1 *= p;
+   }
+
+   return true;
+}
+
+void CFFTPlan::BuildDigitReversal()
+{
+   // -------------------------------------------------------------------------
+   // The passes run innermost factor first, so the outermost factor p
+   // splits the input into p interleaved subsequences x[r * p + q] whose
+   // transforms sit one after another. Applying that split recursively
+   // gives the input index for every position.
+   // -------------------------------------------------------------------------
+   vector<int> order(1, 0);
+   int nLength = 1;
+
+   for (size_t s = 0; s < m_Factors.size(); s++)
+   {
+      int p = m_Factors[s];
+      vector<int> next(nLength * p);
+
+      for (int q = 0; q < p; q++)
+      {
+         for (int t = 0; t < nLength; t++)
+         {
+            next[q * nLength + t] = order[t] * p + q;
+         }
+      }
+
+      order.swap(next);
+      nLength *= p;
+   }
+
+   // -------------------------------------------------------------------------
+   // Turn the permutation into the sequence of swaps that applies it in
+   // place, tracking which input currently sits at each position.
+   // -------------------------------------------------------------------------
+   vector<int> current(m_nSize);
+   vector<int> position(m_nSize);
+   for (int i = 0; i < m_nSize; i++)
+   {
+      current[i] = i;
+      position[i] = i;
+   }
+
+   for (int i = 0; i < m_nSize; i++)
+   {
+      int nWanted = order[i];
+      int j = position[nWanted];
+
+      if (j != i)
+      {
+         m_BitReversalSwaps.push_back(i);
+         m_BitReversalSwaps.push_back(j);
+
+         int nDisplaced = current[i];
+         current[i] = nWanted;
+         current[j] = nDisplaced;
+         position[nWanted] = i;
+         position[nDisplaced] = j;
+      }
+   }
+}
+
+bool CFFTPlan::BuildBluestein()
+{
+   // -------------------------------------------------------------------------
+   // With 2nk = n^2 + k^2 - (k - n)^2, an N-point DFT becomes a chirp
+   // multiply, a convolution with the conjugate chirp and another chirp
+   // multiply. The convolution is circular over a power of two of at least
+   // 2N - 1 points, so it wraps without overlapping.
+   // -------------------------------------------------------------------------
+   int nSize = 1;
+   while (nSize < 2 * m_nSize - 1)
+   {
+      nSize <<= 1;
+   }
+
+   m_pBluesteinPlan = new CFFTPlan;
+   if (!m_pBluesteinPlan->Init(nSize))
+   {
+      return false;
+   }
+   m_nBluesteinSize = nSize;
+
+   // -------------------------------------------------------------------------
+   // n^2 is reduced modulo 2N first, so the angle stays small and exact.
+   // -------------------------------------------------------------------------
+   m_ChirpCos.resize(m_nSize);
+   m_ChirpSin.resize(m_nSize);
+
+   for (int n = 0; n < m_nSize; n++)
+   {
+      long long nSquare = ((long long)n * n) % (2 * m_nSize);
+      double dAngle = (FFT_PI * (double)nSquare) / m_nSize;
+      m_ChirpCos[n] = (float)cos(dAngle);
+      m_ChirpSin[n] = (float)sin(dAngle);
+   }
+
+   // -------------------------------------------------------------------------
+   // The filter for each direction is the conjugate of that direction's
+   // chirp, mirrored so negative lags wrap to the end. Its forward
+   // transform is stored unscaled.
+   // -------------------------------------------------------------------------
+   for (int d = 0; d < 2; d++)
+   {
+      float fSign = (d == 0) ? 1.0f : -1.0f;
+      vector<float>& filterReal = (d == 0) ? m_FilterInverseReal : m_FilterForwardReal;
+      vector<float>& filterImaginary = (d == 0) ? m_FilterInverseImaginary : m_FilterForwardImaginary;
+
+      filterReal.assign(nSize, 0.0f);
+      filterImaginary.assign(nSize, 0.0f);
+
+      for (int n = 0; n < m_nSize; n++)
+      {
+         filterReal[n] = m_ChirpCos[n];
+         filterImaginary[n] = -fSign * m_ChirpSin[n];
+
+         if (n > 0)
+         {
+            filterReal[nSize - n] = filterReal[n];
+            filterImaginary[nSize - n] = filterImaginary[n];
+         }
+      }
+
+      m_pBluesteinPlan->Execute(FFT_DIRECTION_FORWARD, &filterReal[0], &filterImaginary[0]);
+
+      for (int k = 0; k < nSize; k++)
+      {
+         filterReal[k] *= (float)nSize;
+         filterImaginary[k] *= (float)nSize;
+      }
+   }
+
+   return true;
+}
+
+void CFFTPlan::Permute(float* pReal, float* pImaginary, int nLanes)
+{
+   int nSwaps = (int)m_BitReversalSwaps.size();
+
+   if (nLanes == 1)
+   {
+      for (int s = 0; s < nSwaps; s += 2)
+      {
+         int i = m_BitReversalSwaps[s];
+         int j = m_BitReversalSwaps[s + 1];
+
+         float tx = pReal[i];
+         float ty = pImaginary[i];
+         pReal[i] = pReal[j];
+         pImaginary[i] = pImaginary[j];
+         pReal[j] = tx;
+         pImaginary[j] = ty;
+      }
+      return;
+   }
+
+   for (int s = 0; s < nSwaps; s += 2)
+   {
+      float* pRe0 = pReal + m_BitReversalSwaps[s] * FFT_BATCH_LANES;
+      float* pIm0 = pImaginary + m_BitReversalSwaps[s] * FFT_BATCH_LANES;
+      float* pRe1 = pReal + m_BitReversalSwaps[s + 1] * FFT_BATCH_LANES;
+      float* pIm1 = pImaginary + m_BitReversalSwaps[s + 1] * FFT_BATCH_LANES;
+
+      for (int l = 0; l < FFT_BATCH_LANES; l++)
+      {
+         float tx = pRe0[l];
+         float ty = pIm0[l];
+         pRe0[l] = pRe1[l];
+         pIm0[l] = pIm1[l];
+         pRe1[l] = tx;
+         pIm1[l] = ty;
+      }
+   }
+}
+
+void CFFTPlan::Execute(int nDirection, float* pReal, float* pImaginary)
+{
+   float* pWorkReal = m_WorkReal.empty() ? NULL : &m_WorkReal[0];
+   float* pWorkImaginary = m_WorkImaginary.empty() ? NULL : &m_WorkImaginary[0];
+
+   Execute(nDirection, pReal, pImaginary, pWorkReal, pWorkImaginary);
+}
+
+void CFFTPlan::Execute(int nDirection,
+                       float* pReal,
+                       float* pImaginary,
+                       float* pWorkReal,
+                       float* pWorkImaginary)
+{
+   if (m_nPlanType == FFT_PLAN_BLUESTEIN)
+   {
+      ExecuteBluestein(nDirection, pReal, pImaginary, pWorkReal, pWorkImaginary);
+   }
+   else if (m_nPlanType == FFT_PLAN_MIXED_RADIX)
+   {
+      ExecuteMixedRadix(nDirection, pReal, pImaginary, 1);
+   }
+   else
+   {
+      Permute(pReal, pImaginary, 1);
+
+      // ----------------------------------------------------------------------
+      // The inverse transform rotates by exp{+i*theta}, the forward
+      // transform by exp{-i*theta}.
+      // ----------------------------------------------------------------------
+      const float* pCos = &m_TwiddleCos[0];
+      const float* pSin = (nDirection == FFT_DIRECTION_FORWARD) ?
+         &m_TwiddleSinForward[0] : &m_TwiddleSinInverse[0];
+      float fRotate = (nDirection == FFT_DIRECTION_FORWARD) ? -1.0f : 1.0f;
+
+      if (m_pfnFixedTransform != NULL)
+      {
+         m_pfnFixedTransform(pReal, pImaginary, pCos, pSin, fRotate);
+      }
+      else
+      {
+         ExecuteStages(pReal, pImaginary, pCos, pSin, fRotate);
+      }
+   }
+
+   // -------------------------------------------------------------------------
+   // Scaling for forward transform
+   // -------------------------------------------------------------------------
+   if (nDirection == FFT_DIRECTION_FORWARD)
+   {
+      float fScale = 1.0f / (float)m_nSize;
+      for (int i = 0; i < m_nSize; i++)
+      {
+         pReal[i] *= fScale;
+         pImaginary[i] *= fScale;
+      }
+   }
+}
+
+void CFFTPlan::ExecuteStages(float* pReal,
+                             float* pImaginary,
+                             const float* pCos,
+                             const float* pSin,
+                             float fRotate)
+{
+   // -------------------------------------------------------------------------
+   // Pairs of radix-2 stages are fused into radix-4 passes. When log2(N) is
+   // odd the last stage is left over and runs as a single radix-2 pass, so
+   // it spans N/2 points and vectorizes fully.
+   // -------------------------------------------------------------------------
+   int l1 = 1;
+   if (m_nLog2Size >= 2)
+   {
+      m_Kernels.pfnRadix4FirstStage(pReal, pImaginary, m_nSize, fRotate);
+      l1 = 4;
+   }
+
+   for (; l1 * 4 <= m_nSize; l1 *= 4)
+   {
+      m_Kernels.pfnRadix4Stage(
+         pReal,
+         pImaginary,
+         m_nSize,
+         l1,
+         pCos + l1 - 1,
+         pSin + l1 - 1,
+         pCos + 2 * l1 - 1,
+         pSin + 2 * l1 - 1,
+         fRotate);
+   }
+
+   if (l1 < m_nSize)
+   {
+      m_Kernels.pfnRadix2Stage(pReal, pImaginary, m_nSize, l1, pCos + l1 - 1, pSin + l1 - 1);
+   }
+}
+
+void CFFTPlan::ExecuteBatch(int nDirection, float* pReal, float* pImaginary)
+{
+   float* pWorkReal = m_WorkReal.empty() ? NULL : &m_WorkReal[0];
+   float* pWorkImaginary = m_WorkImaginary.empty() ? NULL : &m_WorkImaginary[0];
+
+   ExecuteBatch(nDirection, pReal, pImaginary, pWorkReal, pWorkImaginary);
+}
+
+void CFFTPlan::ExecuteBatch(int nDirection,
+                            float* pReal,
+                            float* pImaginary,
+                            float* pWorkReal,
+                            float* pWorkImaginary)
+{
+   // -------------------------------------------------------------------------
+   // Bluestein lanes go through the convolution one at a time, copied to
+   // the front of the scratch; the convolution uses the rest.
+   // -------------------------------------------------------------------------
+   if (m_nPlanType == FFT_PLAN_BLUESTEIN)
+   {
+      float* pLaneReal = pWorkReal;
+      float* pLaneImaginary = pWorkImaginary;
+
+      for (int l = 0; l < FFT_BATCH_LANES; l++)
+      {
+         for (int i = 0; i < m_nSize; i++)
+         {
+            pLaneReal[i] = pReal[i * FFT_BATCH_LANES + l];
+            pLaneImaginary[i] = pImaginary[i * FFT_BATCH_LANES + l];
+         }
+
+         Execute(nDirection, pLaneReal, pLaneImaginary, pWorkReal + m_nSize, pWorkImaginary + m_nSize);
+
+         for (int i = 0; i < m_nSize; i++)
+         {
+            pReal[i * FFT_BATCH_LANES + l] = pLaneReal[i];
+            pImaginary[i * FFT_BATCH_LANES + l] = pLaneImaginary[i];
+         }
+      }
+      return;
+   }
+
+   if (m_nPlanType == FFT_PLAN_MIXED_RADIX)
+   {
+      ExecuteMixedRadix(nDirection, pReal, pImaginary, FFT_BATCH_LANES);
+   }
+   else
+   {
+      Permute(pReal, pImaginary, FFT_BATCH_LANES);
+
+      const float* pCos = &m_TwiddleCos[0];
+      const float* pSin = (nDirection == FFT_DIRECTION_FORWARD) ?
+         &m_TwiddleSinForward[0] : &m_TwiddleSinInverse[0];
+      float fRotate = (nDirection == FFT_DIRECTION_FORWARD) ? -1.0f : 1.0f;
+
+      int l1 = 1;
+      for (; l1 * 4 <= m_nSize; l1 *= 4)
+      {
+         m_Kernels.pfnBatchRadix4Stage(
+            pReal,
+            pImaginary,
+            m_nSize,
+            l1,
+            pCos + l1 - 1,
+            pSin + l1 - 1,
+            pCos + 2 * l1 - 1,
+            pSin + 2 * l1 - 1,
+            fRotate);
+      }
+
+      if (l1 < m_nSize)
+      {
+         m_Kernels.pfnBatchRadix2Stage(pReal, pImaginary, m_nSize, l1, pCos + l1 - 1, pSin + l1 - 1);
+      }
+   }
+
+   if (nDirection == FFT_DIRECTION_FORWARD)
+   {
+      float fScale = 1.0f / (float)m_nSize;
+      for (int i = 0; i < m_nSize * FFT_BATCH_LANES; i++)
+      {
+         pReal[i] *= fScale;
+         pImaginary[i] *= fScale;
+      }
+   }
+}
+
+void CFFTPlan::ExecuteBatchStockham(int nDirection,
+                                    float* pReal,
+                                    float* pImaginary,
+                                    float* pWorkReal,
+                                    float* pWorkImaginary)
+{
+   if (m_nPlanType != FFT_PLAN_POWER_OF_TWO)
+   {
+      ExecuteBatch(nDirection, pReal, pImaginary, pWorkReal, pWorkImaginary);
+      return;
+   }
+
+   // -------------------------------------------------------------------------
+   // Sizes below 4 have no radix-4 pass and no twiddles.
+   // -------------------------------------------------------------------------
+   const float* pCos = NULL;
+   const float* pSin = NULL;
+   if (!m_StockhamCos.empty())
+   {
+      pCos = &m_StockhamCos[0];
+      pSin = (nDirection == FFT_DIRECTION_FORWARD) ?
+         &m_StockhamSinForward[0] : &m_StockhamSinInverse[0];
+   }
+   float fRotate = (nDirection == FFT_DIRECTION_FORWARD) ? -1.0f : 1.0f;
+
+   // -------------------------------------------------------------------------
+   // Radix-4 passes while at least four points remain per sub-transform,
+   // then one radix-2 pass if log2(N) is odd. Each pass swaps the two
+   // buffers, except that with an odd number of passes the last one runs in
+   // place, so the result always ends up back in the caller's arrays.
+   // -------------------------------------------------------------------------
+   int nPasses = m_nLog2Size / 2 + m_nLog2Size % 2;
+   bool blLastInPlace = (nPasses % 2 == 1);
+
+   float* pInReal = pReal;
+   float* pInImaginary = pImaginary;
+   float* pOutReal = pWorkReal;
+   float* pOutImaginary = pWorkImaginary;
+   int nTwiddleOffset = 0;
+   int nPass = 0;
+
+   for (int nStride = 1; m_nSize / nStride >= 4; nStride *= 4)
+   {
+      nPass++;
+      if (nPass == nPasses && blLastInPlace)
+      {
+         pOutReal = pInReal;
+         pOutImaginary = pInImaginary;
+      }
+
+      m_Kernels.pfnBatchStockham4Stage(
+         pInReal,
+         pInImaginary,
+         pOutReal,
+         pOutImaginary,
+         m_nSize,
+         nStride,
+         pCos + nTwiddleOffset,
+         pSin + nTwiddleOffset,
+         fRotate);
+      nTwiddleOffset += 3 * (m_nSize / nStride / 4);
+
+      swap(pInReal, pOutReal);
+      swap(pInImaginary, pOutImaginary);
+   }
+
+   if (m_nLog2Size % 2 == 1)
+   {
+      if (blLastInPlace)
+      {
+         pOutReal = pInReal;
+         pOutImaginary = pInImaginary;
+      }
+
+      m_Kernels.pfnBatchStockham2Stage(pInReal, pInImaginary, pOutReal, pOutImaginary, m_nSize);
+   }
+
+   if (nDirection == FFT_DIRECTION_FORWARD)
+   {
+      float fScale = 1.0f / (float)m_nSize;
+      for (int i = 0; i < m_nSize * FFT_BATCH_LANES; i++)
+      {
+         pReal[i] *= fScale;
+         pImaginary[i] *= fScale;
+      }
+   }
+}
+
+void CFFTPlan::ExecuteMixedRadix(int nDirection, float* pReal, float* pImaginary, int nLanes)
+{
+   const float* pCos = &m_TwiddleCos[0];
+   const float* pSin = (nDirection == FFT_DIRECTION_FORWARD) ?
+      &m_TwiddleSinForward[0] : &m_TwiddleSinInverse[0];
+   float fRotate = (nDirection == FFT_DIRECTION_FORWARD) ? -1.0f : 1.0f;
+
+   Permute(pReal, pImaginary, nLanes);
+
+   if (nLanes == 1)
+   {
+      MixedRadixPasses<1>(pReal, pImaginary, m_nSize, m_Factors, m_StageOffsets, pCos, pSin, fRotate);
+   }
+   else
+   {
+      MixedRadixPasses<FFT_BATCH_LANES>(
+         pReal,
+         pImaginary,
+         m_nSize,
+         m_Factors,
+         m_StageOffsets,
+         pCos,
+         pSin,
+         fRotate);
+   }
+}
+
+void CFFTPlan::ExecuteBluestein(int nDirection,
+                                float* pReal,
+                                float* pImaginary,
+                                float* pWorkReal,
+                                float* pWorkImaginary)
+{
+   // -------------------------------------------------------------------------
+   // The convolution runs in the caller's scratch so that threads can share
+   // the plan. Only sizes with a prime factor above 5 get here.
+   // -------------------------------------------------------------------------
+   int nSize = m_nBluesteinSize;
+
+   float fSign = (nDirection == FFT_DIRECTION_FORWARD) ? -1.0f : 1.0f;
+   const float* pFilterReal = (nDirection == FFT_DIRECTION_FORWARD) ?
+      &m_FilterForwardReal[0] : &m_FilterInverseReal[0];
+   const float* pFilterImaginary = (nDirection == FFT_DIRECTION_FORWARD) ?
+      &m_FilterForwardImaginary[0] : &m_FilterInverseImaginary[0];
+
+   for (int n = 0; n < m_nSize; n++)
+   {
+      float fCos = m_ChirpCos[n];
+      float fSin = fSign * m_ChirpSin[n];
+      pWorkReal[n] = pReal[n] * fCos - pImaginary[n] * fSin;
+      pWorkImaginary[n] = pReal[n] * fSin + pImaginary[n] * fCos;
+   }
+
+   for (int n = m_nSize; n < nSize; n++)
+   {
+      pWorkReal[n] = 0.0f;
+      pWorkImaginary[n] = 0.0f;
+   }
+
+   // -------------------------------------------------------------------------
+   // The forward transform's 1/M scale and the unscaled filter make the
+   // inverse transform below the exact circular convolution.
+   // -------------------------------------------------------------------------
+   m_pBluesteinPlan->Execute(FFT_DIRECTION_FORWARD, pWorkReal, pWorkImaginary, NULL, NULL);
+
+   for (int k = 0; k < nSize; k++)
+   {
+      float fRe = pWorkReal[k] * pFilterReal[k] - pWorkImaginary[k] * pFilterImaginary[k];
+      float fIm = pWorkReal[k] * pFilterImaginary[k] + pWorkImaginary[k] * pFilterReal[k];
+      pWorkReal[k] = fRe;
+      pWorkImaginary[k] = fIm;
+   }
+
+   m_pBluesteinPlan->Execute(FFT_DIRECTION_INVERSE, pWorkReal, pWorkImaginary, NULL, NULL);
+
+   for (int k = 0; k < m_nSize; k++)
+   {
+      float fCos = m_ChirpCos[k];
+      float fSin = fSign * m_ChirpSin[k];
+      pReal[k] = pWorkReal[k] * fCos - pWorkImaginary[k] * fSin;
+      pImaginary[k] = pWorkReal[k] * fSin + pWorkImaginary[k] * fCos;
+   }
+}
+
+CRealFFTPlan::CRealFFTPlan()
+{
+   m_nSize = 0;
+}
+
+CRealFFTPlan::~CRealFFTPlan()
+{
+}
+
+bool CRealFFTPlan::Init(int nSize)
+{
+   m_nSize = 0;
+
+   if (nSize < 3)
+   {
+      return false;
+   }
+
+   // -------------------------------------------------------------------------
+   // An odd size cannot be folded in half; it rebuilds the full spectrum and
+   // runs a complex transform instead.
+   // -------------------------------------------------------------------------
+   if ((nSize & 1) != 0)
+   {
+      if (!m_FullPlan.Init(nSize))
+      {
+         return false;
+      }
+
+      m_nSize = nSize;
+      m_WorkReal.resize(GetWorkSize());
+      m_WorkImaginary.resize(GetWorkSize());
+      return true;
+   }
+
+   int nHalfSize = nSize / 2;
+   if (!m_HalfPlan.Init(nHalfSize))
+   {
+      return false;
+   }
+
+   m_nSize = nSize;
+   m_PostCos.resize(nHalfSize);
+   m_PostSin.resize(nHalfSize);
+   m_WorkReal.resize(GetWorkSize());
+   m_WorkImaginary.resize(GetWorkSize());
+
+   for (int k = 0; k < nHalfSize; k++)
+   {
+      double dAngle = (2.0 * FFT_PI * k) / nSize;
+      m_PostCos[k] = (float)cos(dAngle);
+      m_PostSin[k] = (float)sin(dAngle);
+   }
+
+   return true;
+}
+
+bool CRealFFTPlan::IsValid()
+{
+   return m_nSize > 0;
+}
+
+int CRealFFTPlan::GetSize()
+{
+   return m_nSize;
+}
+
+int CRealFFTPlan::GetSpectrumSize()
+{
+   return m_nSize / 2 + 1;
+}
+
+int CRealFFTPlan::GetWorkSize()
+{
+   // -------------------------------------------------------------------------
+   // The complex transform's data, followed by its own scratch.
+   // -------------------------------------------------------------------------
+   if ((m_nSize & 1) != 0)
+   {
+      return m_nSize + m_FullPlan.GetWorkSize();
+   }
+
+   return m_nSize / 2 + m_HalfPlan.GetWorkSize();
+}
+
+void CRealFFTPlan::ExecuteInverse(const float* pReal, const float* pImaginary, float* pOutput)
+{
+   ExecuteInverse(pReal, pImaginary, pOutput, &m_WorkReal[0], &m_WorkImaginary[0]);
+}
+
+void CRealFFTPlan::ExecuteInverse(const float* pReal,
+                                  const float* pImaginary,
+                                  float* pOutput,
+                                  float* pWorkReal,
+                                  float* pWorkImaginary,
+                                  float fScale)
+{
+   if ((m_nSize & 1) != 0)
+   {
+      ExecuteInverseOdd(pReal, pImaginary, pOutput, pWorkReal, pWorkImaginary, fScale);
+      return;
+   }
+
+   int nHalfSize = m_nSize / 2;
+
+   // -------------------------------------------------------------------------
+   // Fold the spectrum so that a half-size inverse transform yields the even
+   // samples in its real part and the odd samples in its imaginary part:
+   //
+   //    E(k) = X(k) + conj(X(N/2 - k))
+   //    O(k) = (X(k) - conj(X(N/2 - k))) * exp{i*2*PI*k/N}
+   //    Z(k) = E(k) + i*O(k)
+   //
+   // The transform is linear, so scaling Z scales the output.
+   // -------------------------------------------------------------------------
+   for (int k = 0; k < nHalfSize; k++)
+   {
+      float fAReal = fScale * pReal[k];
+      float fAImaginary = fScale * pImaginary[k];
+      float fBReal = fScale * pReal[nHalfSize - k];
+      float fBImaginary = -fScale * pImaginary[nHalfSize - k];
+
+      float fEReal = fAReal + fBReal;
+      float fEImaginary = fAImaginary + fBImaginary;
+      float fDReal = fAReal - fBReal;
+      float fDImaginary = fAImaginary - fBImaginary;
+
+      float fOReal = fDReal * m_PostCos[k] - fDImaginary * m_PostSin[k];
+      float fOImaginary = fDReal * m_PostSin[k] + fDImaginary * m_PostCos[k];
+
+      pWorkReal[k] = fEReal - fOImaginary;
+      pWorkImaginary[k] = fEImaginary + fOReal;
+   }
+
+   m_HalfPlan.Execute(
+      FFT_DIRECTION_INVERSE,
+      pWorkReal,
+      pWorkImaginary,
+      pWorkReal + nHalfSize,
+      pWorkImaginary + nHalfSize);
+
+   for (int n = 0; n < nHalfSize; n++)
+   {
+      pOutput[2 * n] = pWorkReal[n];
+      pOutput[2 * n + 1] = pWorkImaginary[n];
+   }
+}
+
+void CRealFFTPlan::ExecuteInverseOdd(const float* pReal,
+                                     const float* pImaginary,
+                                     float* pOutput,
+                                     float* pWorkReal,
+                                     float* pWorkImaginary,
+                                     float fScale)
+{
+   // -------------------------------------------------------------------------
+   // Bins above N/2 are the conjugates of the stored ones: X(N - k) is
+   // conj(X(k)).
+   // -------------------------------------------------------------------------
+   int nBins = m_nSize / 2 + 1;
+
+   for (int k = 0; k < nBins; k++)
+   {
+      pWorkReal[k] = fScale * pReal[k];
+      pWorkImaginary[k] = fScale * pImaginary[k];
+   }
+
+   for (int k = 1; k < nBins; k++)
+   {
+      pWorkReal[m_nSize - k] = pWorkReal[k];
+      pWorkImaginary[m_nSize - k] = -pWorkImaginary[k];
+   }
+
+   m_FullPlan.Execute(
+      FFT_DIRECTION_INVERSE,
+      pWorkReal,
+      pWorkImaginary,
+      pWorkReal + m_nSize,
+      pWorkImaginary + m_nSize);
+
+   for (int n = 0; n < m_nSize; n++)
+   {
+      pOutput[n] = pWorkReal[n];
+   }
+}
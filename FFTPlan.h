@@ -0,0 +1,266 @@
+// -------------------------------------------------------------------------
+// Sean Janis
+// spjanis@gmail.com
+// Water Simulations
+//
+// CFFTPlan
+//       Holds everything about a Fast Fourier Transform that depends only on
+//       its size: the input permutation, the twiddle factors of every
+//       butterfly stage and the SIMD kernels picked for this processor. A
+//       plan is built once per grid size and then reused for every
+//       transform of that size.
+//
+//       Powers of two run the radix-2/4 SIMD kernels. Sizes with a
+//       compile-time specialized transform (see GetFixedFFTTransform) use it
+//       instead of the generic stage loop. Other sizes whose prime factors
+//       are all 2, 3 and 5 run a mixed-radix transform with radix 2, 3, 4
+//       and 5 passes. Any other size is computed with Bluestein's algorithm
+//       as a convolution of power-of-two transforms.
+//
+// CRealFFTPlan
+//       Inverse transform of a conjugate-symmetric (Hermitian) spectrum to
+//       a real signal. Only the N/2 + 1 non-redundant bins are read. For
+//       even N the work is done by a complex transform of half the size;
+//       odd N falls back to a full-size complex transform.
+// -------------------------------------------------------------------------
+#pragma once
+
+#include <vector>
+#include "FFTKernels.h"
+using namespace std;
+
+#define FFT_DIRECTION_FORWARD          1
+#define FFT_DIRECTION_INVERSE          -1
+
+#define FFT_PLAN_POWER_OF_TWO          0
+#define FFT_PLAN_MIXED_RADIX           1
+#define FFT_PLAN_BLUESTEIN             2
+
+class CFFTPlan
+{
+public:
+   CFFTPlan();
+   virtual ~CFFTPlan();
+
+   // -------------------------------------------------------------------------
+   // Builds the tables for a transform of nSize points, nSize >= 2. The
+   // kernels are chosen from GetSimdLevel() at this point.
+   // -------------------------------------------------------------------------
+   bool Init(int nSize);
+   bool IsValid();
+   int GetSize();
+   int GetSimdLevel();
+   bool IsFixedSize();
+
+   // -------------------------------------------------------------------------
+   // One of the FFT_PLAN_* algorithms. GetLog2Size is 0 unless the size is
+   // a power of two.
+   // -------------------------------------------------------------------------
+   int GetPlanType();
+   int GetLog2Size();
+
+   // -------------------------------------------------------------------------
+   // Floats of scratch, in each of two arrays, that Execute and ExecuteBatch
+   // need. Only Bluestein plans need any.
+   // -------------------------------------------------------------------------
+   int GetWorkSize();
+
+   // -------------------------------------------------------------------------
+   // In-place transform of the complex sequence stored as separate real and
+   // imaginary arrays. The forward transform is scaled by 1/N, the inverse
+   // transform is not.
+   //
+   // The first form uses scratch kept in the plan, so it must not run on two
+   // threads at once on a Bluestein plan. The second works in caller-supplied
+   // scratch of GetWorkSize() floats each, so several threads can share one
+   // plan; the pointers may be NULL when GetWorkSize() is 0.
+   // -------------------------------------------------------------------------
+   void Execute(int nDirection, float* pReal, float* pImaginary);
+   void Execute(
+      int nDirection,
+      float* pReal,
+      float* pImaginary,
+      float* pWorkReal,
+      float* pWorkImaginary);
+
+   // -------------------------------------------------------------------------
+   // Same transform applied to FFT_BATCH_LANES sequences at once, stored
+   // lane-interleaved: point i of sequence l lives at [i * LANES + l]. The
+   // scratch is as for Execute.
+   // -------------------------------------------------------------------------
+   void ExecuteBatch(int nDirection, float* pReal, float* pImaginary);
+   void ExecuteBatch(
+      int nDirection,
+      float* pReal,
+      float* pImaginary,
+      float* pWorkReal,
+      float* pWorkImaginary);
+
+   // -------------------------------------------------------------------------
+   // The batched transform computed with Stockham autosort passes instead
+   // of a bit-reversal followed by in-place butterflies. The passes
+   // ping-pong between the data and pWorkReal / pWorkImaginary, which must
+   // hold as many floats as the data, and the result ends up in the data.
+   // Only power-of-two plans have a Stockham form; others run ExecuteBatch
+   // in the same scratch, which is never smaller than GetWorkSize().
+   // -------------------------------------------------------------------------
+   void ExecuteBatchStockham(
+      int nDirection,
+      float* pReal,
+      float* pImaginary,
+      float* pWorkReal,
+      float* pWorkImaginary);
+
+protected:
+   void Clear();
+   void BuildBitReversal();
+   void BuildTwiddles();
+   void BuildStockhamTwiddles();
+   bool BuildMixedRadix();
+   void BuildDigitReversal();
+   bool BuildBluestein();
+   void ExecuteStages(
+      float* pReal,
+      float* pImaginary,
+      const float* pCos,
+      const float* pSin,
+      float fRotate);
+   void ExecuteMixedRadix(int nDirection, float* pReal, float* pImaginary, int nLanes);
+   void ExecuteBluestein(
+      int nDirection,
+      float* pReal,
+      float* pImaginary,
+      float* pWorkReal,
+      float* pWorkImaginary);
+   void Permute(float* pReal, float* pImaginary, int nLanes);
+
+protected:
+   int m_nSize;
+   int m_nLog2Size;
+   int m_nPlanType;
+
+   // -------------------------------------------------------------------------
+   // Index pairs (i, j) that are exchanged, in order, to put the input into
+   // bit-reversed (or, for mixed radix, digit-reversed) order.
+   // -------------------------------------------------------------------------
+   vector<int> m_BitReversalSwaps;
+
+   // -------------------------------------------------------------------------
+   // Twiddle factors exp{+-i*PI*j/l1} for every stage, stored back to back.
+   // The stage whose butterflies span l1 points starts at offset (l1 - 1).
+   // The sine table is kept once per direction so the kernels never negate.
+   // Mixed-radix plans store their own layout here, see m_StageOffsets.
+   // -------------------------------------------------------------------------
+   vector<float> m_TwiddleCos;
+   vector<float> m_TwiddleSinInverse;
+   vector<float> m_TwiddleSinForward;
+
+   // -------------------------------------------------------------------------
+   // Stockham radix-4 twiddles, one block per pass from n = N down, see
+   // FFTBatchStockham4StageFunc.
+   // -------------------------------------------------------------------------
+   vector<float> m_StockhamCos;
+   vector<float> m_StockhamSinInverse;
+   vector<float> m_StockhamSinForward;
+
+   FFTKernelTable m_Kernels;
+
+   // -------------------------------------------------------------------------
+   // Compile-time specialized stages for this size, or NULL.
+   // -------------------------------------------------------------------------
+   FFTFixedTransformFunc m_pfnFixedTransform;
+
+   // -------------------------------------------------------------------------
+   // Mixed radix: the radix of every pass, innermost first, and the offset
+   // of each pass's twiddles. A pass of radix p spanning l1 points stores
+   // exp{+-i*2*PI*j*q/(l1*p)} at [offset + j * (p - 1) + q - 1].
+   // -------------------------------------------------------------------------
+   vector<int> m_Factors;
+   vector<int> m_StageOffsets;
+
+   // -------------------------------------------------------------------------
+   // Bluestein: the chirp exp{+i*PI*n^2/N}, the power-of-two plan used for
+   // the convolution and the unscaled spectrum of the conjugate chirp for
+   // each direction.
+   // -------------------------------------------------------------------------
+   int m_nBluesteinSize;
+   CFFTPlan* m_pBluesteinPlan;
+   vector<float> m_ChirpCos;
+   vector<float> m_ChirpSin;
+   vector<float> m_FilterInverseReal;
+   vector<float> m_FilterInverseImaginary;
+   vector<float> m_FilterForwardReal;
+   vector<float> m_FilterForwardImaginary;
+
+   // -------------------------------------------------------------------------
+   // GetWorkSize() floats each for the forms of Execute and ExecuteBatch
+   // that take no scratch.
+   // -------------------------------------------------------------------------
+   vector<float> m_WorkReal;
+   vector<float> m_WorkImaginary;
+
+private:
+   CFFTPlan(const CFFTPlan&);
+   CFFTPlan& operator=(const CFFTPlan&);
+};
+
+class CRealFFTPlan
+{
+public:
+   CRealFFTPlan();
+   virtual ~CRealFFTPlan();
+
+   // -------------------------------------------------------------------------
+   // nSize is the number of real output samples, at least 3.
+   // -------------------------------------------------------------------------
+   bool Init(int nSize);
+   bool IsValid();
+   int GetSize();
+   int GetSpectrumSize();
+   int GetWorkSize();
+
+   // -------------------------------------------------------------------------
+   // pReal / pImaginary hold bins 0..N/2 of a Hermitian spectrum. Writes the
+   // N real samples of the unscaled inverse transform to pOutput.
+   //
+   // The second form works in caller-supplied scratch of GetWorkSize()
+   // floats each, so several threads can share one plan. Its output is
+   // multiplied by fScale, which is applied while the spectrum is folded
+   // rather than as a separate pass over the output.
+   // -------------------------------------------------------------------------
+   void ExecuteInverse(const float* pReal, const float* pImaginary, float* pOutput);
+   void ExecuteInverse(
+      const float* pReal,
+      const float* pImaginary,
+      float* pOutput,
+      float* pWorkReal,
+      float* pWorkImaginary,
+      float fScale = 1.0f);
+
+protected:
+   void ExecuteInverseOdd(
+      const float* pReal,
+      const float* pImaginary,
+      float* pOutput,
+      float* pWorkReal,
+      float* pWorkImaginary,
+      float fScale);
+
+protected:
+   int m_nSize;
+   CFFTPlan m_HalfPlan;
+
+   // -------------------------------------------------------------------------
+   // Odd sizes only: a complex plan of the full size.
+   // -------------------------------------------------------------------------
+   CFFTPlan m_FullPlan;
+
+   // -------------------------------------------------------------------------
+   // exp{+i*2*PI*k/N} used to split the half-size transform back apart.
+   // -------------------------------------------------------------------------
+   vector<float> m_PostCos;
+   vector<float> m_PostSin;
+
+   vector<float> m_WorkReal;
+   vector<float> m_WorkImaginary;
+};
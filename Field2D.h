@@ -0,0 +1,224 @@
+// -------------------------------------------------------------------------
+// Sean Janis
+// spjanis@gmail.com
+// Water Simulations
+//
+// CRealField2D, CComplexField2D
+//       Two dimensional fields of floats laid out for SIMD: nRows rows of
+//       nColumns values, element (x, z) at [x * pitch + z]. Every row
+//       starts ALIGNED_BUFFER_ALIGNMENT bytes aligned, because the pitch
+//       is rounded up to whole cache lines, and the padding is zeroed, so
+//       a kernel can run its last vector past the end of a row.
+//
+//       A complex field keeps its real and imaginary parts in two planes of
+//       the same shape, so that a vector load gets four or eight real parts
+//       and the matching imaginary parts come from the same offset in the
+//       other plane, with no shuffles to pair them up.
+//
+//       Fields handed out whole, such as the spatial maps, are allocated
+//       with a pitch alignment of 1, which packs their rows.
+// -------------------------------------------------------------------------
+#pragma once
+
+#include "AlignedBuffer.h"
+
+#define FIELD2D_PITCH_ALIGNMENT        (ALIGNED_BUFFER_ALIGNMENT / (int)sizeof(float))
+
+class CRealField2D
+{
+public:
+   CRealField2D()
+   {
+      m_nRows = 0;
+      m_nColumns = 0;
+      m_nPitch = 0;
+   }
+
+   virtual ~CRealField2D()
+   {
+   }
+
+   // -------------------------------------------------------------------------
+   // Replaces the contents with a zeroed field, its pitch nColumns rounded
+   // up to a multiple of nPitchAlignment. Returns false, and leaves the
+   // field empty, if the memory cannot be allocated.
+   // -------------------------------------------------------------------------
+   bool Allocate(int nRows, int nColumns, int nPitchAlignment = FIELD2D_PITCH_ALIGNMENT)
+   {
+      Free();
+
+      int nPitch = (nColumns + nPitchAlignment - 1) / nPitchAlignment * nPitchAlignment;
+
+      if (!m_Data.Allocate(nRows * nPitch))
+      {
+         return false;
+      }
+
+      m_nRows = nRows;
+      m_nColumns = nColumns;
+      m_nPitch = nPitch;
+      return true;
+   }
+
+   void Free()
+   {
+      m_Data.Free();
+      m_nRows = 0;
+      m_nColumns = 0;
+      m_nPitch = 0;
+   }
+
+   int GetRows() const
+   {
+      return m_nRows;
+   }
+
+   int GetColumns() const
+   {
+      return m_nColumns;
+   }
+
+   int GetPitch() const
+   {
+      return m_nPitch;
+   }
+
+   float* GetData()
+   {
+      return m_Data.GetData();
+   }
+
+   const float* GetData() const
+   {
+      return m_Data.GetData();
+   }
+
+   float* GetRow(int x)
+   {
+      return m_Data.GetData() + x * m_nPitch;
+   }
+
+   const float* GetRow(int x) const
+   {
+      return m_Data.GetData() + x * m_nPitch;
+   }
+
+protected:
+   CAlignedBuffer<float> m_Data;
+   int m_nRows;
+   int m_nColumns;
+   int m_nPitch;
+
+private:
+   CRealField2D(const CRealField2D&);
+   CRealField2D& operator=(const CRealField2D&);
+};
+
+class CComplexField2D
+{
+public:
+   CComplexField2D()
+   {
+      m_nRows = 0;
+      m_nColumns = 0;
+      m_nPitch = 0;
+   }
+
+   virtual ~CComplexField2D()
+   {
+   }
+
+   // -------------------------------------------------------------------------
+   // As CRealField2D::Allocate. Both planes come from one allocation, the
+   // imaginary plane straight after the real one.
+   // -------------------------------------------------------------------------
+   bool Allocate(int nRows, int nColumns, int nPitchAlignment = FIELD2D_PITCH_ALIGNMENT)
+   {
+      Free();
+
+      int nPitch = (nColumns + nPitchAlignment - 1) / nPitchAlignment * nPitchAlignment;
+
+      if (!m_Data.Allocate(2 * nRows * nPitch))
+      {
+         return false;
+      }
+
+      m_nRows = nRows;
+      m_nColumns = nColumns;
+      m_nPitch = nPitch;
+      return true;
+   }
+
+   void Free()
+   {
+      m_Data.Free();
+      m_nRows = 0;
+      m_nColumns = 0;
+      m_nPitch = 0;
+   }
+
+   int GetRows() const
+   {
+      return m_nRows;
+   }
+
+   int GetColumns() const
+   {
+      return m_nColumns;
+   }
+
+   int GetPitch() const
+   {
+      return m_nPitch;
+   }
+
+   float* GetReal()
+   {
+      return m_Data.GetData();
+   }
+
+   const float* GetReal() const
+   {
+      return m_Data.GetData();
+   }
+
+   float* GetImaginary()
+   {
+      return m_Data.GetData() + m_nRows * m_nPitch;
+   }
+
+   const float* GetImaginary() const
+   {
+      return m_Data.GetData() + m_nRows * m_nPitch;
+   }
+
+   float* GetRealRow(int x)
+   {
+      return GetReal() + x * m_nPitch;
+   }
+
+   const float* GetRealRow(int x) const
+   {
+      return GetReal() + x * m_nPitch;
+   }
+
+   float* GetImaginaryRow(int x)
+   {
+      return GetImaginary() + x * m_nPitch;
+   }
+
+   const float* GetImaginaryRow(int x) const
+   {
+      return GetImaginary() + x * m_nPitch;
+   }
+
+protected:
+   CAlignedBuffer<float> m_Data;
+   int m_nRows;
+   int m_nColumns;
+   int m_nPitch;
+
+private:
+   CComplexField2D(const CComplexField2D&);
+   CComplexField2D& operator=(const CComplexField2D&);
+};
@@ -95,7 +95,7 @@ float CLandEnvironment::GetSkyRadius()
 	return m_fRadius;
 }
 
-void CLandEnvironment::Update(float fCurrentTime, 
+void CLandEnvironment::Update(double dCurrentTime, 
                               bool blMoveObject)
 {
 
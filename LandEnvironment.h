@@ -32,7 +32,7 @@ public:
    // -------------------------------------------------------------------------
    // Animation Object Interface Methods
    // -------------------------------------------------------------------------
-   virtual void Update(float fCurrentTime, bool blMoveObject = false);
+   virtual void Update(double dCurrentTime, bool blMoveObject = false);
    virtual void Draw(
       D3DXMATRIX& projectionMatrix,
       D3DXMATRIX& viewMatrix);
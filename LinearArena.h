@@ -0,0 +1,106 @@
+// -------------------------------------------------------------------------
+// Sean Janis
+// spjanis@gmail.com
+// Water Simulations
+//
+// CLinearArena
+//       One aligned block that hands out contiguous spans by bumping an
+//       offset, for data built once and thrown away together, such as the
+//       staging copies of a grid before it goes to the device. Spans start
+//       ALIGNED_BUFFER_ALIGNMENT bytes aligned and are zero-filled, not
+//       constructed, so they suit plain data only. Nothing is freed on its
+//       own: Reset hands the whole block out again and Free returns it.
+// -------------------------------------------------------------------------
+#pragma once
+
+#include "AlignedBuffer.h"
+
+class CLinearArena
+{
+public:
+   CLinearArena()
+   {
+      m_nUsed = 0;
+   }
+
+   virtual ~CLinearArena()
+   {
+   }
+
+   // -------------------------------------------------------------------------
+   // Replaces the block with one of nBytes. Returns false, and leaves the
+   // arena empty, if the memory cannot be allocated.
+   // -------------------------------------------------------------------------
+   bool Init(size_t nBytes)
+   {
+      m_nUsed = 0;
+      return m_Block.Allocate((int)nBytes);
+   }
+
+   // -------------------------------------------------------------------------
+   // Bytes a span of nCount elements of T takes, alignment padding
+   // included, for sizing the block up front.
+   // -------------------------------------------------------------------------
+   template <class T>
+   static size_t GetSpanBytes(int nCount)
+   {
+      return AlignUp((size_t)nCount * sizeof(T));
+   }
+
+   // -------------------------------------------------------------------------
+   // A span of nCount elements, or NULL if the block has no room left.
+   // -------------------------------------------------------------------------
+   template <class T>
+   T* Allocate(int nCount)
+   {
+      size_t nBytes = GetSpanBytes<T>(nCount);
+
+      if (nBytes > (size_t)m_Block.GetCount() - m_nUsed)
+      {
+         return NULL;
+      }
+
+      T* pSpan = (T*)(m_Block.GetData() + m_nUsed);
+      m_nUsed += nBytes;
+      return pSpan;
+   }
+
+   void Reset()
+   {
+      if (m_nUsed > 0)
+      {
+         memset(m_Block.GetData(), 0, m_nUsed);
+      }
+
+      m_nUsed = 0;
+   }
+
+   void Free()
+   {
+      m_Block.Free();
+      m_nUsed = 0;
+   }
+
+   size_t GetUsedBytes() const
+   {
+      return m_nUsed;
+   }
+
+   size_t GetCapacity() const
+   {
+      return (size_t)m_Block.GetCount();
+   }
+
+protected:
+   static size_t AlignUp(size_t nBytes)
+   {
+      return (nBytes + ALIGNED_BUFFER_ALIGNMENT - 1) & ~(size_t)(ALIGNED_BUFFER_ALIGNMENT - 1);
+   }
+
+   CAlignedBuffer<unsigned char> m_Block;
+   size_t m_nUsed;
+
+private:
+   CLinearArena(const CLinearArena&);
+   CLinearArena& operator=(const CLinearArena&);
+};
@@ -0,0 +1,618 @@
+#include <math.h>
+#include <string.h>
+#include <stddef.h>
+#include "OceanBake.h"
+#include "OceanSimulation.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+void GetOceanBakeHeader(COceanSimulation& ocean,
+                        float fSpacingX,
+                        float fSpacingZ,
+                        float fTimeStep,
+                        float fStartTime,
+                        OceanBakeHeader& header)
+{
+   memset(&header, 0, sizeof(header));
+
+   header.nMagic = OCEAN_BAKE_MAGIC;
+   header.nVersion = OCEAN_BAKE_VERSION;
+   header.nHeaderBytes = sizeof(OceanBakeHeader);
+   header.nFormat = OCEAN_BAKE_FORMAT_RAW;
+
+   header.nWidth = ocean.GetFFTSize();
+   header.nHeight = ocean.GetFFTSize();
+   header.nFields = ocean.GetActiveFieldCount();
+   header.fSpacingX = fSpacingX;
+   header.fSpacingZ = fSpacingZ;
+   header.fTimeStep = fTimeStep;
+   header.fStartTime = fStartTime;
+   header.fLoopPeriod = ocean.GetLoopPeriod();
+
+   header.fXWindSpeed = ocean.GetXWindSpeed();
+   header.fZWindSpeed = ocean.GetZWindSpeed();
+   header.fPhillipsConstant = ocean.GetPhillipsConstant();
+   header.fGravityConstant = ocean.GetGravityConstant();
+   header.fChoppiness = ocean.GetChoppiness();
+   header.nSeed = ocean.GetSeed();
+   header.nSpectrumModel = ocean.GetSpectrumModel();
+   header.nSpreading = ocean.GetSpreading();
+   header.fFetch = ocean.GetFetch();
+   header.fDepth = ocean.GetDepth();
+   header.fPeakEnhancement = ocean.GetPeakEnhancement();
+   header.fSpreadingExponent = ocean.GetSpreadingExponent();
+}
+
+void SetOceanBakeCodec(OceanBakeHeader& header, float fMaxError, int nKeyframeInterval)
+{
+   header.nFormat = OCEAN_BAKE_FORMAT_CODEC;
+   header.nKeyframeInterval = (nKeyframeInterval < 1) ? 1 : nKeyframeInterval;
+
+   for (int f = 0; f < OCEAN_BAKE_MAX_FIELDS; f++)
+   {
+      header.afQuantizationSteps[f] = GetOceanCodecStep(fMaxError);
+   }
+}
+
+// -------------------------------------------------------------------------
+// COceanBakeWriter
+// -------------------------------------------------------------------------
+COceanBakeWriter::COceanBakeWriter()
+{
+   m_pFile = NULL;
+   m_blFailed = false;
+   m_nOffset = 0;
+   memset(&m_Header, 0, sizeof(m_Header));
+}
+
+COceanBakeWriter::~COceanBakeWriter()
+{
+   if (m_pFile != NULL)
+   {
+      Close();
+   }
+}
+
+bool COceanBakeWriter::Open(const char* pPath, const OceanBakeHeader& header)
+{
+   if (m_pFile != NULL)
+   {
+      Close();
+   }
+
+   m_pFile = fopen(pPath, "wb");
+   if (m_pFile == NULL)
+   {
+      return false;
+   }
+
+   m_Header = header;
+   m_Header.nFrames = 0;
+   m_Header.nIndexOffset = 0;
+   m_Index.clear();
+   m_nOffset = 0;
+   m_blFailed = false;
+
+   if (m_Header.nFormat == OCEAN_BAKE_FORMAT_CODEC &&
+       (m_Header.nFields > OCEAN_BAKE_MAX_FIELDS ||
+        !m_Encoder.Init(m_Header.nWidth, m_Header.nHeight, m_Header.nFields, m_Header.afQuantizationSteps)))
+   {
+      m_blFailed = true;
+   }
+
+   // -------------------------------------------------------------------------
+   // A placeholder until Close() knows the frame count and the index.
+   // -------------------------------------------------------------------------
+   return Write(&m_Header, sizeof(m_Header));
+}
+
+bool COceanBakeWriter::WriteFrame(const float* const* ppFields)
+{
+   if (m_pFile == NULL || !Pad())
+   {
+      return false;
+   }
+
+   OceanBakeFrameEntry entry;
+   entry.nOffset = m_nOffset;
+   entry.nFlags = 0;
+
+   if (m_Header.nFormat == OCEAN_BAKE_FORMAT_CODEC)
+   {
+      bool blKeyframe = (m_Index.size() % m_Header.nKeyframeInterval == 0);
+
+      m_Payload.clear();
+      m_Encoder.EncodeFrame(ppFields, blKeyframe, m_Payload);
+
+      entry.nBytes = (unsigned int)m_Payload.size();
+      entry.nFlags = blKeyframe ? OCEAN_BAKE_FRAME_KEYFRAME : 0;
+
+      if (!Write(&m_Payload[0], m_Payload.size()))
+      {
+         return false;
+      }
+
+      m_Index.push_back(entry);
+      return true;
+   }
+
+   size_t nMapBytes = (size_t)m_Header.nWidth * m_Header.nHeight * sizeof(float);
+   entry.nBytes = (unsigned int)(nMapBytes * m_Header.nFields);
+
+   for (int f = 0; f < m_Header.nFields; f++)
+   {
+      if (!Write(ppFields[f], nMapBytes))
+      {
+         return false;
+      }
+   }
+
+   m_Index.push_back(entry);
+   return true;
+}
+
+bool COceanBakeWriter::Close()
+{
+   if (m_pFile == NULL)
+   {
+      return false;
+   }
+
+   m_Header.nFrames = (int)m_Index.size();
+
+   if (Pad())
+   {
+      m_Header.nIndexOffset = m_nOffset;
+
+      if (!m_Index.empty())
+      {
+         Write(&m_Index[0], m_Index.size() * sizeof(OceanBakeFrameEntry));
+      }
+   }
+
+   // -------------------------------------------------------------------------
+   // The real header goes over the placeholder.
+   // -------------------------------------------------------------------------
+   if (fseek(m_pFile, 0, SEEK_SET) != 0 ||
+       fwrite(&m_Header, sizeof(m_Header), 1, m_pFile) != 1)
+   {
+      m_blFailed = true;
+   }
+
+   if (fclose(m_pFile) != 0)
+   {
+      m_blFailed = true;
+   }
+
+   m_pFile = NULL;
+   return !m_blFailed;
+}
+
+float COceanBakeWriter::GetMaxError()
+{
+   return (m_Header.nFormat == OCEAN_BAKE_FORMAT_CODEC) ? m_Encoder.GetMaxError() : 0.0f;
+}
+
+bool COceanBakeWriter::Write(const void* pData, size_t nBytes)
+{
+   if (m_blFailed || fwrite(pData, 1, nBytes, m_pFile) != nBytes)
+   {
+      m_blFailed = true;
+      return false;
+   }
+
+   m_nOffset += nBytes;
+   return true;
+}
+
+bool COceanBakeWriter::Pad()
+{
+   static const unsigned char s_acZeros[OCEAN_BAKE_ALIGNMENT] = { 0 };
+   size_t nPadding = (size_t)((OCEAN_BAKE_ALIGNMENT - m_nOffset % OCEAN_BAKE_ALIGNMENT) % OCEAN_BAKE_ALIGNMENT);
+
+   return Write(s_acZeros, nPadding);
+}
+
+// -------------------------------------------------------------------------
+// COceanBakeReader
+// -------------------------------------------------------------------------
+COceanBakeReader::COceanBakeReader()
+{
+   m_pData = NULL;
+   m_nBytes = 0;
+   m_pHeader = NULL;
+   m_pIndex = NULL;
+   m_nDecodedFrame = -1;
+   memset(&m_Header, 0, sizeof(m_Header));
+
+#ifdef _WIN32
+   m_hFile = INVALID_HANDLE_VALUE;
+   m_hMapping = NULL;
+#endif
+}
+
+COceanBakeReader::~COceanBakeReader()
+{
+   Close();
+}
+
+bool COceanBakeReader::Open(const char* pPath)
+{
+   Close();
+
+   if (!Map(pPath))
+   {
+      return false;
+   }
+
+   if (!Validate())
+   {
+      Close();
+      return false;
+   }
+
+   if (m_pHeader->nFormat == OCEAN_BAKE_FORMAT_CODEC)
+   {
+      if (!m_Decoder.Init(m_pHeader->nWidth, m_pHeader->nHeight, m_pHeader->nFields, m_pHeader->afQuantizationSteps))
+      {
+         Close();
+         return false;
+      }
+
+      m_Decoded.resize((size_t)m_pHeader->nWidth * m_pHeader->nHeight * m_pHeader->nFields);
+   }
+
+   return true;
+}
+
+void COceanBakeReader::Close()
+{
+   Unmap();
+   m_pHeader = NULL;
+   m_pIndex = NULL;
+   m_nDecodedFrame = -1;
+   m_Decoded.clear();
+}
+
+void COceanBakeReader::SetThreadPool(CThreadPool* pPool)
+{
+   m_Decoder.SetThreadPool(pPool);
+}
+
+bool COceanBakeReader::IsOpen()
+{
+   return m_pHeader != NULL;
+}
+
+const OceanBakeHeader& COceanBakeReader::GetHeader()
+{
+   return *m_pHeader;
+}
+
+int COceanBakeReader::GetFrameCount()
+{
+   return (m_pHeader != NULL) ? m_pHeader->nFrames : 0;
+}
+
+int COceanBakeReader::GetFrameIndex(double dTime)
+{
+   int nFrames = m_pHeader->nFrames;
+   double dFrame = floor((dTime - m_pHeader->fStartTime) / m_pHeader->fTimeStep + 0.5);
+
+   if (m_pHeader->fLoopPeriod > 0.0f)
+   {
+      dFrame = fmod(dFrame, (double)nFrames);
+      return (int)((dFrame < 0.0) ? dFrame + nFrames : dFrame);
+   }
+
+   if (dFrame < 0.0)
+   {
+      return 0;
+   }
+
+   return (dFrame >= nFrames) ? nFrames - 1 : (int)dFrame;
+}
+
+bool COceanBakeReader::GetFrame(int nFrame, const float** ppFields)
+{
+   size_t nMapSamples = (size_t)m_pHeader->nWidth * m_pHeader->nHeight;
+   const float* pFrame = NULL;
+
+   if (m_pHeader->nFormat == OCEAN_BAKE_FORMAT_CODEC)
+   {
+      if (!Decode(nFrame))
+      {
+         return false;
+      }
+
+      pFrame = &m_Decoded[0];
+   }
+   else
+   {
+      pFrame = (const float*)(m_pData + (size_t)m_pIndex[nFrame].nOffset);
+   }
+
+   for (int f = 0; f < m_pHeader->nFields; f++)
+   {
+      ppFields[f] = pFrame + f * nMapSamples;
+   }
+
+   return true;
+}
+
+const float* COceanBakeReader::GetField(int nFrame, int nField)
+{
+   const float* apFields[OCEAN_BAKE_MAX_FIELDS];
+
+   if (!GetFrame(nFrame, apFields))
+   {
+      return NULL;
+   }
+
+   return apFields[nField];
+}
+
+bool COceanBakeReader::Decode(int nFrame)
+{
+   if (nFrame == m_nDecodedFrame)
+   {
+      return true;
+   }
+
+   // -------------------------------------------------------------------------
+   // Carry on from the decoded frame when it lies between the keyframe at
+   // or before nFrame and nFrame itself, as it does in playback; otherwise
+   // start over at the keyframe.
+   // -------------------------------------------------------------------------
+   int nKeyframe = nFrame;
+
+   while ((m_pIndex[nKeyframe].nFlags & OCEAN_BAKE_FRAME_KEYFRAME) == 0)
+   {
+      nKeyframe--;
+   }
+
+   int nStart = (m_nDecodedFrame >= nKeyframe && m_nDecodedFrame < nFrame) ? m_nDecodedFrame + 1 : nKeyframe;
+   size_t nMapSamples = (size_t)m_pHeader->nWidth * m_pHeader->nHeight;
+   float* apFields[OCEAN_BAKE_MAX_FIELDS];
+
+   for (int f = 0; f < m_pHeader->nFields; f++)
+   {
+      apFields[f] = &m_Decoded[f * nMapSamples];
+   }
+
+   for (int i = nStart; i <= nFrame; i++)
+   {
+      const OceanBakeFrameEntry& entry = m_pIndex[i];
+
+      if (!m_Decoder.DecodeFrame(m_pData + (size_t)entry.nOffset,
+                                 entry.nBytes,
+                                 (entry.nFlags & OCEAN_BAKE_FRAME_KEYFRAME) != 0,
+                                 apFields))
+      {
+         m_nDecodedFrame = -1;
+         return false;
+      }
+
+      m_nDecodedFrame = i;
+   }
+
+   return true;
+}
+
+bool COceanBakeReader::Validate()
+{
+   // -------------------------------------------------------------------------
+   // Check everything the accessors rely on, so they need no checks of
+   // their own: the header, with maps no larger than an ocean makes, then
+   // every frame lying inside the file with exactly the bytes its maps
+   // need, or for codec frames at least the band table every frame starts
+   // with; the decoder checks the rest.
+   // -------------------------------------------------------------------------
+   static const size_t s_nVersion1Bytes = offsetof(OceanBakeHeader, afQuantizationSteps);
+
+   if (m_nBytes < s_nVersion1Bytes)
+   {
+      return false;
+   }
+
+   OceanBakeHeader* pHeader = &m_Header;
+   memset(pHeader, 0, sizeof(OceanBakeHeader));
+   memcpy(pHeader, m_pData, s_nVersion1Bytes);
+
+   if ((pHeader->nVersion == OCEAN_BAKE_VERSION || pHeader->nVersion == 2) &&
+       pHeader->nHeaderBytes == sizeof(OceanBakeHeader) &&
+       m_nBytes >= sizeof(OceanBakeHeader))
+   {
+      memcpy(pHeader, m_pData, sizeof(OceanBakeHeader));
+   }
+   else if (pHeader->nVersion != 1 || pHeader->nHeaderBytes != s_nVersion1Bytes)
+   {
+      return false;
+   }
+
+   bool blCodec = (pHeader->nFormat == OCEAN_BAKE_FORMAT_CODEC);
+
+   if (pHeader->nMagic != OCEAN_BAKE_MAGIC ||
+       (pHeader->nFormat != OCEAN_BAKE_FORMAT_RAW && !blCodec) ||
+       (blCodec && pHeader->nVersion != OCEAN_BAKE_VERSION) ||
+       pHeader->nWidth <= 0 || pHeader->nWidth > OCEAN_FFT_SIZE_MAX ||
+       pHeader->nHeight <= 0 || pHeader->nHeight > OCEAN_FFT_SIZE_MAX ||
+       pHeader->nFields <= 0 || pHeader->nFields > OCEAN_FIELD_COUNT ||
+       pHeader->nFrames <= 0 ||
+       !(pHeader->fTimeStep > 0.0f))
+   {
+      return false;
+   }
+
+   OceanBakeOffset nIndexBytes = (OceanBakeOffset)pHeader->nFrames * sizeof(OceanBakeFrameEntry);
+
+   if (pHeader->nIndexOffset % OCEAN_BAKE_ALIGNMENT != 0 ||
+       pHeader->nIndexOffset > m_nBytes ||
+       nIndexBytes > m_nBytes - pHeader->nIndexOffset)
+   {
+      return false;
+   }
+
+   for (int f = 0; f < pHeader->nFields && blCodec; f++)
+   {
+      if (!(pHeader->afQuantizationSteps[f] > 0.0f))
+      {
+         return false;
+      }
+   }
+
+   // -------------------------------------------------------------------------
+   // The decoded frame must also be addressable, which only a 32-bit build
+   // can fail; the band table is laid out as COceanFrameDecoder reads it.
+   // -------------------------------------------------------------------------
+   OceanBakeOffset nSamples = (OceanBakeOffset)pHeader->nWidth * pHeader->nHeight * pHeader->nFields;
+
+   if (nSamples > (size_t)-1 / sizeof(float))
+   {
+      return false;
+   }
+
+   const OceanBakeFrameEntry* pIndex = (const OceanBakeFrameEntry*)(m_pData + (size_t)pHeader->nIndexOffset);
+   OceanBakeOffset nFrameBytes = nSamples * sizeof(float);
+   OceanBakeOffset nBands = (pHeader->nWidth + OCEAN_CODEC_BAND_ROWS - 1) / OCEAN_CODEC_BAND_ROWS;
+   OceanBakeOffset nTableBytes = (nBands * pHeader->nFields + 2) * sizeof(unsigned int);
+
+   if (blCodec && (pIndex[0].nFlags & OCEAN_BAKE_FRAME_KEYFRAME) == 0)
+   {
+      return false;
+   }
+
+   for (int i = 0; i < pHeader->nFrames; i++)
+   {
+      if (blCodec)
+      {
+         nFrameBytes = pIndex[i].nBytes;
+      }
+
+      if (pIndex[i].nBytes != nFrameBytes ||
+          (blCodec && nFrameBytes < nTableBytes) ||
+          pIndex[i].nOffset % OCEAN_BAKE_ALIGNMENT != 0 ||
+          pIndex[i].nOffset > m_nBytes ||
+          nFrameBytes > m_nBytes - pIndex[i].nOffset)
+      {
+         return false;
+      }
+   }
+
+   m_pHeader = pHeader;
+   m_pIndex = pIndex;
+   return true;
+}
+
+#ifdef _WIN32
+
+bool COceanBakeReader::Map(const char* pPath)
+{
+   m_hFile = CreateFileA(pPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+   if (m_hFile == INVALID_HANDLE_VALUE)
+   {
+      return false;
+   }
+
+   LARGE_INTEGER size;
+   if (!GetFileSizeEx(m_hFile, &size) || size.QuadPart == 0 || (OceanBakeOffset)size.QuadPart > (size_t)-1)
+   {
+      Unmap();
+      return false;
+   }
+
+   m_hMapping = CreateFileMapping(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+   if (m_hMapping == NULL)
+   {
+      Unmap();
+      return false;
+   }
+
+   m_pData = (const unsigned char*)MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0);
+   if (m_pData == NULL)
+   {
+      Unmap();
+      return false;
+   }
+
+   m_nBytes = (size_t)size.QuadPart;
+   return true;
+}
+
+void COceanBakeReader::Unmap()
+{
+   if (m_pData != NULL)
+   {
+      UnmapViewOfFile(m_pData);
+      m_pData = NULL;
+   }
+
+   if (m_hMapping != NULL)
+   {
+      CloseHandle(m_hMapping);
+      m_hMapping = NULL;
+   }
+
+   if (m_hFile != INVALID_HANDLE_VALUE)
+   {
+      CloseHandle(m_hFile);
+      m_hFile = INVALID_HANDLE_VALUE;
+   }
+
+   m_nBytes = 0;
+}
+
+#else
+
+bool COceanBakeReader::Map(const char* pPath)
+{
+   int nFile = open(pPath, O_RDONLY);
+   if (nFile < 0)
+   {
+      return false;
+   }
+
+   // -------------------------------------------------------------------------
+   // The mapping keeps the file open by itself.
+   // -------------------------------------------------------------------------
+   struct stat status;
+   void* pMapping = MAP_FAILED;
+
+   if (fstat(nFile, &status) == 0 &&
+       status.st_size > 0 &&
+       (OceanBakeOffset)status.st_size <= (size_t)-1)
+   {
+      pMapping = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_SHARED, nFile, 0);
+   }
+
+   close(nFile);
+
+   if (pMapping == MAP_FAILED)
+   {
+      return false;
+   }
+
+   m_pData = (const unsigned char*)pMapping;
+   m_nBytes = (size_t)status.st_size;
+   return true;
+}
+
+void COceanBakeReader::Unmap()
+{
+   if (m_pData != NULL)
+   {
+      munmap((void*)m_pData, m_nBytes);
+      m_pData = NULL;
+   }
+
+   m_nBytes = 0;
+}
+
+#endif
@@ -0,0 +1,265 @@
+// -------------------------------------------------------------------------
+// Sean Janis
+// spjanis@gmail.com
+// Water Simulations
+//
+// OceanBake
+//       File format for a baked ocean animation: the spatial maps of a run
+//       of evenly spaced frames, simulated offline, so that playback costs
+//       no spectrum update or FFT.
+//
+//       The file is little-endian: an OceanBakeHeader, the frames, then one
+//       OceanBakeFrameEntry per frame at nIndexOffset. Each frame starts
+//       OCEAN_BAKE_ALIGNMENT bytes aligned and holds nFields maps of
+//       nWidth * nHeight samples in OCEAN_FIELD_* order, sample (x, z) at
+//       [x * nHeight + z] as COceanSimulation::GetField returns them.
+//
+//       Codec frames instead hold one COceanFrameEncoder payload each, see
+//       OceanCodec.h. A frame that is not a keyframe decodes only on top of
+//       the one before it, so the reader decodes forward from the nearest
+//       keyframe when playback jumps.
+//
+// COceanBakeWriter
+//       Streams frames to a new file and writes the index and the final
+//       header when it is closed.
+//
+// COceanBakeReader
+//       Maps a whole file into memory read-only and hands out pointers
+//       straight into the mapping, so a frame costs no copy, and only the
+//       pages played are ever read from disk. The file has to fit the
+//       address space, which limits 32 bit builds to about a gigabyte.
+//       Codec frames are decoded into maps the reader owns.
+// -------------------------------------------------------------------------
+#pragma once
+
+#include <stdio.h>
+#include <stddef.h>
+#include <vector>
+#include "OceanCodec.h"
+
+using namespace std;
+
+class COceanSimulation;
+
+#ifdef _MSC_VER
+typedef unsigned __int64 OceanBakeOffset;
+#else
+typedef unsigned long long OceanBakeOffset;
+#endif
+
+#define OCEAN_BAKE_MAGIC              0x424E434Fu    // "OCNB"
+#define OCEAN_BAKE_VERSION            3
+#define OCEAN_BAKE_ALIGNMENT          64
+#define OCEAN_BAKE_MAX_FIELDS         8
+
+// -------------------------------------------------------------------------
+// How the frames are stored. Raw frames are the float maps as simulated,
+// codec frames are compressed to an error bound. Version 1 files, which
+// end their header at the index offset, can only be raw. Version 2 codec
+// frames kept unsaturated velocities, see OceanCodec.h, so only raw
+// version 2 files still load.
+// -------------------------------------------------------------------------
+#define OCEAN_BAKE_FORMAT_RAW         0
+#define OCEAN_BAKE_FORMAT_CODEC       1
+
+#define OCEAN_BAKE_KEYFRAME_INTERVAL  30
+
+// -------------------------------------------------------------------------
+// OceanBakeFrameEntry flags.
+// -------------------------------------------------------------------------
+#define OCEAN_BAKE_FRAME_KEYFRAME     0x1
+
+// -------------------------------------------------------------------------
+// Everything needed to play the frames back and to know how they were
+// made. The fields are all 4 bytes up to the 8 byte index offset, so the
+// structure has no padding and is written as it is.
+// -------------------------------------------------------------------------
+struct OceanBakeHeader
+{
+   unsigned int nMagic;
+   unsigned int nVersion;
+   unsigned int nHeaderBytes;    // sizeof(OceanBakeHeader)
+   unsigned int nFormat;         // OCEAN_BAKE_FORMAT_*
+
+   // -------------------------------------------------------------------------
+   // Grid and timing. The spacing is the world distance between samples;
+   // a looping bake's frames span exactly one loop period.
+   // -------------------------------------------------------------------------
+   int nWidth;
+   int nHeight;
+   int nFields;
+   int nFrames;
+   float fSpacingX;
+   float fSpacingZ;
+   float fTimeStep;
+   float fStartTime;
+   float fLoopPeriod;            // 0 if the bake does not loop
+
+   // -------------------------------------------------------------------------
+   // The simulation's parameters, see COceanSimulation.
+   // -------------------------------------------------------------------------
+   float fXWindSpeed;
+   float fZWindSpeed;
+   float fPhillipsConstant;
+   float fGravityConstant;
+   float fChoppiness;
+   unsigned int nSeed;
+   int nSpectrumModel;
+   int nSpreading;
+   float fFetch;
+   float fDepth;
+   float fPeakEnhancement;
+   float fSpreadingExponent;
+   unsigned int nReserved;
+
+   OceanBakeOffset nIndexOffset;
+
+   // -------------------------------------------------------------------------
+   // Version 2. Codec frames quantize each field to its step, and start a
+   // keyframe every nKeyframeInterval frames.
+   // -------------------------------------------------------------------------
+   float afQuantizationSteps[OCEAN_BAKE_MAX_FIELDS];
+   int nKeyframeInterval;
+   unsigned int nReserved2;
+};
+
+struct OceanBakeFrameEntry
+{
+   OceanBakeOffset nOffset;
+   unsigned int nBytes;
+   unsigned int nFlags;          // OCEAN_BAKE_FRAME_*
+};
+
+// -------------------------------------------------------------------------
+// Fills a header with the ocean's grid and parameters and the given
+// spacing and timing, ready for COceanBakeWriter::Open.
+// -------------------------------------------------------------------------
+void GetOceanBakeHeader(
+   COceanSimulation& ocean,
+   float fSpacingX,
+   float fSpacingZ,
+   float fTimeStep,
+   float fStartTime,
+   OceanBakeHeader& header);
+
+// -------------------------------------------------------------------------
+// Switches a header to codec frames, every sample within fMaxError of
+// its simulated value, with a keyframe every nKeyframeInterval frames.
+// -------------------------------------------------------------------------
+void SetOceanBakeCodec(
+   OceanBakeHeader& header,
+   float fMaxError,
+   int nKeyframeInterval);
+
+class COceanBakeWriter
+{
+public:
+   COceanBakeWriter();
+   virtual ~COceanBakeWriter();
+
+   // -------------------------------------------------------------------------
+   // Creates pPath for frames described by header; its frame count and
+   // index offset are filled in by Close().
+   // -------------------------------------------------------------------------
+   bool Open(const char* pPath, const OceanBakeHeader& header);
+
+   // -------------------------------------------------------------------------
+   // Appends a frame of header.nFields maps.
+   // -------------------------------------------------------------------------
+   bool WriteFrame(const float* const* ppFields);
+
+   // -------------------------------------------------------------------------
+   // Writes the index and the final header. Returns false if any write
+   // since Open() failed.
+   // -------------------------------------------------------------------------
+   bool Close();
+
+   // -------------------------------------------------------------------------
+   // Largest error of the codec frames written so far, 0 for raw frames.
+   // -------------------------------------------------------------------------
+   float GetMaxError();
+
+protected:
+   bool Write(const void* pData, size_t nBytes);
+   bool Pad();
+
+   FILE* m_pFile;
+   bool m_blFailed;
+   OceanBakeHeader m_Header;
+   OceanBakeOffset m_nOffset;
+   vector<OceanBakeFrameEntry> m_Index;
+
+   COceanFrameEncoder m_Encoder;
+   vector<unsigned char> m_Payload;
+};
+
+class COceanBakeReader
+{
+public:
+   COceanBakeReader();
+   virtual ~COceanBakeReader();
+
+   // -------------------------------------------------------------------------
+   // Maps pPath and checks its header and index. Returns false, and stays
+   // closed, if the file cannot be mapped or is not a valid bake.
+   // -------------------------------------------------------------------------
+   bool Open(const char* pPath);
+   void Close();
+   bool IsOpen();
+
+   const OceanBakeHeader& GetHeader();
+   int GetFrameCount();
+
+   // -------------------------------------------------------------------------
+   // The frame nearest dTime. A looping bake wraps around, any other is
+   // held at its first or last frame.
+   // -------------------------------------------------------------------------
+   int GetFrameIndex(double dTime);
+
+   // -------------------------------------------------------------------------
+   // Codec frames are decoded on pPool's threads.
+   // -------------------------------------------------------------------------
+   void SetThreadPool(CThreadPool* pPool);
+
+   // -------------------------------------------------------------------------
+   // Every map of a frame. Raw maps point into the mapping and are valid
+   // until Close(); decoded ones only until another frame is asked for.
+   // Returns false, leaving ppFields alone, if a codec frame turns out to
+   // be corrupt.
+   // -------------------------------------------------------------------------
+   bool GetFrame(int nFrame, const float** ppFields);
+
+   // -------------------------------------------------------------------------
+   // One map of a frame, as GetFrame() gives it, or NULL.
+   // -------------------------------------------------------------------------
+   const float* GetField(int nFrame, int nField);
+
+protected:
+   bool Map(const char* pPath);
+   void Unmap();
+   bool Validate();
+   bool Decode(int nFrame);
+
+   const unsigned char* m_pData;
+   size_t m_nBytes;
+   const OceanBakeHeader* m_pHeader;
+   const OceanBakeFrameEntry* m_pIndex;
+
+   // -------------------------------------------------------------------------
+   // The header as read, a version 1 header padded out with zeros.
+   // -------------------------------------------------------------------------
+   OceanBakeHeader m_Header;
+
+   // -------------------------------------------------------------------------
+   // Codec playback: the maps of frame m_nDecodedFrame, or -1 if they
+   // hold none.
+   // -------------------------------------------------------------------------
+   COceanFrameDecoder m_Decoder;
+   vector<float> m_Decoded;
+   int m_nDecodedFrame;
+
+#ifdef _WIN32
+   void* m_hFile;
+   void* m_hMapping;
+#endif
+};
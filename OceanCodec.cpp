@@ -0,0 +1,735 @@
+#include <math.h>
+#include <string.h>
+#include "OceanCodec.h"
+#include "ThreadPool.h"
+#include "CpuFeatures.h"
+
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#define OCEAN_CODEC_SSE2
+#if _MSC_VER >= 1700
+#define OCEAN_CODEC_AVX2
+#endif
+#define OCEAN_CODEC_TARGET_AVX2
+#elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define OCEAN_CODEC_SSE2
+#define OCEAN_CODEC_AVX2
+#define OCEAN_CODEC_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+#ifdef OCEAN_CODEC_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef OCEAN_CODEC_AVX2
+#include <immintrin.h>
+#endif
+
+// -------------------------------------------------------------------------
+// A control byte holds the block's bit width, and a flag if its values
+// are predicted from the row above. A block of width b takes b 32-bit
+// words per lane.
+// -------------------------------------------------------------------------
+#define OCEAN_CODEC_LANES             4
+#define OCEAN_CODEC_LANE_VALUES       (OCEAN_CODEC_BLOCK / OCEAN_CODEC_LANES)
+#define OCEAN_CODEC_MAX_WIDTH         32
+#define OCEAN_CODEC_WIDTH_MASK        0x3F
+#define OCEAN_CODEC_PREDICT_ABOVE     0x80
+
+static size_t GetBlockBytes(int nWidth)
+{
+   return (size_t)nWidth * OCEAN_CODEC_LANES * sizeof(unsigned int);
+}
+
+static int GetBitWidth(unsigned int nValue)
+{
+   int nWidth = 0;
+
+   while (nValue != 0)
+   {
+      nWidth++;
+      nValue >>= 1;
+   }
+
+   return nWidth;
+}
+
+static unsigned int ZigzagEncode(int nValue)
+{
+   return ((unsigned int)nValue << 1) ^ (unsigned int)(nValue >> 31);
+}
+
+static int ZigzagDecode(unsigned int nValue)
+{
+   return (int)(nValue >> 1) ^ -(int)(nValue & 1);
+}
+
+static short SaturateVelocity(int nStep)
+{
+   return (short)((nStep > OCEAN_CODEC_MAX_VELOCITY) ? OCEAN_CODEC_MAX_VELOCITY :
+                  (nStep < -OCEAN_CODEC_MAX_VELOCITY - 1) ? -OCEAN_CODEC_MAX_VELOCITY - 1 : nStep);
+}
+
+static void WriteUInt(unsigned char* pOutput, unsigned int nValue)
+{
+   memcpy(pOutput, &nValue, sizeof(nValue));
+}
+
+static unsigned int ReadUInt(const unsigned char* pInput)
+{
+   unsigned int nValue;
+   memcpy(&nValue, pInput, sizeof(nValue));
+   return nValue;
+}
+
+float GetOceanCodecStep(float fMaxError)
+{
+   // -------------------------------------------------------------------------
+   // Rounding to the nearest multiple is off by at most half a step.
+   // -------------------------------------------------------------------------
+   int nExponent = 0;
+   frexp(2.0 * fMaxError, &nExponent);
+   return (float)ldexp(1.0, nExponent - 1);
+}
+
+// -------------------------------------------------------------------------
+// COceanFrameEncoder
+// -------------------------------------------------------------------------
+COceanFrameEncoder::COceanFrameEncoder()
+{
+   m_nWidth = 0;
+   m_nHeight = 0;
+   m_nFields = 0;
+   m_nBands = 0;
+   m_nBlocksPerRow = 0;
+   m_fMaxError = 0.0f;
+}
+
+bool COceanFrameEncoder::Init(int nWidth, int nHeight, int nFields, const float* pfSteps)
+{
+   if (nWidth <= 0 || nHeight <= 0 || nFields <= 0)
+   {
+      return false;
+   }
+
+   m_nWidth = nWidth;
+   m_nHeight = nHeight;
+   m_nFields = nFields;
+   m_nBands = (nWidth + OCEAN_CODEC_BAND_ROWS - 1) / OCEAN_CODEC_BAND_ROWS;
+   m_nBlocksPerRow = (nHeight + OCEAN_CODEC_BLOCK - 1) / OCEAN_CODEC_BLOCK;
+   m_Steps.assign(pfSteps, pfSteps + nFields);
+   m_fMaxError = 0.0f;
+
+   size_t nPoints = (size_t)nWidth * nHeight;
+
+   m_Quantized.assign(nFields * nPoints, 0);
+   m_Velocities.assign(nFields * nPoints, 0);
+   m_Residuals.assign(nPoints, 0);
+   return true;
+}
+
+float COceanFrameEncoder::GetMaxError()
+{
+   return m_fMaxError;
+}
+
+void COceanFrameEncoder::EncodeFrame(const float* const* ppFields, bool blKeyframe, vector<unsigned char>& output)
+{
+   // -------------------------------------------------------------------------
+   // Payload: the band count, the offset of every band's data from the
+   // end of the offsets plus the end offset, then the bands.
+   // -------------------------------------------------------------------------
+   int nBandCount = m_nFields * m_nBands;
+   size_t nHeaderStart = output.size();
+   output.resize(nHeaderStart + (nBandCount + 2) * sizeof(unsigned int));
+
+   size_t nDataStart = output.size();
+   vector<unsigned int> offsets(nBandCount + 1);
+   size_t nPoints = (size_t)m_nWidth * m_nHeight;
+
+   for (int f = 0; f < m_nFields; f++)
+   {
+      const float* pField = ppFields[f];
+      int* pQuantized = &m_Quantized[f * nPoints];
+      short* pVelocities = &m_Velocities[f * nPoints];
+      float fStep = m_Steps[f];
+      float fInverseStep = 1.0f / fStep;
+
+      for (size_t i = 0; i < nPoints; i++)
+      {
+         double dQuantized = floor(pField[i] * fInverseStep + 0.5f);
+
+         if (dQuantized > OCEAN_CODEC_MAX_QUANTIZED)
+         {
+            dQuantized = OCEAN_CODEC_MAX_QUANTIZED;
+         }
+         else if (dQuantized < -OCEAN_CODEC_MAX_QUANTIZED)
+         {
+            dQuantized = -OCEAN_CODEC_MAX_QUANTIZED;
+         }
+
+         int nQuantized = (int)dQuantized;
+         float fError = (float)fabs(pField[i] - nQuantized * fStep);
+
+         if (fError > m_fMaxError)
+         {
+            m_fMaxError = fError;
+         }
+
+         if (blKeyframe)
+         {
+            m_Residuals[i] = nQuantized;
+            pVelocities[i] = 0;
+         }
+         else
+         {
+            int nStep = nQuantized - pQuantized[i];
+            m_Residuals[i] = nStep - pVelocities[i];
+            pVelocities[i] = SaturateVelocity(nStep);
+         }
+
+         pQuantized[i] = nQuantized;
+      }
+
+      for (int b = 0; b < m_nBands; b++)
+      {
+         offsets[f * m_nBands + b] = (unsigned int)(output.size() - nDataStart);
+         EncodeBand(f, b, output);
+      }
+   }
+
+   offsets[nBandCount] = (unsigned int)(output.size() - nDataStart);
+
+   WriteUInt(&output[nHeaderStart], (unsigned int)nBandCount);
+
+   for (int b = 0; b <= nBandCount; b++)
+   {
+      WriteUInt(&output[nHeaderStart + (b + 1) * sizeof(unsigned int)], offsets[b]);
+   }
+}
+
+void COceanFrameEncoder::EncodeBand(int nField, int nBand, vector<unsigned char>& output)
+{
+   (void)nField;
+
+   int nRow0 = nBand * OCEAN_CODEC_BAND_ROWS;
+   int nRow1 = (nRow0 + OCEAN_CODEC_BAND_ROWS < m_nWidth) ? nRow0 + OCEAN_CODEC_BAND_ROWS : m_nWidth;
+   size_t nControl = output.size();
+
+   output.resize(nControl + (nRow1 - nRow0) * m_nBlocksPerRow);
+
+   for (int x = nRow0; x < nRow1; x++)
+   {
+      const int* pRow = &m_Residuals[(size_t)x * m_nHeight];
+      const int* pAbove = (x > nRow0) ? pRow - m_nHeight : NULL;
+
+      for (int nBlock = 0; nBlock < m_nBlocksPerRow; nBlock++)
+      {
+         // -------------------------------------------------------------------
+         // Zigzag residuals of the block both ways, padded with zeros past
+         // the row, and the narrower of the two kept.
+         // -------------------------------------------------------------------
+         unsigned int anPlain[OCEAN_CODEC_BLOCK];
+         unsigned int anPredicted[OCEAN_CODEC_BLOCK];
+         unsigned int nPlain = 0;
+         unsigned int nPredicted = 0;
+
+         for (int j = 0; j < OCEAN_CODEC_BLOCK; j++)
+         {
+            int z = nBlock * OCEAN_CODEC_BLOCK + j;
+            int nResidual = (z < m_nHeight) ? pRow[z] : 0;
+            int nAbove = (z < m_nHeight && pAbove != NULL) ? pAbove[z] : 0;
+
+            anPlain[j] = ZigzagEncode(nResidual);
+            anPredicted[j] = ZigzagEncode(nResidual - nAbove);
+            nPlain |= anPlain[j];
+            nPredicted |= anPredicted[j];
+         }
+
+         bool blPredict = GetBitWidth(nPredicted) < GetBitWidth(nPlain);
+         const unsigned int* pValues = blPredict ? anPredicted : anPlain;
+         int nWidth = GetBitWidth(blPredict ? nPredicted : nPlain);
+
+         output[nControl++] = (unsigned char)(nWidth | (blPredict ? OCEAN_CODEC_PREDICT_ABOVE : 0));
+
+         // -------------------------------------------------------------------
+         // Lane l packs values l, l + 4, l + 8, ... one after another into
+         // its words, low bits first; word w of lane l is word 4w + l of
+         // the block.
+         // -------------------------------------------------------------------
+         unsigned int anWords[OCEAN_CODEC_MAX_WIDTH * OCEAN_CODEC_LANES];
+         memset(anWords, 0, sizeof(anWords));
+
+         for (int k = 0; k < OCEAN_CODEC_LANE_VALUES && nWidth != 0; k++)
+         {
+            int nBit = k * nWidth;
+            int nWord = nBit >> 5;
+            int nShift = nBit & 31;
+
+            for (int l = 0; l < OCEAN_CODEC_LANES; l++)
+            {
+               unsigned int nValue = pValues[k * OCEAN_CODEC_LANES + l];
+               anWords[nWord * OCEAN_CODEC_LANES + l] |= nValue << nShift;
+
+               if (nShift + nWidth > 32)
+               {
+                  anWords[(nWord + 1) * OCEAN_CODEC_LANES + l] |= nValue >> (32 - nShift);
+               }
+            }
+         }
+
+         size_t nData = output.size();
+         output.resize(nData + GetBlockBytes(nWidth));
+
+         for (int w = 0; w < nWidth * OCEAN_CODEC_LANES; w++)
+         {
+            WriteUInt(&output[nData + w * sizeof(unsigned int)], anWords[w]);
+         }
+      }
+   }
+}
+
+// -------------------------------------------------------------------------
+// Decoding kernels. A block unpacks to OCEAN_CODEC_BLOCK zigzag values;
+// reconstruction then undoes the zigzag and both predictions, and adds the
+// step onto the previous frame. The SIMD kernels do both at once and
+// take whole blocks only, leaving a short last block of a row to these.
+// -------------------------------------------------------------------------
+static const unsigned char* UnpackBlock(int nWidth, const unsigned char* pData, unsigned int* pValues)
+{
+   unsigned int nMask = (nWidth == 32) ? 0xFFFFFFFFu : (1u << nWidth) - 1;
+
+   for (int k = 0; k < OCEAN_CODEC_LANE_VALUES; k++)
+   {
+      int nBit = k * nWidth;
+      int nWord = nBit >> 5;
+      int nShift = nBit & 31;
+
+      for (int l = 0; l < OCEAN_CODEC_LANES; l++)
+      {
+         unsigned int nValue = 0;
+
+         if (nWidth != 0)
+         {
+            nValue = ReadUInt(pData + (nWord * OCEAN_CODEC_LANES + l) * sizeof(unsigned int)) >> nShift;
+
+            if (nShift + nWidth > 32)
+            {
+               nValue |= ReadUInt(pData + ((nWord + 1) * OCEAN_CODEC_LANES + l) * sizeof(unsigned int)) << (32 - nShift);
+            }
+         }
+
+         pValues[k * OCEAN_CODEC_LANES + l] = nValue & nMask;
+      }
+   }
+
+   return pData + GetBlockBytes(nWidth);
+}
+
+static void ReconstructBlock(
+   const unsigned int* pValues,
+   int* pAbove,
+   bool blPredict,
+   int nCount,
+   short* pVelocities,
+   float fStep,
+   bool blKeyframe,
+   float* pOutput)
+{
+   for (int z = 0; z < nCount; z++)
+   {
+      int nResidual = ZigzagDecode(pValues[z]) + (blPredict ? pAbove[z] : 0);
+      pAbove[z] = nResidual;
+
+      if (blKeyframe)
+      {
+         pVelocities[z] = 0;
+         pOutput[z] = (float)nResidual * fStep;
+      }
+      else
+      {
+         int nStep = pVelocities[z] + nResidual;
+         pVelocities[z] = SaturateVelocity(nStep);
+         pOutput[z] += (float)nStep * fStep;
+      }
+   }
+}
+
+#ifdef OCEAN_CODEC_SSE2
+
+// -------------------------------------------------------------------------
+// Decodes a whole block, four values at a time straight from the packed
+// words. Every lane sits at the same bit offset, so one shift by a count
+// held in a register extracts four values. The word after is always
+// merged in rather than branching on whether a value straddles the two:
+// shifted by 32 it is zero, otherwise its bits land above the width and
+// are masked off. Past the last word it is clamped to the last.
+// -------------------------------------------------------------------------
+static const unsigned char* DecodeBlockSSE2(
+   int nWidth,
+   const unsigned char* pData,
+   int* pAbove,
+   bool blPredict,
+   short* pVelocities,
+   float fStep,
+   bool blKeyframe,
+   float* pOutput)
+{
+   const __m128i* pWords = (const __m128i*)pData;
+   __m128i vMask = _mm_set1_epi32((nWidth == 32) ? -1 : (1 << nWidth) - 1);
+   __m128i vOne = _mm_set1_epi32(1);
+   __m128i vZero = _mm_setzero_si128();
+   __m128i vPredict = _mm_set1_epi32(blPredict ? -1 : 0);
+   __m128 vStep = _mm_set1_ps(fStep);
+   int nLastWord = (nWidth > 0) ? nWidth - 1 : 0;
+
+   for (int k = 0; k < OCEAN_CODEC_LANE_VALUES; k++)
+   {
+      int z = k * OCEAN_CODEC_LANES;
+      __m128i vValues = vZero;
+
+      if (nWidth != 0)
+      {
+         int nBit = k * nWidth;
+         int nWord = nBit >> 5;
+         int nShift = nBit & 31;
+         int nNext = (nWord < nLastWord) ? nWord + 1 : nLastWord;
+
+         vValues = _mm_or_si128(
+            _mm_srl_epi32(_mm_loadu_si128(pWords + nWord), _mm_cvtsi32_si128(nShift)),
+            _mm_sll_epi32(_mm_loadu_si128(pWords + nNext), _mm_cvtsi32_si128(32 - nShift)));
+         vValues = _mm_and_si128(vValues, vMask);
+      }
+
+      __m128i vResidual = _mm_xor_si128(
+         _mm_srli_epi32(vValues, 1),
+         _mm_sub_epi32(vZero, _mm_and_si128(vValues, vOne)));
+
+      __m128i vAbove = _mm_and_si128(_mm_loadu_si128((const __m128i*)(pAbove + z)), vPredict);
+      vResidual = _mm_add_epi32(vResidual, vAbove);
+      _mm_storeu_si128((__m128i*)(pAbove + z), vResidual);
+
+      if (blKeyframe)
+      {
+         _mm_storel_epi64((__m128i*)(pVelocities + z), vZero);
+         _mm_storeu_ps(pOutput + z, _mm_mul_ps(_mm_cvtepi32_ps(vResidual), vStep));
+      }
+      else
+      {
+         __m128i vVelocity = _mm_loadl_epi64((const __m128i*)(pVelocities + z));
+         vVelocity = _mm_srai_epi32(_mm_unpacklo_epi16(vVelocity, vVelocity), 16);
+
+         __m128i vDelta = _mm_add_epi32(vVelocity, vResidual);
+         _mm_storel_epi64((__m128i*)(pVelocities + z), _mm_packs_epi32(vDelta, vDelta));
+
+         __m128 vOutput = _mm_add_ps(_mm_loadu_ps(pOutput + z), _mm_mul_ps(_mm_cvtepi32_ps(vDelta), vStep));
+         _mm_storeu_ps(pOutput + z, vOutput);
+      }
+   }
+
+   return pData + GetBlockBytes(nWidth);
+}
+
+#endif
+
+#ifdef OCEAN_CODEC_AVX2
+
+// -------------------------------------------------------------------------
+// The same, eight values at a time: values 4k to 4k + 7 are lanes 0 to 3
+// of two consecutive rounds k and k + 1, which sit at different bit
+// offsets, so each half of the register loads its own words and the
+// shifts are per element. A shift by 32 or more gives zero here, so the
+// word after needs no clamping beyond staying inside the block.
+// -------------------------------------------------------------------------
+OCEAN_CODEC_TARGET_AVX2
+static inline __m256i LoadWordPair(const __m128i* pWords, int nWord0, int nWord1)
+{
+   return _mm256_inserti128_si256(
+      _mm256_castsi128_si256(_mm_loadu_si128(pWords + nWord0)),
+      _mm_loadu_si128(pWords + nWord1), 1);
+}
+
+OCEAN_CODEC_TARGET_AVX2
+static const unsigned char* DecodeBlockAVX2(
+   int nWidth,
+   const unsigned char* pData,
+   int* pAbove,
+   bool blPredict,
+   short* pVelocities,
+   float fStep,
+   bool blKeyframe,
+   float* pOutput)
+{
+   const __m128i* pWords = (const __m128i*)pData;
+   __m256i vMask = _mm256_set1_epi32((nWidth == 32) ? -1 : (1 << nWidth) - 1);
+   __m256i vOne = _mm256_set1_epi32(1);
+   __m256i vZero = _mm256_setzero_si256();
+   __m256i vPredict = _mm256_set1_epi32(blPredict ? -1 : 0);
+   __m256 vStep = _mm256_set1_ps(fStep);
+   int nLastWord = (nWidth > 0) ? nWidth - 1 : 0;
+
+   for (int k = 0; k < OCEAN_CODEC_LANE_VALUES; k += 2)
+   {
+      int z = k * OCEAN_CODEC_LANES;
+      __m256i vValues = vZero;
+
+      if (nWidth != 0)
+      {
+         int nBit0 = k * nWidth;
+         int nBit1 = nBit0 + nWidth;
+         int nWord0 = nBit0 >> 5;
+         int nWord1 = nBit1 >> 5;
+         int nShift0 = nBit0 & 31;
+         int nShift1 = nBit1 & 31;
+         int nNext0 = (nWord0 < nLastWord) ? nWord0 + 1 : nLastWord;
+         int nNext1 = (nWord1 < nLastWord) ? nWord1 + 1 : nLastWord;
+
+         __m256i vShift = _mm256_set_epi32(nShift1, nShift1, nShift1, nShift1, nShift0, nShift0, nShift0, nShift0);
+
+         vValues = _mm256_or_si256(
+            _mm256_srlv_epi32(LoadWordPair(pWords, nWord0, nWord1), vShift),
+            _mm256_sllv_epi32(LoadWordPair(pWords, nNext0, nNext1), _mm256_sub_epi32(_mm256_set1_epi32(32), vShift)));
+         vValues = _mm256_and_si256(vValues, vMask);
+      }
+
+      __m256i vResidual = _mm256_xor_si256(
+         _mm256_srli_epi32(vValues, 1),
+         _mm256_sub_epi32(vZero, _mm256_and_si256(vValues, vOne)));
+
+      __m256i vAbove = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(pAbove + z)), vPredict);
+      vResidual = _mm256_add_epi32(vResidual, vAbove);
+      _mm256_storeu_si256((__m256i*)(pAbove + z), vResidual);
+
+      if (blKeyframe)
+      {
+         _mm_storeu_si128((__m128i*)(pVelocities + z), _mm256_castsi256_si128(vZero));
+         _mm256_storeu_ps(pOutput + z, _mm256_mul_ps(_mm256_cvtepi32_ps(vResidual), vStep));
+      }
+      else
+      {
+         __m256i vDelta = _mm256_add_epi32(
+            _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(pVelocities + z))), vResidual);
+         _mm_storeu_si128((__m128i*)(pVelocities + z),
+            _mm_packs_epi32(_mm256_castsi256_si128(vDelta), _mm256_extracti128_si256(vDelta, 1)));
+
+         __m256 vOutput = _mm256_add_ps(_mm256_loadu_ps(pOutput + z), _mm256_mul_ps(_mm256_cvtepi32_ps(vDelta), vStep));
+         _mm256_storeu_ps(pOutput + z, vOutput);
+      }
+   }
+
+   return pData + GetBlockBytes(nWidth);
+}
+
+#endif
+
+// -------------------------------------------------------------------------
+// COceanFrameDecoder
+// -------------------------------------------------------------------------
+class COceanFrameDecoder::CBandTask : public CParallelTask
+{
+public:
+   CBandTask(COceanFrameDecoder* pDecoder)
+   {
+      m_pDecoder = pDecoder;
+   }
+
+   virtual void Run(int nBegin, int nEnd, int nThread)
+   {
+      for (int b = nBegin; b < nEnd; b++)
+      {
+         m_pDecoder->DecodeBand(b, nThread);
+      }
+   }
+
+protected:
+   COceanFrameDecoder* m_pDecoder;
+};
+
+COceanFrameDecoder::COceanFrameDecoder()
+{
+   m_nWidth = 0;
+   m_nHeight = 0;
+   m_nFields = 0;
+   m_nBands = 0;
+   m_nBlocksPerRow = 0;
+   m_nSimdLevel = SIMD_LEVEL_SCALAR;
+   m_pThreadPool = NULL;
+   m_blKeyframe = false;
+   m_ppFields = NULL;
+}
+
+bool COceanFrameDecoder::Init(int nWidth, int nHeight, int nFields, const float* pfSteps)
+{
+   if (nWidth <= 0 || nHeight <= 0 || nFields <= 0)
+   {
+      return false;
+   }
+
+   m_nWidth = nWidth;
+   m_nHeight = nHeight;
+   m_nFields = nFields;
+   m_nBands = (nWidth + OCEAN_CODEC_BAND_ROWS - 1) / OCEAN_CODEC_BAND_ROWS;
+   m_nBlocksPerRow = (nHeight + OCEAN_CODEC_BLOCK - 1) / OCEAN_CODEC_BLOCK;
+   m_nSimdLevel = GetSimdLevel();
+   m_Steps.assign(pfSteps, pfSteps + nFields);
+   m_BandData.resize((size_t)nFields * m_nBands);
+   m_Velocities.assign((size_t)nFields * nWidth * nHeight, 0);
+
+   AllocateScratch();
+   return true;
+}
+
+void COceanFrameDecoder::SetThreadPool(CThreadPool* pPool)
+{
+   m_pThreadPool = pPool;
+   AllocateScratch();
+}
+
+void COceanFrameDecoder::AllocateScratch()
+{
+   int nThreads = (m_pThreadPool != NULL) ? m_pThreadPool->GetThreadCount() : 1;
+   m_Scratch.resize(nThreads);
+
+   for (int t = 0; t < nThreads; t++)
+   {
+      m_Scratch[t].values.resize(OCEAN_CODEC_BLOCK);
+      m_Scratch[t].above.resize(m_nBlocksPerRow * OCEAN_CODEC_BLOCK);
+   }
+}
+
+bool COceanFrameDecoder::DecodeFrame(const unsigned char* pData, size_t nBytes, bool blKeyframe, float* const* ppFields)
+{
+   // -------------------------------------------------------------------------
+   // Check the whole payload first: the band table, then each band's
+   // control bytes against the data they describe. The band decoders can
+   // then run unchecked.
+   // -------------------------------------------------------------------------
+   int nBandCount = m_nFields * m_nBands;
+   int nThreads = (m_pThreadPool != NULL) ? m_pThreadPool->GetThreadCount() : 1;
+   size_t nTableBytes = (nBandCount + 2) * sizeof(unsigned int);
+
+   if (nBytes < nTableBytes || ReadUInt(pData) != (unsigned int)nBandCount)
+   {
+      return false;
+   }
+
+   const unsigned char* pBands = pData + nTableBytes;
+   size_t nBandBytes = nBytes - nTableBytes;
+
+   for (int b = 0; b < nBandCount; b++)
+   {
+      size_t nBegin = ReadUInt(pData + (b + 1) * sizeof(unsigned int));
+      size_t nEnd = ReadUInt(pData + (b + 2) * sizeof(unsigned int));
+
+      int nRow0 = (b % m_nBands) * OCEAN_CODEC_BAND_ROWS;
+      int nRows = (nRow0 + OCEAN_CODEC_BAND_ROWS < m_nWidth) ? OCEAN_CODEC_BAND_ROWS : m_nWidth - nRow0;
+      size_t nControls = (size_t)nRows * m_nBlocksPerRow;
+
+      if (nBegin > nEnd || nEnd > nBandBytes || nEnd - nBegin < nControls)
+      {
+         return false;
+      }
+
+      size_t nExpected = nControls;
+
+      for (size_t c = 0; c < nControls; c++)
+      {
+         int nControl = pBands[nBegin + c];
+         int nWidth = nControl & OCEAN_CODEC_WIDTH_MASK;
+
+         if (nWidth > OCEAN_CODEC_MAX_WIDTH ||
+             (nControl & ~(OCEAN_CODEC_WIDTH_MASK | OCEAN_CODEC_PREDICT_ABOVE)) != 0)
+         {
+            return false;
+         }
+
+         nExpected += GetBlockBytes(nWidth);
+      }
+
+      if (nExpected != nEnd - nBegin)
+      {
+         return false;
+      }
+
+      m_BandData[b] = pBands + nBegin;
+   }
+
+   // -------------------------------------------------------------------------
+   // The pool may have been resized since it was set.
+   // -------------------------------------------------------------------------
+   if ((int)m_Scratch.size() != nThreads)
+   {
+      AllocateScratch();
+   }
+
+   m_blKeyframe = blKeyframe;
+   m_ppFields = ppFields;
+
+   if (m_pThreadPool != NULL)
+   {
+      CBandTask task(this);
+      m_pThreadPool->ParallelFor(nBandCount, 1, &task);
+   }
+   else
+   {
+      for (int b = 0; b < nBandCount; b++)
+      {
+         DecodeBand(b, 0);
+      }
+   }
+
+   return true;
+}
+
+void COceanFrameDecoder::DecodeBand(int nBand, int nThread)
+{
+   int nField = nBand / m_nBands;
+   int nRow0 = (nBand % m_nBands) * OCEAN_CODEC_BAND_ROWS;
+   int nRow1 = (nRow0 + OCEAN_CODEC_BAND_ROWS < m_nWidth) ? nRow0 + OCEAN_CODEC_BAND_ROWS : m_nWidth;
+
+   const unsigned char* pControls = m_BandData[nBand];
+   const unsigned char* pData = pControls + (nRow1 - nRow0) * m_nBlocksPerRow;
+
+   ThreadScratch& scratch = m_Scratch[nThread];
+   unsigned int* pValues = &scratch.values[0];
+   int* pAbove = &scratch.above[0];
+   float fStep = m_Steps[nField];
+
+   for (int x = nRow0; x < nRow1; x++)
+   {
+      float* pOutput = m_ppFields[nField] + (size_t)x * m_nHeight;
+      short* pVelocities = &m_Velocities[((size_t)nField * m_nWidth + x) * m_nHeight];
+
+      for (int nBlock = 0; nBlock < m_nBlocksPerRow; nBlock++)
+      {
+         // -------------------------------------------------------------------
+         // The first row of a band has nothing above it, whatever a corrupt
+         // control byte says.
+         // -------------------------------------------------------------------
+         int nControl = *pControls++;
+         int nWidth = nControl & OCEAN_CODEC_WIDTH_MASK;
+         bool blPredict = (nControl & OCEAN_CODEC_PREDICT_ABOVE) != 0 && x > nRow0;
+
+         int z = nBlock * OCEAN_CODEC_BLOCK;
+         int nCount = (z + OCEAN_CODEC_BLOCK < m_nHeight) ? OCEAN_CODEC_BLOCK : m_nHeight - z;
+
+#ifdef OCEAN_CODEC_AVX2
+         if (m_nSimdLevel >= SIMD_LEVEL_AVX2 && nCount == OCEAN_CODEC_BLOCK)
+         {
+            pData = DecodeBlockAVX2(nWidth, pData, pAbove + z, blPredict, pVelocities + z, fStep, m_blKeyframe, pOutput + z);
+            continue;
+         }
+#endif
+
+#ifdef OCEAN_CODEC_SSE2
+         if (m_nSimdLevel >= SIMD_LEVEL_SSE2 && nCount == OCEAN_CODEC_BLOCK)
+         {
+            pData = DecodeBlockSSE2(nWidth, pData, pAbove + z, blPredict, pVelocities + z, fStep, m_blKeyframe, pOutput + z);
+            continue;
+         }
+#endif
+
+         pData = UnpackBlock(nWidth, pData, pValues);
+         ReconstructBlock(pValues, pAbove + z, blPredict, nCount, pVelocities + z, fStep, m_blKeyframe, pOutput + z);
+      }
+   }
+}
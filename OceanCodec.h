@@ -0,0 +1,177 @@
+// -------------------------------------------------------------------------
+// Sean Janis
+// spjanis@gmail.com
+// Water Simulations
+//
+// OceanCodec
+//       Lossy compression for sequences of ocean maps, used by the baked
+//       animation format. Every sample is quantized to a multiple q of a
+//       step that is a power of two, no more than twice the error bound, so
+//       q * step is within the bound and exact in single precision.
+//
+//       Each sample is extrapolated from the two frames before it: its last
+//       step v = q(previous) - q(the one before) is taken again, leaving
+//       e = q - q(previous) - v. Waves move smoothly at animation rates, so
+//       this halves the bits of a plain difference. A keyframe codes e = q
+//       and restarts with v = 0. Both sides keep v saturated to 16 bits,
+//       OCEAN_CODEC_MAX_VELOCITY, which only costs bits for a sample that
+//       moves that many steps in a frame.
+//
+//       Within a frame, each block of e may also be predicted from the row
+//       above, r(x, z) = e(x, z) - e(x - 1, z), whichever leaves it fewer
+//       bits. Rows restart every band of OCEAN_CODEC_BAND_ROWS so that bands
+//       decode independently.
+//
+//       The residuals are zigzag coded and bit packed in blocks of
+//       OCEAN_CODEC_BLOCK values, all at the width of the block's largest,
+//       with one control byte per block ahead of the band's data. A block
+//       interleaves four lanes of 32-bit words, value i in lane i % 4, so
+//       that a single SIMD shift and mask unpacks four values at once, or
+//       eight with AVX2's per-element shifts, and the whole decode is
+//       vector adds, conversions and multiplies.
+//
+//       Decoding adds onto the previous frame's floats: with a power of two
+//       step and |q| below 2^23, out + d * step is exact, so the output
+//       never drifts from what the encoder saw. The decoder keeps v for
+//       every sample alongside it. A frame's bands are shared out over a
+//       thread pool.
+//
+//       So a frame costs a read and a write of the float maps plus of the
+//       16-bit velocities, against a read and a write of the maps to copy a
+//       raw frame: with the frames already in memory the decode runs at
+//       roughly 60% of a copy, and it wins only when reading the raw frames
+//       is bound by the disk, which moves 8 to 10 times the bytes.
+// -------------------------------------------------------------------------
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+using namespace std;
+
+class CThreadPool;
+
+#define OCEAN_CODEC_BLOCK             128
+#define OCEAN_CODEC_BAND_ROWS         32
+
+// -------------------------------------------------------------------------
+// Largest |q| for which the decoder's float arithmetic is exact: d, the
+// difference of two of them, must still convert to float exactly. The
+// encoder clamps to it, which only matters for an error bound far below
+// the maps' magnitudes.
+// -------------------------------------------------------------------------
+#define OCEAN_CODEC_MAX_QUANTIZED     8388607
+
+// -------------------------------------------------------------------------
+// Largest |v| kept; past it v saturates and e carries the rest.
+// -------------------------------------------------------------------------
+#define OCEAN_CODEC_MAX_VELOCITY      32767
+
+// -------------------------------------------------------------------------
+// The power of two quantization step for an error bound.
+// -------------------------------------------------------------------------
+float GetOceanCodecStep(float fMaxError);
+
+class COceanFrameEncoder
+{
+public:
+   COceanFrameEncoder();
+
+   // -------------------------------------------------------------------------
+   // Frames of nFields maps of nWidth rows by nHeight samples, each field
+   // quantized with its own step from pfSteps.
+   // -------------------------------------------------------------------------
+   bool Init(int nWidth, int nHeight, int nFields, const float* pfSteps);
+
+   // -------------------------------------------------------------------------
+   // Appends one frame's payload to output. The first frame must be a
+   // keyframe.
+   // -------------------------------------------------------------------------
+   void EncodeFrame(const float* const* ppFields, bool blKeyframe, vector<unsigned char>& output);
+
+   // -------------------------------------------------------------------------
+   // Largest difference between a sample and its decoded value so far.
+   // -------------------------------------------------------------------------
+   float GetMaxError();
+
+protected:
+   void EncodeBand(int nField, int nBand, vector<unsigned char>& output);
+
+   int m_nWidth;
+   int m_nHeight;
+   int m_nFields;
+   int m_nBands;
+   int m_nBlocksPerRow;
+   vector<float> m_Steps;
+   float m_fMaxError;
+
+   // -------------------------------------------------------------------------
+   // The quantized maps of the last frame and their last steps v, and the
+   // temporal residuals e of the field being encoded.
+   // -------------------------------------------------------------------------
+   vector<int> m_Quantized;
+   vector<short> m_Velocities;
+   vector<int> m_Residuals;
+};
+
+class COceanFrameDecoder
+{
+public:
+   COceanFrameDecoder();
+
+   bool Init(int nWidth, int nHeight, int nFields, const float* pfSteps);
+
+   // -------------------------------------------------------------------------
+   // Bands are decoded on pPool's threads, or on the calling thread only
+   // without one.
+   // -------------------------------------------------------------------------
+   void SetThreadPool(CThreadPool* pPool);
+
+   // -------------------------------------------------------------------------
+   // Decodes a payload of nBytes into ppFields, which must hold the
+   // previous frame unless this is a keyframe; frames since the last
+   // keyframe have to be decoded in order. Returns false, leaving the maps
+   // undefined until the next keyframe, if the payload is malformed.
+   // -------------------------------------------------------------------------
+   bool DecodeFrame(const unsigned char* pData, size_t nBytes, bool blKeyframe, float* const* ppFields);
+
+protected:
+   class CBandTask;
+
+   void DecodeBand(int nBand, int nThread);
+   void AllocateScratch();
+
+   int m_nWidth;
+   int m_nHeight;
+   int m_nFields;
+   int m_nBands;
+   int m_nBlocksPerRow;
+   int m_nSimdLevel;
+   vector<float> m_Steps;
+   CThreadPool* m_pThreadPool;
+
+   // -------------------------------------------------------------------------
+   // The frame being decoded, and every band's data, checked before any of
+   // them is decoded.
+   // -------------------------------------------------------------------------
+   bool m_blKeyframe;
+   float* const* m_ppFields;
+   vector<const unsigned char*> m_BandData;
+
+   // -------------------------------------------------------------------------
+   // Every sample's last step v.
+   // -------------------------------------------------------------------------
+   vector<short> m_Velocities;
+
+   // -------------------------------------------------------------------------
+   // Per thread: one unpacked block, and the residuals e of the row above,
+   // padded to whole blocks.
+   // -------------------------------------------------------------------------
+   struct ThreadScratch
+   {
+      vector<unsigned int> values;
+      vector<int> above;
+   };
+
+   vector<ThreadScratch> m_Scratch;
+};
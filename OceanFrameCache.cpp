@@ -0,0 +1,233 @@
+#include <limits.h>
+#include <math.h>
+#include "OceanFrameCache.h"
+#include "CpuFeatures.h"
+
+#if (defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))) || \
+    (defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__)))
+#define OCEAN_FRAME_CACHE_SSE2
+#include <emmintrin.h>
+#endif
+
+// -------------------------------------------------------------------------
+// Largest quantized magnitude, keeping the range symmetric about the bias.
+// -------------------------------------------------------------------------
+#define OCEAN_FRAME_CACHE_INT16_MAX   32767
+
+COceanFrameCache::COceanFrameCache()
+{
+   m_nFrames = 0;
+   m_nFields = 0;
+   m_nPoints = 0;
+   m_nFormat = OCEAN_FRAME_CACHE_FLOAT;
+   m_nSimdLevel = SIMD_LEVEL_SCALAR;
+}
+
+bool COceanFrameCache::Allocate(int nFrames, int nFields, int nPoints, int nFormat)
+{
+   Free();
+
+   // -------------------------------------------------------------------------
+   // The samples are one buffer, indexed by an int.
+   // -------------------------------------------------------------------------
+   double dSamples = (double)nFrames * nFields * nPoints;
+
+   if (nFrames <= 0 || nFields <= 0 || nPoints <= 0 || dSamples > INT_MAX)
+   {
+      return false;
+   }
+
+   int nSamples = nFrames * nFields * nPoints;
+   bool blAllocated = (nFormat == OCEAN_FRAME_CACHE_INT16) ?
+      m_Quantized.Allocate(nSamples) :
+      m_Floats.Allocate(nSamples);
+
+   if (!blAllocated)
+   {
+      return false;
+   }
+
+   m_nFrames = nFrames;
+   m_nFields = nFields;
+   m_nPoints = nPoints;
+   m_nFormat = nFormat;
+   m_nSimdLevel = GetSimdLevel();
+   m_Scales.assign(nFrames * nFields, 0.0f);
+   m_Biases.assign(nFrames * nFields, 0.0f);
+   return true;
+}
+
+void COceanFrameCache::Free()
+{
+   m_Floats.Free();
+   m_Quantized.Free();
+   m_Scales.clear();
+   m_Biases.clear();
+   m_nFrames = 0;
+   m_nFields = 0;
+   m_nPoints = 0;
+}
+
+int COceanFrameCache::GetFrameCount() const
+{
+   return m_nFrames;
+}
+
+int COceanFrameCache::GetFieldCount() const
+{
+   return m_nFields;
+}
+
+int COceanFrameCache::GetFormat() const
+{
+   return m_nFormat;
+}
+
+size_t COceanFrameCache::GetByteCount() const
+{
+   return (size_t)m_Floats.GetCount() * sizeof(float) +
+          (size_t)m_Quantized.GetCount() * sizeof(short);
+}
+
+float COceanFrameCache::GetMaxError() const
+{
+   float fMaxError = 0.0f;
+
+   if (m_nFormat == OCEAN_FRAME_CACHE_INT16)
+   {
+      for (size_t i = 0; i < m_Scales.size(); i++)
+      {
+         if (m_Scales[i] * 0.5f > fMaxError)
+         {
+            fMaxError = m_Scales[i] * 0.5f;
+         }
+      }
+   }
+
+   return fMaxError;
+}
+
+void COceanFrameCache::StoreField(int nFrame, int nField, const float* pMap)
+{
+   int nMap = nFrame * m_nFields + nField;
+
+   if (m_nFormat != OCEAN_FRAME_CACHE_INT16)
+   {
+      float* pFrame = m_Floats.GetData() + nMap * m_nPoints;
+
+      for (int i = 0; i < m_nPoints; i++)
+      {
+         pFrame[i] = pMap[i];
+      }
+      return;
+   }
+
+   // -------------------------------------------------------------------------
+   // Spread the map's range over the whole 16 bits, centred on the bias.
+   // -------------------------------------------------------------------------
+   float fMin = pMap[0];
+   float fMax = pMap[0];
+
+   for (int i = 1; i < m_nPoints; i++)
+   {
+      fMin = (pMap[i] < fMin) ? pMap[i] : fMin;
+      fMax = (pMap[i] > fMax) ? pMap[i] : fMax;
+   }
+
+   float fBias = 0.5f * (fMin + fMax);
+   float fScale = (fMax - fMin) / (2.0f * OCEAN_FRAME_CACHE_INT16_MAX);
+   float fInverseScale = (fScale > 0.0f) ? 1.0f / fScale : 0.0f;
+
+   m_Scales[nMap] = fScale;
+   m_Biases[nMap] = fBias;
+
+   short* pFrame = m_Quantized.GetData() + nMap * m_nPoints;
+
+   for (int i = 0; i < m_nPoints; i++)
+   {
+      int nValue = (int)floor((pMap[i] - fBias) * fInverseScale + 0.5f);
+
+      if (nValue > OCEAN_FRAME_CACHE_INT16_MAX)
+      {
+         nValue = OCEAN_FRAME_CACHE_INT16_MAX;
+      }
+      else if (nValue < -OCEAN_FRAME_CACHE_INT16_MAX)
+      {
+         nValue = -OCEAN_FRAME_CACHE_INT16_MAX;
+      }
+
+      pFrame[i] = (short)nValue;
+   }
+}
+
+void COceanFrameCache::BlendField(int nFrame0,
+                                  int nFrame1,
+                                  float fBlend,
+                                  int nField,
+                                  int nBegin,
+                                  int nCount,
+                                  float* pOutput) const
+{
+   int nMap0 = nFrame0 * m_nFields + nField;
+   int nMap1 = nFrame1 * m_nFields + nField;
+
+   if (m_nFormat != OCEAN_FRAME_CACHE_INT16)
+   {
+      const float* pFrame0 = m_Floats.GetData() + nMap0 * m_nPoints + nBegin;
+      const float* pFrame1 = m_Floats.GetData() + nMap1 * m_nPoints + nBegin;
+
+      for (int i = 0; i < nCount; i++)
+      {
+         pOutput[i] = pFrame0[i] + (pFrame1[i] - pFrame0[i]) * fBlend;
+      }
+      return;
+   }
+
+   // -------------------------------------------------------------------------
+   // Dequantizing and blending fold into one scale per frame and a shared
+   // bias: (1 - t) * (q0 * s0 + b0) + t * (q1 * s1 + b1).
+   // -------------------------------------------------------------------------
+   const short* pFrame0 = m_Quantized.GetData() + nMap0 * m_nPoints + nBegin;
+   const short* pFrame1 = m_Quantized.GetData() + nMap1 * m_nPoints + nBegin;
+
+   float fScale0 = m_Scales[nMap0] * (1.0f - fBlend);
+   float fScale1 = m_Scales[nMap1] * fBlend;
+   float fBias = m_Biases[nMap0] * (1.0f - fBlend) + m_Biases[nMap1] * fBlend;
+
+   int i = 0;
+
+#ifdef OCEAN_FRAME_CACHE_SSE2
+   // -------------------------------------------------------------------------
+   // Eight samples at a time, sign extended to 32 bits by unpacking each
+   // short into the high half and shifting it back down. The arithmetic is
+   // the scalar loop's, so both give the same floats.
+   // -------------------------------------------------------------------------
+   if (m_nSimdLevel >= SIMD_LEVEL_SSE2)
+   {
+      __m128 vScale0 = _mm_set1_ps(fScale0);
+      __m128 vScale1 = _mm_set1_ps(fScale1);
+      __m128 vBias = _mm_set1_ps(fBias);
+
+      for (; i + 8 <= nCount; i += 8)
+      {
+         __m128i vFrame0 = _mm_loadu_si128((const __m128i*)(pFrame0 + i));
+         __m128i vFrame1 = _mm_loadu_si128((const __m128i*)(pFrame1 + i));
+
+         __m128 vLow0 = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(vFrame0, vFrame0), 16));
+         __m128 vHigh0 = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(vFrame0, vFrame0), 16));
+         __m128 vLow1 = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(vFrame1, vFrame1), 16));
+         __m128 vHigh1 = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(vFrame1, vFrame1), 16));
+
+         _mm_storeu_ps(pOutput + i, _mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(vLow0, vScale0), _mm_mul_ps(vLow1, vScale1)), vBias));
+         _mm_storeu_ps(pOutput + i + 4, _mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(vHigh0, vScale0), _mm_mul_ps(vHigh1, vScale1)), vBias));
+      }
+   }
+#endif
+
+   for (; i < nCount; i++)
+   {
+      pOutput[i] = (float)pFrame0[i] * fScale0 + (float)pFrame1[i] * fScale1 + fBias;
+   }
+}
@@ -0,0 +1,81 @@
+// -------------------------------------------------------------------------
+// Sean Janis
+// spjanis@gmail.com
+// Water Simulations
+//
+// COceanFrameCache
+//       The spatial maps of every frame of one loop of a periodic ocean,
+//       kept in memory so that playback is a blend of two stored frames
+//       instead of a spectrum update and an inverse FFT.
+//
+//       Frames are stored as floats, or quantized to 16 bits per sample
+//       with a scale and bias per frame and field, which halves the memory
+//       and the bytes read per frame. The quantized samples are within
+//       half a step, (max - min) / 65534 / 2, of the floats, give or take
+//       the float rounding of the blend; GetMaxError() reports the largest
+//       such bound over the cache.
+// -------------------------------------------------------------------------
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+#include "AlignedBuffer.h"
+
+using namespace std;
+
+#define OCEAN_FRAME_CACHE_FLOAT       0
+#define OCEAN_FRAME_CACHE_INT16       1
+
+class COceanFrameCache
+{
+public:
+   COceanFrameCache();
+
+   // -------------------------------------------------------------------------
+   // Makes room for nFrames frames of nFields maps of nPoints samples each
+   // in one of the OCEAN_FRAME_CACHE_* formats. Returns false, and leaves
+   // the cache empty, if the memory cannot be allocated.
+   // -------------------------------------------------------------------------
+   bool Allocate(int nFrames, int nFields, int nPoints, int nFormat);
+   void Free();
+
+   int GetFrameCount() const;
+   int GetFieldCount() const;
+   int GetFormat() const;
+   size_t GetByteCount() const;
+   float GetMaxError() const;
+
+   // -------------------------------------------------------------------------
+   // Copies one field's map into frame nFrame, quantizing it if needed.
+   // -------------------------------------------------------------------------
+   void StoreField(int nFrame, int nField, const float* pMap);
+
+   // -------------------------------------------------------------------------
+   // Samples nBegin .. nBegin + nCount - 1 of a field, blended linearly
+   // from frame nFrame0 (fBlend = 0) to frame nFrame1 (fBlend = 1).
+   // -------------------------------------------------------------------------
+   void BlendField(
+      int nFrame0,
+      int nFrame1,
+      float fBlend,
+      int nField,
+      int nBegin,
+      int nCount,
+      float* pOutput) const;
+
+protected:
+   int m_nFrames;
+   int m_nFields;
+   int m_nPoints;
+   int m_nFormat;
+   int m_nSimdLevel;
+
+   CAlignedBuffer<float> m_Floats;
+   CAlignedBuffer<short> m_Quantized;
+
+   // -------------------------------------------------------------------------
+   // Sample = quantized * scale + bias, per frame and field.
+   // -------------------------------------------------------------------------
+   vector<float> m_Scales;
+   vector<float> m_Biases;
+};
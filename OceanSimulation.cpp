@@ -0,0 +1,1398 @@
+#include <math.h>
+#include <stdlib.h>
+#include "OceanSimulation.h"
+#include "CpuFeatures.h"
+
+#define PI                                      3.141593
+
+#if (defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))) || \
+    (defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__)))
+#include <xmmintrin.h>
+#define OCEAN_PREFETCH(p)                       _mm_prefetch((const char*)(p), _MM_HINT_T0)
+#else
+#define OCEAN_PREFETCH(p)
+#endif
+
+#define OCEAN_CACHE_LINE                        64
+
+// -------------------------------------------------------------------------
+// Philox stream of the initial spectrum's Gaussian draws.
+// -------------------------------------------------------------------------
+#define OCEAN_RANDOM_STREAM_SPECTRUM            0
+#define OCEAN_PREFETCH_ROWS                     4
+
+COceanSimulation::COceanSimulation()
+{
+   m_fXWindSpeed = 10.0f;
+   m_fZWindSpeed = 10.0f;
+   m_fPhillipsConstant = 0.00008f;
+   m_fGravityConstant = 2.0f;
+   m_fChoppiness = OCEAN_CHOPPINESS;
+   m_nSeed = OCEAN_SEED;
+   m_fFetch = OCEAN_FETCH;
+   m_fDepth = OCEAN_DEPTH;
+   m_fPeakEnhancement = OCEAN_PEAK_ENHANCEMENT;
+   m_fSpreadingExponent = OCEAN_COSINE_2S_EXPONENT;
+   m_fLoopPeriod = OCEAN_LOOP_PERIOD;
+
+   m_nSpectrumModel = OCEAN_SPECTRUM_PHILLIPS;
+   m_nSpreading = OCEAN_SPREADING_COSINE_SQUARED;
+   m_nSpectrumEvaluation = OCEAN_SPECTRUM_EVALUATION_ANALYTIC;
+   m_pSpectrumModel = CreateSpectrumModel(m_nSpectrumModel);
+   m_blPhillipsKernels = true;
+   m_nDirtyTables = OCEAN_DIRTY_ALL;
+   m_nFFTThreadCount = OCEAN_FFT_THREADS;
+
+   m_nFrameCacheFrames = OCEAN_FRAME_CACHE_FRAMES;
+   m_nFrameCacheFormat = OCEAN_FRAME_CACHE_FLOAT;
+   m_blFrameCacheValid = false;
+   m_nPlaybackFrame0 = 0;
+   m_nPlaybackFrame1 = 0;
+   m_fPlaybackBlend = 0.0f;
+
+   m_nEvolutionMode = OCEAN_EVOLUTION_INCREMENTAL;
+   m_blFusedTransform = true;
+   m_blPhasorsValid = false;
+   m_dPhasorTime = 0.0;
+   m_dPhasorStep = 0.0;
+   m_dPhasorBuildTime = 0.0;
+   m_dLastTime = 0.0;
+   m_dMeanStep = 0.0;
+   m_nResyncRow = 0;
+
+   m_nFFTWidth = OCEAN_FFT_SIZE;
+   m_nFFTHeight = OCEAN_FFT_SIZE;
+   m_nSpectrumHeight = m_nFFTHeight / 2 + 1;
+   m_blPlansValid = false;
+}
+
+COceanSimulation::~COceanSimulation()
+{
+   delete m_pSpectrumModel;
+}
+
+bool COceanSimulation::Init()
+{
+   // -------------------------------------------------------------------------
+   // Precompute the FFT tables for the Fourier grid size.
+   // -------------------------------------------------------------------------
+   if (!CreateFFTPlans(m_nFFTWidth, m_nFFTHeight))
+   {
+      return false;
+   }
+
+   // -------------------------------------------------------------------------
+   // Build a Fourier Height Map which will help us statistically compute
+   // height values at each H(X, T) position.
+   // -------------------------------------------------------------------------
+   if (!LoadInitialFourierHeightMap())
+   {
+      return false;
+   }
+
+   return true;
+}
+
+bool COceanSimulation::IsValid()
+{
+   return m_blPlansValid;
+}
+
+void COceanSimulation::Update(double dCurrentTime)
+{
+   if (!m_blPlansValid)
+   {
+      return;
+   }
+
+   // -------------------------------------------------------------------------
+   // Catch up with any parameter changes since the last frame.
+   // -------------------------------------------------------------------------
+   if (m_nDirtyTables != 0)
+   {
+      LoadInitialFourierHeightMap();
+   }
+
+   // -------------------------------------------------------------------------
+   // A looping ocean only ever needs the time within the loop, which keeps
+   // the phases small however long it runs. With a frame cache, play the
+   // loop back from memory, simulating it first if anything has changed.
+   // -------------------------------------------------------------------------
+   if (m_fLoopPeriod > 0.0f)
+   {
+      dCurrentTime = fmod(dCurrentTime, (double)m_fLoopPeriod);
+
+      if (dCurrentTime < 0.0)
+      {
+         dCurrentTime += m_fLoopPeriod;
+      }
+
+      if (m_nFrameCacheFrames > 0)
+      {
+         if (m_FrameCache.GetFieldCount() != GetActiveFieldCount())
+         {
+            m_blFrameCacheValid = false;
+         }
+
+         if (m_blFrameCacheValid || BuildFrameCache())
+         {
+            PlayFrameCache(dCurrentTime);
+            return;
+         }
+      }
+   }
+
+   // -------------------------------------------------------------------------
+   // Perform the Inverse Fast Fourier Transform to go from the Frequency
+   // domain to the Spatial Domain. This will give us our Wave Heights.
+   // -------------------------------------------------------------------------
+   UpdateFourierHeightMap(dCurrentTime);
+}
+
+bool COceanSimulation::CreateFFTPlans(int nWidth, int nHeight)
+{
+   m_blPlansValid = false;
+
+   if (!m_FFT2D.Init(nWidth, nHeight, OCEAN_FIELD_COUNT))
+   {
+      return false;
+   }
+
+   // -------------------------------------------------------------------------
+   // Scale the Height Map values down to the size of our grid as the row
+   // pass writes them. The other fields are linear in the heights and are
+   // scaled the same way.
+   // -------------------------------------------------------------------------
+   m_FFT2D.SetOutputScale(1.0f / 5.0f);
+   GetSpectrumKernels(GetSimdLevel(), m_SpectrumKernels);
+
+   // -------------------------------------------------------------------------
+   // Fourier and spatial maps for the new FFT size, zero-filled.
+   // -------------------------------------------------------------------------
+   int nBins = nHeight / 2 + 1;
+
+   if (!m_InitialHeightMap.Allocate(nWidth, nHeight) ||
+       !m_Gaussians.Allocate(nWidth, nHeight) ||
+       !m_KWaveVectorsX.Allocate(nWidth, nHeight) ||
+       !m_KWaveVectorsZ.Allocate(nWidth, nHeight) ||
+       !m_AngularFreqs.Allocate(nWidth, nHeight) ||
+       !m_SpectrumBins.h0Sum.Allocate(nWidth, nBins) ||
+       !m_SpectrumBins.h0Difference.Allocate(nWidth, nBins) ||
+       !m_SpectrumBins.kX.Allocate(nWidth, nBins) ||
+       !m_SpectrumBins.kZ.Allocate(nWidth, nBins) ||
+       !m_SpectrumBins.unitKX.Allocate(nWidth, nBins) ||
+       !m_SpectrumBins.unitKZ.Allocate(nWidth, nBins) ||
+       !m_SpectrumBins.phasor.Allocate(nWidth, nBins) ||
+       !m_SpectrumBins.phasorStep.Allocate(nWidth, nBins))
+   {
+      return false;
+   }
+
+   for (int f = 0; f < OCEAN_FIELD_COUNT; f++)
+   {
+      if (!m_VertexFieldMaps[f].Allocate(nWidth, nHeight, 1))
+      {
+         return false;
+      }
+
+      // -------------------------------------------------------------------------
+      // Only the unfused path stores the spectra; it allocates them when it
+      // first runs at this size.
+      // -------------------------------------------------------------------------
+      m_FourierFieldMaps[f].Free();
+   }
+
+   // -------------------------------------------------------------------------
+   // Without worker threads the transform still runs, on this thread only.
+   // -------------------------------------------------------------------------
+   m_ThreadPool.Init(m_nFFTThreadCount);
+   m_FFT2D.SetThreadPool(&m_ThreadPool);
+
+   m_nFFTWidth = nWidth;
+   m_nFFTHeight = nHeight;
+   m_nSpectrumHeight = nBins;
+   m_blPlansValid = true;
+   m_blPhasorsValid = false;
+   Invalidate(OCEAN_DIRTY_ALL);
+   return true;
+}
+
+void COceanSimulation::SetXWindSpeed(float fValue)
+{
+   if (fValue != m_fXWindSpeed)
+   {
+      m_fXWindSpeed = fValue;
+      Invalidate(OCEAN_DIRTY_AMPLITUDES);
+   }
+}
+
+float COceanSimulation::GetXWindSpeed()
+{
+   return m_fXWindSpeed;
+}
+
+void COceanSimulation::SetZWindSpeed(float fValue)
+{
+   if (fValue != m_fZWindSpeed)
+   {
+      m_fZWindSpeed = fValue;
+      Invalidate(OCEAN_DIRTY_AMPLITUDES);
+   }
+}
+
+float COceanSimulation::GetZWindSpeed()
+{
+   return m_fZWindSpeed;
+}
+
+void COceanSimulation::SetPhillipsConstant(float fValue)
+{
+   if (fValue != m_fPhillipsConstant)
+   {
+      m_fPhillipsConstant = fValue;
+      Invalidate(OCEAN_DIRTY_AMPLITUDES);
+   }
+}
+
+float COceanSimulation::GetPhillipsConstant()
+{
+   return m_fPhillipsConstant;
+}
+
+void COceanSimulation::SetGravityConstant(float fValue)
+{
+   if (fValue != m_fGravityConstant)
+   {
+      m_fGravityConstant = fValue;
+      Invalidate(OCEAN_DIRTY_DISPERSION | OCEAN_DIRTY_AMPLITUDES);
+   }
+}
+
+float COceanSimulation::GetGravityConstant()
+{
+   return m_fGravityConstant;
+}
+
+void COceanSimulation::SetChoppiness(float fValue)
+{
+   m_fChoppiness = fValue;
+}
+
+float COceanSimulation::GetChoppiness()
+{
+   return m_fChoppiness;
+}
+
+void COceanSimulation::SetSeed(unsigned int nSeed)
+{
+   if (nSeed != m_nSeed)
+   {
+      m_nSeed = nSeed;
+      Invalidate(OCEAN_DIRTY_GAUSSIANS);
+   }
+}
+
+unsigned int COceanSimulation::GetSeed()
+{
+   return m_nSeed;
+}
+
+bool COceanSimulation::SetSpectrumModel(int nModel)
+{
+   if (nModel == m_nSpectrumModel)
+   {
+      return true;
+   }
+
+   CSpectrumModel* pModel = CreateSpectrumModel(nModel);
+   if (pModel == NULL)
+   {
+      return false;
+   }
+
+   delete m_pSpectrumModel;
+   m_pSpectrumModel = pModel;
+   m_nSpectrumModel = nModel;
+   Invalidate(OCEAN_DIRTY_AMPLITUDES);
+   return true;
+}
+
+int COceanSimulation::GetSpectrumModel()
+{
+   return m_nSpectrumModel;
+}
+
+bool COceanSimulation::SetSpreading(int nSpreading)
+{
+   if (nSpreading < 0 || nSpreading >= OCEAN_SPREADING_COUNT)
+   {
+      return false;
+   }
+
+   if (nSpreading != m_nSpreading)
+   {
+      m_nSpreading = nSpreading;
+      Invalidate(OCEAN_DIRTY_AMPLITUDES);
+   }
+
+   return true;
+}
+
+int COceanSimulation::GetSpreading()
+{
+   return m_nSpreading;
+}
+
+bool COceanSimulation::SetSpectrumEvaluation(int nMode)
+{
+   if (nMode < 0 || nMode >= OCEAN_SPECTRUM_EVALUATION_COUNT)
+   {
+      return false;
+   }
+
+   if (nMode != m_nSpectrumEvaluation)
+   {
+      m_nSpectrumEvaluation = nMode;
+      Invalidate(OCEAN_DIRTY_AMPLITUDES);
+   }
+
+   return true;
+}
+
+int COceanSimulation::GetSpectrumEvaluation()
+{
+   return m_nSpectrumEvaluation;
+}
+
+void COceanSimulation::SetFetch(float fValue)
+{
+   if (fValue != m_fFetch)
+   {
+      m_fFetch = fValue;
+      Invalidate(OCEAN_DIRTY_AMPLITUDES);
+   }
+}
+
+float COceanSimulation::GetFetch()
+{
+   return m_fFetch;
+}
+
+void COceanSimulation::SetDepth(float fValue)
+{
+   if (fValue != m_fDepth)
+   {
+      m_fDepth = fValue;
+      Invalidate(OCEAN_DIRTY_AMPLITUDES);
+   }
+}
+
+float COceanSimulation::GetDepth()
+{
+   return m_fDepth;
+}
+
+void COceanSimulation::SetPeakEnhancement(float fValue)
+{
+   if (fValue != m_fPeakEnhancement)
+   {
+      m_fPeakEnhancement = fValue;
+      Invalidate(OCEAN_DIRTY_AMPLITUDES);
+   }
+}
+
+float COceanSimulation::GetPeakEnhancement()
+{
+   return m_fPeakEnhancement;
+}
+
+void COceanSimulation::SetSpreadingExponent(float fValue)
+{
+   if (fValue != m_fSpreadingExponent)
+   {
+      m_fSpreadingExponent = fValue;
+      Invalidate(OCEAN_DIRTY_AMPLITUDES);
+   }
+}
+
+float COceanSimulation::GetSpreadingExponent()
+{
+   return m_fSpreadingExponent;
+}
+
+void COceanSimulation::SetLoopPeriod(float fSeconds)
+{
+   if (fSeconds < 0.0f)
+   {
+      fSeconds = 0.0f;
+   }
+
+   if (fSeconds != m_fLoopPeriod)
+   {
+      m_fLoopPeriod = fSeconds;
+      Invalidate(OCEAN_DIRTY_DISPERSION);
+   }
+}
+
+float COceanSimulation::GetLoopPeriod()
+{
+   return m_fLoopPeriod;
+}
+
+void COceanSimulation::SetFrameCache(int nFrames, int nFormat)
+{
+   if (nFrames < 0)
+   {
+      nFrames = 0;
+   }
+
+   if (nFrames != m_nFrameCacheFrames || nFormat != m_nFrameCacheFormat)
+   {
+      m_nFrameCacheFrames = nFrames;
+      m_nFrameCacheFormat = nFormat;
+      m_blFrameCacheValid = false;
+      m_FrameCache.Free();
+   }
+}
+
+int COceanSimulation::GetFrameCacheFrames()
+{
+   return m_nFrameCacheFrames;
+}
+
+int COceanSimulation::GetFrameCacheFormat()
+{
+   return m_nFrameCacheFormat;
+}
+
+const COceanFrameCache& COceanSimulation::GetFrameCache()
+{
+   return m_FrameCache;
+}
+
+void COceanSimulation::SetFFTThreadCount(int nThreads)
+{
+   m_nFFTThreadCount = nThreads;
+
+   if (m_blPlansValid)
+   {
+      m_ThreadPool.Init(m_nFFTThreadCount);
+      m_FFT2D.SetThreadPool(&m_ThreadPool);
+   }
+}
+
+int COceanSimulation::GetFFTThreadCount()
+{
+   return m_ThreadPool.GetThreadCount();
+}
+
+CThreadPool& COceanSimulation::GetThreadPool()
+{
+   return m_ThreadPool;
+}
+
+void COceanSimulation::SetEvolutionMode(int nMode)
+{
+   m_nEvolutionMode = nMode;
+   m_blPhasorsValid = false;
+}
+
+int COceanSimulation::GetEvolutionMode()
+{
+   return m_nEvolutionMode;
+}
+
+void COceanSimulation::SetFusedTransform(bool blFused)
+{
+   m_blFusedTransform = blFused;
+}
+
+bool COceanSimulation::GetFusedTransform()
+{
+   return m_blFusedTransform;
+}
+
+bool COceanSimulation::SetFFTSize(int nSize)
+{
+   if (nSize < OCEAN_FFT_SIZE_MIN || 
+       nSize > OCEAN_FFT_SIZE_MAX)
+   {
+      return false;
+   }
+
+   // -------------------------------------------------------------------------
+   // Before Init() the size is only recorded; Init() builds everything.
+   // -------------------------------------------------------------------------
+   if (!m_blPlansValid)
+   {
+      m_nFFTWidth = nSize;
+      m_nFFTHeight = nSize;
+      m_nSpectrumHeight = m_nFFTHeight / 2 + 1;
+      return true;
+   }
+
+   if (CreateFFTPlans(nSize, nSize))
+   {
+      return LoadInitialFourierHeightMap();
+   }
+
+   // -------------------------------------------------------------------------
+   // The new size did not fit. The failed attempt has already replaced some
+   // of the plans and maps, so build them again at the size still in
+   // effect; the memory that size needed before is normally free again.
+   // -------------------------------------------------------------------------
+   if (CreateFFTPlans(m_nFFTWidth, m_nFFTHeight))
+   {
+      LoadInitialFourierHeightMap();
+   }
+
+   return false;
+}
+
+int COceanSimulation::GetFFTSize()
+{
+   return m_nFFTWidth;
+}
+
+CFFT2D& COceanSimulation::GetFFT()
+{
+   return m_FFT2D;
+}
+
+const float* COceanSimulation::GetField(int nField)
+{
+   return m_VertexFieldMaps[nField].GetData();
+}
+
+bool COceanSimulation::LoadInitialFourierHeightMap()
+{
+   // -------------------------------------------------------------------------
+   // Rebuild only the tables whose inputs changed, in dependency order.
+   // -------------------------------------------------------------------------
+   int nDirtyTables = m_nDirtyTables;
+   m_nDirtyTables = 0;
+
+   if (nDirtyTables & OCEAN_DIRTY_WAVE_VECTORS)
+   {
+      BuildWaveVectors();
+   }
+
+   if (nDirtyTables & OCEAN_DIRTY_GAUSSIANS)
+   {
+      BuildGaussians();
+   }
+
+   if (nDirtyTables & OCEAN_DIRTY_DISPERSION)
+   {
+      BuildDispersion();
+   }
+
+   if (nDirtyTables & OCEAN_DIRTY_AMPLITUDES)
+   {
+      BuildAmplitudes();
+   }
+
+   return true;
+}
+
+void COceanSimulation::Invalidate(int nTables)
+{
+   // -------------------------------------------------------------------------
+   // Everything downstream of a changed table changes with it.
+   // -------------------------------------------------------------------------
+   if (nTables & OCEAN_DIRTY_WAVE_VECTORS)
+   {
+      nTables |= OCEAN_DIRTY_DISPERSION | OCEAN_DIRTY_AMPLITUDES;
+   }
+
+   if (nTables & OCEAN_DIRTY_GAUSSIANS)
+   {
+      nTables |= OCEAN_DIRTY_AMPLITUDES;
+   }
+
+   m_nDirtyTables |= nTables;
+
+   // -------------------------------------------------------------------------
+   // Every cached frame depends on every table.
+   // -------------------------------------------------------------------------
+   m_blFrameCacheValid = false;
+}
+
+// -------------------------------------------------------------------------
+// Runs a table's row method over every row x on the thread pool. Rows are
+// independent within a table and write disjoint memory.
+// -------------------------------------------------------------------------
+class COceanSimulation::CTableRowTask : public CParallelTask
+{
+public:
+   CTableRowTask(COceanSimulation* pOcean, TableRowMethod pfnBuildRow)
+   {
+      m_pOcean = pOcean;
+      m_pfnBuildRow = pfnBuildRow;
+   }
+
+   virtual void Run(int nBegin, int nEnd, int nThread)
+   {
+      (void)nThread;
+
+      for (int x = nBegin; x < nEnd; x++)
+      {
+         (m_pOcean->*m_pfnBuildRow)(x);
+      }
+   }
+
+protected:
+   COceanSimulation* m_pOcean;
+   TableRowMethod m_pfnBuildRow;
+};
+
+void COceanSimulation::BuildTableRows(TableRowMethod pfnBuildRow)
+{
+   // -------------------------------------------------------------------------
+   // A few chunks per thread, as for the FFT's row pass.
+   // -------------------------------------------------------------------------
+   int nGrain = m_nFFTWidth / (m_ThreadPool.GetThreadCount() * 4);
+
+   if (nGrain < 1)
+   {
+      nGrain = 1;
+   }
+
+   CTableRowTask task(this, pfnBuildRow);
+   m_ThreadPool.ParallelFor(m_nFFTWidth, nGrain, &task);
+}
+
+void COceanSimulation::BuildWaveVectors()
+{
+   BuildTableRows(&COceanSimulation::BuildWaveVectorRow);
+}
+
+void COceanSimulation::BuildWaveVectorRow(int x)
+{
+   // -------------------------------------------------------------------------
+   // Only even sizes have a Nyquist bin.
+   // -------------------------------------------------------------------------
+   int nNyquistX = (m_nFFTWidth % 2 == 0) ? m_nFFTWidth / 2 : -1;
+   int nNyquistZ = (m_nFFTHeight % 2 == 0) ? m_nFFTHeight / 2 : -1;
+
+   for (int z = 0; z < m_nFFTHeight; z++)
+   {
+      // -------------------------------------------------------------------------
+      // At each iteration stage, generate a 2D component vector that will be used
+      // to calculate the Phillips Spectrum. Ensure that the vecKBounded's values
+      // are within the (-N/2 <= n < N/2) or (-M/2 <= m < M/2) constraints as
+      // specified by Tessendorf's paper. Odd sizes keep one more positive bin.
+      // -------------------------------------------------------------------------
+      int nX = (2 * x < m_nFFTWidth) ? x : x - m_nFFTWidth;
+      int nZ = (2 * z < m_nFFTHeight) ? z : z - m_nFFTHeight;
+
+      float fKX = (float)((2 * PI * nX) / m_nFFTWidth);
+      float fKZ = (float)((2 * PI * nZ) / m_nFFTHeight);
+
+      m_KWaveVectorsX.GetRow(x)[z] = fKX;
+      m_KWaveVectorsZ.GetRow(x)[z] = fKZ;
+
+      if (z >= m_nSpectrumHeight)
+      {
+         continue;
+      }
+
+      // -------------------------------------------------------------------------
+      // The Nyquist bins of a derivative have no real counterpart, so they
+      // are dropped along with k == 0.
+      // -------------------------------------------------------------------------
+      float fKLength = sqrt(fKX * fKX + fKZ * fKZ);
+
+      if (fKLength == 0.0f || x == nNyquistX || z == nNyquistZ)
+      {
+         m_SpectrumBins.kX.GetRow(x)[z] = 0.0f;
+         m_SpectrumBins.kZ.GetRow(x)[z] = 0.0f;
+         m_SpectrumBins.unitKX.GetRow(x)[z] = 0.0f;
+         m_SpectrumBins.unitKZ.GetRow(x)[z] = 0.0f;
+      }
+      else
+      {
+         m_SpectrumBins.kX.GetRow(x)[z] = fKX;
+         m_SpectrumBins.kZ.GetRow(x)[z] = fKZ;
+         m_SpectrumBins.unitKX.GetRow(x)[z] = fKX / fKLength;
+         m_SpectrumBins.unitKZ.GetRow(x)[z] = fKZ / fKLength;
+      }
+   }
+}
+
+void COceanSimulation::BuildGaussians()
+{
+   BuildTableRows(&COceanSimulation::BuildGaussianRow);
+}
+
+void COceanSimulation::BuildGaussianRow(int x)
+{
+   // -------------------------------------------------------------------------
+   // Generate Gaussian Random Numbers for the Phillips Spectrum formula. These
+   // Gaussian Random Numbers tend to follow the experimental data on ocean
+   // waves. They are kept, so a new sea state rescales the same ocean.
+   //
+   // The draws depend only on the seed and the wave numbers, see Philox.h.
+   // The row's wave numbers nZ run 0, 1, .. up to the middle and then on
+   // from -M/2, so each half is one run of consecutive counters.
+   // -------------------------------------------------------------------------
+   int nX = (2 * x < m_nFFTWidth) ? x : x - m_nFFTWidth;
+   int nPositive = (m_nFFTHeight + 1) / 2;
+   float* pReal = m_Gaussians.GetRealRow(x);
+   float* pImaginary = m_Gaussians.GetImaginaryRow(x);
+
+   m_SpectrumKernels.pfnGaussianRow(
+      m_nSeed, OCEAN_RANDOM_STREAM_SPECTRUM, nX, 0, nPositive, pReal, pImaginary);
+
+   m_SpectrumKernels.pfnGaussianRow(
+      m_nSeed,
+      OCEAN_RANDOM_STREAM_SPECTRUM,
+      nX,
+      nPositive - m_nFFTHeight,
+      m_nFFTHeight - nPositive,
+      pReal + nPositive,
+      pImaginary + nPositive);
+}
+
+void COceanSimulation::BuildDispersion()
+{
+   BuildTableRows(&COceanSimulation::BuildDispersionRow);
+
+   // -------------------------------------------------------------------------
+   // The phasors and their steps were built from the old frequencies.
+   // -------------------------------------------------------------------------
+   m_blPhasorsValid = false;
+   m_dPhasorStep = 0.0;
+}
+
+void COceanSimulation::BuildDispersionRow(int x)
+{
+   // -------------------------------------------------------------------------
+   // Deep water dispersion: each wave's angular frequency is sqrt(g * |k|).
+   // -------------------------------------------------------------------------
+   float* pAngularFreqs = m_AngularFreqs.GetRow(x);
+
+   m_SpectrumKernels.pfnDispersionRow(
+      m_KWaveVectorsX.GetRow(x), m_KWaveVectorsZ.GetRow(x), m_nFFTHeight, m_fGravityConstant, pAngularFreqs);
+
+   if (m_fLoopPeriod <= 0.0f)
+   {
+      return;
+   }
+
+   // -------------------------------------------------------------------------
+   // Looping: round to the nearest multiple of the loop's own frequency,
+   // keeping every moving wave moving.
+   // -------------------------------------------------------------------------
+   double dLoopFrequency = 2 * PI / m_fLoopPeriod;
+
+   for (int z = 0; z < m_nFFTHeight; z++)
+   {
+      if (pAngularFreqs[z] > 0.0f)
+      {
+         double dCycles = floor(pAngularFreqs[z] / dLoopFrequency + 0.5);
+         pAngularFreqs[z] = (float)(((dCycles < 1.0) ? 1.0 : dCycles) * dLoopFrequency);
+      }
+   }
+}
+
+void COceanSimulation::BuildAmplitudes()
+{
+   GetPhillipsParameters(m_PhillipsParameters);
+
+   // -------------------------------------------------------------------------
+   // The Phillips model with its own spreading has SIMD kernels. Any other
+   // model gets the sea state, and in the lookup mode is tabulated over the
+   // |k| of the grid, from one bin up to the corner bin.
+   // -------------------------------------------------------------------------
+   m_blPhillipsKernels =
+      m_nSpectrumModel == OCEAN_SPECTRUM_PHILLIPS &&
+      m_nSpreading == OCEAN_SPREADING_COSINE_SQUARED &&
+      m_nSpectrumEvaluation == OCEAN_SPECTRUM_EVALUATION_ANALYTIC;
+
+   if (!m_blPhillipsKernels)
+   {
+      OceanSeaState seaState;
+      GetSeaState(seaState);
+      m_pSpectrumModel->SetSeaState(seaState);
+
+      if (m_nSpectrumEvaluation == OCEAN_SPECTRUM_EVALUATION_LOOKUP)
+      {
+         int nLongest = (m_nFFTWidth > m_nFFTHeight) ? m_nFFTWidth : m_nFFTHeight;
+         float fKMin = (float)(2 * PI / nLongest);
+         float fKMax = (float)(PI * sqrt(2.0));
+
+         m_SpectrumLookup.Build(m_pSpectrumModel, fKMin, fKMax);
+      }
+   }
+
+   // -------------------------------------------------------------------------
+   // Build a Fourier Height Map which will help us statistically compute
+   // height values at each H(X, T) position. The bins pair each row with
+   // its mirror row, so they wait for the whole map.
+   // -------------------------------------------------------------------------
+   BuildTableRows(&COceanSimulation::BuildAmplitudeRow);
+   BuildTableRows(&COceanSimulation::BuildBinAmplitudeRow);
+}
+
+void COceanSimulation::BuildAmplitudeRow(int x)
+{
+   // -------------------------------------------------------------------------
+   // Calculate a wave spectrum based from Phillips Spectrum which is a useful
+   // model for wind-driven waves, and store the Results in the Fourier Height
+   // Map for later inverse transforms.
+   // -------------------------------------------------------------------------
+   const float* pKX = m_KWaveVectorsX.GetRow(x);
+   const float* pKZ = m_KWaveVectorsZ.GetRow(x);
+   const float* pGaussianReal = m_Gaussians.GetRealRow(x);
+   const float* pGaussianImaginary = m_Gaussians.GetImaginaryRow(x);
+   float* pH0Real = m_InitialHeightMap.GetRealRow(x);
+   float* pH0Imaginary = m_InitialHeightMap.GetImaginaryRow(x);
+
+   if (m_blPhillipsKernels)
+   {
+      m_SpectrumKernels.pfnAmplitudeRow(
+         pKX, pKZ, pGaussianReal, pGaussianImaginary, m_nFFTHeight, m_PhillipsParameters, pH0Real, pH0Imaginary);
+   }
+   else if (m_nSpectrumEvaluation == OCEAN_SPECTRUM_EVALUATION_LOOKUP)
+   {
+      m_SpectrumLookup.GetAmplitudeRow(
+         pKX,
+         pKZ,
+         pGaussianReal,
+         pGaussianImaginary,
+         m_nFFTHeight,
+         m_PhillipsParameters.fAmplitudeScale,
+         pH0Real,
+         pH0Imaginary);
+   }
+   else
+   {
+      float fAmplitudeScale = m_PhillipsParameters.fAmplitudeScale;
+
+      for (int z = 0; z < m_nFFTHeight; z++)
+      {
+         KWaveVector k;
+         k.fX = pKX[z];
+         k.fZ = pKZ[z];
+
+         float fRootSpectrum = (float)sqrt(m_pSpectrumModel->GetSpectrum(k));
+         pH0Real[z] = fAmplitudeScale * pGaussianReal[z] * fRootSpectrum;
+         pH0Imaginary[z] = fAmplitudeScale * pGaussianImaginary[z] * fRootSpectrum;
+      }
+   }
+}
+
+void COceanSimulation::BuildBinAmplitudeRow(int x)
+{
+   // -------------------------------------------------------------------------
+   // The evolution reads h0(k) and h0(-k) combined, per stored bin. The
+   // index of -k wraps so that bin 0 maps onto itself.
+   // -------------------------------------------------------------------------
+   int nNegX = (m_nFFTWidth - x) % m_nFFTWidth;
+
+   const float* pH0Real = m_InitialHeightMap.GetRealRow(x);
+   const float* pH0Imaginary = m_InitialHeightMap.GetImaginaryRow(x);
+   const float* pH0NegReal = m_InitialHeightMap.GetRealRow(nNegX);
+   const float* pH0NegImaginary = m_InitialHeightMap.GetImaginaryRow(nNegX);
+
+   float* pSumReal = m_SpectrumBins.h0Sum.GetRealRow(x);
+   float* pSumImaginary = m_SpectrumBins.h0Sum.GetImaginaryRow(x);
+   float* pDifferenceReal = m_SpectrumBins.h0Difference.GetRealRow(x);
+   float* pDifferenceImaginary = m_SpectrumBins.h0Difference.GetImaginaryRow(x);
+
+   for (int z = 0; z < m_nSpectrumHeight; z++)
+   {
+      int nNegZ = (m_nFFTHeight - z) % m_nFFTHeight;
+
+      pSumReal[z] = pH0Real[z] + pH0NegReal[nNegZ];
+      pSumImaginary[z] = pH0Imaginary[z] + pH0NegImaginary[nNegZ];
+      pDifferenceReal[z] = pH0Real[z] - pH0NegReal[nNegZ];
+      pDifferenceImaginary[z] = pH0Imaginary[z] - pH0NegImaginary[nNegZ];
+   }
+}
+
+bool COceanSimulation::BuildFrameCache()
+{
+   int nFields = GetActiveFieldCount();
+
+   if (!m_FrameCache.Allocate(m_nFrameCacheFrames, nFields, m_nFFTWidth * m_nFFTHeight, m_nFrameCacheFormat))
+   {
+      return false;
+   }
+
+   // -------------------------------------------------------------------------
+   // Frame i is the ocean at i / frames of the way through the loop. The
+   // frames are evenly spaced, so after the first the phasors step there.
+   // -------------------------------------------------------------------------
+   for (int i = 0; i < m_nFrameCacheFrames; i++)
+   {
+      UpdateFourierHeightMap((double)m_fLoopPeriod * i / m_nFrameCacheFrames);
+
+      for (int f = 0; f < nFields; f++)
+      {
+         m_FrameCache.StoreField(i, f, m_VertexFieldMaps[f].GetData());
+      }
+   }
+
+   m_blFrameCacheValid = true;
+   return true;
+}
+
+void COceanSimulation::PlayFrameCache(double dLoopTime)
+{
+   // -------------------------------------------------------------------------
+   // The loop closes on itself, so the frame after the last is frame 0.
+   // -------------------------------------------------------------------------
+   double dPosition = dLoopTime / m_fLoopPeriod * m_nFrameCacheFrames;
+   int nFrame = (int)floor(dPosition);
+
+   m_fPlaybackBlend = (float)(dPosition - nFrame);
+   m_nPlaybackFrame0 = nFrame % m_nFrameCacheFrames;
+   m_nPlaybackFrame1 = (m_nPlaybackFrame0 + 1) % m_nFrameCacheFrames;
+
+   BuildTableRows(&COceanSimulation::PlayFrameCacheRow);
+}
+
+void COceanSimulation::PlayFrameCacheRow(int x)
+{
+   int nBegin = x * m_nFFTHeight;
+
+   for (int f = 0; f < m_FrameCache.GetFieldCount(); f++)
+   {
+      m_FrameCache.BlendField(
+         m_nPlaybackFrame0,
+         m_nPlaybackFrame1,
+         m_fPlaybackBlend,
+         f,
+         nBegin,
+         m_nFFTHeight,
+         m_VertexFieldMaps[f].GetRow(x));
+   }
+}
+
+// -------------------------------------------------------------------------
+// Hands the evolved spectrum to the column pass a block at a time, so it
+// goes straight into the FFT tiles without being stored.
+// -------------------------------------------------------------------------
+class COceanSimulation::CEvolutionSource : public CFFT2DSource
+{
+public:
+   CEvolutionSource(COceanSimulation* pOcean, bool blAdvancePhasors, bool blChoppy)
+   {
+      m_pOcean = pOcean;
+      m_blAdvancePhasors = blAdvancePhasors;
+      m_blChoppy = blChoppy;
+   }
+
+   virtual void GetBins(int x, int z0, int nColumns, float* const* ppReal, float* const* ppImaginary)
+   {
+      m_pOcean->EvolveBins(x, z0, nColumns, m_blAdvancePhasors, m_blChoppy, ppReal, ppImaginary);
+   }
+
+protected:
+   COceanSimulation* m_pOcean;
+   bool m_blAdvancePhasors;
+   bool m_blChoppy;
+};
+
+void COceanSimulation::UpdateFourierHeightMap(double dCurrentTime)
+{
+   // -------------------------------------------------------------------------
+   // Given a set of angular frequencies, perform the inverse Fast Fourier 
+   // animation by iterating over the h0 Height Map. Only the non-redundant
+   // half of the spectrum (z <= HEIGHT/2) is evaluated.
+   // -------------------------------------------------------------------------
+   bool blChoppy = (GetActiveFieldCount() > OCEAN_FIELD_DISPLACEMENT_X);
+   bool blAdvancePhasors = PreparePhasors(dCurrentTime);
+
+   if (m_blFusedTransform)
+   {
+      CEvolutionSource source(this, blAdvancePhasors, blChoppy);
+      float* apOutputs[OCEAN_FIELD_COUNT];
+
+      for (int f = 0; f < OCEAN_FIELD_COUNT; f++)
+      {
+         apOutputs[f] = m_VertexFieldMaps[f].GetData();
+      }
+
+      m_FFT2D.InverseRealSource(GetActiveFieldCount(), &source, apOutputs, m_VertexFieldMaps[0].GetPitch());
+      return;
+   }
+
+   // -------------------------------------------------------------------------
+   // Unfused: evolve every row straight into the stored spectra, then
+   // transform them.
+   // -------------------------------------------------------------------------
+   for (int f = 0; f < OCEAN_FIELD_COUNT; f++)
+   {
+      if ((m_FourierFieldMaps[f].GetRows() != m_nFFTWidth || m_FourierFieldMaps[f].GetColumns() != m_nSpectrumHeight) &&
+          !m_FourierFieldMaps[f].Allocate(m_nFFTWidth, m_nSpectrumHeight))
+      {
+         return;
+      }
+   }
+
+   float* apRowReal[OCEAN_FIELD_COUNT];
+   float* apRowImaginary[OCEAN_FIELD_COUNT];
+
+   for (int x = 0; x < m_nFFTWidth; x++)
+   {
+      for (int f = 0; f < OCEAN_FIELD_COUNT; f++)
+      {
+         apRowReal[f] = m_FourierFieldMaps[f].GetRealRow(x);
+         apRowImaginary[f] = m_FourierFieldMaps[f].GetImaginaryRow(x);
+      }
+
+      EvolveBins(x, 0, m_nSpectrumHeight, blAdvancePhasors, blChoppy, apRowReal, apRowImaginary);
+   }
+
+   // -------------------------------------------------------------------------
+   // Perform an inverse Fourier Transform to get height map values.
+   // -------------------------------------------------------------------------
+   FFT2D();
+}
+
+void COceanSimulation::EvolveBins(int x,
+                                  int z0,
+                                  int nColumns,
+                                  bool blAdvancePhasors,
+                                  bool blChoppy,
+                                  float* const* ppReal,
+                                  float* const* ppImaginary)
+{
+   OceanSpectrumBins& bins = m_SpectrumBins;
+   SpectrumEvolutionRow row;
+
+   row.pH0SumReal = bins.h0Sum.GetRealRow(x) + z0;
+   row.pH0SumImaginary = bins.h0Sum.GetImaginaryRow(x) + z0;
+   row.pH0DifferenceReal = bins.h0Difference.GetRealRow(x) + z0;
+   row.pH0DifferenceImaginary = bins.h0Difference.GetImaginaryRow(x) + z0;
+   row.pKX = bins.kX.GetRow(x) + z0;
+   row.pKZ = bins.kZ.GetRow(x) + z0;
+   row.pUnitKX = bins.unitKX.GetRow(x) + z0;
+   row.pUnitKZ = bins.unitKZ.GetRow(x) + z0;
+   row.pPhasorReal = bins.phasor.GetRealRow(x) + z0;
+   row.pPhasorImaginary = bins.phasor.GetImaginaryRow(x) + z0;
+   row.pPhasorStepReal = bins.phasorStep.GetRealRow(x) + z0;
+   row.pPhasorStepImaginary = bins.phasorStep.GetImaginaryRow(x) + z0;
+
+   // -------------------------------------------------------------------------
+   // The column pass asks for the same few bins of row after row. Rows are
+   // further apart than the hardware prefetchers follow, so fetch the bins
+   // of a row a few calls ahead, from every field the row reads. All of
+   // them share one pitch.
+   // -------------------------------------------------------------------------
+   if (nColumns < m_nSpectrumHeight && x + OCEAN_PREFETCH_ROWS < m_nFFTWidth)
+   {
+      const float* apAhead[] =
+      {
+         row.pH0SumReal, row.pH0SumImaginary, row.pH0DifferenceReal, row.pH0DifferenceImaginary,
+         row.pKX, row.pKZ, row.pUnitKX, row.pUnitKZ,
+         row.pPhasorReal, row.pPhasorImaginary, row.pPhasorStepReal, row.pPhasorStepImaginary
+      };
+      int nAhead = OCEAN_PREFETCH_ROWS * bins.kX.GetPitch();
+      int nBytes = nColumns * (int)sizeof(float);
+
+      for (int i = 0; i < (int)(sizeof(apAhead) / sizeof(apAhead[0])); i++)
+      {
+         const char* pAhead = (const char*)(apAhead[i] + nAhead);
+
+         for (int nOffset = 0; nOffset < nBytes; nOffset += OCEAN_CACHE_LINE)
+         {
+            OCEAN_PREFETCH(pAhead + nOffset);
+         }
+      }
+   }
+
+   m_SpectrumKernels.pfnEvolveRow(row, nColumns, blAdvancePhasors, blChoppy, ppReal, ppImaginary);
+}
+
+bool COceanSimulation::PreparePhasors(double dCurrentTime)
+{
+   double dStep = dCurrentTime - m_dPhasorTime;
+   double dFrameStep = dCurrentTime - m_dLastTime;
+
+   // -------------------------------------------------------------------------
+   // Start over from the absolute phases when there is nothing to step
+   // from, or when the time jumped.
+   // -------------------------------------------------------------------------
+   if (m_nEvolutionMode == OCEAN_EVOLUTION_ABSOLUTE ||
+       !m_blPhasorsValid ||
+       dStep < 0.0 ||
+       dStep > OCEAN_PHASOR_MAX_STEP ||
+       dFrameStep < 0.0)
+   {
+      SetAbsolutePhasors(dCurrentTime);
+      return false;
+   }
+
+   if (dFrameStep == 0.0)
+   {
+      return false;
+   }
+
+   m_dLastTime = dCurrentTime;
+
+   // -------------------------------------------------------------------------
+   // Average the frame times, each held near the average so a hitch moves
+   // it only a little, and rebuild the step table when the average has
+   // moved away from it: when the frame rate changes, not when it jitters.
+   // -------------------------------------------------------------------------
+   if (m_dPhasorStep <= 0.0)
+   {
+      m_dMeanStep = dFrameStep;
+      BuildPhasorSteps(dFrameStep);
+   }
+   else
+   {
+      double dLow = m_dMeanStep * (1.0 - OCEAN_PHASOR_STEP_CLAMP);
+      double dHigh = m_dMeanStep * (1.0 + OCEAN_PHASOR_STEP_CLAMP);
+      double dSample = (dFrameStep < dLow) ? dLow : ((dFrameStep > dHigh) ? dHigh : dFrameStep);
+
+      m_dMeanStep += (dSample - m_dMeanStep) * OCEAN_PHASOR_STEP_SMOOTHING;
+
+      if (fabs(m_dMeanStep - m_dPhasorStep) > m_dPhasorStep * OCEAN_PHASOR_STEP_TOLERANCE)
+      {
+         BuildPhasorSteps(m_dMeanStep);
+      }
+   }
+
+   // -------------------------------------------------------------------------
+   // The phasors advance by the table's step whatever the frame took, so
+   // they lag or lead the real time by what the frames have added up to.
+   // That only delays the whole ocean. Half a step behind, they take an
+   // extra step; half a step ahead, they wait a frame; and past
+   // OCEAN_PHASOR_MAX_LAG steps, after a hitch, they start over.
+   // -------------------------------------------------------------------------
+   double dLag = dCurrentTime - (m_dPhasorTime + m_dPhasorStep);
+
+   if (fabs(dLag) > m_dPhasorStep * OCEAN_PHASOR_MAX_LAG)
+   {
+      SetAbsolutePhasors(dCurrentTime);
+      return false;
+   }
+
+   if (dLag < -0.5 * m_dPhasorStep)
+   {
+      return false;
+   }
+
+   ResyncPhasorRows();
+
+   if (dLag > 0.5 * m_dPhasorStep)
+   {
+      BuildTableRows(&COceanSimulation::AdvancePhasorRow);
+      m_dPhasorTime += m_dPhasorStep;
+   }
+
+   m_dPhasorTime += m_dPhasorStep;
+   return true;
+}
+
+void COceanSimulation::SetAbsolutePhasors(double dCurrentTime)
+{
+   m_dPhasorBuildTime = dCurrentTime;
+   BuildTableRows(&COceanSimulation::SetAbsolutePhasorRow);
+
+   m_blPhasorsValid = true;
+   m_dPhasorTime = dCurrentTime;
+   m_dLastTime = dCurrentTime;
+}
+
+void COceanSimulation::SetAbsolutePhasorRow(int x)
+{
+   // -------------------------------------------------------------------------
+   // The phase is reduced in double precision, so it stays accurate however
+   // large the time grows.
+   // -------------------------------------------------------------------------
+   double dTwoPi = 2.0 * PI;
+   const float* pAngularFreqs = m_AngularFreqs.GetRow(x);
+   float* pReal = m_SpectrumBins.phasor.GetRealRow(x);
+   float* pImaginary = m_SpectrumBins.phasor.GetImaginaryRow(x);
+
+   for (int z = 0; z < m_nSpectrumHeight; z++)
+   {
+      double dPhase = fmod((double)pAngularFreqs[z] * m_dPhasorBuildTime, dTwoPi);
+
+      pReal[z] = (float)cos(dPhase);
+      pImaginary[z] = (float)sin(dPhase);
+   }
+}
+
+void COceanSimulation::BuildPhasorSteps(double dStep)
+{
+   m_dPhasorBuildTime = dStep;
+   BuildTableRows(&COceanSimulation::BuildPhasorStepRow);
+   m_dPhasorStep = dStep;
+}
+
+void COceanSimulation::BuildPhasorStepRow(int x)
+{
+   const float* pAngularFreqs = m_AngularFreqs.GetRow(x);
+   float* pReal = m_SpectrumBins.phasorStep.GetRealRow(x);
+   float* pImaginary = m_SpectrumBins.phasorStep.GetImaginaryRow(x);
+
+   for (int z = 0; z < m_nSpectrumHeight; z++)
+   {
+      double dPhase = (double)pAngularFreqs[z] * m_dPhasorBuildTime;
+
+      pReal[z] = (float)cos(dPhase);
+      pImaginary[z] = (float)sin(dPhase);
+   }
+}
+
+void COceanSimulation::AdvancePhasorRow(int x)
+{
+   float* pReal = m_SpectrumBins.phasor.GetRealRow(x);
+   float* pImaginary = m_SpectrumBins.phasor.GetImaginaryRow(x);
+   const float* pStepReal = m_SpectrumBins.phasorStep.GetRealRow(x);
+   const float* pStepImaginary = m_SpectrumBins.phasorStep.GetImaginaryRow(x);
+
+   for (int z = 0; z < m_nSpectrumHeight; z++)
+   {
+      float fReal = pReal[z] * pStepReal[z] - pImaginary[z] * pStepImaginary[z];
+      float fImaginary = pReal[z] * pStepImaginary[z] + pImaginary[z] * pStepReal[z];
+
+      pReal[z] = fReal;
+      pImaginary[z] = fImaginary;
+   }
+}
+
+void COceanSimulation::ResyncPhasorRows()
+{
+   // -------------------------------------------------------------------------
+   // Reset the next few rows to their absolute phases at the phasor time,
+   // before this frame's step, so every row is exact again once every
+   // OCEAN_PHASOR_RESYNC_FRAMES frames. A couple of rows a frame is too
+   // little work to share out.
+   // -------------------------------------------------------------------------
+   int nRows = (m_nFFTWidth + OCEAN_PHASOR_RESYNC_FRAMES - 1) / OCEAN_PHASOR_RESYNC_FRAMES;
+
+   m_dPhasorBuildTime = m_dPhasorTime;
+
+   for (int r = 0; r < nRows; r++)
+   {
+      if (m_nResyncRow >= m_nFFTWidth)
+      {
+         m_nResyncRow = 0;
+      }
+
+      SetAbsolutePhasorRow(m_nResyncRow++);
+   }
+}
+
+bool COceanSimulation::FFT2D()
+{
+   // -------------------------------------------------------------------------
+   // Column pass along x over the stored half spectra, then a
+   // complex-to-real pass along each row straight into the spatial maps.
+   // All active fields go through both passes together.
+   // -------------------------------------------------------------------------
+   const float* apSpectraReal[OCEAN_FIELD_COUNT];
+   const float* apSpectraImaginary[OCEAN_FIELD_COUNT];
+   float* apOutputs[OCEAN_FIELD_COUNT];
+
+   for (int f = 0; f < OCEAN_FIELD_COUNT; f++)
+   {
+      apSpectraReal[f] = m_FourierFieldMaps[f].GetReal();
+      apSpectraImaginary[f] = m_FourierFieldMaps[f].GetImaginary();
+      apOutputs[f] = m_VertexFieldMaps[f].GetData();
+   }
+
+   if (!m_FFT2D.InverseRealFields(
+      GetActiveFieldCount(),
+      apSpectraReal,
+      apSpectraImaginary,
+      m_FourierFieldMaps[0].GetPitch(),
+      apOutputs,
+      m_VertexFieldMaps[0].GetPitch()))
+   {
+      return false;
+   }
+
+   return true;
+}
+
+int COceanSimulation::GetActiveFieldCount()
+{
+   // -------------------------------------------------------------------------
+   // The displacement fields come last so they can simply be left off.
+   // -------------------------------------------------------------------------
+   if (m_fChoppiness == 0.0f)
+   {
+      return OCEAN_FIELD_DISPLACEMENT_X;
+   }
+
+   return OCEAN_FIELD_COUNT;
+}
+
+float COceanSimulation::SampleField(int nField, float fX, float fZ)
+{
+   return SampleMap(m_VertexFieldMaps[nField].GetData(), m_nFFTWidth, m_nFFTHeight, fX, fZ);
+}
+
+float COceanSimulation::SampleMap(const float* pMap, int nWidth, int nHeight, float fX, float fZ)
+{
+   // -------------------------------------------------------------------------
+   // Bilinear filter of a spatial map at a fractional (x, z) sample
+   // position. The FFT result is periodic, so samples past the last row or
+   // column wrap around to the first.
+   // -------------------------------------------------------------------------
+   int nX0 = (int)fX;
+   int nZ0 = (int)fZ;
+   float fTX = fX - (float)nX0;
+   float fTZ = fZ - (float)nZ0;
+
+   nX0 %= nWidth;
+   nZ0 %= nHeight;
+   int nX1 = (nX0 + 1) % nWidth;
+   int nZ1 = (nZ0 + 1) % nHeight;
+
+   const float* pRow0 = &pMap[nX0 * nHeight];
+   const float* pRow1 = &pMap[nX1 * nHeight];
+
+   float fHeight0 = pRow0[nZ0] + (pRow0[nZ1] - pRow0[nZ0]) * fTZ;
+   float fHeight1 = pRow1[nZ0] + (pRow1[nZ1] - pRow1[nZ0]) * fTZ;
+
+   return fHeight0 + (fHeight1 - fHeight0) * fTX;
+}
+
+void COceanSimulation::GetPhillipsParameters(PhillipsParameters& parameters)
+{
+   // -------------------------------------------------------------------------
+   // Wind Direction
+   // -------------------------------------------------------------------------
+   parameters.fWindX = m_fXWindSpeed;
+   parameters.fWindZ = m_fZWindSpeed;
+
+   // -------------------------------------------------------------------------
+   // Represents the largest possible waves arising from a continuous wind of
+   // speed V.
+   // -------------------------------------------------------------------------
+   parameters.fWindspeedGravity = (
+      (m_fXWindSpeed * m_fXWindSpeed) + 
+      (m_fZWindSpeed * m_fZWindSpeed)) / m_fGravityConstant;
+
+   parameters.fPhillipsConstant = m_fPhillipsConstant;
+   parameters.fAmplitudeScale = (float)1 / (float)sqrt((float)2);
+}
+
+void COceanSimulation::GetSeaState(OceanSeaState& seaState)
+{
+   seaState.fWindX = m_fXWindSpeed;
+   seaState.fWindZ = m_fZWindSpeed;
+   seaState.fGravity = m_fGravityConstant;
+   seaState.fPhillipsConstant = m_fPhillipsConstant;
+   seaState.fFetch = m_fFetch;
+   seaState.fDepth = m_fDepth;
+   seaState.fPeakEnhancement = m_fPeakEnhancement;
+   seaState.nSpreading = m_nSpreading;
+   seaState.fSpreadingExponent = m_fSpreadingExponent;
+
+   // -------------------------------------------------------------------------
+   // The grid spans m_nFFTWidth by m_nFFTHeight samples, so its bins are
+   // 2 PI / size apart.
+   // -------------------------------------------------------------------------
+   seaState.fBinArea = (float)((2 * PI / m_nFFTWidth) * (2 * PI / m_nFFTHeight));
+}
@@ -0,0 +1,511 @@
+// -------------------------------------------------------------------------
+// Sean Janis
+// spjanis@gmail.com
+// Water Simulations
+//
+// COceanSimulation
+//       The statistical ocean model on its own, with no Direct3D dependency.
+//       It builds the initial Phillips spectrum, evolves it to a given time
+//       and inverse transforms the height, slope and displacement fields to
+//       spatial maps. CWaterSurface samples those maps onto its render grid,
+//       and the headless benchmarks drive it directly.
+// -------------------------------------------------------------------------
+#pragma once
+
+#include <vector>
+#include "KWaveVector.h"
+#include "FFT2D.h"
+#include "SpectrumKernels.h"
+#include "SpectrumModel.h"
+#include "OceanFrameCache.h"
+#include "ThreadPool.h"
+#include "Field2D.h"
+
+using namespace std;
+
+#define OCEAN_FFT_SIZE                64
+#define OCEAN_FFT_SIZE_MIN            16
+#define OCEAN_FFT_SIZE_MAX            2048
+
+// -------------------------------------------------------------------------
+// Threads used for the inverse FFT, counting the calling thread. 0 means
+// one per hardware thread.
+// -------------------------------------------------------------------------
+#define OCEAN_FFT_THREADS             0
+
+// -------------------------------------------------------------------------
+// Fields transformed every frame. X and Z name the FFT axes: x runs down
+// the grid rows (world -z) and z along the columns (world +x). Slopes are
+// per FFT sample; displacements are in height units. The displacement
+// fields are only transformed while the choppiness is non-zero.
+// -------------------------------------------------------------------------
+#define OCEAN_FIELD_HEIGHT            0
+#define OCEAN_FIELD_SLOPE_X           1
+#define OCEAN_FIELD_SLOPE_Z           2
+#define OCEAN_FIELD_DISPLACEMENT_X    3
+#define OCEAN_FIELD_DISPLACEMENT_Z    4
+#define OCEAN_FIELD_COUNT             5
+
+#define OCEAN_CHOPPINESS              1.0f
+
+// -------------------------------------------------------------------------
+// Sea state of the physical spectrum models, see SpectrumModel.h: the
+// fetch and depth in FFT samples, the JONSWAP peak enhancement and the
+// exponent of the cosine 2s spreading.
+// -------------------------------------------------------------------------
+#define OCEAN_FETCH                   10000.0f
+#define OCEAN_DEPTH                   20.0f
+#define OCEAN_PEAK_ENHANCEMENT        3.3f
+#define OCEAN_COSINE_2S_EXPONENT      8.0f
+
+// -------------------------------------------------------------------------
+// How h0(k) is evaluated from the spectrum model. The analytic mode calls
+// the model for every bin, except for the Phillips model with its own
+// cosine squared spreading, which has SIMD kernels. The lookup mode
+// tabulates the model once per sea state and interpolates every bin from
+// the tables, which makes changing the sea state much cheaper for the
+// physical models. The interpolated spectrum is within about 1e-3 of the
+// analytic one, measured as the error in each bin's variance summed over
+// the grid, relative to the total variance.
+// -------------------------------------------------------------------------
+#define OCEAN_SPECTRUM_EVALUATION_ANALYTIC   0
+#define OCEAN_SPECTRUM_EVALUATION_LOOKUP     1
+#define OCEAN_SPECTRUM_EVALUATION_COUNT      2
+
+// -------------------------------------------------------------------------
+// The spectrum's random numbers are a pure function of the seed and each
+// bin's wave numbers, see Philox.h, so a seed reproduces the same ocean on
+// every machine. A wave keeps its draw when the FFT size changes.
+// -------------------------------------------------------------------------
+#define OCEAN_SEED                    0x5EA5EEDu
+
+// -------------------------------------------------------------------------
+// A looping ocean rounds every w(k) to a multiple of 2 PI / T, at least one
+// for k != 0, so that each wave runs a whole number of cycles per period T
+// and the surface repeats exactly. The rounding moves each w(k) by up to
+// PI / T, which only the longest, slowest waves notice unless T is short.
+// 0, the default, turns looping off.
+//
+// One loop can then be cached: OCEAN_FRAME_CACHE_FRAMES evenly spaced
+// frames are simulated once and the spatial maps are blended linearly from
+// the two nearest of them on each Update(). The blend is only close to the
+// simulated surface while the frames are well under a period of the
+// fastest wave apart, about two seconds at the default gravity; with an
+// eighth of that period between frames its error is about 8% of the
+// fastest waves' height. The cache costs frames times fields times the
+// FFT size squared samples, so it suits the smaller FFT sizes, and is
+// rebuilt whenever a parameter changes.
+// -------------------------------------------------------------------------
+#define OCEAN_LOOP_PERIOD             0.0f
+#define OCEAN_FRAME_CACHE_FRAMES      0
+
+// -------------------------------------------------------------------------
+// Tables derived from the parameters. A setter marks only the tables its
+// parameter feeds, and everything downstream of them; the marked tables
+// are rebuilt together on the next Update(), so several changes in one
+// frame cost one rebuild:
+//
+//    FFT size -> k -> w(k) and amplitudes
+//    seed     -> Gaussian draws -> amplitudes
+//    gravity  -> w(k) and amplitudes (L = V^2 / g)
+//    loop period -> w(k)
+//    wind, A, the spectrum model and its sea state -> amplitudes
+//
+// The amplitudes are h0(k), the spectrum model applied to the cached
+// draws. The phasors survive everything but a change of w(k).
+// -------------------------------------------------------------------------
+#define OCEAN_DIRTY_WAVE_VECTORS      0x01
+#define OCEAN_DIRTY_GAUSSIANS         0x02
+#define OCEAN_DIRTY_DISPERSION        0x04
+#define OCEAN_DIRTY_AMPLITUDES        0x08
+#define OCEAN_DIRTY_ALL               0x0F
+
+// -------------------------------------------------------------------------
+// How the spectrum phases exp{i*w(k)*t} are found each frame. The absolute
+// mode evaluates sin and cos of w(k)*t for every bin. The incremental mode
+// keeps one phasor per bin and multiplies it by exp{i*w(k)*dt}, so the
+// per-frame loop has no transcendental calls.
+//
+// The step table is built for a nominal dt, a running average of the
+// frame times with each sample weighted OCEAN_PHASOR_STEP_SMOOTHING and
+// held within OCEAN_PHASOR_STEP_CLAMP of the average, so frame time jitter
+// and single hitches leave it alone. It is rebuilt only when the average
+// moves by more than OCEAN_PHASOR_STEP_TOLERANCE of the table's step.
+// Stepping by the nominal dt lets the phasors lag the real time; the lag
+// is the same for every bin, so the ocean is exact, only slightly late.
+// Half a step behind the phasors take one extra step, with no sin or cos,
+// and half a step ahead they skip one, which keeps the lag within half a
+// frame. Past OCEAN_PHASOR_MAX_LAG steps the phasors are set from the
+// absolute phases at the real time, as they are for steps longer than
+// OCEAN_PHASOR_MAX_STEP seconds or backwards in time.
+//
+// Rounding in the multiplies drifts both the length and the phase of each
+// phasor, so a few rows a frame are also reset to their absolute phases,
+// each row once every OCEAN_PHASOR_RESYNC_FRAMES frames, which keeps the
+// error bounded however long the ocean runs.
+// -------------------------------------------------------------------------
+#define OCEAN_EVOLUTION_ABSOLUTE          0
+#define OCEAN_EVOLUTION_INCREMENTAL       1
+
+#define OCEAN_PHASOR_STEP_SMOOTHING       0.0625
+#define OCEAN_PHASOR_STEP_CLAMP           0.25
+#define OCEAN_PHASOR_STEP_TOLERANCE       0.05
+#define OCEAN_PHASOR_MAX_LAG              2.0
+#define OCEAN_PHASOR_MAX_STEP             0.25
+#define OCEAN_PHASOR_RESYNC_FRAMES        256
+
+// -------------------------------------------------------------------------
+// Everything the per-frame evolution reads and writes for the stored
+// spectrum bins, one field per quantity, so that a run of bins is one
+// contiguous vector load from each. The wave vector and its direction are
+// zero on the bins whose slope and displacement are dropped.
+// -------------------------------------------------------------------------
+struct OceanSpectrumBins
+{
+   CComplexField2D h0Sum;        // h0(k) + h0(-k)
+   CComplexField2D h0Difference; // h0(k) - h0(-k)
+   CRealField2D kX;
+   CRealField2D kZ;
+   CRealField2D unitKX;
+   CRealField2D unitKZ;
+   CComplexField2D phasor;       // exp{i*w(k)*t}
+   CComplexField2D phasorStep;   // exp{i*w(k)*dt}
+};
+
+class COceanSimulation
+{
+public:
+   COceanSimulation();
+   virtual ~COceanSimulation();
+
+   // -------------------------------------------------------------------------
+   // Builds the FFT plans, the maps and the initial spectrum for the current
+   // FFT size. Plans pick their kernels from GetSimdLevel() here, so calling
+   // Init() again after changing the SIMD limit rebuilds them.
+   // -------------------------------------------------------------------------
+   bool Init();
+   bool IsValid();
+
+   // -------------------------------------------------------------------------
+   // Evolves the spectrum to dCurrentTime seconds and transforms every
+   // active field to its spatial map. The time is a double so the phases
+   // stay accurate after a long uptime.
+   // -------------------------------------------------------------------------
+   void Update(double dCurrentTime);
+
+   // -------------------------------------------------------------------------
+   // Basic Mutators / Accessors. The spectrum parameters take effect on the
+   // next Update(), which rebuilds only what they feed.
+   // -------------------------------------------------------------------------
+   void SetXWindSpeed(float fValue);
+   float GetXWindSpeed();
+
+   void SetZWindSpeed(float fValue);
+   float GetZWindSpeed();
+
+   void SetPhillipsConstant(float fValue);
+   float GetPhillipsConstant();
+
+   void SetGravityConstant(float fValue);
+   float GetGravityConstant();
+
+   // -------------------------------------------------------------------------
+   // Scale of the horizontal displacement that sharpens wave crests. 0 turns
+   // it off and skips its two transforms.
+   // -------------------------------------------------------------------------
+   void SetChoppiness(float fValue);
+   float GetChoppiness();
+
+   // -------------------------------------------------------------------------
+   // Seed of the spectrum's random numbers, OCEAN_SEED by default.
+   // -------------------------------------------------------------------------
+   void SetSeed(unsigned int nSeed);
+   unsigned int GetSeed();
+
+   // -------------------------------------------------------------------------
+   // Spectrum model, one of OCEAN_SPECTRUM_*, Phillips by default, and its
+   // directional spreading, one of OCEAN_SPREADING_*, cosine squared by
+   // default. Both return false, and keep the current one, for an unknown
+   // type.
+   // -------------------------------------------------------------------------
+   bool SetSpectrumModel(int nModel);
+   int GetSpectrumModel();
+
+   bool SetSpreading(int nSpreading);
+   int GetSpreading();
+
+   // -------------------------------------------------------------------------
+   // One of the OCEAN_SPECTRUM_EVALUATION_* modes, analytic by default.
+   // Returns false, and keeps the current mode, for an unknown mode.
+   // -------------------------------------------------------------------------
+   bool SetSpectrumEvaluation(int nMode);
+   int GetSpectrumEvaluation();
+
+   // -------------------------------------------------------------------------
+   // Sea state of the physical models, see OceanSeaState.
+   // -------------------------------------------------------------------------
+   void SetFetch(float fValue);
+   float GetFetch();
+
+   void SetDepth(float fValue);
+   float GetDepth();
+
+   void SetPeakEnhancement(float fValue);
+   float GetPeakEnhancement();
+
+   void SetSpreadingExponent(float fValue);
+   float GetSpreadingExponent();
+
+   // -------------------------------------------------------------------------
+   // Loop period T in seconds, OCEAN_LOOP_PERIOD by default, and the frames
+   // cached per loop in one of the OCEAN_FRAME_CACHE_* formats. The cache
+   // is only used while looping; 0 frames turns it off.
+   // -------------------------------------------------------------------------
+   void SetLoopPeriod(float fSeconds);
+   float GetLoopPeriod();
+
+   void SetFrameCache(int nFrames, int nFormat);
+   int GetFrameCacheFrames();
+   int GetFrameCacheFormat();
+   const COceanFrameCache& GetFrameCache();
+
+   void SetFFTThreadCount(int nThreads);
+   int GetFFTThreadCount();
+
+   // -------------------------------------------------------------------------
+   // The pool the FFTs and table builds run on, for other per frame work
+   // that should share its threads.
+   // -------------------------------------------------------------------------
+   CThreadPool& GetThreadPool();
+
+   // -------------------------------------------------------------------------
+   // One of the OCEAN_EVOLUTION_* modes, incremental by default.
+   // -------------------------------------------------------------------------
+   void SetEvolutionMode(int nMode);
+   int GetEvolutionMode();
+
+   // -------------------------------------------------------------------------
+   // When fused, the default, the evolved spectrum is computed block by
+   // block inside the FFT column pass and never stored. Unfused, it is
+   // written to full spectrum maps first, which is kept for comparison.
+   // -------------------------------------------------------------------------
+   void SetFusedTransform(bool blFused);
+   bool GetFusedTransform();
+
+   // -------------------------------------------------------------------------
+   // Resolution of the simulated height field, any size from
+   // OCEAN_FFT_SIZE_MIN to OCEAN_FFT_SIZE_MAX. Powers of two are fastest;
+   // sizes made of the factors 2, 3 and 5 use the mixed-radix FFT and
+   // anything else the slower Bluestein transform. Changing it after Init()
+   // rebuilds the spectrum. Returns false, and keeps the current size, if
+   // nSize is not allowed or its plans and maps cannot be allocated; they
+   // are then rebuilt at the current size, and only if that fails too is
+   // the simulation left invalid until the next Init().
+   // -------------------------------------------------------------------------
+   bool SetFFTSize(int nSize);
+   int GetFFTSize();
+
+   CFFT2D& GetFFT();
+
+   // -------------------------------------------------------------------------
+   // Spatial maps from the last Update(). Each is GetFFTSize() rows of
+   // GetFFTSize() samples, with sample (x, z) at [x * GetFFTSize() + z];
+   // their rows are packed, with no padding between them.
+   // Only the first GetActiveFieldCount() fields are current.
+   // -------------------------------------------------------------------------
+   int GetActiveFieldCount();
+   const float* GetField(int nField);
+
+   // -------------------------------------------------------------------------
+   // Bilinear sample of a field at a fractional (x, z) sample position,
+   // wrapping around the periodic patch.
+   // -------------------------------------------------------------------------
+   float SampleField(int nField, float fX, float fZ);
+
+   // -------------------------------------------------------------------------
+   // The same for any map of nWidth rows of nHeight samples, such as a
+   // baked frame.
+   // -------------------------------------------------------------------------
+   static float SampleMap(const float* pMap, int nWidth, int nHeight, float fX, float fZ);
+
+protected:
+   class CEvolutionSource;
+   class CTableRowTask;
+
+   //--------------------------------------------------------------------------
+   // Basically, create a wave field having the same spectrum as the ocean and
+   // then transform it to the spatial domain by an inverse Fast Fourier
+   // Transform. LoadInitialFourierHeightMap rebuilds the tables marked by
+   // Invalidate.
+   //--------------------------------------------------------------------------
+   virtual bool LoadInitialFourierHeightMap();
+   virtual void UpdateFourierHeightMap(double dCurrentTime);
+
+   // -------------------------------------------------------------------------
+   // Evolves bins z0 .. z0 + nColumns - 1 of spectrum row x, writing every
+   // active field's bins to ppReal[f][c] / ppImaginary[f][c].
+   // -------------------------------------------------------------------------
+   void EvolveBins(
+      int x,
+      int z0,
+      int nColumns,
+      bool blAdvancePhasors,
+      bool blChoppy,
+      float* const* ppReal,
+      float* const* ppImaginary);
+
+   // -------------------------------------------------------------------------
+   // Spectrum Table Helper Methods, one per OCEAN_DIRTY_* table. Each table
+   // is built a row of x at a time, with the rows shared out over the
+   // thread pool by BuildTableRows.
+   // -------------------------------------------------------------------------
+   typedef void (COceanSimulation::*TableRowMethod)(int x);
+
+   void Invalidate(int nTables);
+   void BuildTableRows(TableRowMethod pfnBuildRow);
+   void BuildWaveVectors();
+   void BuildGaussians();
+   void BuildDispersion();
+   void BuildAmplitudes();
+   void BuildWaveVectorRow(int x);
+   void BuildGaussianRow(int x);
+   void BuildDispersionRow(int x);
+   void BuildAmplitudeRow(int x);
+   void BuildBinAmplitudeRow(int x);
+
+   // -------------------------------------------------------------------------
+   // Frame Cache Helper Methods. BuildFrameCache simulates one loop into the
+   // cache, and PlayFrameCache blends a row of every cached field at a time
+   // into the spatial maps.
+   // -------------------------------------------------------------------------
+   bool BuildFrameCache();
+   void PlayFrameCache(double dLoopTime);
+   void PlayFrameCacheRow(int x);
+
+   // -------------------------------------------------------------------------
+   // Phase Evolution Helper Methods. PreparePhasors brings the phasors to
+   // dCurrentTime, or returns true if the update loop should advance them
+   // by multiplying each with its step. The phasor tables are built a row
+   // at a time like the spectrum tables, for m_dPhasorBuildTime.
+   // -------------------------------------------------------------------------
+   bool PreparePhasors(double dCurrentTime);
+   void SetAbsolutePhasors(double dCurrentTime);
+   void SetAbsolutePhasorRow(int x);
+   void BuildPhasorSteps(double dStep);
+   void BuildPhasorStepRow(int x);
+   void AdvancePhasorRow(int x);
+   void ResyncPhasorRows();
+
+   // -------------------------------------------------------------------------
+   // Fast Fourier Helper Methods. CreateFFTPlans makes nWidth x nHeight the
+   // FFT size only once everything for it is allocated.
+   // -------------------------------------------------------------------------
+   bool CreateFFTPlans(int nWidth, int nHeight);
+   bool FFT2D();
+   void GetPhillipsParameters(PhillipsParameters& parameters);
+   void GetSeaState(OceanSeaState& seaState);
+
+protected:
+   // -------------------------------------------------------------------------
+   // Water Parameters
+   // -------------------------------------------------------------------------
+   float m_fXWindSpeed;
+   float m_fZWindSpeed;
+   float m_fPhillipsConstant;
+   float m_fGravityConstant;
+   float m_fChoppiness;
+   unsigned int m_nSeed;
+   float m_fFetch;
+   float m_fDepth;
+   float m_fPeakEnhancement;
+   float m_fSpreadingExponent;
+   float m_fLoopPeriod;
+
+   // -------------------------------------------------------------------------
+   // Spectrum model and how it is evaluated.
+   // -------------------------------------------------------------------------
+   int m_nSpectrumModel;
+   int m_nSpreading;
+   int m_nSpectrumEvaluation;
+   CSpectrumModel* m_pSpectrumModel;
+
+   // -------------------------------------------------------------------------
+   // OCEAN_DIRTY_* tables to rebuild before the next frame.
+   // -------------------------------------------------------------------------
+   int m_nDirtyTables;
+
+   // -------------------------------------------------------------------------
+   // One loop of spatial maps, valid until a table is rebuilt, and the two
+   // frames and blend weight being played back.
+   // -------------------------------------------------------------------------
+   COceanFrameCache m_FrameCache;
+   int m_nFrameCacheFrames;
+   int m_nFrameCacheFormat;
+   bool m_blFrameCacheValid;
+   int m_nPlaybackFrame0;
+   int m_nPlaybackFrame1;
+   float m_fPlaybackBlend;
+
+   // -------------------------------------------------------------------------
+   // Fourier Height Map Data (Computed at each iteration). Every map is
+   // m_nFFTWidth rows, with element (x, z) at [x * pitch + z]. The time-
+   // evolved spectra are Hermitian, so only their bins 0..m_nFFTHeight/2 are
+   // stored, m_nSpectrumHeight per row, and only by the unfused path. There
+   // is one spectrum and one spatial map per OCEAN_FIELD_* index. The
+   // spatial maps are packed, so they can be handed out whole; everything
+   // else has padded rows.
+   // -------------------------------------------------------------------------
+   int m_nFFTWidth;
+   int m_nFFTHeight;
+   int m_nSpectrumHeight;
+
+   CComplexField2D m_InitialHeightMap;
+   CComplexField2D m_Gaussians;
+   CComplexField2D m_FourierFieldMaps[OCEAN_FIELD_COUNT];
+   CRealField2D m_VertexFieldMaps[OCEAN_FIELD_COUNT];
+   bool m_blFusedTransform;
+
+   CRealField2D m_KWaveVectorsX;
+   CRealField2D m_KWaveVectorsZ;
+   CRealField2D m_AngularFreqs;
+
+   // -------------------------------------------------------------------------
+   // Kernels that build the tables, picked from GetSimdLevel() with the FFT
+   // plans, and the sea state of the amplitudes being built: Phillips
+   // constants for the kernels, or the model's lookup tables.
+   // -------------------------------------------------------------------------
+   SpectrumKernelTable m_SpectrumKernels;
+   PhillipsParameters m_PhillipsParameters;
+   bool m_blPhillipsKernels;
+   CSpectrumLookup m_SpectrumLookup;
+
+   // -------------------------------------------------------------------------
+   // The per-frame inputs of the stored half spectrum, m_nSpectrumHeight
+   // bins per row. Their phasors hold the phases at m_dPhasorTime and the
+   // steps those of m_dPhasorStep. m_blPhasorsValid is cleared whenever
+   // w(k) changes. m_dLastTime is the time of the last update and
+   // m_dMeanStep the running average of the frame times; m_nResyncRow is
+   // the next row the rolling resync resets.
+   // -------------------------------------------------------------------------
+   OceanSpectrumBins m_SpectrumBins;
+
+   int m_nEvolutionMode;
+   bool m_blPhasorsValid;
+   double m_dPhasorTime;
+   double m_dPhasorStep;
+   double m_dPhasorBuildTime;
+   double m_dLastTime;
+   double m_dMeanStep;
+   int m_nResyncRow;
+
+   // -------------------------------------------------------------------------
+   // FFT plans and scratch buffers, built once in Init() and reused every
+   // frame, and the worker threads that share out each pass.
+   // m_blPlansValid is set once the plans and every map are allocated at
+   // the FFT size.
+   // -------------------------------------------------------------------------
+   CFFT2D m_FFT2D;
+   bool m_blPlansValid;
+   CThreadPool m_ThreadPool;
+   int m_nFFTThreadCount;
+};
@@ -0,0 +1,159 @@
+#include <math.h>
+#include "Philox.h"
+
+#define PHILOX_M0                      0xD2511F53u
+#define PHILOX_M1                      0xCD9E8D57u
+#define PHILOX_W0                      0x9E3779B9u
+#define PHILOX_W1                      0xBB67AE85u
+
+#if defined(_MSC_VER)
+typedef unsigned __int64 PhiloxWide;
+#else
+typedef unsigned long long PhiloxWide;
+#endif
+
+static inline void MultiplyHighLow(unsigned int a, unsigned int b, unsigned int& nHigh, unsigned int& nLow)
+{
+   PhiloxWide nProduct = (PhiloxWide)a * (PhiloxWide)b;
+   nHigh = (unsigned int)(nProduct >> 32);
+   nLow = (unsigned int)nProduct;
+}
+
+void Philox4x32(const unsigned int anCounter[4], const unsigned int anKey[2], unsigned int anOutput[4])
+{
+   unsigned int c0 = anCounter[0];
+   unsigned int c1 = anCounter[1];
+   unsigned int c2 = anCounter[2];
+   unsigned int c3 = anCounter[3];
+   unsigned int k0 = anKey[0];
+   unsigned int k1 = anKey[1];
+
+   for (int r = 0; r < PHILOX_ROUNDS; r++)
+   {
+      unsigned int nHigh0, nLow0, nHigh1, nLow1;
+      MultiplyHighLow(PHILOX_M0, c0, nHigh0, nLow0);
+      MultiplyHighLow(PHILOX_M1, c2, nHigh1, nLow1);
+
+      c0 = nHigh1 ^ c1 ^ k0;
+      c1 = nLow1;
+      c2 = nHigh0 ^ c3 ^ k1;
+      c3 = nLow0;
+
+      k0 += PHILOX_W0;
+      k1 += PHILOX_W1;
+   }
+
+   anOutput[0] = c0;
+   anOutput[1] = c1;
+   anOutput[2] = c2;
+   anOutput[3] = c3;
+}
+
+// -------------------------------------------------------------------------
+// 53-bit uniforms from two random words. The open form never returns 0, so
+// its logarithm is finite.
+// -------------------------------------------------------------------------
+static inline double GetUniformOpen(unsigned int nHigh, unsigned int nLow)
+{
+   return ((double)(nHigh >> 5) * 67108864.0 + (double)(nLow >> 6) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+static inline double GetUniform(unsigned int nHigh, unsigned int nLow)
+{
+   return ((double)(nHigh >> 5) * 67108864.0 + (double)(nLow >> 6)) * (1.0 / 9007199254740992.0);
+}
+
+// -------------------------------------------------------------------------
+// Natural logarithm of u in (0, 1]. With u = m * 2^e and m in
+// [sqrt(1/2), sqrt(2)), log(m) = 2 * atanh(s) for s = (m - 1) / (m + 1),
+// |s| < 0.172. The series through s^17 is good to about 1e-16.
+// -------------------------------------------------------------------------
+static double GetPortableLog(double u)
+{
+   int nExponent;
+   double m = frexp(u, &nExponent);
+
+   if (m < 0.70710678118654752440)
+   {
+      m *= 2.0;
+      nExponent--;
+   }
+
+   double s = (m - 1.0) / (m + 1.0);
+   double s2 = s * s;
+
+   double dSeries =
+      2.0 + s2 * (2.0 / 3.0 + s2 * (2.0 / 5.0 + s2 * (2.0 / 7.0 + s2 * (2.0 / 9.0 +
+      s2 * (2.0 / 11.0 + s2 * (2.0 / 13.0 + s2 * (2.0 / 15.0 + s2 * (2.0 / 17.0))))))));
+
+   return (double)nExponent * 0.69314718055994530942 + s * dSeries;
+}
+
+// -------------------------------------------------------------------------
+// Cosine and sine of 2 * PI * u for u in [0, 1). The angle is split into a
+// quarter turn q and a remainder in [-PI/4, PI/4); both steps are exact.
+// The Taylor series through a^17 and a^16 are good to about 1e-16.
+// -------------------------------------------------------------------------
+static void GetPortableCosSin(double u, double& dCos, double& dSin)
+{
+   double dQuarters = 4.0 * u;
+   double dQuadrant = floor(dQuarters + 0.5);
+   double a = (dQuarters - dQuadrant) * 1.57079632679489661923;
+   double a2 = a * a;
+
+   double dS =
+      a * (1.0 - a2 * (1.0 / 6.0 - a2 * (1.0 / 120.0 - a2 * (1.0 / 5040.0 - a2 * (1.0 / 362880.0 -
+      a2 * (1.0 / 39916800.0 - a2 * (1.0 / 6227020800.0 - a2 * (1.0 / 1307674368000.0 -
+      a2 * (1.0 / 355687428096000.0)))))))));
+
+   double dC =
+      1.0 - a2 * (1.0 / 2.0 - a2 * (1.0 / 24.0 - a2 * (1.0 / 720.0 - a2 * (1.0 / 40320.0 -
+      a2 * (1.0 / 3628800.0 - a2 * (1.0 / 479001600.0 - a2 * (1.0 / 87178291200.0 -
+      a2 * (1.0 / 20922789888000.0))))))));
+
+   switch ((int)dQuadrant & 3)
+   {
+   case 0:
+      dCos = dC;
+      dSin = dS;
+      break;
+   case 1:
+      dCos = -dS;
+      dSin = dC;
+      break;
+   case 2:
+      dCos = -dC;
+      dSin = -dS;
+      break;
+   default:
+      dCos = dS;
+      dSin = -dC;
+      break;
+   }
+}
+
+void GetPhiloxGaussians(unsigned int nSeed,
+                        unsigned int nStream,
+                        int nX,
+                        int nZ,
+                        float& fGaussian1,
+                        float& fGaussian2)
+{
+   unsigned int anCounter[4] = { (unsigned int)nX, (unsigned int)nZ, nStream, 0 };
+   unsigned int anKey[2] = { nSeed, 0 };
+   unsigned int anBits[4];
+
+   Philox4x32(anCounter, anKey, anBits);
+
+   // -------------------------------------------------------------------------
+   // Box-Muller: a radius with a Rayleigh distribution and a uniform angle
+   // give two independent deviates with mean 0 and standard deviation 1.
+   // -------------------------------------------------------------------------
+   double dRadius = sqrt(-2.0 * GetPortableLog(GetUniformOpen(anBits[0], anBits[1])));
+
+   double dCos, dSin;
+   GetPortableCosSin(GetUniform(anBits[2], anBits[3]), dCos, dSin);
+
+   fGaussian1 = (float)(dRadius * dCos);
+   fGaussian2 = (float)(dRadius * dSin);
+}
@@ -0,0 +1,41 @@
+// -------------------------------------------------------------------------
+// Sean Janis
+// spjanis@gmail.com
+// Water Simulations
+//
+// Philox
+//       Counter-based random numbers for the ocean spectrum. Philox4x32-10
+//       (Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3")
+//       turns a 128-bit counter and a 64-bit key into 128 random bits with
+//       integer operations only, so any bin's numbers can be generated on
+//       their own, in any order, on any thread.
+//
+//       The Gaussian deviates come from the Box-Muller transform, computed
+//       in double precision with additions, multiplications, divisions and
+//       square roots only (no library log, sin or cos), and then rounded to
+//       float. The results are therefore the same on every IEEE platform
+//       and compiler, provided floating point contraction into fused
+//       multiply-adds is off (the default for MSVC, -ffp-contract=off for
+//       GCC and Clang when FMA instructions are enabled).
+// -------------------------------------------------------------------------
+#pragma once
+
+#define PHILOX_ROUNDS                  10
+
+// -------------------------------------------------------------------------
+// One Philox4x32-10 block: anOutput receives the four random words for
+// anCounter under anKey.
+// -------------------------------------------------------------------------
+void Philox4x32(const unsigned int anCounter[4], const unsigned int anKey[2], unsigned int anOutput[4]);
+
+// -------------------------------------------------------------------------
+// Two independent standard normal deviates for the 2D index (nX, nZ) of
+// stream nStream under nSeed.
+// -------------------------------------------------------------------------
+void GetPhiloxGaussians(
+   unsigned int nSeed,
+   unsigned int nStream,
+   int nX,
+   int nZ,
+   float& fGaussian1,
+   float& fGaussian2);
@@ -0,0 +1,879 @@
+#include <math.h>
+#include <string.h>
+#include "SpectrumKernels.h"
+#include "CpuFeatures.h"
+#include "Philox.h"
+
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#define SPECTRUM_KERNELS_SSE2
+#if _MSC_VER >= 1700
+#define SPECTRUM_KERNELS_AVX2
+#endif
+#define SPECTRUM_TARGET_AVX2
+#elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define SPECTRUM_KERNELS_SSE2
+#define SPECTRUM_KERNELS_AVX2
+#define SPECTRUM_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+#ifdef SPECTRUM_KERNELS_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef SPECTRUM_KERNELS_AVX2
+#include <immintrin.h>
+#endif
+
+// -------------------------------------------------------------------------
+// Constants of the Philox rounds and the Box-Muller transform, see
+// Philox.cpp; the vector versions below repeat its arithmetic exactly.
+// -------------------------------------------------------------------------
+#define SPECTRUM_PHILOX_M0             0xD2511F53u
+#define SPECTRUM_PHILOX_M1             0xCD9E8D57u
+#define SPECTRUM_PHILOX_W0             0x9E3779B9u
+#define SPECTRUM_PHILOX_W1             0xBB67AE85u
+
+#define SPECTRUM_TWO_POW_26            67108864.0
+#define SPECTRUM_TWO_POW_MINUS_53      (1.0 / 9007199254740992.0)
+#define SPECTRUM_SQRT_HALF             0.70710678118654752440
+#define SPECTRUM_LN2                   0.69314718055994530942
+#define SPECTRUM_PI_OVER_2             1.57079632679489661923
+
+// -------------------------------------------------------------------------
+// SpectrumExp: e^x = 2^n * e^r with n = round(x / ln 2), r = x - n * ln 2
+// in two parts (Cody-Waite), and e^r from the Cephes minimax polynomial.
+// x is clamped to [-87, 88], where 2^n stays a normal float.
+// -------------------------------------------------------------------------
+#define SPECTRUM_EXP_MIN               -87.0f
+#define SPECTRUM_EXP_MAX               88.0f
+#define SPECTRUM_EXP_LOG2E             1.44269504088896341f
+#define SPECTRUM_EXP_ROUND             12582912.0f
+#define SPECTRUM_EXP_LN2_HIGH          0.693359375f
+#define SPECTRUM_EXP_LN2_LOW           -2.12194440e-4f
+#define SPECTRUM_EXP_P0                1.9875691500e-4f
+#define SPECTRUM_EXP_P1                1.3981999507e-3f
+#define SPECTRUM_EXP_P2                8.3334519073e-3f
+#define SPECTRUM_EXP_P3                4.1665795894e-2f
+#define SPECTRUM_EXP_P4                1.6666665459e-1f
+#define SPECTRUM_EXP_P5                5.0000001201e-1f
+
+// -------------------------------------------------------------------------
+// Scalar Kernels
+// -------------------------------------------------------------------------
+float SpectrumExp(float x)
+{
+   x = (x > SPECTRUM_EXP_MIN) ? x : SPECTRUM_EXP_MIN;
+   x = (x < SPECTRUM_EXP_MAX) ? x : SPECTRUM_EXP_MAX;
+
+   float n = (x * SPECTRUM_EXP_LOG2E + SPECTRUM_EXP_ROUND) - SPECTRUM_EXP_ROUND;
+   float r = x - n * SPECTRUM_EXP_LN2_HIGH;
+   r = r - n * SPECTRUM_EXP_LN2_LOW;
+   float r2 = r * r;
+
+   float p = SPECTRUM_EXP_P0;
+   p = p * r + SPECTRUM_EXP_P1;
+   p = p * r + SPECTRUM_EXP_P2;
+   p = p * r + SPECTRUM_EXP_P3;
+   p = p * r + SPECTRUM_EXP_P4;
+   p = p * r + SPECTRUM_EXP_P5;
+   p = p * r2 + r + 1.0f;
+
+   int nBits = ((int)n + 127) << 23;
+   float fScale;
+   memcpy(&fScale, &nBits, sizeof(fScale));
+
+   return p * fScale;
+}
+
+static inline void GetAmplitude_Scalar(float fKX,
+                                       float fKZ,
+                                       float fGaussianReal,
+                                       float fGaussianImaginary,
+                                       const PhillipsParameters& parameters,
+                                       float& fReal,
+                                       float& fImaginary)
+{
+   float fKSquared = fKX * fKX + fKZ * fKZ;
+   float fPhillipsSpectrum = 0.0f;
+
+   if (fKSquared != 0.0f)
+   {
+      float fKSquaredWindspeed = fKSquared * parameters.fWindspeedGravity * parameters.fWindspeedGravity;
+
+      // -------------------------------------------------------------------------
+      // Eliminates waves that move perpendicular to the wind direction.
+      // -------------------------------------------------------------------------
+      float fPerpendWaveEliminator = fKX * parameters.fWindX + fKZ * parameters.fWindZ;
+
+      fPhillipsSpectrum =
+         parameters.fPhillipsConstant
+         * (SpectrumExp(-1.0f / fKSquaredWindspeed) / (fKSquared * fKSquared))
+         * (fPerpendWaveEliminator * fPerpendWaveEliminator);
+   }
+
+   float fRootSpectrum = sqrtf(fPhillipsSpectrum);
+   fReal = parameters.fAmplitudeScale * fGaussianReal * fRootSpectrum;
+   fImaginary = parameters.fAmplitudeScale * fGaussianImaginary * fRootSpectrum;
+}
+
+static inline float GetDispersion_Scalar(float fKX, float fKZ, float fGravity)
+{
+   float fKVectorDistance = sqrtf(fKX * fKX + fKZ * fKZ);
+   return sqrtf(fKVectorDistance * fGravity);
+}
+
+static void GaussianRow_Scalar(unsigned int nSeed, unsigned int nStream, int nX, int nZ0, int nCount,
+                               float* pReal, float* pImaginary)
+{
+   for (int i = 0; i < nCount; i++)
+   {
+      GetPhiloxGaussians(nSeed, nStream, nX, nZ0 + i, pReal[i], pImaginary[i]);
+   }
+}
+
+static void AmplitudeRow_Scalar(const float* pKX, const float* pKZ,
+                                const float* pGaussianReal, const float* pGaussianImaginary, int nCount,
+                                const PhillipsParameters& parameters, float* pReal, float* pImaginary)
+{
+   for (int i = 0; i < nCount; i++)
+   {
+      GetAmplitude_Scalar(pKX[i], pKZ[i], pGaussianReal[i], pGaussianImaginary[i], parameters,
+                          pReal[i], pImaginary[i]);
+   }
+}
+
+static void DispersionRow_Scalar(const float* pKX, const float* pKZ, int nCount, float fGravity, float* pOutput)
+{
+   for (int i = 0; i < nCount; i++)
+   {
+      pOutput[i] = GetDispersion_Scalar(pKX[i], pKZ[i], fGravity);
+   }
+}
+
+// -------------------------------------------------------------------------
+// Bins i0 .. nCount - 1 of EvolveRow, which the SIMD versions finish with.
+// -------------------------------------------------------------------------
+static void EvolveBins_Scalar(const SpectrumEvolutionRow& row, int i0, int nCount,
+                              bool blAdvancePhasors, bool blChoppy,
+                              float* const* ppReal, float* const* ppImaginary)
+{
+   for (int i = i0; i < nCount; i++)
+   {
+      // -------------------------------------------------------------------------
+      // exp{iw(k)t}, advanced from the last frame by one step when
+      // running incrementally.
+      // -------------------------------------------------------------------------
+      if (blAdvancePhasors)
+      {
+         float fPhasorReal = row.pPhasorReal[i];
+         float fPhasorImaginary = row.pPhasorImaginary[i];
+
+         row.pPhasorReal[i] =
+            fPhasorReal * row.pPhasorStepReal[i] - fPhasorImaginary * row.pPhasorStepImaginary[i];
+         row.pPhasorImaginary[i] =
+            fPhasorReal * row.pPhasorStepImaginary[i] + fPhasorImaginary * row.pPhasorStepReal[i];
+      }
+
+      float fAngularSine = row.pPhasorImaginary[i];
+      float fAngularCosine = row.pPhasorReal[i];
+
+      // -------------------------------------------------------------------------
+      // Convert from Fourier Space to the Spatial Domain by combining the effects
+      // of the each sinus waveform to get a surface height.
+      //
+      // Trying to compute: h0(k)exp{iw(k)t} + conj(h0(-k))exp{-iw(k)t}
+      // exp{iwkt} can be represented as: cos(wkt) + i*sin(wkt)
+      //
+      // Since w(k) == w(-k), the result satisfies h(-k) == conj(h(k)) and the
+      // inverse transform is purely real.
+      // -------------------------------------------------------------------------
+      float fHReal =
+         row.pH0SumReal[i] * fAngularCosine -
+         row.pH0SumImaginary[i] * fAngularSine;
+
+      float fHImaginary =
+         row.pH0DifferenceReal[i] * fAngularSine +
+         row.pH0DifferenceImaginary[i] * fAngularCosine;
+
+      ppReal[0][i] = fHReal;
+      ppImaginary[0][i] = fHImaginary;
+
+      // -------------------------------------------------------------------------
+      // The other fields follow from h(k) in the frequency domain:
+      //
+      //    slope:        i * k * h(k)
+      //    displacement: -i * k / |k| * h(k)
+      // -------------------------------------------------------------------------
+      ppReal[1][i] = -(row.pKX[i] * fHImaginary);
+      ppImaginary[1][i] = row.pKX[i] * fHReal;
+      ppReal[2][i] = -(row.pKZ[i] * fHImaginary);
+      ppImaginary[2][i] = row.pKZ[i] * fHReal;
+
+      if (blChoppy)
+      {
+         ppReal[3][i] = row.pUnitKX[i] * fHImaginary;
+         ppImaginary[3][i] = -(row.pUnitKX[i] * fHReal);
+         ppReal[4][i] = row.pUnitKZ[i] * fHImaginary;
+         ppImaginary[4][i] = -(row.pUnitKZ[i] * fHReal);
+      }
+   }
+}
+
+static void EvolveRow_Scalar(const SpectrumEvolutionRow& row, int nCount, bool blAdvancePhasors, bool blChoppy,
+                             float* const* ppReal, float* const* ppImaginary)
+{
+   EvolveBins_Scalar(row, 0, nCount, blAdvancePhasors, blChoppy, ppReal, ppImaginary);
+}
+
+#ifdef SPECTRUM_KERNELS_SSE2
+// -------------------------------------------------------------------------
+// SSE2 Kernels: four Philox blocks per pass, whose Box-Muller transforms
+// run two bins at a time in double precision.
+// -------------------------------------------------------------------------
+static inline void PhiloxMultiply_SSE2(__m128i vM, __m128i c, __m128i& vHigh, __m128i& vLow)
+{
+   __m128i vMaskLow = _mm_set_epi32(0, -1, 0, -1);
+   __m128i vEven = _mm_mul_epu32(c, vM);
+   __m128i vOdd = _mm_mul_epu32(_mm_srli_epi64(c, 32), vM);
+
+   vLow = _mm_or_si128(_mm_and_si128(vEven, vMaskLow), _mm_slli_epi64(vOdd, 32));
+   vHigh = _mm_or_si128(_mm_srli_epi64(vEven, 32), _mm_andnot_si128(vMaskLow, vOdd));
+}
+
+static inline void Philox4x32_SSE2(__m128i& c0, __m128i& c1, __m128i& c2, __m128i& c3, unsigned int nSeed)
+{
+   __m128i vM0 = _mm_set1_epi32((int)SPECTRUM_PHILOX_M0);
+   __m128i vM1 = _mm_set1_epi32((int)SPECTRUM_PHILOX_M1);
+   unsigned int k0 = nSeed;
+   unsigned int k1 = 0;
+
+   for (int r = 0; r < PHILOX_ROUNDS; r++)
+   {
+      __m128i vHigh0, vLow0, vHigh1, vLow1;
+      PhiloxMultiply_SSE2(vM0, c0, vHigh0, vLow0);
+      PhiloxMultiply_SSE2(vM1, c2, vHigh1, vLow1);
+
+      c0 = _mm_xor_si128(_mm_xor_si128(vHigh1, c1), _mm_set1_epi32((int)k0));
+      c1 = vLow1;
+      c2 = _mm_xor_si128(_mm_xor_si128(vHigh0, c3), _mm_set1_epi32((int)k1));
+      c3 = vLow0;
+
+      k0 += SPECTRUM_PHILOX_W0;
+      k1 += SPECTRUM_PHILOX_W1;
+   }
+}
+
+// -------------------------------------------------------------------------
+// GetUniform of Philox.cpp for the two words in the low lanes; the shifted
+// words are below 2^27, so the signed conversion is exact.
+// -------------------------------------------------------------------------
+static inline __m128d GetUniform_SSE2(__m128i vHigh, __m128i vLow, __m128d vOffset)
+{
+   __m128d vH = _mm_cvtepi32_pd(_mm_srli_epi32(vHigh, 5));
+   __m128d vL = _mm_cvtepi32_pd(_mm_srli_epi32(vLow, 6));
+   __m128d vSum = _mm_add_pd(_mm_add_pd(_mm_mul_pd(vH, _mm_set1_pd(SPECTRUM_TWO_POW_26)), vL), vOffset);
+   return _mm_mul_pd(vSum, _mm_set1_pd(SPECTRUM_TWO_POW_MINUS_53));
+}
+
+static inline __m128d Select_SSE2(__m128d vMask, __m128d vTrue, __m128d vFalse)
+{
+   return _mm_or_pd(_mm_and_pd(vMask, vTrue), _mm_andnot_pd(vMask, vFalse));
+}
+
+// -------------------------------------------------------------------------
+// GetPortableLog for u in (0, 1], where u is normal: frexp reads the
+// exponent bits, and the exponent becomes a double through the 2^52 trick.
+// -------------------------------------------------------------------------
+static inline __m128d GetLog_SSE2(__m128d u)
+{
+   __m128i vBits = _mm_castpd_si128(u);
+   __m128i vMantissaMask = _mm_set_epi32(0x000FFFFF, -1, 0x000FFFFF, -1);
+   __m128i vHalfExponent = _mm_set_epi32(0x3FE00000, 0, 0x3FE00000, 0);
+   __m128i vTwoPow52 = _mm_set_epi32(0x43300000, 0, 0x43300000, 0);
+
+   __m128d m = _mm_castsi128_pd(_mm_or_si128(_mm_and_si128(vBits, vMantissaMask), vHalfExponent));
+   __m128d vBiased = _mm_castsi128_pd(_mm_or_si128(_mm_srli_epi64(vBits, 52), vTwoPow52));
+   __m128d vExponent = _mm_sub_pd(_mm_sub_pd(vBiased, _mm_set1_pd(4503599627370496.0)), _mm_set1_pd(1022.0));
+
+   __m128d vSmall = _mm_cmplt_pd(m, _mm_set1_pd(SPECTRUM_SQRT_HALF));
+   m = Select_SSE2(vSmall, _mm_mul_pd(m, _mm_set1_pd(2.0)), m);
+   vExponent = _mm_sub_pd(vExponent, _mm_and_pd(vSmall, _mm_set1_pd(1.0)));
+
+   __m128d vOne = _mm_set1_pd(1.0);
+   __m128d s = _mm_div_pd(_mm_sub_pd(m, vOne), _mm_add_pd(m, vOne));
+   __m128d s2 = _mm_mul_pd(s, s);
+
+   __m128d vSeries = _mm_set1_pd(2.0 / 17.0);
+   vSeries = _mm_add_pd(_mm_set1_pd(2.0 / 15.0), _mm_mul_pd(s2, vSeries));
+   vSeries = _mm_add_pd(_mm_set1_pd(2.0 / 13.0), _mm_mul_pd(s2, vSeries));
+   vSeries = _mm_add_pd(_mm_set1_pd(2.0 / 11.0), _mm_mul_pd(s2, vSeries));
+   vSeries = _mm_add_pd(_mm_set1_pd(2.0 / 9.0), _mm_mul_pd(s2, vSeries));
+   vSeries = _mm_add_pd(_mm_set1_pd(2.0 / 7.0), _mm_mul_pd(s2, vSeries));
+   vSeries = _mm_add_pd(_mm_set1_pd(2.0 / 5.0), _mm_mul_pd(s2, vSeries));
+   vSeries = _mm_add_pd(_mm_set1_pd(2.0 / 3.0), _mm_mul_pd(s2, vSeries));
+   vSeries = _mm_add_pd(_mm_set1_pd(2.0), _mm_mul_pd(s2, vSeries));
+
+   return _mm_add_pd(_mm_mul_pd(vExponent, _mm_set1_pd(SPECTRUM_LN2)), _mm_mul_pd(s, vSeries));
+}
+
+// -------------------------------------------------------------------------
+// GetPortableCosSin for u in [0, 1). The quadrant is below 5, so floor is
+// a truncation; it swaps cos and sin and flips their sign bits.
+// -------------------------------------------------------------------------
+static inline void GetCosSin_SSE2(__m128d u, __m128d& vCos, __m128d& vSin)
+{
+   __m128d vQuarters = _mm_mul_pd(_mm_set1_pd(4.0), u);
+   __m128i vQuadrant = _mm_cvttpd_epi32(_mm_add_pd(vQuarters, _mm_set1_pd(0.5)));
+   __m128d a = _mm_mul_pd(_mm_sub_pd(vQuarters, _mm_cvtepi32_pd(vQuadrant)), _mm_set1_pd(SPECTRUM_PI_OVER_2));
+   __m128d a2 = _mm_mul_pd(a, a);
+
+   __m128d vS = _mm_set1_pd(1.0 / 355687428096000.0);
+   vS = _mm_sub_pd(_mm_set1_pd(1.0 / 1307674368000.0), _mm_mul_pd(a2, vS));
+   vS = _mm_sub_pd(_mm_set1_pd(1.0 / 6227020800.0), _mm_mul_pd(a2, vS));
+   vS = _mm_sub_pd(_mm_set1_pd(1.0 / 39916800.0), _mm_mul_pd(a2, vS));
+   vS = _mm_sub_pd(_mm_set1_pd(1.0 / 362880.0), _mm_mul_pd(a2, vS));
+   vS = _mm_sub_pd(_mm_set1_pd(1.0 / 5040.0), _mm_mul_pd(a2, vS));
+   vS = _mm_sub_pd(_mm_set1_pd(1.0 / 120.0), _mm_mul_pd(a2, vS));
+   vS = _mm_sub_pd(_mm_set1_pd(1.0 / 6.0), _mm_mul_pd(a2, vS));
+   vS = _mm_sub_pd(_mm_set1_pd(1.0), _mm_mul_pd(a2, vS));
+   vS = _mm_mul_pd(a, vS);
+
+   __m128d vC = _mm_set1_pd(1.0 / 20922789888000.0);
+   vC = _mm_sub_pd(_mm_set1_pd(1.0 / 87178291200.0), _mm_mul_pd(a2, vC));
+   vC = _mm_sub_pd(_mm_set1_pd(1.0 / 479001600.0), _mm_mul_pd(a2, vC));
+   vC = _mm_sub_pd(_mm_set1_pd(1.0 / 3628800.0), _mm_mul_pd(a2, vC));
+   vC = _mm_sub_pd(_mm_set1_pd(1.0 / 40320.0), _mm_mul_pd(a2, vC));
+   vC = _mm_sub_pd(_mm_set1_pd(1.0 / 720.0), _mm_mul_pd(a2, vC));
+   vC = _mm_sub_pd(_mm_set1_pd(1.0 / 24.0), _mm_mul_pd(a2, vC));
+   vC = _mm_sub_pd(_mm_set1_pd(1.0 / 2.0), _mm_mul_pd(a2, vC));
+   vC = _mm_sub_pd(_mm_set1_pd(1.0), _mm_mul_pd(a2, vC));
+
+   __m128i vQuadrant64 = _mm_unpacklo_epi32(vQuadrant, _mm_setzero_si128());
+   __m128i vOne64 = _mm_set_epi32(0, 1, 0, 1);
+   __m128d vSwap = _mm_castsi128_pd(_mm_sub_epi64(_mm_setzero_si128(), _mm_and_si128(vQuadrant64, vOne64)));
+   __m128d vCosSign = _mm_castsi128_pd(_mm_slli_epi64(
+      _mm_and_si128(_mm_xor_si128(vQuadrant64, _mm_srli_epi64(vQuadrant64, 1)), vOne64), 63));
+   __m128d vSinSign = _mm_castsi128_pd(_mm_slli_epi64(_mm_srli_epi64(vQuadrant64, 1), 63));
+
+   vCos = _mm_xor_pd(Select_SSE2(vSwap, vS, vC), vCosSign);
+   vSin = _mm_xor_pd(Select_SSE2(vSwap, vC, vS), vSinSign);
+}
+
+// -------------------------------------------------------------------------
+// Box-Muller for the blocks in the low two lanes of the Philox words: the
+// two bins' real parts in the low lanes of vReal, their imaginary parts in
+// those of vImaginary.
+// -------------------------------------------------------------------------
+static inline void GetGaussians_SSE2(__m128i w0, __m128i w1, __m128i w2, __m128i w3,
+                                     __m128& vReal, __m128& vImaginary)
+{
+   __m128d vRadius = _mm_sqrt_pd(_mm_mul_pd(_mm_set1_pd(-2.0),
+      GetLog_SSE2(GetUniform_SSE2(w0, w1, _mm_set1_pd(0.5)))));
+
+   __m128d vCos, vSin;
+   GetCosSin_SSE2(GetUniform_SSE2(w2, w3, _mm_setzero_pd()), vCos, vSin);
+
+   vReal = _mm_cvtpd_ps(_mm_mul_pd(vRadius, vCos));
+   vImaginary = _mm_cvtpd_ps(_mm_mul_pd(vRadius, vSin));
+}
+
+static void GaussianRow_SSE2(unsigned int nSeed, unsigned int nStream, int nX, int nZ0, int nCount,
+                             float* pReal, float* pImaginary)
+{
+   int i = 0;
+
+   for (; i + 4 <= nCount; i += 4)
+   {
+      __m128i c0 = _mm_set1_epi32(nX);
+      __m128i c1 = _mm_add_epi32(_mm_set1_epi32(nZ0 + i), _mm_set_epi32(3, 2, 1, 0));
+      __m128i c2 = _mm_set1_epi32((int)nStream);
+      __m128i c3 = _mm_setzero_si128();
+      Philox4x32_SSE2(c0, c1, c2, c3, nSeed);
+
+      __m128 vReal01, vImaginary01, vReal23, vImaginary23;
+      GetGaussians_SSE2(c0, c1, c2, c3, vReal01, vImaginary01);
+      GetGaussians_SSE2(_mm_srli_si128(c0, 8), _mm_srli_si128(c1, 8),
+                        _mm_srli_si128(c2, 8), _mm_srli_si128(c3, 8), vReal23, vImaginary23);
+
+      _mm_storeu_ps(pReal + i, _mm_movelh_ps(vReal01, vReal23));
+      _mm_storeu_ps(pImaginary + i, _mm_movelh_ps(vImaginary01, vImaginary23));
+   }
+
+   GaussianRow_Scalar(nSeed, nStream, nX, nZ0 + i, nCount - i, pReal + i, pImaginary + i);
+}
+
+static inline __m128 GetExp_SSE2(__m128 x)
+{
+   x = _mm_max_ps(x, _mm_set1_ps(SPECTRUM_EXP_MIN));
+   x = _mm_min_ps(x, _mm_set1_ps(SPECTRUM_EXP_MAX));
+
+   __m128 vRound = _mm_set1_ps(SPECTRUM_EXP_ROUND);
+   __m128 n = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(SPECTRUM_EXP_LOG2E)), vRound), vRound);
+   __m128 r = _mm_sub_ps(x, _mm_mul_ps(n, _mm_set1_ps(SPECTRUM_EXP_LN2_HIGH)));
+   r = _mm_sub_ps(r, _mm_mul_ps(n, _mm_set1_ps(SPECTRUM_EXP_LN2_LOW)));
+   __m128 r2 = _mm_mul_ps(r, r);
+
+   __m128 p = _mm_set1_ps(SPECTRUM_EXP_P0);
+   p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(SPECTRUM_EXP_P1));
+   p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(SPECTRUM_EXP_P2));
+   p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(SPECTRUM_EXP_P3));
+   p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(SPECTRUM_EXP_P4));
+   p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(SPECTRUM_EXP_P5));
+   p = _mm_add_ps(_mm_add_ps(_mm_mul_ps(p, r2), r), _mm_set1_ps(1.0f));
+
+   __m128i vBits = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(n), _mm_set1_epi32(127)), 23);
+   return _mm_mul_ps(p, _mm_castsi128_ps(vBits));
+}
+
+// -------------------------------------------------------------------------
+// The Phillips spectrum of GetAmplitude_Scalar for four bins, in columns.
+// A zero k gives a NaN here, which the mask turns into P = 0.
+// -------------------------------------------------------------------------
+static inline __m128 GetPhillipsSpectrum_SSE2(__m128 vKX, __m128 vKZ, __m128 vKSquared,
+                                              const PhillipsParameters& parameters)
+{
+   __m128 vL = _mm_set1_ps(parameters.fWindspeedGravity);
+   __m128 vKSquaredWindspeed = _mm_mul_ps(_mm_mul_ps(vKSquared, vL), vL);
+   __m128 vPerpend = _mm_add_ps(_mm_mul_ps(vKX, _mm_set1_ps(parameters.fWindX)),
+                                _mm_mul_ps(vKZ, _mm_set1_ps(parameters.fWindZ)));
+
+   __m128 vExp = GetExp_SSE2(_mm_div_ps(_mm_set1_ps(-1.0f), vKSquaredWindspeed));
+   __m128 vSpectrum = _mm_mul_ps(
+      _mm_mul_ps(_mm_set1_ps(parameters.fPhillipsConstant), _mm_div_ps(vExp, _mm_mul_ps(vKSquared, vKSquared))),
+      _mm_mul_ps(vPerpend, vPerpend));
+
+   return _mm_and_ps(vSpectrum, _mm_cmpneq_ps(vKSquared, _mm_setzero_ps()));
+}
+
+static void AmplitudeRow_SSE2(const float* pKX, const float* pKZ,
+                              const float* pGaussianReal, const float* pGaussianImaginary, int nCount,
+                              const PhillipsParameters& parameters, float* pReal, float* pImaginary)
+{
+   __m128 vScale = _mm_set1_ps(parameters.fAmplitudeScale);
+   int i = 0;
+
+   for (; i + 4 <= nCount; i += 4)
+   {
+      __m128 vKX = _mm_loadu_ps(pKX + i);
+      __m128 vKZ = _mm_loadu_ps(pKZ + i);
+
+      __m128 vKSquared = _mm_add_ps(_mm_mul_ps(vKX, vKX), _mm_mul_ps(vKZ, vKZ));
+      __m128 vRoot = _mm_sqrt_ps(GetPhillipsSpectrum_SSE2(vKX, vKZ, vKSquared, parameters));
+
+      _mm_storeu_ps(pReal + i, _mm_mul_ps(_mm_mul_ps(vScale, _mm_loadu_ps(pGaussianReal + i)), vRoot));
+      _mm_storeu_ps(pImaginary + i, _mm_mul_ps(_mm_mul_ps(vScale, _mm_loadu_ps(pGaussianImaginary + i)), vRoot));
+   }
+
+   AmplitudeRow_Scalar(pKX + i, pKZ + i, pGaussianReal + i, pGaussianImaginary + i, nCount - i,
+                       parameters, pReal + i, pImaginary + i);
+}
+
+static void DispersionRow_SSE2(const float* pKX, const float* pKZ, int nCount, float fGravity, float* pOutput)
+{
+   __m128 vGravity = _mm_set1_ps(fGravity);
+   int i = 0;
+
+   for (; i + 4 <= nCount; i += 4)
+   {
+      __m128 vKX = _mm_loadu_ps(pKX + i);
+      __m128 vKZ = _mm_loadu_ps(pKZ + i);
+
+      __m128 vDistance = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(vKX, vKX), _mm_mul_ps(vKZ, vKZ)));
+      _mm_storeu_ps(pOutput + i, _mm_sqrt_ps(_mm_mul_ps(vDistance, vGravity)));
+   }
+
+   DispersionRow_Scalar(pKX + i, pKZ + i, nCount - i, fGravity, pOutput + i);
+}
+
+// -------------------------------------------------------------------------
+// EvolveBins_Scalar four bins at a time. Negating flips the sign bit, as
+// the scalar negation does.
+// -------------------------------------------------------------------------
+static void EvolveRow_SSE2(const SpectrumEvolutionRow& row, int nCount, bool blAdvancePhasors, bool blChoppy,
+                           float* const* ppReal, float* const* ppImaginary)
+{
+   __m128 vSign = _mm_set1_ps(-0.0f);
+   int i = 0;
+
+   for (; i + 4 <= nCount; i += 4)
+   {
+      __m128 vCos = _mm_loadu_ps(row.pPhasorReal + i);
+      __m128 vSin = _mm_loadu_ps(row.pPhasorImaginary + i);
+
+      if (blAdvancePhasors)
+      {
+         __m128 vStepReal = _mm_loadu_ps(row.pPhasorStepReal + i);
+         __m128 vStepImaginary = _mm_loadu_ps(row.pPhasorStepImaginary + i);
+         __m128 vReal = _mm_sub_ps(_mm_mul_ps(vCos, vStepReal), _mm_mul_ps(vSin, vStepImaginary));
+         __m128 vImaginary = _mm_add_ps(_mm_mul_ps(vCos, vStepImaginary), _mm_mul_ps(vSin, vStepReal));
+
+         vCos = vReal;
+         vSin = vImaginary;
+         _mm_storeu_ps(row.pPhasorReal + i, vCos);
+         _mm_storeu_ps(row.pPhasorImaginary + i, vSin);
+      }
+
+      __m128 vHReal = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(row.pH0SumReal + i), vCos),
+                                 _mm_mul_ps(_mm_loadu_ps(row.pH0SumImaginary + i), vSin));
+      __m128 vHImaginary = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(row.pH0DifferenceReal + i), vSin),
+                                      _mm_mul_ps(_mm_loadu_ps(row.pH0DifferenceImaginary + i), vCos));
+
+      _mm_storeu_ps(ppReal[0] + i, vHReal);
+      _mm_storeu_ps(ppImaginary[0] + i, vHImaginary);
+
+      __m128 vKX = _mm_loadu_ps(row.pKX + i);
+      __m128 vKZ = _mm_loadu_ps(row.pKZ + i);
+      _mm_storeu_ps(ppReal[1] + i, _mm_xor_ps(_mm_mul_ps(vKX, vHImaginary), vSign));
+      _mm_storeu_ps(ppImaginary[1] + i, _mm_mul_ps(vKX, vHReal));
+      _mm_storeu_ps(ppReal[2] + i, _mm_xor_ps(_mm_mul_ps(vKZ, vHImaginary), vSign));
+      _mm_storeu_ps(ppImaginary[2] + i, _mm_mul_ps(vKZ, vHReal));
+
+      if (blChoppy)
+      {
+         __m128 vUnitKX = _mm_loadu_ps(row.pUnitKX + i);
+         __m128 vUnitKZ = _mm_loadu_ps(row.pUnitKZ + i);
+         _mm_storeu_ps(ppReal[3] + i, _mm_mul_ps(vUnitKX, vHImaginary));
+         _mm_storeu_ps(ppImaginary[3] + i, _mm_xor_ps(_mm_mul_ps(vUnitKX, vHReal), vSign));
+         _mm_storeu_ps(ppReal[4] + i, _mm_mul_ps(vUnitKZ, vHImaginary));
+         _mm_storeu_ps(ppImaginary[4] + i, _mm_xor_ps(_mm_mul_ps(vUnitKZ, vHReal), vSign));
+      }
+   }
+
+   EvolveBins_Scalar(row, i, nCount, blAdvancePhasors, blChoppy, ppReal, ppImaginary);
+}
+#endif
+
+#ifdef SPECTRUM_KERNELS_AVX2
+// -------------------------------------------------------------------------
+// AVX2 Kernels: eight Philox blocks per pass and four Box-Muller
+// transforms at a time, and eight bins at a time in the float kernels.
+// -------------------------------------------------------------------------
+SPECTRUM_TARGET_AVX2
+static inline void PhiloxMultiply_AVX2(__m256i vM, __m256i c, __m256i& vHigh, __m256i& vLow)
+{
+   __m256i vMaskLow = _mm256_set1_epi64x(0x00000000FFFFFFFFLL);
+   __m256i vEven = _mm256_mul_epu32(c, vM);
+   __m256i vOdd = _mm256_mul_epu32(_mm256_srli_epi64(c, 32), vM);
+
+   vLow = _mm256_or_si256(_mm256_and_si256(vEven, vMaskLow), _mm256_slli_epi64(vOdd, 32));
+   vHigh = _mm256_or_si256(_mm256_srli_epi64(vEven, 32), _mm256_andnot_si256(vMaskLow, vOdd));
+}
+
+SPECTRUM_TARGET_AVX2
+static inline void Philox4x32_AVX2(__m256i& c0, __m256i& c1, __m256i& c2, __m256i& c3, unsigned int nSeed)
+{
+   __m256i vM0 = _mm256_set1_epi32((int)SPECTRUM_PHILOX_M0);
+   __m256i vM1 = _mm256_set1_epi32((int)SPECTRUM_PHILOX_M1);
+   unsigned int k0 = nSeed;
+   unsigned int k1 = 0;
+
+   for (int r = 0; r < PHILOX_ROUNDS; r++)
+   {
+      __m256i vHigh0, vLow0, vHigh1, vLow1;
+      PhiloxMultiply_AVX2(vM0, c0, vHigh0, vLow0);
+      PhiloxMultiply_AVX2(vM1, c2, vHigh1, vLow1);
+
+      c0 = _mm256_xor_si256(_mm256_xor_si256(vHigh1, c1), _mm256_set1_epi32((int)k0));
+      c1 = vLow1;
+      c2 = _mm256_xor_si256(_mm256_xor_si256(vHigh0, c3), _mm256_set1_epi32((int)k1));
+      c3 = vLow0;
+
+      k0 += SPECTRUM_PHILOX_W0;
+      k1 += SPECTRUM_PHILOX_W1;
+   }
+}
+
+SPECTRUM_TARGET_AVX2
+static inline __m256d GetUniform_AVX2(__m128i vHigh, __m128i vLow, __m256d vOffset)
+{
+   __m256d vH = _mm256_cvtepi32_pd(_mm_srli_epi32(vHigh, 5));
+   __m256d vL = _mm256_cvtepi32_pd(_mm_srli_epi32(vLow, 6));
+   __m256d vSum = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(vH, _mm256_set1_pd(SPECTRUM_TWO_POW_26)), vL), vOffset);
+   return _mm256_mul_pd(vSum, _mm256_set1_pd(SPECTRUM_TWO_POW_MINUS_53));
+}
+
+SPECTRUM_TARGET_AVX2
+static inline __m256d GetLog_AVX2(__m256d u)
+{
+   __m256i vBits = _mm256_castpd_si256(u);
+   __m256i vMantissaMask = _mm256_set1_epi64x(0x000FFFFFFFFFFFFFLL);
+   __m256i vHalfExponent = _mm256_set1_epi64x(0x3FE0000000000000LL);
+   __m256i vTwoPow52 = _mm256_set1_epi64x(0x4330000000000000LL);
+
+   __m256d m = _mm256_castsi256_pd(_mm256_or_si256(_mm256_and_si256(vBits, vMantissaMask), vHalfExponent));
+   __m256d vBiased = _mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(vBits, 52), vTwoPow52));
+   __m256d vExponent = _mm256_sub_pd(_mm256_sub_pd(vBiased, _mm256_set1_pd(4503599627370496.0)),
+                                     _mm256_set1_pd(1022.0));
+
+   __m256d vSmall = _mm256_cmp_pd(m, _mm256_set1_pd(SPECTRUM_SQRT_HALF), _CMP_LT_OQ);
+   m = _mm256_blendv_pd(m, _mm256_mul_pd(m, _mm256_set1_pd(2.0)), vSmall);
+   vExponent = _mm256_sub_pd(vExponent, _mm256_and_pd(vSmall, _mm256_set1_pd(1.0)));
+
+   __m256d vOne = _mm256_set1_pd(1.0);
+   __m256d s = _mm256_div_pd(_mm256_sub_pd(m, vOne), _mm256_add_pd(m, vOne));
+   __m256d s2 = _mm256_mul_pd(s, s);
+
+   __m256d vSeries = _mm256_set1_pd(2.0 / 17.0);
+   vSeries = _mm256_add_pd(_mm256_set1_pd(2.0 / 15.0), _mm256_mul_pd(s2, vSeries));
+   vSeries = _mm256_add_pd(_mm256_set1_pd(2.0 / 13.0), _mm256_mul_pd(s2, vSeries));
+   vSeries = _mm256_add_pd(_mm256_set1_pd(2.0 / 11.0), _mm256_mul_pd(s2, vSeries));
+   vSeries = _mm256_add_pd(_mm256_set1_pd(2.0 / 9.0), _mm256_mul_pd(s2, vSeries));
+   vSeries = _mm256_add_pd(_mm256_set1_pd(2.0 / 7.0), _mm256_mul_pd(s2, vSeries));
+   vSeries = _mm256_add_pd(_mm256_set1_pd(2.0 / 5.0), _mm256_mul_pd(s2, vSeries));
+   vSeries = _mm256_add_pd(_mm256_set1_pd(2.0 / 3.0), _mm256_mul_pd(s2, vSeries));
+   vSeries = _mm256_add_pd(_mm256_set1_pd(2.0), _mm256_mul_pd(s2, vSeries));
+
+   return _mm256_add_pd(_mm256_mul_pd(vExponent, _mm256_set1_pd(SPECTRUM_LN2)), _mm256_mul_pd(s, vSeries));
+}
+
+SPECTRUM_TARGET_AVX2
+static inline void GetCosSin_AVX2(__m256d u, __m256d& vCos, __m256d& vSin)
+{
+   __m256d vQuarters = _mm256_mul_pd(_mm256_set1_pd(4.0), u);
+   __m128i vQuadrant = _mm256_cvttpd_epi32(_mm256_add_pd(vQuarters, _mm256_set1_pd(0.5)));
+   __m256d a = _mm256_mul_pd(_mm256_sub_pd(vQuarters, _mm256_cvtepi32_pd(vQuadrant)),
+                             _mm256_set1_pd(SPECTRUM_PI_OVER_2));
+   __m256d a2 = _mm256_mul_pd(a, a);
+
+   __m256d vS = _mm256_set1_pd(1.0 / 355687428096000.0);
+   vS = _mm256_sub_pd(_mm256_set1_pd(1.0 / 1307674368000.0), _mm256_mul_pd(a2, vS));
+   vS = _mm256_sub_pd(_mm256_set1_pd(1.0 / 6227020800.0), _mm256_mul_pd(a2, vS));
+   vS = _mm256_sub_pd(_mm256_set1_pd(1.0 / 39916800.0), _mm256_mul_pd(a2, vS));
+   vS = _mm256_sub_pd(_mm256_set1_pd(1.0 / 362880.0), _mm256_mul_pd(a2, vS));
+   vS = _mm256_sub_pd(_mm256_set1_pd(1.0 / 5040.0), _mm256_mul_pd(a2, vS));
+   vS = _mm256_sub_pd(_mm256_set1_pd(1.0 / 120.0), _mm256_mul_pd(a2, vS));
+   vS = _mm256_sub_pd(_mm256_set1_pd(1.0 / 6.0), _mm256_mul_pd(a2, vS));
+   vS = _mm256_sub_pd(_mm256_set1_pd(1.0), _mm256_mul_pd(a2, vS));
+   vS = _mm256_mul_pd(a, vS);
+
+   __m256d vC = _mm256_set1_pd(1.0 / 20922789888000.0);
+   vC = _mm256_sub_pd(_mm256_set1_pd(1.0 / 87178291200.0), _mm256_mul_pd(a2, vC));
+   vC = _mm256_sub_pd(_mm256_set1_pd(1.0 / 479001600.0), _mm256_mul_pd(a2, vC));
+   vC = _mm256_sub_pd(_mm256_set1_pd(1.0 / 3628800.0), _mm256_mul_pd(a2, vC));
+   vC = _mm256_sub_pd(_mm256_set1_pd(1.0 / 40320.0), _mm256_mul_pd(a2, vC));
+   vC = _mm256_sub_pd(_mm256_set1_pd(1.0 / 720.0), _mm256_mul_pd(a2, vC));
+   vC = _mm256_sub_pd(_mm256_set1_pd(1.0 / 24.0), _mm256_mul_pd(a2, vC));
+   vC = _mm256_sub_pd(_mm256_set1_pd(1.0 / 2.0), _mm256_mul_pd(a2, vC));
+   vC = _mm256_sub_pd(_mm256_set1_pd(1.0), _mm256_mul_pd(a2, vC));
+
+   __m256i vQuadrant64 = _mm256_cvtepi32_epi64(vQuadrant);
+   __m256i vOne64 = _mm256_set1_epi64x(1);
+   __m256d vSwap = _mm256_castsi256_pd(_mm256_sub_epi64(_mm256_setzero_si256(), _mm256_and_si256(vQuadrant64, vOne64)));
+   __m256d vCosSign = _mm256_castsi256_pd(_mm256_slli_epi64(
+      _mm256_and_si256(_mm256_xor_si256(vQuadrant64, _mm256_srli_epi64(vQuadrant64, 1)), vOne64), 63));
+   __m256d vSinSign = _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_srli_epi64(vQuadrant64, 1), 63));
+
+   vCos = _mm256_xor_pd(_mm256_blendv_pd(vC, vS, vSwap), vCosSign);
+   vSin = _mm256_xor_pd(_mm256_blendv_pd(vS, vC, vSwap), vSinSign);
+}
+
+SPECTRUM_TARGET_AVX2
+static inline void StoreGaussians_AVX2(__m128i w0, __m128i w1, __m128i w2, __m128i w3,
+                                       float* pReal, float* pImaginary)
+{
+   __m256d vRadius = _mm256_sqrt_pd(_mm256_mul_pd(_mm256_set1_pd(-2.0),
+      GetLog_AVX2(GetUniform_AVX2(w0, w1, _mm256_set1_pd(0.5)))));
+
+   __m256d vCos, vSin;
+   GetCosSin_AVX2(GetUniform_AVX2(w2, w3, _mm256_setzero_pd()), vCos, vSin);
+
+   _mm_storeu_ps(pReal, _mm256_cvtpd_ps(_mm256_mul_pd(vRadius, vCos)));
+   _mm_storeu_ps(pImaginary, _mm256_cvtpd_ps(_mm256_mul_pd(vRadius, vSin)));
+}
+
+SPECTRUM_TARGET_AVX2
+static void GaussianRow_AVX2(unsigned int nSeed, unsigned int nStream, int nX, int nZ0, int nCount,
+                             float* pReal, float* pImaginary)
+{
+   int i = 0;
+
+   for (; i + 8 <= nCount; i += 8)
+   {
+      __m256i c0 = _mm256_set1_epi32(nX);
+      __m256i c1 = _mm256_add_epi32(_mm256_set1_epi32(nZ0 + i), _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+      __m256i c2 = _mm256_set1_epi32((int)nStream);
+      __m256i c3 = _mm256_setzero_si256();
+      Philox4x32_AVX2(c0, c1, c2, c3, nSeed);
+
+      StoreGaussians_AVX2(_mm256_castsi256_si128(c0), _mm256_castsi256_si128(c1),
+                          _mm256_castsi256_si128(c2), _mm256_castsi256_si128(c3),
+                          pReal + i, pImaginary + i);
+      StoreGaussians_AVX2(_mm256_extracti128_si256(c0, 1), _mm256_extracti128_si256(c1, 1),
+                          _mm256_extracti128_si256(c2, 1), _mm256_extracti128_si256(c3, 1),
+                          pReal + i + 4, pImaginary + i + 4);
+   }
+
+   GaussianRow_Scalar(nSeed, nStream, nX, nZ0 + i, nCount - i, pReal + i, pImaginary + i);
+}
+
+SPECTRUM_TARGET_AVX2
+static inline __m256 GetExp_AVX2(__m256 x)
+{
+   x = _mm256_max_ps(x, _mm256_set1_ps(SPECTRUM_EXP_MIN));
+   x = _mm256_min_ps(x, _mm256_set1_ps(SPECTRUM_EXP_MAX));
+
+   __m256 vRound = _mm256_set1_ps(SPECTRUM_EXP_ROUND);
+   __m256 n = _mm256_sub_ps(_mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(SPECTRUM_EXP_LOG2E)), vRound), vRound);
+   __m256 r = _mm256_sub_ps(x, _mm256_mul_ps(n, _mm256_set1_ps(SPECTRUM_EXP_LN2_HIGH)));
+   r = _mm256_sub_ps(r, _mm256_mul_ps(n, _mm256_set1_ps(SPECTRUM_EXP_LN2_LOW)));
+   __m256 r2 = _mm256_mul_ps(r, r);
+
+   __m256 p = _mm256_set1_ps(SPECTRUM_EXP_P0);
+   p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(SPECTRUM_EXP_P1));
+   p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(SPECTRUM_EXP_P2));
+   p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(SPECTRUM_EXP_P3));
+   p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(SPECTRUM_EXP_P4));
+   p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(SPECTRUM_EXP_P5));
+   p = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(p, r2), r), _mm256_set1_ps(1.0f));
+
+   __m256i vBits = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvttps_epi32(n), _mm256_set1_epi32(127)), 23);
+   return _mm256_mul_ps(p, _mm256_castsi256_ps(vBits));
+}
+
+SPECTRUM_TARGET_AVX2
+static inline __m256 GetPhillipsSpectrum_AVX2(__m256 vKX, __m256 vKZ, __m256 vKSquared,
+                                              const PhillipsParameters& parameters)
+{
+   __m256 vL = _mm256_set1_ps(parameters.fWindspeedGravity);
+   __m256 vKSquaredWindspeed = _mm256_mul_ps(_mm256_mul_ps(vKSquared, vL), vL);
+   __m256 vPerpend = _mm256_add_ps(_mm256_mul_ps(vKX, _mm256_set1_ps(parameters.fWindX)),
+                                   _mm256_mul_ps(vKZ, _mm256_set1_ps(parameters.fWindZ)));
+
+   __m256 vExp = GetExp_AVX2(_mm256_div_ps(_mm256_set1_ps(-1.0f), vKSquaredWindspeed));
+   __m256 vSpectrum = _mm256_mul_ps(
+      _mm256_mul_ps(_mm256_set1_ps(parameters.fPhillipsConstant),
+                    _mm256_div_ps(vExp, _mm256_mul_ps(vKSquared, vKSquared))),
+      _mm256_mul_ps(vPerpend, vPerpend));
+
+   return _mm256_and_ps(vSpectrum, _mm256_cmp_ps(vKSquared, _mm256_setzero_ps(), _CMP_NEQ_UQ));
+}
+
+SPECTRUM_TARGET_AVX2
+static void AmplitudeRow_AVX2(const float* pKX, const float* pKZ,
+                              const float* pGaussianReal, const float* pGaussianImaginary, int nCount,
+                              const PhillipsParameters& parameters, float* pReal, float* pImaginary)
+{
+   __m256 vScale = _mm256_set1_ps(parameters.fAmplitudeScale);
+   int i = 0;
+
+   for (; i + 8 <= nCount; i += 8)
+   {
+      __m256 vKX = _mm256_loadu_ps(pKX + i);
+      __m256 vKZ = _mm256_loadu_ps(pKZ + i);
+
+      __m256 vKSquared = _mm256_add_ps(_mm256_mul_ps(vKX, vKX), _mm256_mul_ps(vKZ, vKZ));
+      __m256 vRoot = _mm256_sqrt_ps(GetPhillipsSpectrum_AVX2(vKX, vKZ, vKSquared, parameters));
+
+      _mm256_storeu_ps(pReal + i,
+         _mm256_mul_ps(_mm256_mul_ps(vScale, _mm256_loadu_ps(pGaussianReal + i)), vRoot));
+      _mm256_storeu_ps(pImaginary + i,
+         _mm256_mul_ps(_mm256_mul_ps(vScale, _mm256_loadu_ps(pGaussianImaginary + i)), vRoot));
+   }
+
+   AmplitudeRow_Scalar(pKX + i, pKZ + i, pGaussianReal + i, pGaussianImaginary + i, nCount - i,
+                       parameters, pReal + i, pImaginary + i);
+}
+
+SPECTRUM_TARGET_AVX2
+static void DispersionRow_AVX2(const float* pKX, const float* pKZ, int nCount, float fGravity, float* pOutput)
+{
+   __m256 vGravity = _mm256_set1_ps(fGravity);
+   int i = 0;
+
+   for (; i + 8 <= nCount; i += 8)
+   {
+      __m256 vKX = _mm256_loadu_ps(pKX + i);
+      __m256 vKZ = _mm256_loadu_ps(pKZ + i);
+
+      __m256 vDistance = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(vKX, vKX), _mm256_mul_ps(vKZ, vKZ)));
+      _mm256_storeu_ps(pOutput + i, _mm256_sqrt_ps(_mm256_mul_ps(vDistance, vGravity)));
+   }
+
+   DispersionRow_Scalar(pKX + i, pKZ + i, nCount - i, fGravity, pOutput + i);
+}
+
+SPECTRUM_TARGET_AVX2
+static void EvolveRow_AVX2(const SpectrumEvolutionRow& row, int nCount, bool blAdvancePhasors, bool blChoppy,
+                           float* const* ppReal, float* const* ppImaginary)
+{
+   __m256 vSign = _mm256_set1_ps(-0.0f);
+   int i = 0;
+
+   for (; i + 8 <= nCount; i += 8)
+   {
+      __m256 vCos = _mm256_loadu_ps(row.pPhasorReal + i);
+      __m256 vSin = _mm256_loadu_ps(row.pPhasorImaginary + i);
+
+      if (blAdvancePhasors)
+      {
+         __m256 vStepReal = _mm256_loadu_ps(row.pPhasorStepReal + i);
+         __m256 vStepImaginary = _mm256_loadu_ps(row.pPhasorStepImaginary + i);
+         __m256 vReal = _mm256_sub_ps(_mm256_mul_ps(vCos, vStepReal), _mm256_mul_ps(vSin, vStepImaginary));
+         __m256 vImaginary = _mm256_add_ps(_mm256_mul_ps(vCos, vStepImaginary), _mm256_mul_ps(vSin, vStepReal));
+
+         vCos = vReal;
+         vSin = vImaginary;
+         _mm256_storeu_ps(row.pPhasorReal + i, vCos);
+         _mm256_storeu_ps(row.pPhasorImaginary + i, vSin);
+      }
+
+      __m256 vHReal = _mm256_sub_ps(_mm256_mul_ps(_mm256_loadu_ps(row.pH0SumReal + i), vCos),
+                                    _mm256_mul_ps(_mm256_loadu_ps(row.pH0SumImaginary + i), vSin));
+      __m256 vHImaginary = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(row.pH0DifferenceReal + i), vSin),
+                                         _mm256_mul_ps(_mm256_loadu_ps(row.pH0DifferenceImaginary + i), vCos));
+
+      _mm256_storeu_ps(ppReal[0] + i, vHReal);
+      _mm256_storeu_ps(ppImaginary[0] + i, vHImaginary);
+
+      __m256 vKX = _mm256_loadu_ps(row.pKX + i);
+      __m256 vKZ = _mm256_loadu_ps(row.pKZ + i);
+      _mm256_storeu_ps(ppReal[1] + i, _mm256_xor_ps(_mm256_mul_ps(vKX, vHImaginary), vSign));
+      _mm256_storeu_ps(ppImaginary[1] + i, _mm256_mul_ps(vKX, vHReal));
+      _mm256_storeu_ps(ppReal[2] + i, _mm256_xor_ps(_mm256_mul_ps(vKZ, vHImaginary), vSign));
+      _mm256_storeu_ps(ppImaginary[2] + i, _mm256_mul_ps(vKZ, vHReal));
+
+      if (blChoppy)
+      {
+         __m256 vUnitKX = _mm256_loadu_ps(row.pUnitKX + i);
+         __m256 vUnitKZ = _mm256_loadu_ps(row.pUnitKZ + i);
+         _mm256_storeu_ps(ppReal[3] + i, _mm256_mul_ps(vUnitKX, vHImaginary));
+         _mm256_storeu_ps(ppImaginary[3] + i, _mm256_xor_ps(_mm256_mul_ps(vUnitKX, vHReal), vSign));
+         _mm256_storeu_ps(ppReal[4] + i, _mm256_mul_ps(vUnitKZ, vHImaginary));
+         _mm256_storeu_ps(ppImaginary[4] + i, _mm256_xor_ps(_mm256_mul_ps(vUnitKZ, vHReal), vSign));
+      }
+   }
+
+   EvolveBins_Scalar(row, i, nCount, blAdvancePhasors, blChoppy, ppReal, ppImaginary);
+}
+#endif
+
+void GetSpectrumKernels(int nSimdLevel, SpectrumKernelTable& kernels)
+{
+   kernels.nSimdLevel = SIMD_LEVEL_SCALAR;
+   kernels.pfnGaussianRow = GaussianRow_Scalar;
+   kernels.pfnAmplitudeRow = AmplitudeRow_Scalar;
+   kernels.pfnDispersionRow = DispersionRow_Scalar;
+   kernels.pfnEvolveRow = EvolveRow_Scalar;
+
+#ifdef SPECTRUM_KERNELS_SSE2
+   if (nSimdLevel >= SIMD_LEVEL_SSE2)
+   {
+      kernels.nSimdLevel = SIMD_LEVEL_SSE2;
+      kernels.pfnGaussianRow = GaussianRow_SSE2;
+      kernels.pfnAmplitudeRow = AmplitudeRow_SSE2;
+      kernels.pfnDispersionRow = DispersionRow_SSE2;
+      kernels.pfnEvolveRow = EvolveRow_SSE2;
+   }
+#endif
+
+#ifdef SPECTRUM_KERNELS_AVX2
+   if (nSimdLevel >= SIMD_LEVEL_AVX2)
+   {
+      kernels.nSimdLevel = SIMD_LEVEL_AVX2;
+      kernels.pfnGaussianRow = GaussianRow_AVX2;
+      kernels.pfnAmplitudeRow = AmplitudeRow_AVX2;
+      kernels.pfnDispersionRow = DispersionRow_AVX2;
+      kernels.pfnEvolveRow = EvolveRow_AVX2;
+   }
+#endif
+}
@@ -0,0 +1,129 @@
+// -------------------------------------------------------------------------
+// Sean Janis
+// spjanis@gmail.com
+// Water Simulations
+//
+// SpectrumKernels
+//       Row kernels that build the ocean's initial spectrum: the Gaussian
+//       draws, the Phillips amplitudes h0(k) and the dispersion w(k), and
+//       the one that evolves it every frame. Each kernel has a scalar, SSE2 and AVX2 version, picked at runtime like
+//       the FFT kernels.
+//
+//       All versions perform the same IEEE operations in the same order, so
+//       every SIMD level builds a bit-identical spectrum and a seed gives
+//       the same ocean on every machine. The Gaussians follow Philox.h
+//       exactly. The Phillips spectrum replaces the library exp with
+//       SpectrumExp, a Cody-Waite reduction and a degree 6 polynomial with
+//       a relative error below 1e-7 (1.5 ulp) over [-87, 88], below which
+//       it returns e^-87; divisions and square roots are the correctly
+//       rounded IEEE ones. Identical results need single precision float arithmetic
+//       (x64, or /arch:SSE2 on x86) and no FMA contraction.
+// -------------------------------------------------------------------------
+#pragma once
+
+// -------------------------------------------------------------------------
+// Constants of the Phillips spectrum, shared by every bin.
+// -------------------------------------------------------------------------
+struct PhillipsParameters
+{
+   float fWindX;
+   float fWindZ;
+   float fWindspeedGravity;      // L = V^2 / g, the largest wave
+   float fPhillipsConstant;      // A
+   float fAmplitudeScale;        // 1 / sqrt(2)
+};
+
+// -------------------------------------------------------------------------
+// The kernels read and write split planes, such as the rows of a
+// CComplexField2D: bin i of a complex row is pReal[i] + i * pImaginary[i],
+// and of a wave vector row (pKX[i], pKZ[i]).
+//
+// Gaussian pairs for nCount bins of one row, at wave numbers (nX, nZ0 + i),
+// written to pReal[i] and pImaginary[i] as GetPhiloxGaussians would.
+// -------------------------------------------------------------------------
+typedef void (*SpectrumGaussianRowFunc)(
+   unsigned int nSeed,
+   unsigned int nStream,
+   int nX,
+   int nZ0,
+   int nCount,
+   float* pReal,
+   float* pImaginary);
+
+// -------------------------------------------------------------------------
+// h0(k) = A / sqrt(2) * gaussian * sqrt(P(k)) for nCount bins, with
+// P(k) = A * exp(-1 / (k L)^2) / k^4 * (k . V)^2 and P(0) = 0.
+// -------------------------------------------------------------------------
+typedef void (*SpectrumAmplitudeRowFunc)(
+   const float* pKX,
+   const float* pKZ,
+   const float* pGaussianReal,
+   const float* pGaussianImaginary,
+   int nCount,
+   const PhillipsParameters& parameters,
+   float* pReal,
+   float* pImaginary);
+
+// -------------------------------------------------------------------------
+// Deep water dispersion w(k) = sqrt(g * |k|) for nCount bins.
+// -------------------------------------------------------------------------
+typedef void (*SpectrumDispersionRowFunc)(
+   const float* pKX,
+   const float* pKZ,
+   int nCount,
+   float fGravity,
+   float* pOutput);
+
+// -------------------------------------------------------------------------
+// One run of stored spectrum bins for the per-frame evolution, every array
+// starting at the same bin.
+// -------------------------------------------------------------------------
+struct SpectrumEvolutionRow
+{
+   const float* pH0SumReal;               // h0(k) + h0(-k)
+   const float* pH0SumImaginary;
+   const float* pH0DifferenceReal;        // h0(k) - h0(-k)
+   const float* pH0DifferenceImaginary;
+   const float* pKX;
+   const float* pKZ;
+   const float* pUnitKX;
+   const float* pUnitKZ;
+   float* pPhasorReal;                    // exp{i*w(k)*t}
+   float* pPhasorImaginary;
+   const float* pPhasorStepReal;          // exp{i*w(k)*dt}
+   const float* pPhasorStepImaginary;
+};
+
+// -------------------------------------------------------------------------
+// h(k, t) for nCount bins of row, first advancing each phasor by its step
+// if blAdvancePhasors, and the fields that follow from it, written to
+// ppReal[f][i] and ppImaginary[f][i] in the order of OCEAN_FIELD_*: the
+// height, the x and z slopes i * k * h and, if blChoppy, the x and z
+// displacements -i * k / |k| * h.
+// -------------------------------------------------------------------------
+typedef void (*SpectrumEvolveRowFunc)(
+   const SpectrumEvolutionRow& row,
+   int nCount,
+   bool blAdvancePhasors,
+   bool blChoppy,
+   float* const* ppReal,
+   float* const* ppImaginary);
+
+struct SpectrumKernelTable
+{
+   int nSimdLevel;
+   SpectrumGaussianRowFunc pfnGaussianRow;
+   SpectrumAmplitudeRowFunc pfnAmplitudeRow;
+   SpectrumDispersionRowFunc pfnDispersionRow;
+   SpectrumEvolveRowFunc pfnEvolveRow;
+};
+
+// -------------------------------------------------------------------------
+// Fills the table with the best kernels available at or below nSimdLevel.
+// -------------------------------------------------------------------------
+void GetSpectrumKernels(int nSimdLevel, SpectrumKernelTable& kernels);
+
+// -------------------------------------------------------------------------
+// The exp approximation the kernels use. x is clamped to [-87, 88].
+// -------------------------------------------------------------------------
+float SpectrumExp(float x);
@@ -0,0 +1,461 @@
+#include <math.h>
+#include <string.h>
+#include "SpectrumModel.h"
+
+#define SPECTRUM_PI                          3.14159265358979323846
+
+// -------------------------------------------------------------------------
+// Pierson-Moskowitz: alpha and the peak of a fully developed sea.
+// JONSWAP: the widths of the peak below and above it.
+// Mitsuyasu: the spreading exponent at the peak is 11.5 (g / (wp U))^2.5.
+// -------------------------------------------------------------------------
+#define SPECTRUM_PM_ALPHA                    8.1e-3
+#define SPECTRUM_PM_PEAK                     0.855
+#define SPECTRUM_JONSWAP_SIGMA_LOW           0.07
+#define SPECTRUM_JONSWAP_SIGMA_HIGH          0.09
+#define SPECTRUM_MITSUYASU_PEAK_EXPONENT     11.5
+
+// -------------------------------------------------------------------------
+// log(Gamma(x)) for x >= 1/2, by the Lanczos approximation (g = 7, n = 9),
+// good to about 1e-15.
+// -------------------------------------------------------------------------
+static double GetLogGamma(double x)
+{
+   static const double s_adCoefficients[9] =
+   {
+      0.99999999999980993,
+      676.5203681218851,
+      -1259.1392167224028,
+      771.32342877765313,
+      -176.61502916214059,
+      12.507343278686905,
+      -0.13857109526572012,
+      9.9843695780195716e-6,
+      1.5056327351493116e-7
+   };
+
+   x -= 1.0;
+   double dSum = s_adCoefficients[0];
+
+   for (int i = 1; i < 9; i++)
+   {
+      dSum += s_adCoefficients[i] / (x + i);
+   }
+
+   double t = x + 7.5;
+   return 0.5 * log(2.0 * SPECTRUM_PI) + (x + 0.5) * log(t) - t + log(dSum);
+}
+
+// -------------------------------------------------------------------------
+// The normalized Longuet-Higgins spreading
+// 2^(2s - 1) / PI * Gamma(s + 1)^2 / Gamma(2s + 1) * cos^2s(theta / 2),
+// with cos^2(theta / 2) = (1 + cos theta) / 2.
+// -------------------------------------------------------------------------
+static double GetCosine2SSpreading(double dCosine, double s)
+{
+   double dHalfCosine = 0.5 * (1.0 + dCosine);
+
+   if (dHalfCosine <= 0.0)
+   {
+      return (s > 0.0) ? 0.0 : 0.5 / SPECTRUM_PI;
+   }
+
+   double dLogNormalization = (2.0 * s - 1.0) * log(2.0) + 2.0 * GetLogGamma(s + 1.0) - GetLogGamma(2.0 * s + 1.0);
+   return exp(dLogNormalization + s * log(dHalfCosine)) / SPECTRUM_PI;
+}
+
+// -------------------------------------------------------------------------
+// CSpectrumModel
+// -------------------------------------------------------------------------
+CSpectrumModel::CSpectrumModel()
+{
+   memset(&m_SeaState, 0, sizeof(m_SeaState));
+   m_dWindSpeed = 0.0;
+   m_dWindDirectionX = 1.0;
+   m_dWindDirectionZ = 0.0;
+}
+
+CSpectrumModel::~CSpectrumModel()
+{
+}
+
+void CSpectrumModel::SetSeaState(const OceanSeaState& seaState)
+{
+   m_SeaState = seaState;
+   m_dWindSpeed = sqrt((double)seaState.fWindX * seaState.fWindX + (double)seaState.fWindZ * seaState.fWindZ);
+
+   if (m_dWindSpeed > 0.0)
+   {
+      m_dWindDirectionX = seaState.fWindX / m_dWindSpeed;
+      m_dWindDirectionZ = seaState.fWindZ / m_dWindSpeed;
+   }
+   else
+   {
+      m_dWindDirectionX = 1.0;
+      m_dWindDirectionZ = 0.0;
+   }
+}
+
+double CSpectrumModel::GetSpreading(double dK, double dCosine)
+{
+   switch (m_SeaState.nSpreading)
+   {
+   case OCEAN_SPREADING_COSINE_2S:
+      return GetCosine2SSpreading(dCosine, m_SeaState.fSpreadingExponent);
+
+   case OCEAN_SPREADING_MITSUYASU:
+      {
+         // -------------------------------------------------------------------------
+         // Without wind there is no peak to fit to; the sea is isotropic.
+         // -------------------------------------------------------------------------
+         double dPeakFrequency = GetPeakFrequency();
+
+         if (m_dWindSpeed <= 0.0 || dPeakFrequency <= 0.0)
+         {
+            return 0.5 / SPECTRUM_PI;
+         }
+
+         double dOmega = sqrt(m_SeaState.fGravity * dK);
+         double dRatio = dOmega / dPeakFrequency;
+         double dPeakExponent = SPECTRUM_MITSUYASU_PEAK_EXPONENT *
+            pow(m_SeaState.fGravity / (dPeakFrequency * m_dWindSpeed), 2.5);
+         double s = (dRatio <= 1.0) ? dPeakExponent * pow(dRatio, 5.0) : dPeakExponent * pow(dRatio, -2.5);
+
+         return GetCosine2SSpreading(dCosine, s);
+      }
+
+   default:
+      return dCosine * dCosine / SPECTRUM_PI;
+   }
+}
+
+bool CSpectrumModel::IsSpreadingRadial()
+{
+   return m_SeaState.nSpreading == OCEAN_SPREADING_MITSUYASU;
+}
+
+double CSpectrumModel::GetSpectrum(const KWaveVector& k)
+{
+   double dK = sqrt((double)k.fX * k.fX + (double)k.fZ * k.fZ);
+
+   if (dK == 0.0)
+   {
+      return 0.0;
+   }
+
+   double dCosine = (k.fX * m_dWindDirectionX + k.fZ * m_dWindDirectionZ) / dK;
+   dCosine = (dCosine < -1.0) ? -1.0 : ((dCosine > 1.0) ? 1.0 : dCosine);
+
+   return GetRadialSpectrum(dK) * GetSpreading(dK, dCosine);
+}
+
+float CSpectrumModel::GetWindDirectionX()
+{
+   return (float)m_dWindDirectionX;
+}
+
+float CSpectrumModel::GetWindDirectionZ()
+{
+   return (float)m_dWindDirectionZ;
+}
+
+double CSpectrumModel::GetRadialFromFrequency(double dK, double dOmega, double dFrequencySpectrum)
+{
+   double dGroupFactor = m_SeaState.fGravity / (2.0 * dOmega);
+   return dFrequencySpectrum * dGroupFactor / dK * m_SeaState.fBinArea;
+}
+
+double CSpectrumModel::GetPiersonMoskowitzShape(double dOmega, double dAlpha, double dPeakFrequency)
+{
+   double g = m_SeaState.fGravity;
+   double dPeakRatio = dPeakFrequency / dOmega;
+   double dPeakRatio2 = dPeakRatio * dPeakRatio;
+   double dOmega2 = dOmega * dOmega;
+
+   return dAlpha * g * g / (dOmega2 * dOmega2 * dOmega) * exp(-1.25 * dPeakRatio2 * dPeakRatio2);
+}
+
+// -------------------------------------------------------------------------
+// Phillips: P(k) = A * exp(-1 / (k L)^2) / k^4 * (k . V)^2 with L = V^2 / g.
+// (k . V)^2 = k^2 V^2 cos^2(theta) = k^2 V^2 * PI * D(theta) for the
+// normalized cosine squared spreading. The spectrum peaks at k = 1 / L.
+// -------------------------------------------------------------------------
+double CPhillipsSpectrum::GetRadialSpectrum(double dK)
+{
+   if (m_dWindSpeed <= 0.0)
+   {
+      return 0.0;
+   }
+
+   double dWindSpeed2 = m_dWindSpeed * m_dWindSpeed;
+   double dLargestWave = dWindSpeed2 / m_SeaState.fGravity;
+   double dKL = dK * dLargestWave;
+
+   return m_SeaState.fPhillipsConstant * dWindSpeed2 * SPECTRUM_PI * exp(-1.0 / (dKL * dKL)) / (dK * dK);
+}
+
+double CPhillipsSpectrum::GetPeakFrequency()
+{
+   return (m_dWindSpeed > 0.0) ? m_SeaState.fGravity / m_dWindSpeed : 0.0;
+}
+
+// -------------------------------------------------------------------------
+// Pierson-Moskowitz
+// -------------------------------------------------------------------------
+double CPiersonMoskowitzSpectrum::GetRadialSpectrum(double dK)
+{
+   if (m_dWindSpeed <= 0.0)
+   {
+      return 0.0;
+   }
+
+   double dOmega = sqrt(m_SeaState.fGravity * dK);
+   double dSpectrum = GetPiersonMoskowitzShape(dOmega, SPECTRUM_PM_ALPHA, GetPeakFrequency());
+
+   return GetRadialFromFrequency(dK, dOmega, dSpectrum);
+}
+
+double CPiersonMoskowitzSpectrum::GetPeakFrequency()
+{
+   return (m_dWindSpeed > 0.0) ? SPECTRUM_PM_PEAK * m_SeaState.fGravity / m_dWindSpeed : 0.0;
+}
+
+// -------------------------------------------------------------------------
+// JONSWAP: alpha = 0.076 (U^2 / (F g))^0.22, wp = 22 (g^2 / (U F))^(1/3),
+// and the peak raised by gamma^r, r = exp(-(w - wp)^2 / (2 sigma^2 wp^2)).
+// -------------------------------------------------------------------------
+void CJonswapSpectrum::SetSeaState(const OceanSeaState& seaState)
+{
+   CSpectrumModel::SetSeaState(seaState);
+
+   double g = seaState.fGravity;
+   double dFetch = seaState.fFetch;
+
+   if (m_dWindSpeed > 0.0 && dFetch > 0.0)
+   {
+      m_dAlpha = 0.076 * pow(m_dWindSpeed * m_dWindSpeed / (dFetch * g), 0.22);
+      m_dPeakFrequency = 22.0 * pow(g * g / (m_dWindSpeed * dFetch), 1.0 / 3.0);
+   }
+   else
+   {
+      m_dAlpha = 0.0;
+      m_dPeakFrequency = 0.0;
+   }
+}
+
+double CJonswapSpectrum::GetFrequencySpectrum(double dOmega)
+{
+   double dSigma = (dOmega <= m_dPeakFrequency) ? SPECTRUM_JONSWAP_SIGMA_LOW : SPECTRUM_JONSWAP_SIGMA_HIGH;
+   double dOffset = (dOmega - m_dPeakFrequency) / (dSigma * m_dPeakFrequency);
+   double r = exp(-0.5 * dOffset * dOffset);
+
+   return GetPiersonMoskowitzShape(dOmega, m_dAlpha, m_dPeakFrequency) * pow((double)m_SeaState.fPeakEnhancement, r);
+}
+
+double CJonswapSpectrum::GetRadialSpectrum(double dK)
+{
+   if (m_dPeakFrequency <= 0.0)
+   {
+      return 0.0;
+   }
+
+   double dOmega = sqrt(m_SeaState.fGravity * dK);
+   return GetRadialFromFrequency(dK, dOmega, GetFrequencySpectrum(dOmega));
+}
+
+double CJonswapSpectrum::GetPeakFrequency()
+{
+   return m_dPeakFrequency;
+}
+
+// -------------------------------------------------------------------------
+// TMA: JONSWAP times the Kitaigorodskii depth attenuation, a function of
+// wh = w * sqrt(h / g). The dispersion itself stays the deep water one.
+// -------------------------------------------------------------------------
+double CTMASpectrum::GetRadialSpectrum(double dK)
+{
+   if (m_dPeakFrequency <= 0.0)
+   {
+      return 0.0;
+   }
+
+   double dOmega = sqrt(m_SeaState.fGravity * dK);
+   double dOmegaH = dOmega * sqrt(m_SeaState.fDepth / m_SeaState.fGravity);
+   double dAttenuation = 1.0;
+
+   if (dOmegaH <= 1.0)
+   {
+      dAttenuation = 0.5 * dOmegaH * dOmegaH;
+   }
+   else if (dOmegaH < 2.0)
+   {
+      dAttenuation = 1.0 - 0.5 * (2.0 - dOmegaH) * (2.0 - dOmegaH);
+   }
+
+   return GetRadialFromFrequency(dK, dOmega, GetFrequencySpectrum(dOmega) * dAttenuation);
+}
+
+CSpectrumModel* CreateSpectrumModel(int nModel)
+{
+   switch (nModel)
+   {
+   case OCEAN_SPECTRUM_PHILLIPS:
+      return new CPhillipsSpectrum;
+   case OCEAN_SPECTRUM_PIERSON_MOSKOWITZ:
+      return new CPiersonMoskowitzSpectrum;
+   case OCEAN_SPECTRUM_JONSWAP:
+      return new CJonswapSpectrum;
+   case OCEAN_SPECTRUM_TMA:
+      return new CTMASpectrum;
+   }
+
+   return NULL;
+}
+
+// -------------------------------------------------------------------------
+// CSpectrumLookup
+// -------------------------------------------------------------------------
+#define SPECTRUM_LOOKUP_RADIAL_SHIFT         (23 - OCEAN_SPECTRUM_LOOKUP_RADIAL_BITS)
+#define SPECTRUM_LOOKUP_SPREADING_SHIFT      (23 - OCEAN_SPECTRUM_LOOKUP_SPREADING_BITS)
+
+static inline int GetFloatBits(float f)
+{
+   int nBits;
+   memcpy(&nBits, &f, sizeof(nBits));
+   return nBits;
+}
+
+static inline float GetBitsFloat(int nBits)
+{
+   float f;
+   memcpy(&f, &nBits, sizeof(f));
+   return f;
+}
+
+CSpectrumLookup::CSpectrumLookup()
+{
+   m_nBaseBits = 0;
+   m_nMaxOffset = 0;
+   m_nSpreadingRows = 0;
+   m_fWindDirectionX = 1.0f;
+   m_fWindDirectionZ = 0.0f;
+}
+
+void CSpectrumLookup::Build(CSpectrumModel* pModel, float fKMin, float fKMax)
+{
+   // -------------------------------------------------------------------------
+   // The first sample sits at or below fKMin on the coarser spreading grid,
+   // so the radial and spreading rows share it. One sample past fKMax
+   // keeps every interpolation inside the tables.
+   // -------------------------------------------------------------------------
+   m_nBaseBits = GetFloatBits(fKMin) & ~((1 << SPECTRUM_LOOKUP_SPREADING_SHIFT) - 1);
+   int nRange = GetFloatBits(fKMax) - m_nBaseBits;
+   int nRadialCount = (nRange >> SPECTRUM_LOOKUP_RADIAL_SHIFT) + 2;
+   m_nMaxOffset = ((nRadialCount - 1) << SPECTRUM_LOOKUP_RADIAL_SHIFT) - 1;
+
+   m_Radial.resize(nRadialCount);
+
+   for (int i = 0; i < nRadialCount; i++)
+   {
+      float fK = GetBitsFloat(m_nBaseBits + (i << SPECTRUM_LOOKUP_RADIAL_SHIFT));
+      m_Radial[i] = (float)pModel->GetRadialSpectrum(fK);
+   }
+
+   m_nSpreadingRows = pModel->IsSpreadingRadial() ? (m_nMaxOffset >> SPECTRUM_LOOKUP_SPREADING_SHIFT) + 2 : 1;
+   m_Spreading.resize(m_nSpreadingRows * (OCEAN_SPECTRUM_LOOKUP_COSINES + 1));
+
+   for (int r = 0; r < m_nSpreadingRows; r++)
+   {
+      float fK = GetBitsFloat(m_nBaseBits + (r << SPECTRUM_LOOKUP_SPREADING_SHIFT));
+      float* pRow = &m_Spreading[r * (OCEAN_SPECTRUM_LOOKUP_COSINES + 1)];
+
+      for (int c = 0; c <= OCEAN_SPECTRUM_LOOKUP_COSINES; c++)
+      {
+         double dHalfCosine = (double)c / OCEAN_SPECTRUM_LOOKUP_COSINES;
+         pRow[c] = (float)pModel->GetSpreading(fK, 2.0 * dHalfCosine * dHalfCosine - 1.0);
+      }
+   }
+
+   m_fWindDirectionX = pModel->GetWindDirectionX();
+   m_fWindDirectionZ = pModel->GetWindDirectionZ();
+}
+
+float CSpectrumLookup::GetSpectrum(const KWaveVector& k) const
+{
+   float fKSquared = k.fX * k.fX + k.fZ * k.fZ;
+
+   if (fKSquared == 0.0f)
+   {
+      return 0.0f;
+   }
+
+   float fK = sqrtf(fKSquared);
+
+   // -------------------------------------------------------------------------
+   // Radial table position from the bits of |k|.
+   // -------------------------------------------------------------------------
+   int nOffset = GetFloatBits(fK) - m_nBaseBits;
+   nOffset = (nOffset < 0) ? 0 : ((nOffset > m_nMaxOffset) ? m_nMaxOffset : nOffset);
+
+   int nRadial = nOffset >> SPECTRUM_LOOKUP_RADIAL_SHIFT;
+   float fRadialT = (float)(nOffset & ((1 << SPECTRUM_LOOKUP_RADIAL_SHIFT) - 1)) *
+      (1.0f / (1 << SPECTRUM_LOOKUP_RADIAL_SHIFT));
+   float fRadial = m_Radial[nRadial] + (m_Radial[nRadial + 1] - m_Radial[nRadial]) * fRadialT;
+
+   // -------------------------------------------------------------------------
+   // Spreading column from cos(theta / 2), and row from |k| if it has rows.
+   // -------------------------------------------------------------------------
+   float fCosine = (k.fX * m_fWindDirectionX + k.fZ * m_fWindDirectionZ) / fK;
+   float fHalfCosine2 = (fCosine + 1.0f) * 0.5f;
+   fHalfCosine2 = (fHalfCosine2 < 0.0f) ? 0.0f : fHalfCosine2;
+
+   float fColumn = sqrtf(fHalfCosine2) * OCEAN_SPECTRUM_LOOKUP_COSINES;
+
+   int nColumn = (int)fColumn;
+   nColumn = (nColumn > OCEAN_SPECTRUM_LOOKUP_COSINES - 1) ? OCEAN_SPECTRUM_LOOKUP_COSINES - 1 : nColumn;
+   float fColumnT = fColumn - (float)nColumn;
+
+   const float* pRow = &m_Spreading[nColumn];
+   float fSpreading;
+
+   if (m_nSpreadingRows > 1)
+   {
+      int nRow = nOffset >> SPECTRUM_LOOKUP_SPREADING_SHIFT;
+      float fRowT = (float)(nOffset & ((1 << SPECTRUM_LOOKUP_SPREADING_SHIFT) - 1)) *
+         (1.0f / (1 << SPECTRUM_LOOKUP_SPREADING_SHIFT));
+
+      pRow += nRow * (OCEAN_SPECTRUM_LOOKUP_COSINES + 1);
+      const float* pNextRow = pRow + (OCEAN_SPECTRUM_LOOKUP_COSINES + 1);
+
+      float fSpreading0 = pRow[0] + (pRow[1] - pRow[0]) * fColumnT;
+      float fSpreading1 = pNextRow[0] + (pNextRow[1] - pNextRow[0]) * fColumnT;
+      fSpreading = fSpreading0 + (fSpreading1 - fSpreading0) * fRowT;
+   }
+   else
+   {
+      fSpreading = pRow[0] + (pRow[1] - pRow[0]) * fColumnT;
+   }
+
+   return fRadial * fSpreading;
+}
+
+void CSpectrumLookup::GetAmplitudeRow(const float* pKX,
+                                      const float* pKZ,
+                                      const float* pGaussianReal,
+                                      const float* pGaussianImaginary,
+                                      int nCount,
+                                      float fAmplitudeScale,
+                                      float* pReal,
+                                      float* pImaginary) const
+{
+   for (int i = 0; i < nCount; i++)
+   {
+      KWaveVector k;
+      k.fX = pKX[i];
+      k.fZ = pKZ[i];
+
+      float fRootSpectrum = sqrtf(GetSpectrum(k));
+      pReal[i] = fAmplitudeScale * pGaussianReal[i] * fRootSpectrum;
+      pImaginary[i] = fAmplitudeScale * pGaussianImaginary[i] * fRootSpectrum;
+   }
+}
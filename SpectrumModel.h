@@ -0,0 +1,219 @@
+// -------------------------------------------------------------------------
+// Sean Janis
+// spjanis@gmail.com
+// Water Simulations
+//
+// CSpectrumModel
+//       Wave spectrum models for the ocean's initial amplitudes. A model
+//       gives the variance E(k) of every Fourier bin as a radial part R(|k|)
+//       times a directional spreading D(|k|, cos theta), where theta is the
+//       angle between k and the wind. h0(k) is then a Gaussian draw times
+//       sqrt(E(k) / 2).
+//
+//       Phillips is the original empirical model; its constant A sets the
+//       wave height. Pierson-Moskowitz (a fully developed sea), JONSWAP (a
+//       fetch-limited sea) and TMA (JONSWAP in finite depth) are frequency
+//       spectra S(w) fitted to measured seas; their heights follow from the
+//       wind, fetch and depth alone. They are converted to the wave number
+//       spectrum through the deep water dispersion w^2 = g * |k| that the
+//       simulation uses, and integrated over the bin area dk^2.
+//
+//       See Horvath, "Empirical Directional Wave Spectra for Computer
+//       Graphics" (DigiPro 2015), for the formulas and their constants.
+//
+// CSpectrumLookup
+//       A model's E(k) tabulated for one sea state, so that the amplitudes
+//       cost a few table reads per bin instead of the model's
+//       transcendentals. Building the tables evaluates the model a few
+//       thousand times, independent of the FFT size.
+//
+//       The radial samples are spaced evenly in the bit pattern of the
+//       float |k|, which is linear in |k| within each octave, so the table
+//       index is an integer subtraction and shift and the interpolation is
+//       linear in |k|. The spreading is tabulated over cos(theta / 2),
+//       which keeps the cos^2s(theta / 2) lobes smooth for every s, as a 2D
+//       table bilinearly interpolated when it depends on |k| and as a
+//       single row otherwise.
+// -------------------------------------------------------------------------
+#pragma once
+
+#include <vector>
+#include "KWaveVector.h"
+
+using namespace std;
+
+#define OCEAN_SPECTRUM_PHILLIPS              0
+#define OCEAN_SPECTRUM_PIERSON_MOSKOWITZ     1
+#define OCEAN_SPECTRUM_JONSWAP               2
+#define OCEAN_SPECTRUM_TMA                   3
+#define OCEAN_SPECTRUM_COUNT                 4
+
+// -------------------------------------------------------------------------
+// Directional spreading functions, each normalized to integrate to 1 over
+// the circle. Cosine squared is the Phillips model's own cos^2(theta),
+// which sends as much energy upwind as downwind. Cosine 2s is the
+// Longuet-Higgins cos^2s(theta / 2) for a fixed exponent s, and Mitsuyasu
+// the same with s fitted to each wave's frequency, narrowest at the peak.
+// -------------------------------------------------------------------------
+#define OCEAN_SPREADING_COSINE_SQUARED       0
+#define OCEAN_SPREADING_COSINE_2S            1
+#define OCEAN_SPREADING_MITSUYASU            2
+#define OCEAN_SPREADING_COUNT                3
+
+// -------------------------------------------------------------------------
+// Everything a model needs to know about the sea. Lengths are in FFT
+// samples and times in seconds, like the rest of the simulation.
+// -------------------------------------------------------------------------
+struct OceanSeaState
+{
+   float fWindX;
+   float fWindZ;
+   float fGravity;
+   float fPhillipsConstant;      // A, Phillips only
+   float fFetch;                 // distance the wind has blown over
+   float fDepth;                 // TMA only
+   float fPeakEnhancement;       // JONSWAP gamma
+   int nSpreading;               // OCEAN_SPREADING_*
+   float fSpreadingExponent;     // s of OCEAN_SPREADING_COSINE_2S
+   float fBinArea;               // dkx * dkz of one Fourier bin
+};
+
+class CSpectrumModel
+{
+public:
+   CSpectrumModel();
+   virtual ~CSpectrumModel();
+
+   // -------------------------------------------------------------------------
+   // Takes the sea state that the following calls evaluate.
+   // -------------------------------------------------------------------------
+   virtual void SetSeaState(const OceanSeaState& seaState);
+
+   // -------------------------------------------------------------------------
+   // R(k) for |k| = dK > 0, so that E(k) = R(|k|) * D(|k|, cos theta).
+   // -------------------------------------------------------------------------
+   virtual double GetRadialSpectrum(double dK) = 0;
+
+   // -------------------------------------------------------------------------
+   // Angular frequency of the spectrum's peak, which the Mitsuyasu
+   // spreading is fitted around.
+   // -------------------------------------------------------------------------
+   virtual double GetPeakFrequency() = 0;
+
+   double GetSpreading(double dK, double dCosine);
+   bool IsSpreadingRadial();
+
+   // -------------------------------------------------------------------------
+   // E(k) of one bin, evaluated analytically. E(0) = 0.
+   // -------------------------------------------------------------------------
+   double GetSpectrum(const KWaveVector& k);
+
+   // -------------------------------------------------------------------------
+   // Unit wind direction, (1, 0) when there is no wind.
+   // -------------------------------------------------------------------------
+   float GetWindDirectionX();
+   float GetWindDirectionZ();
+
+protected:
+   // -------------------------------------------------------------------------
+   // R(k) of a frequency spectrum S(w): S(k) = S(w) * dw/dk, divided by k
+   // for the polar to Cartesian area and multiplied by the bin area.
+   // -------------------------------------------------------------------------
+   double GetRadialFromFrequency(double dK, double dOmega, double dFrequencySpectrum);
+
+   // -------------------------------------------------------------------------
+   // The Pierson-Moskowitz shape alpha * g^2 / w^5 * exp(-5/4 (wp / w)^4)
+   // shared by the frequency spectra.
+   // -------------------------------------------------------------------------
+   double GetPiersonMoskowitzShape(double dOmega, double dAlpha, double dPeakFrequency);
+
+   OceanSeaState m_SeaState;
+   double m_dWindSpeed;
+   double m_dWindDirectionX;
+   double m_dWindDirectionZ;
+};
+
+class CPhillipsSpectrum : public CSpectrumModel
+{
+public:
+   virtual double GetRadialSpectrum(double dK);
+   virtual double GetPeakFrequency();
+};
+
+class CPiersonMoskowitzSpectrum : public CSpectrumModel
+{
+public:
+   virtual double GetRadialSpectrum(double dK);
+   virtual double GetPeakFrequency();
+};
+
+class CJonswapSpectrum : public CSpectrumModel
+{
+public:
+   virtual void SetSeaState(const OceanSeaState& seaState);
+   virtual double GetRadialSpectrum(double dK);
+   virtual double GetPeakFrequency();
+
+protected:
+   double GetFrequencySpectrum(double dOmega);
+
+   double m_dAlpha;
+   double m_dPeakFrequency;
+};
+
+class CTMASpectrum : public CJonswapSpectrum
+{
+public:
+   virtual double GetRadialSpectrum(double dK);
+};
+
+// -------------------------------------------------------------------------
+// A new model of an OCEAN_SPECTRUM_* type, or NULL for an unknown type.
+// The caller deletes it.
+// -------------------------------------------------------------------------
+CSpectrumModel* CreateSpectrumModel(int nModel);
+
+// -------------------------------------------------------------------------
+// Samples per octave of |k| in the radial table, and in the rows of the
+// spreading table when the spreading depends on |k|, as powers of two;
+// and the intervals of cos(theta / 2) from 0 to 1 in each spreading row.
+// -------------------------------------------------------------------------
+#define OCEAN_SPECTRUM_LOOKUP_RADIAL_BITS      7
+#define OCEAN_SPECTRUM_LOOKUP_SPREADING_BITS   3
+#define OCEAN_SPECTRUM_LOOKUP_COSINES          256
+
+class CSpectrumLookup
+{
+public:
+   CSpectrumLookup();
+
+   // -------------------------------------------------------------------------
+   // Tabulates pModel's current sea state for fKMin <= |k| <= fKMax.
+   // -------------------------------------------------------------------------
+   void Build(CSpectrumModel* pModel, float fKMin, float fKMax);
+
+   float GetSpectrum(const KWaveVector& k) const;
+
+   // -------------------------------------------------------------------------
+   // h0 = fAmplitudeScale * gaussian * sqrt(E(k)) for nCount bins, in split
+   // planes as the SpectrumKernels rows.
+   // -------------------------------------------------------------------------
+   void GetAmplitudeRow(
+      const float* pKX,
+      const float* pKZ,
+      const float* pGaussianReal,
+      const float* pGaussianImaginary,
+      int nCount,
+      float fAmplitudeScale,
+      float* pReal,
+      float* pImaginary) const;
+
+protected:
+   vector<float> m_Radial;
+   vector<float> m_Spreading;
+   int m_nBaseBits;
+   int m_nMaxOffset;
+   int m_nSpreadingRows;
+   float m_fWindDirectionX;
+   float m_fWindDirectionZ;
+};
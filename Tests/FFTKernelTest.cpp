@@ -0,0 +1,462 @@
+// -------------------------------------------------------------------------
+// Sean Janis
+// spjanis@gmail.com
+// Water Simulations
+//
+// FFTKernelTest
+//       Checks the FFT kernel dispatch, see FFTKernels.h and FFTPlan.h:
+//
+//       - a plan built under every SIMD level the CPU has runs that level's
+//         kernels;
+//       - every power of two from 2 to 4096, in both directions, through
+//         Execute, ExecuteBatch and ExecuteBatchStockham, matches the
+//         scalar kernels bit for bit at every level;
+//       - the scalar result stays within FFT_TEST_ULPS_PER_STAGE ulps of
+//         the output peak per radix-2 stage of the original radix-2
+//         routine, kept below as LegacyFFT;
+//       - mixed-radix and Bluestein sizes match the scalar kernels bit for
+//         bit at every level and stay within the same bound of a double
+//         precision DFT.
+//
+//       Prints each failure and exits with 1 if there were any.
+//
+//       Usage: fft_kernel_test
+// -------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+
+#include "CpuFeatures.h"
+#include "FFTPlan.h"
+
+using namespace std;
+
+#define FFT_TEST_LOG2_SIZE_MAX         12
+#define FFT_TEST_SEEDS                 4
+
+// -------------------------------------------------------------------------
+// Allowed difference from the reference, in units of FLT_EPSILON times the
+// largest output component, per radix-2 stage (log2 N, rounded up).
+// Both sides round a few times per stage, in different orders; the worst
+// case over the sizes below is 0.4.
+// -------------------------------------------------------------------------
+#define FFT_TEST_ULPS_PER_STAGE        1.0
+
+static int s_nFailures = 0;
+
+static void Fail(const char* pCase, int nLevel, int nSize, int nDirection, const char* pWhat, double dValue)
+{
+   printf(
+      "FAILED %s: %s, size %d, %s: %s (%g)\n",
+      pCase,
+      GetSimdLevelName(nLevel),
+      nSize,
+      nDirection == FFT_DIRECTION_FORWARD ? "forward" : "inverse",
+      pWhat,
+      dValue);
+
+   s_nFailures++;
+}
+
+static float RandomSample(unsigned int& nState)
+{
+   nState = nState * 1664525u + 1013904223u;
+   return (float)(nState >> 8) / (float)(1 << 23) - 1.0f;
+}
+
+// -------------------------------------------------------------------------
+// CWaterSurface::FFT from before CFFTPlan, unchanged but for the return
+// value: radix-2 over 2^m points, twiddles by recurrence in double
+// precision, dir 1 forward and scaled by 1/N, -1 inverse.
+// -------------------------------------------------------------------------
+static void LegacyFFT(int dir, int m, float* x, float* y)
+{
+   long nn,i,i1,j,k,i2,l,l1,l2;
+   double c1,c2,tx,ty,t1,t2,u1,u2,z;
+
+   nn = 1 << m;
+
+   /* Do the bit reversal */
+   i2 = nn >> 1;
+   j = 0;
+   for (i=0;i<nn-1;i++) {
+      if (i < j) {
+         tx = x[i];
+         ty = y[i];
+         x[i] = x[j];
+         y[i] = y[j];
+         x[j] = tx;
+         y[j] = ty;
+      }
+      k = i2;
+      while (k <= j) {
+         j -= k;
+         k >>= 1;
+      }
+      j += k;
+   }
+
+   /* Compute the FFT */
+   c1 = -1.0;
+   c2 = 0.0;
+   l2 = 1;
+   for (l=0;l<m;l++) {
+      l1 = l2;
+      l2 <<= 1;
+      u1 = 1.0;
+      u2 = 0.0;
+      for (j=0;j<l1;j++) {
+         for (i=j;i<nn;i+=l2) {
+            i1 = i + l1;
+            t1 = u1 * x[i1] - u2 * y[i1];
+            t2 = u1 * y[i1] + u2 * x[i1];
+            x[i1] = x[i] - t1;
+            y[i1] = y[i] - t2;
+            x[i] += t1;
+            y[i] += t2;
+         }
+         z =  u1 * c1 - u2 * c2;
+         u2 = u1 * c2 + u2 * c1;
+         u1 = z;
+      }
+      c2 = sqrt((1.0 - c1) / 2.0);
+      if (dir == 1)
+         c2 = -c2;
+      c1 = sqrt((1.0 + c1) / 2.0);
+   }
+
+   /* Scaling for forward transform */
+   if (dir == 1) {
+      for (i=0;i<nn;i++) {
+         x[i] /= (float)nn;
+         y[i] /= (float)nn;
+      }
+   }
+}
+
+// -------------------------------------------------------------------------
+// Direct O(N^2) transform in double precision, same conventions.
+// -------------------------------------------------------------------------
+static void ReferenceDFT(int nDirection, int nSize, float* pReal, float* pImaginary)
+{
+   vector<double> real(nSize);
+   vector<double> imaginary(nSize);
+   double dSign = (nDirection == FFT_DIRECTION_FORWARD) ? -1.0 : 1.0;
+   double dScale = (nDirection == FFT_DIRECTION_FORWARD) ? 1.0 / nSize : 1.0;
+
+   for (int k = 0; k < nSize; k++)
+   {
+      double dReal = 0.0;
+      double dImaginary = 0.0;
+
+      for (int n = 0; n < nSize; n++)
+      {
+         double dAngle = dSign * 2.0 * 3.14159265358979323846 * (double)((n * k) % nSize) / nSize;
+         double dCos = cos(dAngle);
+         double dSin = sin(dAngle);
+
+         dReal += pReal[n] * dCos - pImaginary[n] * dSin;
+         dImaginary += pReal[n] * dSin + pImaginary[n] * dCos;
+      }
+
+      real[k] = dReal * dScale;
+      imaginary[k] = dImaginary * dScale;
+   }
+
+   for (int k = 0; k < nSize; k++)
+   {
+      pReal[k] = (float)real[k];
+      pImaginary[k] = (float)imaginary[k];
+   }
+}
+
+static int CeilLog2(int nSize)
+{
+   int nLog2 = 0;
+
+   while ((1 << nLog2) < nSize)
+   {
+      nLog2++;
+   }
+
+   return nLog2;
+}
+
+// -------------------------------------------------------------------------
+// Largest difference from the reference in units of FLT_EPSILON times the
+// reference's largest component, divided by the number of stages.
+// -------------------------------------------------------------------------
+static double ErrorPerStage(
+   int nSize,
+   const float* pReal,
+   const float* pImaginary,
+   const float* pReferenceReal,
+   const float* pReferenceImaginary)
+{
+   double dPeak = 0.0;
+   double dError = 0.0;
+
+   for (int i = 0; i < nSize; i++)
+   {
+      dPeak = max(dPeak, fabs((double)pReferenceReal[i]));
+      dPeak = max(dPeak, fabs((double)pReferenceImaginary[i]));
+      dError = max(dError, fabs((double)pReal[i] - pReferenceReal[i]));
+      dError = max(dError, fabs((double)pImaginary[i] - pReferenceImaginary[i]));
+   }
+
+   if (dPeak == 0.0)
+   {
+      return dError == 0.0 ? 0.0 : 1e30;
+   }
+
+   return dError / (dPeak * 1.1920928955078125e-7 * CeilLog2(nSize));
+}
+
+static bool SameBits(const vector<float>& a, const vector<float>& b)
+{
+   return a.size() == b.size() && memcmp(&a[0], &b[0], a.size() * sizeof(float)) == 0;
+}
+
+// -------------------------------------------------------------------------
+// One sequence per batch lane, each from its own seed.
+// -------------------------------------------------------------------------
+static void FillBatch(int nSize, unsigned int nSeed, vector<float>& real, vector<float>& imaginary)
+{
+   real.resize(nSize * FFT_BATCH_LANES);
+   imaginary.resize(nSize * FFT_BATCH_LANES);
+
+   for (int l = 0; l < FFT_BATCH_LANES; l++)
+   {
+      unsigned int nState = nSeed * 977u + (unsigned int)l;
+
+      for (int i = 0; i < nSize; i++)
+      {
+         real[i * FFT_BATCH_LANES + l] = RandomSample(nState);
+         imaginary[i * FFT_BATCH_LANES + l] = RandomSample(nState);
+      }
+   }
+}
+
+static void ExtractLane(int nSize, int nLane, const vector<float>& batch, vector<float>& lane)
+{
+   lane.resize(nSize);
+
+   for (int i = 0; i < nSize; i++)
+   {
+      lane[i] = batch[i * FFT_BATCH_LANES + nLane];
+   }
+}
+
+static void TestDispatch()
+{
+   for (int nLevel = SIMD_LEVEL_SCALAR; nLevel <= GetCpuSimdLevel(); nLevel++)
+   {
+      SetSimdLevelLimit(nLevel);
+
+      CFFTPlan plan;
+
+      if (!plan.Init(256) || plan.GetSimdLevel() != nLevel)
+      {
+         Fail("dispatch", nLevel, 256, FFT_DIRECTION_FORWARD, "plan runs level", plan.GetSimdLevel());
+      }
+   }
+
+   SetSimdLevelLimit(SIMD_LEVEL_AVX2);
+}
+
+// -------------------------------------------------------------------------
+// Runs Execute, ExecuteBatch and ExecuteBatchStockham on the batch at
+// every level. The scalar results go to the reference arrays; every other
+// level must reproduce them exactly.
+// -------------------------------------------------------------------------
+static void RunLevels(
+   const char* pCase,
+   int nSize,
+   int nDirection,
+   unsigned int nSeed,
+   vector<float> apReal[3],
+   vector<float> apImaginary[3])
+{
+   vector<float> real;
+   vector<float> imaginary;
+   vector<float> workReal;
+   vector<float> workImaginary;
+
+   FillBatch(nSize, nSeed, real, imaginary);
+
+   for (int nLevel = SIMD_LEVEL_SCALAR; nLevel <= GetCpuSimdLevel(); nLevel++)
+   {
+      SetSimdLevelLimit(nLevel);
+
+      CFFTPlan plan;
+
+      if (!plan.Init(nSize))
+      {
+         Fail(pCase, nLevel, nSize, nDirection, "Init failed", 0);
+         continue;
+      }
+
+      vector<float> aResultReal[3];
+      vector<float> aResultImaginary[3];
+
+      ExtractLane(nSize, 0, real, aResultReal[0]);
+      ExtractLane(nSize, 0, imaginary, aResultImaginary[0]);
+      plan.Execute(nDirection, &aResultReal[0][0], &aResultImaginary[0][0]);
+
+      aResultReal[1] = real;
+      aResultImaginary[1] = imaginary;
+      plan.ExecuteBatch(nDirection, &aResultReal[1][0], &aResultImaginary[1][0]);
+
+      aResultReal[2] = real;
+      aResultImaginary[2] = imaginary;
+      workReal.assign(real.size(), 0.0f);
+      workImaginary.assign(real.size(), 0.0f);
+      plan.ExecuteBatchStockham(
+         nDirection,
+         &aResultReal[2][0],
+         &aResultImaginary[2][0],
+         &workReal[0],
+         &workImaginary[0]);
+
+      for (int p = 0; p < 3; p++)
+      {
+         if (nLevel == SIMD_LEVEL_SCALAR)
+         {
+            apReal[p] = aResultReal[p];
+            apImaginary[p] = aResultImaginary[p];
+         }
+         else if (!SameBits(aResultReal[p], apReal[p]) || !SameBits(aResultImaginary[p], apImaginary[p]))
+         {
+            static const char* s_apPaths[3] = { "Execute", "ExecuteBatch", "ExecuteBatchStockham" };
+            Fail(pCase, nLevel, nSize, nDirection, s_apPaths[p], 0);
+         }
+      }
+   }
+
+   SetSimdLevelLimit(SIMD_LEVEL_AVX2);
+}
+
+// -------------------------------------------------------------------------
+// Checks every lane of the scalar results against the reference, which
+// computes lane l of the batch from its input.
+// -------------------------------------------------------------------------
+typedef void (*ReferenceFunc)(int nDirection, int nSize, float* pReal, float* pImaginary);
+
+static void CheckAccuracy(
+   const char* pCase,
+   int nSize,
+   int nDirection,
+   unsigned int nSeed,
+   ReferenceFunc pfnReference,
+   vector<float> apReal[3],
+   vector<float> apImaginary[3])
+{
+   vector<float> real;
+   vector<float> imaginary;
+   vector<float> referenceReal;
+   vector<float> referenceImaginary;
+   vector<float> laneReal;
+   vector<float> laneImaginary;
+
+   FillBatch(nSize, nSeed, real, imaginary);
+
+   for (int l = 0; l < FFT_BATCH_LANES; l++)
+   {
+      ExtractLane(nSize, l, real, referenceReal);
+      ExtractLane(nSize, l, imaginary, referenceImaginary);
+      pfnReference(nDirection, nSize, &referenceReal[0], &referenceImaginary[0]);
+
+      for (int p = 0; p < 3; p++)
+      {
+         // Execute transformed lane 0 only.
+         if (p == 0 && l != 0)
+         {
+            continue;
+         }
+
+         if (p == 0)
+         {
+            laneReal = apReal[0];
+            laneImaginary = apImaginary[0];
+         }
+         else
+         {
+            ExtractLane(nSize, l, apReal[p], laneReal);
+            ExtractLane(nSize, l, apImaginary[p], laneImaginary);
+         }
+
+         double dError = ErrorPerStage(
+            nSize,
+            &laneReal[0],
+            &laneImaginary[0],
+            &referenceReal[0],
+            &referenceImaginary[0]);
+
+         if (!(dError <= FFT_TEST_ULPS_PER_STAGE))
+         {
+            Fail(pCase, SIMD_LEVEL_SCALAR, nSize, nDirection, "ulps per stage from the reference", dError);
+         }
+      }
+   }
+}
+
+static void Legacy(int nDirection, int nSize, float* pReal, float* pImaginary)
+{
+   LegacyFFT(nDirection == FFT_DIRECTION_FORWARD ? 1 : -1, CeilLog2(nSize), pReal, pImaginary);
+}
+
+static void TestPowersOfTwo()
+{
+   for (int nLog2 = 1; nLog2 <= FFT_TEST_LOG2_SIZE_MAX; nLog2++)
+   {
+      for (int d = 0; d < 2; d++)
+      {
+         int nDirection = d == 0 ? FFT_DIRECTION_FORWARD : FFT_DIRECTION_INVERSE;
+
+         for (unsigned int nSeed = 1; nSeed <= FFT_TEST_SEEDS; nSeed++)
+         {
+            vector<float> aReal[3];
+            vector<float> aImaginary[3];
+
+            RunLevels("power of two", 1 << nLog2, nDirection, nSeed, aReal, aImaginary);
+            CheckAccuracy("power of two", 1 << nLog2, nDirection, nSeed, Legacy, aReal, aImaginary);
+         }
+      }
+   }
+}
+
+static void TestOtherSizes()
+{
+   static const int s_anSizes[] = { 3, 5, 6, 7, 9, 10, 12, 15, 24, 60, 97, 100, 360, 480, 1000, 1021 };
+
+   for (int s = 0; s < (int)(sizeof(s_anSizes) / sizeof(s_anSizes[0])); s++)
+   {
+      for (int d = 0; d < 2; d++)
+      {
+         int nDirection = d == 0 ? FFT_DIRECTION_FORWARD : FFT_DIRECTION_INVERSE;
+         vector<float> aReal[3];
+         vector<float> aImaginary[3];
+
+         RunLevels("other size", s_anSizes[s], nDirection, 1, aReal, aImaginary);
+         CheckAccuracy("other size", s_anSizes[s], nDirection, 1, ReferenceDFT, aReal, aImaginary);
+      }
+   }
+}
+
+int main()
+{
+   TestDispatch();
+   TestPowersOfTwo();
+   TestOtherSizes();
+
+   if (s_nFailures != 0)
+   {
+      printf("fft kernels: %d failures\n", s_nFailures);
+      return 1;
+   }
+
+   printf("fft kernels: all passed\n");
+   return 0;
+}
@@ -0,0 +1,292 @@
+// -------------------------------------------------------------------------
+// Sean Janis
+// spjanis@gmail.com
+// Water Simulations
+//
+// UploadRingTest
+//       Checks CUploadRing against a CCpuUploadSink, whose GPU runs a set
+//       number of frames behind and counts every no-overwrite lock over a
+//       span it may still be reading:
+//
+//       - random spans, several a frame, across capacities and latencies
+//         up to past UPLOAD_RING_MAX_FRAMES, never cause a hazard and
+//         always lie inside the buffer;
+//       - one whole frame a frame, in a ring that holds a few of them,
+//         discards after the first lock only when the GPU is as many
+//         frames behind as the ring holds, or has every fence out;
+//       - with every fence out, EndFrame forgets the frames in flight and
+//         the next lock discards, still without a hazard.
+//
+//       Prints each failure and exits with 1 if there were any.
+//
+//       Usage: upload_ring_test
+// -------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "UploadRing.h"
+
+static int s_nFailures = 0;
+
+static void Fail(const char* pCase, int nCapacity, int nLatency, const char* pWhat, int nValue)
+{
+   printf("FAILED %s: capacity %d, latency %d: %s (%d)\n", pCase, nCapacity, nLatency, pWhat, nValue);
+   s_nFailures++;
+}
+
+static int Random(unsigned int& nState, int nRange)
+{
+   nState = nState * 1664525u + 1013904223u;
+   return (int)((nState >> 8) % (unsigned int)nRange);
+}
+
+static void TestRandomSpans()
+{
+   for (int nLatency = 0; nLatency <= UPLOAD_RING_MAX_FRAMES + 2; nLatency++)
+   {
+      for (int nCapacity = 64; nCapacity <= 4096; nCapacity *= 2)
+      {
+         for (unsigned int nSeed = 1; nSeed <= 16; nSeed++)
+         {
+            CCpuUploadSink sink;
+            sink.SetLatency(nLatency);
+
+            CUploadRing ring;
+
+            if (!ring.Init(&sink, nCapacity))
+            {
+               Fail("random spans", nCapacity, nLatency, "Init failed", 0);
+               return;
+            }
+
+            unsigned int nState = nSeed;
+
+            for (int f = 0; f < 500; f++)
+            {
+               int nSpans = Random(nState, 4);
+
+               for (int s = 0; s < nSpans; s++)
+               {
+                  int nBytes = 1 + Random(nState, nCapacity / 3);
+                  int nOffset = 0;
+                  void* pData = ring.Lock(nBytes, nOffset);
+
+                  if (pData == NULL)
+                  {
+                     Fail("random spans", nCapacity, nLatency, "lock failed for bytes", nBytes);
+                     continue;
+                  }
+
+                  if (nOffset < 0 || nOffset + nBytes > nCapacity)
+                  {
+                     Fail("random spans", nCapacity, nLatency, "span outside the buffer at", nOffset);
+                  }
+
+                  memset(pData, 0, nBytes);
+                  ring.Unlock();
+               }
+
+               ring.EndFrame();
+            }
+
+            if (sink.GetHazardCount() != 0)
+            {
+               Fail("random spans", nCapacity, nLatency, "hazards", sink.GetHazardCount());
+            }
+
+            if (ring.GetStats().nDiscardLocks != sink.GetDiscardCount())
+            {
+               Fail("random spans", nCapacity, nLatency, "discards the sink did not see", ring.GetStats().nDiscardLocks);
+            }
+         }
+      }
+   }
+}
+
+static void TestRingDepth()
+{
+   // -------------------------------------------------------------------------
+   // A frame is nFrameBytes, already aligned, so a ring of nRingFrames
+   // holds exactly that many. The lock of each frame finds the nLatency
+   // before it still in flight, so it fits without a discard while
+   // nLatency < nRingFrames, unless the fences run out first.
+   // -------------------------------------------------------------------------
+   const int nFrameBytes = 64 * UPLOAD_RING_ALIGNMENT;
+
+   for (int nRingFrames = 1; nRingFrames <= UPLOAD_RING_MAX_FRAMES + 4; nRingFrames++)
+   {
+      for (int nLatency = 0; nLatency <= UPLOAD_RING_MAX_FRAMES + 2; nLatency++)
+      {
+         int nCapacity = nRingFrames * nFrameBytes;
+
+         CCpuUploadSink sink;
+         sink.SetLatency(nLatency);
+
+         CUploadRing ring;
+
+         if (!ring.Init(&sink, nCapacity))
+         {
+            Fail("ring depth", nCapacity, nLatency, "Init failed", 0);
+            return;
+         }
+
+         for (int f = 0; f < 200; f++)
+         {
+            int nOffset = 0;
+
+            if (ring.Lock(nFrameBytes, nOffset) == NULL)
+            {
+               Fail("ring depth", nCapacity, nLatency, "lock failed in frame", f);
+               break;
+            }
+
+            ring.Unlock();
+            ring.EndFrame();
+         }
+
+         const UploadRingStats& stats = ring.GetStats();
+         bool blExpectDiscards = (nLatency >= nRingFrames || nLatency >= UPLOAD_RING_MAX_FRAMES);
+
+         if (sink.GetHazardCount() != 0)
+         {
+            Fail("ring depth", nCapacity, nLatency, "hazards", sink.GetHazardCount());
+         }
+
+         if (blExpectDiscards && stats.nDiscardLocks <= 1)
+         {
+            Fail("ring depth", nCapacity, nLatency, "expected discards, got", stats.nDiscardLocks);
+         }
+
+         if (!blExpectDiscards && stats.nDiscardLocks != 1)
+         {
+            Fail("ring depth", nCapacity, nLatency, "discards past the first lock", stats.nDiscardLocks - 1);
+         }
+
+         if (stats.nMaxFramesInFlight > UPLOAD_RING_MAX_FRAMES)
+         {
+            Fail("ring depth", nCapacity, nLatency, "frames in flight", stats.nMaxFramesInFlight);
+         }
+      }
+   }
+}
+
+// -------------------------------------------------------------------------
+// Shows whether the next lock has to discard.
+// -------------------------------------------------------------------------
+class CTestUploadRing : public CUploadRing
+{
+public:
+   bool IsDiscardPending() const
+   {
+      return m_blDiscardNext;
+   }
+};
+
+static void TestFenceExhaustion()
+{
+   // -------------------------------------------------------------------------
+   // Small spans in a large ring, so space never runs out and only the
+   // fences do. A frame ending with every fence out must start the ring
+   // over, with only itself in flight, and the next lock must discard;
+   // no other lock may.
+   // -------------------------------------------------------------------------
+   const int nCapacity = 64 * 1024;
+   const int nLatency = UPLOAD_RING_MAX_FRAMES;
+
+   CCpuUploadSink sink;
+   sink.SetLatency(nLatency);
+
+   CTestUploadRing ring;
+
+   if (!ring.Init(&sink, nCapacity))
+   {
+      Fail("fence exhaustion", nCapacity, nLatency, "Init failed", 0);
+      return;
+   }
+
+   int nExhausted = 0;
+
+   for (int f = 0; f < 100; f++)
+   {
+      bool blDiscardPending = ring.IsDiscardPending();
+      int nDiscards = ring.GetStats().nDiscardLocks;
+      int nOffset = 0;
+
+      if (ring.Lock(256, nOffset) == NULL)
+      {
+         Fail("fence exhaustion", nCapacity, nLatency, "lock failed in frame", f);
+         return;
+      }
+
+      if ((ring.GetStats().nDiscardLocks > nDiscards) != blDiscardPending)
+      {
+         Fail("fence exhaustion", nCapacity, nLatency, "discard not after exhaustion, in frame", f);
+      }
+
+      int nInFlight = ring.GetFramesInFlight();
+
+      ring.Unlock();
+      ring.EndFrame();
+
+      if (ring.IsDiscardPending())
+      {
+         if (nInFlight != UPLOAD_RING_MAX_FRAMES || ring.GetFramesInFlight() != 1)
+         {
+            Fail("fence exhaustion", nCapacity, nLatency, "started over with fences to spare, in frame", f);
+         }
+
+         nExhausted++;
+      }
+   }
+
+   if (nExhausted == 0)
+   {
+      Fail("fence exhaustion", nCapacity, nLatency, "fences never ran out", 0);
+   }
+
+   if (ring.GetStats().nMaxFramesInFlight != UPLOAD_RING_MAX_FRAMES)
+   {
+      Fail("fence exhaustion", nCapacity, nLatency, "most frames in flight", ring.GetStats().nMaxFramesInFlight);
+   }
+
+   if (sink.GetHazardCount() != 0)
+   {
+      Fail("fence exhaustion", nCapacity, nLatency, "hazards", sink.GetHazardCount());
+   }
+}
+
+static void TestOversizedLock()
+{
+   CCpuUploadSink sink;
+   CUploadRing ring;
+   int nOffset = 0;
+
+   if (!ring.Init(&sink, 1024))
+   {
+      Fail("oversized lock", 1024, 0, "Init failed", 0);
+      return;
+   }
+
+   if (ring.Lock(1025, nOffset) != NULL || ring.GetStats().nFailedLocks != 1)
+   {
+      Fail("oversized lock", 1024, 0, "locked more than the buffer, bytes", 1025);
+   }
+}
+
+int main()
+{
+   TestRandomSpans();
+   TestRingDepth();
+   TestFenceExhaustion();
+   TestOversizedLock();
+
+   if (s_nFailures != 0)
+   {
+      printf("upload ring: %d failures\n", s_nFailures);
+      return 1;
+   }
+
+   printf("upload ring: all passed\n");
+   return 0;
+}
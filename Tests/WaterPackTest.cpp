@@ -0,0 +1,585 @@
+// -------------------------------------------------------------------------
+// Sean Janis
+// spjanis@gmail.com
+// Water Simulations
+//
+// WaterPackTest
+//       Checks the conversions behind the dynamic vertex stream's compact
+//       encodings, see WaterPackKernels.h and WaterVertexStreams.h:
+//
+//       - every WaterPackKernelTable entry at every SIMD level the CPU has
+//         matches the scalar one bit for bit, over edge cases and random
+//         data, at every count up to a few vectors and at unaligned
+//         addresses;
+//       - FloatToHalf and HalfToFloat round trip every half float, round
+//         ties to even, flush what is below the smallest denormal, give
+//         infinity on overflow and keep NaNs quiet NaNs with their sign;
+//       - the packer's MeasureError, on live ocean frames, stays within
+//         what each encoding's precision allows.
+//
+//       Prints each failure and exits with 1 if there were any.
+//
+//       Usage: water_pack_test
+// -------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+
+#include "OceanSimulation.h"
+#include "CpuFeatures.h"
+#include "WaterPackKernels.h"
+#include "WaterVertexStreams.h"
+
+using namespace std;
+
+static int s_nFailures = 0;
+
+static void Fail(const char* pCase, const char* pWhat, double dValue)
+{
+   printf("FAILED %s: %s (%g)\n", pCase, pWhat, dValue);
+   s_nFailures++;
+}
+
+static unsigned int FloatBits(float fValue)
+{
+   unsigned int nBits;
+   memcpy(&nBits, &fValue, sizeof(nBits));
+   return nBits;
+}
+
+static float BitsFloat(unsigned int nBits)
+{
+   float fValue;
+   memcpy(&fValue, &nBits, sizeof(fValue));
+   return fValue;
+}
+
+static float Random(unsigned int& nState)
+{
+   nState = nState * 1664525u + 1013904223u;
+   return (float)(nState >> 8) / (float)(1 << 24);
+}
+
+// -------------------------------------------------------------------------
+// Kernels
+// -------------------------------------------------------------------------
+#define TEST_MAX_COUNT     1003
+#define TEST_MAX_OFFSET    3
+
+// -------------------------------------------------------------------------
+// The inputs every kernel is run on: values for the half floats, the
+// quantizer and the range, and vectors, mostly unit, for the normals.
+// Edge cases come first so that they land in both the vector bodies and
+// the scalar tails as the count grows.
+// -------------------------------------------------------------------------
+struct KernelInputs
+{
+   vector<float> values;
+   vector<float> x;
+   vector<float> y;
+   vector<float> z;
+};
+
+static void MakeKernelInputs(KernelInputs& inputs)
+{
+   int nSize = TEST_MAX_COUNT + TEST_MAX_OFFSET;
+   unsigned int nState = 1;
+
+   inputs.values.resize(nSize);
+   inputs.x.resize(nSize);
+   inputs.y.resize(nSize);
+   inputs.z.resize(nSize);
+
+   for (int i = 0; i < nSize; i++)
+   {
+      inputs.values[i] = (Random(nState) - 0.5f) * 300.0f;
+
+      float fX = Random(nState) * 2.0f - 1.0f;
+      float fY = Random(nState) * 2.0f - 1.0f;
+      float fZ = Random(nState) * 2.0f - 1.0f;
+      float fLength = sqrtf(fX * fX + fY * fY + fZ * fZ);
+
+      inputs.x[i] = fX / fLength;
+      inputs.y[i] = fY / fLength;
+      inputs.z[i] = fZ / fLength;
+   }
+
+   static const float s_afValues[] =
+   {
+      0.0f, -0.0f, 0.5f, -0.5f, 1.5f, -1.5f, 2.5f, -2.5f,
+      1e30f, -1e30f, 65504.0f, 65520.0f, -65520.0f, 6.0e-8f, 2.9802322e-8f, 1e-40f,
+      3.0f + 0.5f / 100.0f, 3.0f - 0.5f / 100.0f, 330.0f, -330.0f, 32767.5f, -32767.5f, 1e-3f, -1e-3f
+   };
+
+   for (size_t i = 0; i < sizeof(s_afValues) / sizeof(s_afValues[0]); i++)
+   {
+      inputs.values[i] = s_afValues[i];
+   }
+
+   static const float s_afVectors[][3] =
+   {
+      { 0.0f, 1.0f, 0.0f }, { 0.0f, -1.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { -1.0f, 0.0f, 0.0f },
+      { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, -1.0f }, { -0.0f, 1.0f, -0.0f }, { 0.0f, -0.0f, 1.0f },
+      { 0.6f, -0.0f, 0.8f }, { -0.6f, -0.8f, 0.0f }, { 0.5f / 127.5f - 1.0f, 0.0f, 0.0f }, { 1e6f, -1e6f, 0.0f },
+      { 0.57735f, -0.57735f, -0.57735f }, { -0.57735f, -0.57735f, 0.57735f }, { 0.70710677f, -0.70710677f, 0.0f }
+   };
+
+   for (size_t i = 0; i < sizeof(s_afVectors) / sizeof(s_afVectors[0]); i++)
+   {
+      inputs.x[i] = s_afVectors[i][0];
+      inputs.y[i] = s_afVectors[i][1];
+      inputs.z[i] = s_afVectors[i][2];
+   }
+}
+
+template <class T>
+static bool SameBits(const vector<T>& a, const vector<T>& b, int nCount)
+{
+   return nCount == 0 || memcmp(&a[0], &b[0], nCount * sizeof(T)) == 0;
+}
+
+static void CompareKernels(const char* pLevel, const WaterPackKernelTable& scalar, const WaterPackKernelTable& kernels,
+                           const KernelInputs& inputs, int nCount, int nOffset)
+{
+   // -------------------------------------------------------------------------
+   // Outputs are sized and pre-filled alike, so a kernel writing past the
+   // count shows up as a difference too.
+   // -------------------------------------------------------------------------
+   int nSize = nCount + 8;
+   const float* pValues = &inputs.values[nOffset];
+   const float* pX = &inputs.x[nOffset];
+   const float* pY = &inputs.y[nOffset];
+   const float* pZ = &inputs.z[nOffset];
+   char acCase[64];
+   sprintf(acCase, "%s kernels, count %d, offset %d", pLevel, nCount, nOffset);
+
+   vector<unsigned short> halves0(nSize, 0xCDCD), halves1(nSize, 0xCDCD);
+   scalar.pfnFloatToHalf(pValues, nCount, &halves0[0]);
+   kernels.pfnFloatToHalf(pValues, nCount, &halves1[0]);
+
+   if (!SameBits(halves0, halves1, nSize))
+   {
+      Fail(acCase, "pfnFloatToHalf differs", 0);
+   }
+
+   static const float s_aafQuantize[][4] =
+   {
+      { 3.0f, 100.0f, -32767.0f, 32767.0f },
+      { -1.0f, 127.5f, 0.0f, 255.0f },
+      { 0.0f, 32767.0f, -32767.0f, 32767.0f },
+      { -7.25f, 0.0f, -32767.0f, 32767.0f }
+   };
+
+   for (size_t q = 0; q < sizeof(s_aafQuantize) / sizeof(s_aafQuantize[0]); q++)
+   {
+      const float* pParams = s_aafQuantize[q];
+      vector<short> words0(nSize, 0x5A5A), words1(nSize, 0x5A5A);
+
+      scalar.pfnQuantize(pValues, nCount, pParams[0], pParams[1], pParams[2], pParams[3], &words0[0]);
+      kernels.pfnQuantize(pValues, nCount, pParams[0], pParams[1], pParams[2], pParams[3], &words1[0]);
+
+      if (!SameBits(words0, words1, nSize))
+      {
+         Fail(acCase, "pfnQuantize differs, parameter set", (double)q);
+      }
+   }
+
+   vector<float> u0(nSize, 7.0f), v0(nSize, 7.0f), u1(nSize, 7.0f), v1(nSize, 7.0f);
+   scalar.pfnOctahedral(pX, pY, pZ, nCount, &u0[0], &v0[0]);
+   kernels.pfnOctahedral(pX, pY, pZ, nCount, &u1[0], &v1[0]);
+
+   if (!SameBits(u0, u1, nSize) || !SameBits(v0, v1, nSize))
+   {
+      Fail(acCase, "pfnOctahedral differs", 0);
+   }
+
+   vector<unsigned int> colors0(nSize, 0xDEADBEEF), colors1(nSize, 0xDEADBEEF);
+   scalar.pfnNormalColor(pX, pY, pZ, nCount, &colors0[0]);
+   kernels.pfnNormalColor(pX, pY, pZ, nCount, &colors1[0]);
+
+   if (!SameBits(colors0, colors1, nSize))
+   {
+      Fail(acCase, "pfnNormalColor differs", 0);
+   }
+
+   if (nCount > 0)
+   {
+      float fMin0, fMax0, fMin1, fMax1;
+      scalar.pfnRange(pValues, nCount, fMin0, fMax0);
+      kernels.pfnRange(pValues, nCount, fMin1, fMax1);
+
+      if (FloatBits(fMin0) != FloatBits(fMin1) || FloatBits(fMax0) != FloatBits(fMax1))
+      {
+         Fail(acCase, "pfnRange differs", 0);
+      }
+   }
+}
+
+static void CompareHalfSweep(const char* pLevel, const WaterPackKernelTable& kernels)
+{
+   // -------------------------------------------------------------------------
+   // Every 4097th float bit pattern, which passes through every exponent,
+   // both signs, denormals, infinities and NaNs, against FloatToHalf.
+   // -------------------------------------------------------------------------
+   const int nChunk = 4096;
+   vector<float> input(nChunk);
+   vector<unsigned short> output(nChunk);
+   unsigned long long nBits = 0;
+   int nMismatches = 0;
+
+   while (nBits <= 0xFFFFFFFFull)
+   {
+      int nCount = 0;
+
+      for (; nCount < nChunk && nBits <= 0xFFFFFFFFull; nCount++, nBits += 4097)
+      {
+         input[nCount] = BitsFloat((unsigned int)nBits);
+      }
+
+      kernels.pfnFloatToHalf(&input[0], nCount, &output[0]);
+
+      for (int i = 0; i < nCount; i++)
+      {
+         if (output[i] != FloatToHalf(input[i]))
+         {
+            nMismatches++;
+         }
+      }
+   }
+
+   if (nMismatches != 0)
+   {
+      char acCase[64];
+      sprintf(acCase, "%s half sweep", pLevel);
+      Fail(acCase, "pfnFloatToHalf differs from FloatToHalf, values", nMismatches);
+   }
+}
+
+static void TestKernels()
+{
+   KernelInputs inputs;
+   MakeKernelInputs(inputs);
+
+   WaterPackKernelTable scalar;
+   GetWaterPackKernels(SIMD_LEVEL_SCALAR, scalar);
+
+   for (int nLevel = SIMD_LEVEL_SCALAR; nLevel <= SIMD_LEVEL_AVX2; nLevel++)
+   {
+      const char* pLevel = GetSimdLevelName(nLevel);
+
+      if (nLevel > GetCpuSimdLevel())
+      {
+         printf("skipped %s: not supported by this CPU\n", pLevel);
+         continue;
+      }
+
+      WaterPackKernelTable kernels;
+      GetWaterPackKernels(nLevel, kernels);
+
+      if (kernels.nSimdLevel != nLevel)
+      {
+         Fail(pLevel, "kernel table is for another level", kernels.nSimdLevel);
+      }
+
+      for (int nOffset = 0; nOffset <= TEST_MAX_OFFSET; nOffset++)
+      {
+         for (int nCount = 0; nCount <= 40; nCount++)
+         {
+            CompareKernels(pLevel, scalar, kernels, inputs, nCount, nOffset);
+         }
+
+         CompareKernels(pLevel, scalar, kernels, inputs, TEST_MAX_COUNT, nOffset);
+      }
+
+      CompareHalfSweep(pLevel, kernels);
+   }
+}
+
+// -------------------------------------------------------------------------
+// Half floats
+// -------------------------------------------------------------------------
+static double GetHalfValue(unsigned short nHalf)
+{
+   int nExponent = (nHalf >> 10) & 0x1F;
+   int nMantissa = nHalf & 0x3FF;
+   double dValue = (nExponent == 0) ? ldexp((double)nMantissa, -24) : ldexp((double)(nMantissa | 0x400), nExponent - 25);
+   return (nHalf & 0x8000) ? -dValue : dValue;
+}
+
+static bool IsHalfNaN(unsigned short nHalf)
+{
+   return (nHalf & 0x7C00) == 0x7C00 && (nHalf & 0x3FF) != 0;
+}
+
+static void CheckHalf(const char* pWhat, float fValue, unsigned short nExpected)
+{
+   unsigned short nHalf = FloatToHalf(fValue);
+
+   if (nHalf != nExpected)
+   {
+      char acCase[96];
+      sprintf(acCase, "half %s, float 0x%08X to 0x%04X", pWhat, FloatBits(fValue), nHalf);
+      Fail(acCase, "expected", nExpected);
+   }
+}
+
+static void TestHalfFloats()
+{
+   // -------------------------------------------------------------------------
+   // Every half converts to the float of its exact value, and back to
+   // itself; NaNs come back quiet, with their sign and payload.
+   // -------------------------------------------------------------------------
+   for (int h = 0; h <= 0xFFFF; h++)
+   {
+      unsigned short nHalf = (unsigned short)h;
+      float fValue = HalfToFloat(nHalf);
+
+      if (IsHalfNaN(nHalf))
+      {
+         if (fValue == fValue || FloatToHalf(fValue) != (nHalf | 0x200))
+         {
+            Fail("half NaN round trip", "half", h);
+         }
+         continue;
+      }
+
+      bool blInfinity = (nHalf & 0x7FFF) == 0x7C00;
+      bool blSameValue = blInfinity ? (fabs(fValue) > 3.4e38 && (fValue < 0) == ((nHalf & 0x8000) != 0))
+                                    : ((double)fValue == GetHalfValue(nHalf) && (FloatBits(fValue) >> 31) == (unsigned int)(h >> 15));
+
+      if (!blSameValue || FloatToHalf(fValue) != nHalf)
+      {
+         Fail("half round trip", "half", h);
+      }
+   }
+
+   // -------------------------------------------------------------------------
+   // Halfway between neighbouring finite halves, denormals included, goes
+   // to the even one, and the floats either side of it, a bit further from
+   // or nearer to zero, to the nearer half. The midpoints need 12
+   // significant bits, so floats hold them exactly.
+   // -------------------------------------------------------------------------
+   for (int h = 0; h < 0x7BFF; h++)
+   {
+      for (int nSign = 0; nSign <= 0x8000; nSign += 0x8000)
+      {
+         unsigned short nLow = (unsigned short)(h | nSign);
+         unsigned short nHigh = (unsigned short)((h + 1) | nSign);
+         float fMiddle = (float)(0.5 * (GetHalfValue(nLow) + GetHalfValue(nHigh)));
+
+         CheckHalf("tie", fMiddle, (h & 1) ? nHigh : nLow);
+         CheckHalf("above tie", BitsFloat(FloatBits(fMiddle) + 1), nHigh);
+         CheckHalf("below tie", BitsFloat(FloatBits(fMiddle) - 1), nLow);
+      }
+   }
+
+   // -------------------------------------------------------------------------
+   // Underflow, overflow, infinities and NaNs.
+   // -------------------------------------------------------------------------
+   CheckHalf("smallest denormal", 5.9604645e-8f, 0x0001);
+   CheckHalf("half the smallest denormal", 2.9802322e-8f, 0x0000);
+   CheckHalf("just over half the smallest denormal", BitsFloat(FloatBits(2.9802322e-8f) + 1), 0x0001);
+   CheckHalf("float denormal", 1e-40f, 0x0000);
+   CheckHalf("negative float denormal", -1e-40f, 0x8000);
+   CheckHalf("negative zero", -0.0f, 0x8000);
+   CheckHalf("largest half", 65504.0f, 0x7BFF);
+   CheckHalf("just under the overflow tie", BitsFloat(FloatBits(65520.0f) - 1), 0x7BFF);
+   CheckHalf("overflow tie", 65520.0f, 0x7C00);
+   CheckHalf("negative overflow tie", -65520.0f, 0xFC00);
+   CheckHalf("overflow", 1e30f, 0x7C00);
+   CheckHalf("largest float", 3.4028235e38f, 0x7C00);
+   CheckHalf("infinity", BitsFloat(0x7F800000), 0x7C00);
+   CheckHalf("negative infinity", BitsFloat(0xFF800000), 0xFC00);
+
+   static const unsigned int s_anNaNs[] =
+   {
+      0x7FC00000, 0xFFC00000, 0x7F800001, 0xFF800001, 0x7FA00000, 0x7FFFFFFF, 0x7F802000, 0xFFBFFFFF
+   };
+
+   for (size_t i = 0; i < sizeof(s_anNaNs) / sizeof(s_anNaNs[0]); i++)
+   {
+      unsigned short nHalf = FloatToHalf(BitsFloat(s_anNaNs[i]));
+
+      if (!IsHalfNaN(nHalf) || (nHalf & 0x200) == 0 || (nHalf >> 15) != (s_anNaNs[i] >> 31))
+      {
+         char acCase[64];
+         sprintf(acCase, "half NaN, float 0x%08X to 0x%04X", s_anNaNs[i], nHalf);
+         Fail(acCase, "not a quiet NaN of the same sign", 0);
+      }
+   }
+}
+
+// -------------------------------------------------------------------------
+// Packing error
+// -------------------------------------------------------------------------
+static void GetFieldPeak(const WaterFieldFrame& frame, int nField, double& dPeak)
+{
+   dPeak = 0.0;
+
+   if (nField >= frame.nFields)
+   {
+      return;
+   }
+
+   for (int i = 0; i < frame.nWidth * frame.nHeight; i++)
+   {
+      double dValue = fabs(frame.apMaps[nField][i]);
+      dPeak = (dValue > dPeak) ? dValue : dPeak;
+   }
+}
+
+static void TestPackingError(int nFFTSize, float fChoppiness, int nGridSize)
+{
+   COceanSimulation ocean;
+   ocean.SetChoppiness(fChoppiness);
+
+   if (!ocean.SetFFTSize(nFFTSize) || !ocean.Init())
+   {
+      Fail("packing error", "cannot make an ocean of size", nFFTSize);
+      return;
+   }
+   ocean.Update(1.0);
+
+   WaterFieldFrame frame;
+   memset(&frame, 0, sizeof(frame));
+   frame.nWidth = nFFTSize;
+   frame.nHeight = nFFTSize;
+   frame.nFields = ocean.GetActiveFieldCount();
+   frame.fChoppiness = ocean.GetChoppiness();
+
+   for (int f = 0; f < frame.nFields; f++)
+   {
+      frame.apMaps[f] = ocean.GetField(f);
+   }
+
+   bool blChoppy = IsWaterFrameChoppy(frame);
+
+   // -------------------------------------------------------------------------
+   // The packer samples the maps, so nothing it packs is larger than
+   // their peaks, times the choppiness for the offsets.
+   // -------------------------------------------------------------------------
+   double dHeightPeak, dOffsetPeakX, dOffsetPeakZ;
+   GetFieldPeak(frame, OCEAN_FIELD_HEIGHT, dHeightPeak);
+   GetFieldPeak(frame, OCEAN_FIELD_DISPLACEMENT_X, dOffsetPeakX);
+   GetFieldPeak(frame, OCEAN_FIELD_DISPLACEMENT_Z, dOffsetPeakZ);
+   double dOffsetPeak = fabs(fChoppiness) * ((dOffsetPeakX > dOffsetPeakZ) ? dOffsetPeakX : dOffsetPeakZ);
+
+   WaterGridLayout grid;
+   grid.nRows = nGridSize;
+   grid.nColumns = nGridSize;
+   grid.fXSpacing = 1.0f;
+   grid.fZSpacing = 1.0f;
+   grid.fXOffset = -0.5f * (nGridSize - 1);
+   grid.fZOffset = 0.5f * (nGridSize - 1);
+
+   vector<unsigned char> output(nGridSize * nGridSize * WATER_DYNAMIC_VERTEX_MAX_SIZE);
+
+   // -------------------------------------------------------------------------
+   // Normals in degrees: a D3DCOLOR rounds each component to half of
+   // 2/255, at most sqrt(3)/255 radians off; 2 x 16 bits of octahedral
+   // coordinates are far finer than the float arithmetic that measures
+   // them; 2 x 8 bits are off by up to about 0.9 degrees where the
+   // octahedron stretches most. Each with some room for that arithmetic.
+   // -------------------------------------------------------------------------
+   static const double s_adNormalDegrees[WATER_NORMAL_FORMAT_COUNT] = { 0.45, 0.06, 1.0 };
+
+   for (int nLevel = SIMD_LEVEL_SCALAR; nLevel <= GetCpuSimdLevel(); nLevel++)
+   {
+      SetSimdLevelLimit(nLevel);
+
+      CWaterVertexPacker packer;
+
+      if (!packer.Init(grid))
+      {
+         Fail("packing error", "cannot make a packer for a grid of", nGridSize);
+         return;
+      }
+
+      for (int w = 0; w < WATER_WAVE_FORMAT_COUNT; w++)
+      {
+         for (int n = 0; n < WATER_NORMAL_FORMAT_COUNT; n++)
+         {
+            packer.SetFormat(w, n);
+
+            WaterDynamicConstants constants;
+            packer.Pack(frame, &output[0], constants);
+
+            WaterPackingError error;
+            packer.MeasureError(frame, &output[0], constants, error);
+
+            // -------------------------------------------------------------
+            // Floats are exact; half floats are within half an ulp, 2^-11
+            // of the value; shorts within half of their scale, with a
+            // little room for decoding through the scale and bias.
+            // -------------------------------------------------------------
+            double dMaxHeight = 0.0;
+            double dMaxOffset = 0.0;
+
+            if (w == WATER_WAVE_FLOAT16)
+            {
+               dMaxHeight = ldexp(dHeightPeak, -11) + ldexp(1.0, -24);
+               dMaxOffset = ldexp(dOffsetPeak, -11) + ldexp(1.0, -24);
+            }
+            else if (w == WATER_WAVE_INT16)
+            {
+               dMaxHeight = 0.5 * constants.afWaveScale[0] * 1.05;
+               dMaxOffset = 0.5 * ((constants.afWaveScale[1] > constants.afWaveScale[2]) ?
+                                   constants.afWaveScale[1] : constants.afWaveScale[2]) * 1.05;
+            }
+
+            char acCase[128];
+            sprintf(acCase, "packing error, ocean %d, grid %d, %s, %s, wave %d, normal %d",
+               nFFTSize, nGridSize, blChoppy ? "choppy" : "flat", GetSimdLevelName(nLevel), w, n);
+
+            if (error.fMaxHeightError > dMaxHeight)
+            {
+               Fail(acCase, "height error", error.fMaxHeightError);
+            }
+
+            if (error.fRmsHeightError > error.fMaxHeightError)
+            {
+               Fail(acCase, "RMS height error above the largest", error.fRmsHeightError);
+            }
+
+            if (blChoppy && error.fMaxOffsetError > dMaxOffset)
+            {
+               Fail(acCase, "offset error", error.fMaxOffsetError);
+            }
+
+            if (!blChoppy && error.fMaxOffsetError != 0.0f)
+            {
+               Fail(acCase, "offset error without offsets", error.fMaxOffsetError);
+            }
+
+            if (error.fMaxNormalDegrees > s_adNormalDegrees[n])
+            {
+               Fail(acCase, "normal error in degrees", error.fMaxNormalDegrees);
+            }
+         }
+      }
+   }
+
+   SetSimdLevelLimit(GetCpuSimdLevel());
+}
+
+int main()
+{
+   printf("cpu simd: %s\n", GetSimdLevelName(GetCpuSimdLevel()));
+
+   TestKernels();
+   TestHalfFloats();
+   TestPackingError(64, 1.0f, 64);
+   TestPackingError(64, 0.0f, 100);
+   TestPackingError(256, 1.0f, 256);
+
+   if (s_nFailures != 0)
+   {
+      printf("water pack: %d failures\n", s_nFailures);
+      return 1;
+   }
+
+   printf("water pack: all passed\n");
+   return 0;
+}
@@ -0,0 +1,240 @@
+#include "ThreadPool.h"
+
+CThreadPool::CThreadPool()
+{
+   m_nThreadCount = 1;
+   m_pTask = NULL;
+   m_nCount = 0;
+   m_nGrain = 1;
+   m_nPendingChunks = 0;
+   m_nGeneration = 0;
+   m_blShutdown = false;
+}
+
+CThreadPool::~CThreadPool()
+{
+   Shutdown();
+}
+
+bool CThreadPool::Init(int nThreads)
+{
+   Shutdown();
+
+   if (nThreads <= 0)
+   {
+      nThreads = GetHardwareThreadCount();
+   }
+
+   m_blShutdown = false;
+   m_nThreadCount = nThreads;
+
+   for (int t = 0; t < m_nThreadCount; t++)
+   {
+      WorkQueue* pQueue = new WorkQueue;
+      pQueue->nHead = 0;
+      pQueue->nTail = 0;
+      m_Queues.push_back(pQueue);
+   }
+
+   // -------------------------------------------------------------------------
+   // The contexts must not move once the workers hold pointers to them.
+   // -------------------------------------------------------------------------
+   m_Contexts.resize(m_nThreadCount);
+   for (int t = 1; t < m_nThreadCount; t++)
+   {
+      m_Contexts[t].pPool = this;
+      m_Contexts[t].nThread = t;
+
+      CThread* pThread = new CThread;
+      m_Threads.push_back(pThread);
+
+      if (!pThread->Start(WorkerEntry, &m_Contexts[t]))
+      {
+         Shutdown();
+         return false;
+      }
+   }
+
+   return true;
+}
+
+void CThreadPool::Shutdown()
+{
+   m_Mutex.Lock();
+   m_blShutdown = true;
+   m_WorkAvailable.Broadcast();
+   m_Mutex.Unlock();
+
+   for (size_t t = 0; t < m_Threads.size(); t++)
+   {
+      m_Threads[t]->Join();
+      delete m_Threads[t];
+   }
+   m_Threads.clear();
+   m_Contexts.clear();
+
+   for (size_t q = 0; q < m_Queues.size(); q++)
+   {
+      delete m_Queues[q];
+   }
+   m_Queues.clear();
+
+   m_nThreadCount = 1;
+}
+
+int CThreadPool::GetThreadCount()
+{
+   return m_nThreadCount;
+}
+
+void CThreadPool::ParallelFor(int nCount, int nGrain, CParallelTask* pTask)
+{
+   if (nCount <= 0)
+   {
+      return;
+   }
+
+   if (nGrain < 1)
+   {
+      nGrain = 1;
+   }
+
+   int nChunks = (nCount + nGrain - 1) / nGrain;
+
+   // -------------------------------------------------------------------------
+   // Nothing to share out: run the loop on the calling thread.
+   // -------------------------------------------------------------------------
+   if (m_Threads.empty() || nChunks == 1)
+   {
+      pTask->Run(0, nCount, 0);
+      return;
+   }
+
+   m_Mutex.Lock();
+   m_pTask = pTask;
+   m_nCount = nCount;
+   m_nGrain = nGrain;
+   m_nPendingChunks = nChunks;
+   m_Mutex.Unlock();
+
+   // -------------------------------------------------------------------------
+   // Deal neighbouring chunks to the same thread, so each thread starts on
+   // memory next to what it just touched.
+   // -------------------------------------------------------------------------
+   for (int t = 0; t < m_nThreadCount; t++)
+   {
+      WorkQueue* pQueue = m_Queues[t];
+      pQueue->mutex.Lock();
+      pQueue->nHead = (int)((long long)nChunks * t / m_nThreadCount);
+      pQueue->nTail = (int)((long long)nChunks * (t + 1) / m_nThreadCount);
+      pQueue->mutex.Unlock();
+   }
+
+   m_Mutex.Lock();
+   m_nGeneration++;
+   m_WorkAvailable.Broadcast();
+   m_Mutex.Unlock();
+
+   RunChunks(0);
+
+   m_Mutex.Lock();
+   while (m_nPendingChunks != 0)
+   {
+      m_WorkFinished.Wait(m_Mutex);
+   }
+   m_Mutex.Unlock();
+
+   m_pTask = NULL;
+}
+
+void CThreadPool::WorkerEntry(void* pContext)
+{
+   WorkerContext* pWorker = (WorkerContext*)pContext;
+   pWorker->pPool->WorkerLoop(pWorker->nThread);
+}
+
+void CThreadPool::WorkerLoop(int nThread)
+{
+   int nSeenGeneration = 0;
+
+   m_Mutex.Lock();
+   for (;;)
+   {
+      while (!m_blShutdown && m_nGeneration == nSeenGeneration)
+      {
+         m_WorkAvailable.Wait(m_Mutex);
+      }
+
+      if (m_blShutdown)
+      {
+         break;
+      }
+
+      nSeenGeneration = m_nGeneration;
+      m_Mutex.Unlock();
+
+      RunChunks(nThread);
+
+      m_Mutex.Lock();
+   }
+   m_Mutex.Unlock();
+}
+
+void CThreadPool::RunChunks(int nThread)
+{
+   for (;;)
+   {
+      // ----------------------------------------------------------------------
+      // Own queue first, then steal from the others starting with the next
+      // thread along, so thieves spread out over different victims.
+      // ----------------------------------------------------------------------
+      int nChunk = 0;
+      bool blFound = PopChunk(nThread, false, nChunk);
+
+      for (int v = 1; !blFound && v < m_nThreadCount; v++)
+      {
+         blFound = PopChunk((nThread + v) % m_nThreadCount, true, nChunk);
+      }
+
+      if (!blFound)
+      {
+         return;
+      }
+
+      int nBegin = nChunk * m_nGrain;
+      int nEnd = nBegin + m_nGrain;
+      if (nEnd > m_nCount)
+      {
+         nEnd = m_nCount;
+      }
+
+      m_pTask->Run(nBegin, nEnd, nThread);
+
+      // ----------------------------------------------------------------------
+      // Counting under the pool mutex also publishes this chunk's results to
+      // the thread waiting in ParallelFor.
+      // ----------------------------------------------------------------------
+      m_Mutex.Lock();
+      if (--m_nPendingChunks == 0)
+      {
+         m_WorkFinished.Signal();
+      }
+      m_Mutex.Unlock();
+   }
+}
+
+bool CThreadPool::PopChunk(int nQueue, bool blSteal, int& nChunk)
+{
+   WorkQueue* pQueue = m_Queues[nQueue];
+   bool blFound = false;
+
+   pQueue->mutex.Lock();
+   if (pQueue->nHead < pQueue->nTail)
+   {
+      nChunk = blSteal ? --pQueue->nTail : pQueue->nHead++;
+      blFound = true;
+   }
+   pQueue->mutex.Unlock();
+
+   return blFound;
+}
@@ -0,0 +1,98 @@
+// -------------------------------------------------------------------------
+// Sean Janis
+// spjanis@gmail.com
+// Water Simulations
+//
+// CThreadPool
+//       Fixed set of worker threads that run parallel loops. ParallelFor
+//       splits an index range into chunks and deals them out evenly to one
+//       queue per thread. Each thread takes chunks from the front of its own
+//       queue. When that queue is empty it steals from the back of the
+//       others, so a thread that falls behind is helped out rather than
+//       holding up the loop. The calling thread works as thread 0, and
+//       ParallelFor returns only once every chunk has finished. This makes
+//       each call a barrier.
+// -------------------------------------------------------------------------
+#pragma once
+
+#include <vector>
+#include "Threading.h"
+using namespace std;
+
+// -------------------------------------------------------------------------
+// Body of a parallel loop. Run is called for each chunk [nBegin, nEnd) on
+// the thread numbered nThread, in the range 0..GetThreadCount() - 1. No two
+// chunks run on the same thread at the same time, so nThread can index
+// per-thread scratch memory.
+// -------------------------------------------------------------------------
+class CParallelTask
+{
+public:
+   virtual ~CParallelTask() {}
+   virtual void Run(int nBegin, int nEnd, int nThread) = 0;
+};
+
+class CThreadPool
+{
+public:
+   CThreadPool();
+   virtual ~CThreadPool();
+
+   // -------------------------------------------------------------------------
+   // nThreads counts the calling thread, so nThreads - 1 workers are started.
+   // 0 means one thread per hardware thread. A pool that was never started
+   // runs every loop on the calling thread.
+   // -------------------------------------------------------------------------
+   bool Init(int nThreads = 0);
+   void Shutdown();
+   int GetThreadCount();
+
+   // -------------------------------------------------------------------------
+   // Runs pTask over [0, nCount) in chunks of nGrain indices and waits for
+   // all of them to finish. Must not be called from inside a task.
+   // -------------------------------------------------------------------------
+   void ParallelFor(int nCount, int nGrain, CParallelTask* pTask);
+
+protected:
+   // -------------------------------------------------------------------------
+   // Each queue holds a contiguous run of chunk numbers [nHead, nTail).
+   // -------------------------------------------------------------------------
+   struct WorkQueue
+   {
+      CMutex mutex;
+      int nHead;
+      int nTail;
+   };
+
+   struct WorkerContext
+   {
+      CThreadPool* pPool;
+      int nThread;
+   };
+
+   static void WorkerEntry(void* pContext);
+   void WorkerLoop(int nThread);
+   void RunChunks(int nThread);
+   bool PopChunk(int nQueue, bool blSteal, int& nChunk);
+
+protected:
+   int m_nThreadCount;
+   vector<CThread*> m_Threads;
+   vector<WorkerContext> m_Contexts;
+   vector<WorkQueue*> m_Queues;
+
+   // -------------------------------------------------------------------------
+   // Current loop. m_nGeneration is bumped for every ParallelFor so sleeping
+   // workers know there is new work.
+   // -------------------------------------------------------------------------
+   CParallelTask* m_pTask;
+   int m_nCount;
+   int m_nGrain;
+   int m_nPendingChunks;
+
+   CMutex m_Mutex;
+   CConditionVariable m_WorkAvailable;
+   CConditionVariable m_WorkFinished;
+   int m_nGeneration;
+   bool m_blShutdown;
+};
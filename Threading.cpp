@@ -0,0 +1,180 @@
+#include "Threading.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+int GetHardwareThreadCount()
+{
+#ifdef _WIN32
+   SYSTEM_INFO systemInfo;
+   GetSystemInfo(&systemInfo);
+   int nCount = (int)systemInfo.dwNumberOfProcessors;
+#else
+   int nCount = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+   return (nCount > 0) ? nCount : 1;
+}
+
+// -------------------------------------------------------------------------
+// CMutex
+// -------------------------------------------------------------------------
+CMutex::CMutex()
+{
+#ifdef _WIN32
+   InitializeCriticalSection(&m_Mutex);
+#else
+   pthread_mutex_init(&m_Mutex, NULL);
+#endif
+}
+
+CMutex::~CMutex()
+{
+#ifdef _WIN32
+   DeleteCriticalSection(&m_Mutex);
+#else
+   pthread_mutex_destroy(&m_Mutex);
+#endif
+}
+
+void CMutex::Lock()
+{
+#ifdef _WIN32
+   EnterCriticalSection(&m_Mutex);
+#else
+   pthread_mutex_lock(&m_Mutex);
+#endif
+}
+
+void CMutex::Unlock()
+{
+#ifdef _WIN32
+   LeaveCriticalSection(&m_Mutex);
+#else
+   pthread_mutex_unlock(&m_Mutex);
+#endif
+}
+
+// -------------------------------------------------------------------------
+// CConditionVariable
+// -------------------------------------------------------------------------
+CConditionVariable::CConditionVariable()
+{
+#ifdef _WIN32
+   InitializeConditionVariable(&m_Condition);
+#else
+   pthread_cond_init(&m_Condition, NULL);
+#endif
+}
+
+CConditionVariable::~CConditionVariable()
+{
+#ifndef _WIN32
+   pthread_cond_destroy(&m_Condition);
+#endif
+}
+
+void CConditionVariable::Wait(CMutex& mutex)
+{
+#ifdef _WIN32
+   SleepConditionVariableCS(&m_Condition, &mutex.m_Mutex, INFINITE);
+#else
+   pthread_cond_wait(&m_Condition, &mutex.m_Mutex);
+#endif
+}
+
+void CConditionVariable::Signal()
+{
+#ifdef _WIN32
+   WakeConditionVariable(&m_Condition);
+#else
+   pthread_cond_signal(&m_Condition);
+#endif
+}
+
+void CConditionVariable::Broadcast()
+{
+#ifdef _WIN32
+   WakeAllConditionVariable(&m_Condition);
+#else
+   pthread_cond_broadcast(&m_Condition);
+#endif
+}
+
+// -------------------------------------------------------------------------
+// CThread
+// -------------------------------------------------------------------------
+CThread::CThread()
+{
+#ifdef _WIN32
+   m_hThread = NULL;
+#endif
+   m_blRunning = false;
+   m_pfnThread = NULL;
+   m_pContext = NULL;
+}
+
+CThread::~CThread()
+{
+   Join();
+}
+
+bool CThread::Start(ThreadFunc pfnThread, void* pContext)
+{
+   if (m_blRunning)
+   {
+      return false;
+   }
+
+   m_pfnThread = pfnThread;
+   m_pContext = pContext;
+
+#ifdef _WIN32
+   m_hThread = CreateThread(NULL, 0, ThreadEntry, this, 0, NULL);
+   m_blRunning = (m_hThread != NULL);
+#else
+   m_blRunning = (pthread_create(&m_Thread, NULL, ThreadEntry, this) == 0);
+#endif
+
+   return m_blRunning;
+}
+
+void CThread::Join()
+{
+   if (!m_blRunning)
+   {
+      return;
+   }
+
+#ifdef _WIN32
+   WaitForSingleObject(m_hThread, INFINITE);
+   CloseHandle(m_hThread);
+   m_hThread = NULL;
+#else
+   pthread_join(m_Thread, NULL);
+#endif
+
+   m_blRunning = false;
+}
+
+bool CThread::IsRunning()
+{
+   return m_blRunning;
+}
+
+#ifdef _WIN32
+DWORD WINAPI CThread::ThreadEntry(LPVOID pParameter)
+{
+   CThread* pThread = (CThread*)pParameter;
+   pThread->m_pfnThread(pThread->m_pContext);
+   return 0;
+}
+#else
+void* CThread::ThreadEntry(void* pParameter)
+{
+   CThread* pThread = (CThread*)pParameter;
+   pThread->m_pfnThread(pThread->m_pContext);
+   return NULL;
+}
+#endif
@@ -0,0 +1,102 @@
+// -------------------------------------------------------------------------
+// Sean Janis
+// spjanis@gmail.com
+// Water Simulations
+//
+// Threading
+//       Thin wrappers over the Win32 and POSIX threading primitives used by
+//       CThreadPool: a mutex, a condition variable and a worker thread.
+// -------------------------------------------------------------------------
+#pragma once
+
+#ifdef _WIN32
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT   0x0600
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+// -------------------------------------------------------------------------
+// Number of hardware threads available to this process, at least 1.
+// -------------------------------------------------------------------------
+int GetHardwareThreadCount();
+
+class CMutex
+{
+public:
+   CMutex();
+   virtual ~CMutex();
+
+   void Lock();
+   void Unlock();
+
+protected:
+   friend class CConditionVariable;
+
+#ifdef _WIN32
+   CRITICAL_SECTION m_Mutex;
+#else
+   pthread_mutex_t m_Mutex;
+#endif
+
+private:
+   CMutex(const CMutex&);
+   CMutex& operator=(const CMutex&);
+};
+
+class CConditionVariable
+{
+public:
+   CConditionVariable();
+   virtual ~CConditionVariable();
+
+   // -------------------------------------------------------------------------
+   // The mutex must be locked by the caller. It is released while waiting
+   // and locked again before Wait returns.
+   // -------------------------------------------------------------------------
+   void Wait(CMutex& mutex);
+   void Signal();
+   void Broadcast();
+
+protected:
+#ifdef _WIN32
+   CONDITION_VARIABLE m_Condition;
+#else
+   pthread_cond_t m_Condition;
+#endif
+
+private:
+   CConditionVariable(const CConditionVariable&);
+   CConditionVariable& operator=(const CConditionVariable&);
+};
+
+typedef void (*ThreadFunc)(void* pContext);
+
+class CThread
+{
+public:
+   CThread();
+   virtual ~CThread();
+
+   bool Start(ThreadFunc pfnThread, void* pContext);
+   void Join();
+   bool IsRunning();
+
+protected:
+#ifdef _WIN32
+   static DWORD WINAPI ThreadEntry(LPVOID pParameter);
+   HANDLE m_hThread;
+#else
+   static void* ThreadEntry(void* pParameter);
+   pthread_t m_Thread;
+#endif
+   bool m_blRunning;
+   ThreadFunc m_pfnThread;
+   void* m_pContext;
+
+private:
+   CThread(const CThread&);
+   CThread& operator=(const CThread&);
+};
@@ -0,0 +1,309 @@
+// -------------------------------------------------------------------------
+// Sean Janis
+// spjanis@gmail.com
+// Water Simulations
+//
+// OceanBakeTool
+//       Console tool that runs COceanSimulation headlessly and bakes its
+//       spatial maps, frame by frame, to a file the water surface can play
+//       back with -bake:FILE, see OceanBake.h. It can also describe a baked
+//       file and time copying, or decoding, every frame of it.
+//
+//       Usage: ocean_bake [-size N] [-rate HZ] [-frames F] [-start S]
+//                         [-loop T] [-seed SEED] [-wind X Z] [-choppiness C]
+//                         [-spacing X Z] [-error E] [-keyframes K]
+//                         [-threads N] FILE
+//              ocean_bake -info FILE
+//              HZ frames per second (60 by default) are simulated from S
+//              seconds, F of them (600 by default). A loop of T seconds
+//              bakes exactly one period, as many frames of it as fit the
+//              rate, and plays back seamlessly. The spacing is the world
+//              distance between samples written to the header. An error
+//              bound E compresses the frames, every sample within E of the
+//              simulation, with a keyframe every K frames (30 by default).
+// -------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "OceanSimulation.h"
+#include "OceanBake.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+static double GetSeconds()
+{
+#ifdef _WIN32
+   LARGE_INTEGER frequency, counter;
+   QueryPerformanceFrequency(&frequency);
+   QueryPerformanceCounter(&counter);
+   return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+   timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return now.tv_sec + now.tv_nsec * 1e-9;
+#endif
+}
+
+static int PrintInfo(const char* pPath, int nThreads)
+{
+   COceanBakeReader reader;
+   CThreadPool pool;
+
+   if (!reader.Open(pPath))
+   {
+      printf("%s is not a valid ocean bake\n", pPath);
+      return 1;
+   }
+
+   const OceanBakeHeader& header = reader.GetHeader();
+
+   printf("version:      %u\n", header.nVersion);
+   printf("grid:         %d x %d, %d fields\n", header.nWidth, header.nHeight, header.nFields);
+   printf("spacing:      %g x %g\n", header.fSpacingX, header.fSpacingZ);
+   printf("frames:       %d from %g s, %g s apart\n", header.nFrames, header.fStartTime, header.fTimeStep);
+   printf("loop period:  %g s\n", header.fLoopPeriod);
+   printf("wind:         %g, %g\n", header.fXWindSpeed, header.fZWindSpeed);
+   printf("phillips A:   %g\n", header.fPhillipsConstant);
+   printf("gravity:      %g\n", header.fGravityConstant);
+   printf("choppiness:   %g\n", header.fChoppiness);
+   printf("seed:         0x%X\n", header.nSeed);
+   printf("spectrum:     model %d, spreading %d\n", header.nSpectrumModel, header.nSpreading);
+
+   int nSamples = header.nWidth * header.nHeight;
+   double dBytes = (double)header.nFrames * header.nFields * nSamples * sizeof(float);
+
+   if (header.nFormat == OCEAN_BAKE_FORMAT_CODEC)
+   {
+      printf("codec:        step %g, keyframe every %d frames\n",
+         header.afQuantizationSteps[0], header.nKeyframeInterval);
+      printf("compression:  %.2f:1 against raw frames\n",
+         dBytes / (double)header.nIndexOffset);
+
+      pool.Init(nThreads);
+      reader.SetThreadPool(&pool);
+   }
+
+   // -------------------------------------------------------------------------
+   // Copy every frame out of the mapping once, the first time from disk or
+   // the page cache, which is what playback costs at most; codec frames
+   // are decoded in order instead, as playback does. Only the copy or the
+   // decode is timed, the checksum is taken after.
+   // -------------------------------------------------------------------------
+   vector<float> copy((size_t)header.nFields * nSamples);
+   double dElapsed = 0.0;
+   float fSum = 0.0f;
+
+   for (int i = 0; i < header.nFrames; i++)
+   {
+      const float* apMaps[OCEAN_BAKE_MAX_FIELDS];
+      double dStart = GetSeconds();
+
+      if (!reader.GetFrame(i, apMaps))
+      {
+         printf("frame %d is corrupt\n", i);
+         return 1;
+      }
+
+      if (header.nFormat != OCEAN_BAKE_FORMAT_CODEC)
+      {
+         for (int f = 0; f < header.nFields; f++)
+         {
+            memcpy(&copy[f * nSamples], apMaps[f], nSamples * sizeof(float));
+            apMaps[f] = &copy[f * nSamples];
+         }
+      }
+
+      dElapsed += GetSeconds() - dStart;
+
+      for (int f = 0; f < header.nFields; f++)
+      {
+         for (int s = 0; s < nSamples; s++)
+         {
+            fSum += apMaps[f][s];
+         }
+      }
+   }
+
+   printf("%s        %.3f ms/frame, %.2f GB/s of maps (checksum %g)\n",
+      (header.nFormat == OCEAN_BAKE_FORMAT_CODEC) ? "decode:" : "copy:  ",
+      dElapsed * 1e3 / header.nFrames,
+      dBytes / dElapsed * 1e-9,
+      (double)fSum);
+   return 0;
+}
+
+int main(int argc, char* argv[])
+{
+   int nSize = OCEAN_FFT_SIZE;
+   float fRate = 60.0f;
+   int nFrames = 600;
+   bool blFramesSet = false;
+   float fStartTime = 0.0f;
+   float fLoopPeriod = 0.0f;
+   float fSpacingX = 1.0f;
+   float fSpacingZ = 1.0f;
+   float fMaxError = 0.0f;
+   int nKeyframeInterval = OCEAN_BAKE_KEYFRAME_INTERVAL;
+   int nThreads = 0;
+   const char* pInfoPath = NULL;
+   const char* pPath = NULL;
+
+   COceanSimulation ocean;
+
+   for (int i = 1; i < argc; i++)
+   {
+      if (strcmp(argv[i], "-info") == 0 && i + 1 < argc)
+      {
+         pInfoPath = argv[++i];
+      }
+      else if (strcmp(argv[i], "-size") == 0 && i + 1 < argc)
+      {
+         nSize = atoi(argv[++i]);
+      }
+      else if (strcmp(argv[i], "-rate") == 0 && i + 1 < argc)
+      {
+         fRate = (float)atof(argv[++i]);
+      }
+      else if (strcmp(argv[i], "-frames") == 0 && i + 1 < argc)
+      {
+         nFrames = atoi(argv[++i]);
+         blFramesSet = true;
+      }
+      else if (strcmp(argv[i], "-start") == 0 && i + 1 < argc)
+      {
+         fStartTime = (float)atof(argv[++i]);
+      }
+      else if (strcmp(argv[i], "-loop") == 0 && i + 1 < argc)
+      {
+         fLoopPeriod = (float)atof(argv[++i]);
+      }
+      else if (strcmp(argv[i], "-seed") == 0 && i + 1 < argc)
+      {
+         ocean.SetSeed((unsigned int)strtoul(argv[++i], NULL, 0));
+      }
+      else if (strcmp(argv[i], "-wind") == 0 && i + 2 < argc)
+      {
+         ocean.SetXWindSpeed((float)atof(argv[++i]));
+         ocean.SetZWindSpeed((float)atof(argv[++i]));
+      }
+      else if (strcmp(argv[i], "-choppiness") == 0 && i + 1 < argc)
+      {
+         ocean.SetChoppiness((float)atof(argv[++i]));
+      }
+      else if (strcmp(argv[i], "-spacing") == 0 && i + 2 < argc)
+      {
+         fSpacingX = (float)atof(argv[++i]);
+         fSpacingZ = (float)atof(argv[++i]);
+      }
+      else if (strcmp(argv[i], "-error") == 0 && i + 1 < argc)
+      {
+         fMaxError = (float)atof(argv[++i]);
+      }
+      else if (strcmp(argv[i], "-keyframes") == 0 && i + 1 < argc)
+      {
+         nKeyframeInterval = atoi(argv[++i]);
+      }
+      else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc)
+      {
+         nThreads = atoi(argv[++i]);
+      }
+      else
+      {
+         pPath = argv[i];
+      }
+   }
+
+   if (pInfoPath != NULL)
+   {
+      return PrintInfo(pInfoPath, nThreads);
+   }
+
+   if (pPath == NULL || !(fRate > 0.0f))
+   {
+      printf("usage: ocean_bake [options] FILE, or ocean_bake [-threads N] -info FILE\n");
+      return 1;
+   }
+
+   // -------------------------------------------------------------------------
+   // A loop is baked whole, with the frames spread evenly over one period
+   // so that the last leads straight back into the first.
+   // -------------------------------------------------------------------------
+   float fTimeStep = 1.0f / fRate;
+
+   if (fLoopPeriod > 0.0f)
+   {
+      if (!blFramesSet)
+      {
+         nFrames = (int)floor(fLoopPeriod * fRate + 0.5f);
+      }
+
+      nFrames = (nFrames < 1) ? 1 : nFrames;
+      fTimeStep = fLoopPeriod / nFrames;
+      fStartTime = 0.0f;
+   }
+
+   ocean.SetLoopPeriod(fLoopPeriod);
+   ocean.SetFFTThreadCount(nThreads);
+
+   if (nFrames <= 0 || !ocean.SetFFTSize(nSize) || !ocean.Init())
+   {
+      printf("cannot simulate %d frames at size %d\n", nFrames, nSize);
+      return 1;
+   }
+
+   OceanBakeHeader header;
+   GetOceanBakeHeader(ocean, fSpacingX, fSpacingZ, fTimeStep, fStartTime, header);
+
+   if (fMaxError > 0.0f)
+   {
+      SetOceanBakeCodec(header, fMaxError, nKeyframeInterval);
+   }
+
+   COceanBakeWriter writer;
+   if (!writer.Open(pPath, header))
+   {
+      printf("cannot write %s\n", pPath);
+      return 1;
+   }
+
+   double dStart = GetSeconds();
+
+   for (int i = 0; i < nFrames; i++)
+   {
+      const float* apMaps[OCEAN_FIELD_COUNT];
+
+      ocean.Update(fStartTime + (double)fTimeStep * i);
+
+      for (int f = 0; f < header.nFields; f++)
+      {
+         apMaps[f] = ocean.GetField(f);
+      }
+
+      if (!writer.WriteFrame(apMaps))
+      {
+         break;
+      }
+   }
+
+   if (!writer.Close())
+   {
+      printf("cannot write %s\n", pPath);
+      return 1;
+   }
+
+   printf("baked %d frames of %d x %d, %d fields, in %.2f s\n",
+      nFrames, nSize, nSize, header.nFields, GetSeconds() - dStart);
+
+   if (fMaxError > 0.0f)
+   {
+      printf("max error %g within %g\n", writer.GetMaxError(), fMaxError);
+   }
+
+   return 0;
+}
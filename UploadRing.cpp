@@ -0,0 +1,360 @@
+#include <string.h>
+#include "UploadRing.h"
+
+static int AlignUp(int nBytes)
+{
+   return (nBytes + UPLOAD_RING_ALIGNMENT - 1) & ~(UPLOAD_RING_ALIGNMENT - 1);
+}
+
+CUploadRing::CUploadRing()
+{
+   m_pSink = NULL;
+   m_nCapacity = 0;
+   m_nHead = 0;
+   m_nFrameStart = 0;
+   m_blFrameHasSpans = false;
+   m_blDiscardNext = false;
+   m_nFirstFrame = 0;
+   m_nFrameCount = 0;
+   m_nNextFence = 0;
+   ResetStats();
+}
+
+CUploadRing::~CUploadRing()
+{
+   Free();
+}
+
+bool CUploadRing::Init(CUploadSink* pSink, int nCapacity)
+{
+   Free();
+
+   if (pSink == NULL || nCapacity <= 0 || !pSink->Create(nCapacity))
+   {
+      return false;
+   }
+
+   m_pSink = pSink;
+   m_nCapacity = nCapacity;
+
+   // -------------------------------------------------------------------------
+   // The first lock discards, whatever the buffer held before.
+   // -------------------------------------------------------------------------
+   m_blDiscardNext = true;
+   ResetStats();
+   return true;
+}
+
+void CUploadRing::Free()
+{
+   if (m_pSink != NULL)
+   {
+      m_pSink->Destroy();
+      m_pSink = NULL;
+   }
+
+   m_nCapacity = 0;
+   m_nHead = 0;
+   m_nFrameStart = 0;
+   m_blFrameHasSpans = false;
+   m_blDiscardNext = false;
+   m_nFirstFrame = 0;
+   m_nFrameCount = 0;
+   m_nNextFence = 0;
+}
+
+void* CUploadRing::Lock(int nBytes, int& nOffset)
+{
+   nOffset = 0;
+   int nSize = AlignUp(nBytes);
+
+   if (m_pSink == NULL || nBytes <= 0 || nSize > m_nCapacity)
+   {
+      m_Stats.nFailedLocks++;
+      return NULL;
+   }
+
+   RetireFrames();
+
+   int nStart = m_blDiscardNext ? -1 : FindSpan(nSize);
+   bool blDiscard = (nStart < 0);
+
+   if (blDiscard)
+   {
+      // -------------------------------------------------------------------------
+      // The driver gives the buffer fresh memory and keeps the old one for
+      // the GPU, so nothing written before is in the way any more.
+      // -------------------------------------------------------------------------
+      nStart = 0;
+      m_nFirstFrame = 0;
+      m_nFrameCount = 0;
+      m_blFrameHasSpans = false;
+      m_blDiscardNext = false;
+   }
+   else if (nStart < m_nHead)
+   {
+      m_Stats.nWraps++;
+   }
+
+   void* pData = m_pSink->Lock(nStart, nBytes, blDiscard);
+
+   if (pData == NULL)
+   {
+      m_Stats.nFailedLocks++;
+      m_blDiscardNext = true;
+      return NULL;
+   }
+
+   if (!m_blFrameHasSpans)
+   {
+      m_nFrameStart = nStart;
+      m_blFrameHasSpans = true;
+   }
+
+   m_nHead = nStart + nSize;
+
+   m_Stats.nLocks++;
+   m_Stats.nDiscardLocks += blDiscard ? 1 : 0;
+   m_Stats.nNoOverwriteLocks += blDiscard ? 0 : 1;
+   m_Stats.dBytes += nBytes;
+
+   nOffset = nStart;
+   return pData;
+}
+
+void CUploadRing::Unlock()
+{
+   if (m_pSink != NULL)
+   {
+      m_pSink->Unlock();
+   }
+}
+
+void CUploadRing::EndFrame()
+{
+   m_Stats.nFrames++;
+
+   if (m_pSink == NULL || !m_blFrameHasSpans)
+   {
+      return;
+   }
+
+   RetireFrames();
+
+   // -------------------------------------------------------------------------
+   // With every fence still out there is none to mark this frame with, so
+   // the ring forgets them all and the next lock discards instead.
+   // -------------------------------------------------------------------------
+   if (m_nFrameCount == UPLOAD_RING_MAX_FRAMES)
+   {
+      m_nFirstFrame = 0;
+      m_nFrameCount = 0;
+      m_blDiscardNext = true;
+   }
+
+   UploadFrame& frame = m_aFrames[(m_nFirstFrame + m_nFrameCount) % UPLOAD_RING_MAX_FRAMES];
+   frame.nFence = m_nNextFence;
+   frame.nStart = m_nFrameStart;
+   frame.nEnd = m_nHead;
+   m_nFrameCount++;
+
+   m_pSink->IssueFence(m_nNextFence);
+   m_nNextFence = (m_nNextFence + 1) % UPLOAD_RING_MAX_FRAMES;
+   m_blFrameHasSpans = false;
+
+   if (m_nFrameCount > m_Stats.nMaxFramesInFlight)
+   {
+      m_Stats.nMaxFramesInFlight = m_nFrameCount;
+   }
+}
+
+int CUploadRing::GetCapacity() const
+{
+   return m_nCapacity;
+}
+
+int CUploadRing::GetFramesInFlight() const
+{
+   return m_nFrameCount;
+}
+
+const UploadRingStats& CUploadRing::GetStats() const
+{
+   return m_Stats;
+}
+
+void CUploadRing::ResetStats()
+{
+   memset(&m_Stats, 0, sizeof(m_Stats));
+}
+
+void CUploadRing::RetireFrames()
+{
+   while (m_nFrameCount > 0 && m_pSink->IsFenceComplete(m_aFrames[m_nFirstFrame].nFence))
+   {
+      m_nFirstFrame = (m_nFirstFrame + 1) % UPLOAD_RING_MAX_FRAMES;
+      m_nFrameCount--;
+   }
+}
+
+int CUploadRing::FindSpan(int nBytes) const
+{
+   // -------------------------------------------------------------------------
+   // What is in use runs round the ring from the start of the oldest frame
+   // in flight, or of this frame, to the head. Next comes the space after
+   // the head, then the space from the front of the buffer up to that
+   // start. -1 means neither is big enough.
+   // -------------------------------------------------------------------------
+   if (m_nFrameCount == 0 && !m_blFrameHasSpans)
+   {
+      return (m_nHead + nBytes <= m_nCapacity) ? m_nHead : 0;
+   }
+
+   int nTail = (m_nFrameCount > 0) ? m_aFrames[m_nFirstFrame].nStart : m_nFrameStart;
+
+   if (nTail < m_nHead)
+   {
+      if (m_nHead + nBytes <= m_nCapacity)
+      {
+         return m_nHead;
+      }
+
+      return (nBytes <= nTail) ? 0 : -1;
+   }
+
+   if (nTail > m_nHead)
+   {
+      return (m_nHead + nBytes <= nTail) ? m_nHead : -1;
+   }
+
+   return -1;
+}
+
+CCpuUploadSink::CCpuUploadSink()
+{
+   m_nLatency = 0;
+   m_nIssueCount = 0;
+   m_nHazards = 0;
+   m_nDiscards = 0;
+
+   for (int f = 0; f < UPLOAD_RING_MAX_FRAMES; f++)
+   {
+      m_anFenceIssues[f] = -1;
+   }
+}
+
+CCpuUploadSink::~CCpuUploadSink()
+{
+}
+
+bool CCpuUploadSink::Create(int nBytes)
+{
+   Destroy();
+   return m_Buffer.Allocate(nBytes);
+}
+
+void CCpuUploadSink::Destroy()
+{
+   m_Buffer.Free();
+   m_WrittenSpans.clear();
+}
+
+void* CCpuUploadSink::Lock(int nOffset, int nBytes, bool blDiscard)
+{
+   if (nOffset < 0 || nBytes <= 0 || nOffset + nBytes > m_Buffer.GetCount())
+   {
+      return NULL;
+   }
+
+   RetireSpans();
+
+   if (blDiscard)
+   {
+      m_nDiscards++;
+      m_WrittenSpans.clear();
+   }
+   else
+   {
+      for (size_t s = 0; s < m_WrittenSpans.size(); s++)
+      {
+         const WrittenSpan& span = m_WrittenSpans[s];
+
+         if (nOffset < span.nOffset + span.nBytes && span.nOffset < nOffset + nBytes)
+         {
+            m_nHazards++;
+            break;
+         }
+      }
+   }
+
+   WrittenSpan span;
+   span.nOffset = nOffset;
+   span.nBytes = nBytes;
+   span.nIssue = -1;
+   m_WrittenSpans.push_back(span);
+
+   return m_Buffer.GetData() + nOffset;
+}
+
+void CCpuUploadSink::Unlock()
+{
+}
+
+void CCpuUploadSink::IssueFence(int nFence)
+{
+   for (size_t s = 0; s < m_WrittenSpans.size(); s++)
+   {
+      if (m_WrittenSpans[s].nIssue < 0)
+      {
+         m_WrittenSpans[s].nIssue = m_nIssueCount;
+      }
+   }
+
+   m_anFenceIssues[nFence] = m_nIssueCount;
+   m_nIssueCount++;
+}
+
+bool CCpuUploadSink::IsFenceComplete(int nFence)
+{
+   return m_nIssueCount - 1 - m_anFenceIssues[nFence] >= m_nLatency;
+}
+
+void CCpuUploadSink::SetLatency(int nLatency)
+{
+   m_nLatency = (nLatency > 0) ? nLatency : 0;
+}
+
+int CCpuUploadSink::GetLatency() const
+{
+   return m_nLatency;
+}
+
+int CCpuUploadSink::GetHazardCount() const
+{
+   return m_nHazards;
+}
+
+int CCpuUploadSink::GetDiscardCount() const
+{
+   return m_nDiscards;
+}
+
+void CCpuUploadSink::RetireSpans()
+{
+   // -------------------------------------------------------------------------
+   // The GPU has read every span behind a fence it has passed.
+   // -------------------------------------------------------------------------
+   size_t nKept = 0;
+
+   for (size_t s = 0; s < m_WrittenSpans.size(); s++)
+   {
+      const WrittenSpan& span = m_WrittenSpans[s];
+
+      if (span.nIssue < 0 || m_nIssueCount - 1 - span.nIssue < m_nLatency)
+      {
+         m_WrittenSpans[nKept++] = span;
+      }
+   }
+
+   m_WrittenSpans.resize(nKept);
+}
@@ -0,0 +1,205 @@
+// -------------------------------------------------------------------------
+// Sean Janis
+// spjanis@gmail.com
+// Water Simulations
+//
+// UploadRing
+//       Streams per-frame data, such as the water surface's dynamic
+//       vertices, into one buffer the GPU reads from, without stalling on
+//       it. CUploadRing sub-allocates the buffer front to back and locks
+//       each span with no-overwrite, promising not to touch anything the
+//       GPU may still be reading. Every frame ends with a fence; once the
+//       GPU passes a frame's fence its spans are free again, and the ring
+//       wraps round to them. Only when the GPU is too far behind for the
+//       next span to fit does it discard the buffer, which lets the driver
+//       hand out fresh memory instead of waiting.
+//
+//       The buffer and its fences sit behind CUploadSink: D3DUploadSink.h
+//       has the Direct3D one, and CCpuUploadSink below keeps the buffer in
+//       plain memory and plays a GPU a set number of frames behind, so the
+//       ring runs headless. It also checks that no span is overwritten
+//       while its frame is in flight.
+// -------------------------------------------------------------------------
+#pragma once
+
+#include <vector>
+#include "AlignedBuffer.h"
+
+// -------------------------------------------------------------------------
+// Frames the ring keeps track of at once, each with a fence of its own.
+// -------------------------------------------------------------------------
+#define UPLOAD_RING_MAX_FRAMES         8
+
+// -------------------------------------------------------------------------
+// Spans start this many bytes apart at least, which keeps them on their
+// own cache lines and suits any vertex stride D3D allows as a stream
+// offset.
+// -------------------------------------------------------------------------
+#define UPLOAD_RING_ALIGNMENT          16
+
+class CUploadSink
+{
+public:
+   virtual ~CUploadSink()
+   {
+   }
+
+   // -------------------------------------------------------------------------
+   // Replaces the buffer with one of nBytes. Returns false, and leaves no
+   // buffer, on failure.
+   // -------------------------------------------------------------------------
+   virtual bool Create(int nBytes) = 0;
+   virtual void Destroy() = 0;
+
+   // -------------------------------------------------------------------------
+   // Maps nBytes at nOffset for writing, discarding the whole buffer if
+   // blDiscard, and otherwise promising not to touch what the GPU may be
+   // reading. Returns NULL on failure.
+   // -------------------------------------------------------------------------
+   virtual void* Lock(int nOffset, int nBytes, bool blDiscard) = 0;
+   virtual void Unlock() = 0;
+
+   // -------------------------------------------------------------------------
+   // Fences 0 to UPLOAD_RING_MAX_FRAMES - 1. IssueFence marks the end of
+   // the GPU work submitted so far; IsFenceComplete polls, without
+   // waiting, whether the GPU has passed it since.
+   // -------------------------------------------------------------------------
+   virtual void IssueFence(int nFence) = 0;
+   virtual bool IsFenceComplete(int nFence) = 0;
+};
+
+// -------------------------------------------------------------------------
+// Counts since Init or ResetStats. dBytes is what the caller asked to
+// upload, before alignment.
+// -------------------------------------------------------------------------
+struct UploadRingStats
+{
+   int nFrames;
+   int nLocks;
+   int nNoOverwriteLocks;
+   int nDiscardLocks;
+   int nWraps;
+   int nFailedLocks;
+   int nMaxFramesInFlight;
+   double dBytes;
+};
+
+class CUploadRing
+{
+public:
+   CUploadRing();
+   virtual ~CUploadRing();
+
+   // -------------------------------------------------------------------------
+   // Creates a buffer of nCapacity bytes in pSink, which the ring uses but
+   // does not own. A few frames' worth lets the GPU fall that far behind
+   // before a discard. Returns false if the sink cannot create it.
+   // -------------------------------------------------------------------------
+   bool Init(CUploadSink* pSink, int nCapacity);
+   void Free();
+
+   // -------------------------------------------------------------------------
+   // Maps a span of nBytes for this frame and gives its offset in the
+   // buffer. Returns NULL if nBytes is larger than the buffer or the sink
+   // fails. Unlock before the next Lock and before drawing from it.
+   // -------------------------------------------------------------------------
+   void* Lock(int nBytes, int& nOffset);
+   void Unlock();
+
+   // -------------------------------------------------------------------------
+   // Call once the frame's draws from the buffer are submitted.
+   // -------------------------------------------------------------------------
+   void EndFrame();
+
+   int GetCapacity() const;
+   int GetFramesInFlight() const;
+
+   const UploadRingStats& GetStats() const;
+   void ResetStats();
+
+protected:
+   void RetireFrames();
+   int FindSpan(int nBytes) const;
+
+   struct UploadFrame
+   {
+      int nFence;
+      int nStart;
+      int nEnd;
+   };
+
+   CUploadSink* m_pSink;
+   int m_nCapacity;
+
+   // -------------------------------------------------------------------------
+   // Where the next span goes, where this frame's spans started if it has
+   // any, and whether the next lock must discard; the frames in flight,
+   // oldest first, in a circular queue; and the next fence to issue.
+   // -------------------------------------------------------------------------
+   int m_nHead;
+   int m_nFrameStart;
+   bool m_blFrameHasSpans;
+   bool m_blDiscardNext;
+   UploadFrame m_aFrames[UPLOAD_RING_MAX_FRAMES];
+   int m_nFirstFrame;
+   int m_nFrameCount;
+   int m_nNextFence;
+
+   UploadRingStats m_Stats;
+
+private:
+   CUploadRing(const CUploadRing&);
+   CUploadRing& operator=(const CUploadRing&);
+};
+
+// -------------------------------------------------------------------------
+// A sink in plain memory. Its GPU runs nLatency frames behind: a fence
+// completes once nLatency more have been issued after it, 0 completing it
+// at once. Locks count as hazards when a no-overwrite span overlaps one
+// written since a fence that has not completed, or since the last fence,
+// which the GPU has yet to read.
+// -------------------------------------------------------------------------
+class CCpuUploadSink : public CUploadSink
+{
+public:
+   CCpuUploadSink();
+   virtual ~CCpuUploadSink();
+
+   virtual bool Create(int nBytes);
+   virtual void Destroy();
+   virtual void* Lock(int nOffset, int nBytes, bool blDiscard);
+   virtual void Unlock();
+   virtual void IssueFence(int nFence);
+   virtual bool IsFenceComplete(int nFence);
+
+   void SetLatency(int nLatency);
+   int GetLatency() const;
+
+   int GetHazardCount() const;
+   int GetDiscardCount() const;
+
+protected:
+   void RetireSpans();
+
+   struct WrittenSpan
+   {
+      int nOffset;
+      int nBytes;
+      int nIssue;
+   };
+
+   CAlignedBuffer<unsigned char> m_Buffer;
+   int m_nLatency;
+
+   // -------------------------------------------------------------------------
+   // Fences issued so far, and when each fence was last issued; spans
+   // written and not yet read, tagged with the fence issue that covers
+   // them, -1 until the next one.
+   // -------------------------------------------------------------------------
+   int m_nIssueCount;
+   int m_anFenceIssues[UPLOAD_RING_MAX_FRAMES];
+   std::vector<WrittenSpan> m_WrittenSpans;
+
+   int m_nHazards;
+   int m_nDiscards;
+};
@@ -2,6 +2,7 @@
 #include "Vertex.h"
 
 IDirect3DVertexDeclaration9* CVertex::Decl = 0;
+IDirect3DVertexDeclaration9* CWaterVertex::Decls[WATER_WAVE_FORMAT_COUNT][WATER_NORMAL_FORMAT_COUNT][2] = { 0 };
 
 CVertex::CVertex(D3DXVECTOR3 pos, D3DXVECTOR3 normal, D3DXVECTOR2 texture)
 {
@@ -10,6 +11,41 @@ CVertex::CVertex(D3DXVECTOR3 pos, D3DXVECTOR3 normal, D3DXVECTOR2 texture)
    m_Texture = texture;
 }
 
+// -------------------------------------------------------------------------
+// The D3DDECLTYPE of a WATER_ELEMENT_*.
+// -------------------------------------------------------------------------
+static BYTE GetWaterDeclType(int nElement)
+{
+   switch (nElement)
+   {
+      case WATER_ELEMENT_FLOAT1:
+         return D3DDECLTYPE_FLOAT1;
+
+      case WATER_ELEMENT_FLOAT3:
+         return D3DDECLTYPE_FLOAT3;
+
+      case WATER_ELEMENT_FLOAT16_2:
+         return D3DDECLTYPE_FLOAT16_2;
+
+      case WATER_ELEMENT_FLOAT16_4:
+         return D3DDECLTYPE_FLOAT16_4;
+
+      case WATER_ELEMENT_SHORT2:
+         return D3DDECLTYPE_SHORT2;
+
+      case WATER_ELEMENT_SHORT4:
+         return D3DDECLTYPE_SHORT4;
+
+      case WATER_ELEMENT_SHORT2N:
+         return D3DDECLTYPE_SHORT2N;
+
+      case WATER_ELEMENT_UBYTE4N:
+         return D3DDECLTYPE_UBYTE4N;
+   }
+
+   return D3DDECLTYPE_D3DCOLOR;
+}
+
 void InitVertexDeclarations(IDirect3DDevice9* pDirect3D9Device)
 {
 	D3DVERTEXELEMENT9 VertexPosElements[] = 
@@ -21,9 +57,64 @@ void InitVertexDeclarations(IDirect3DDevice9* pDirect3D9Device)
 	};	
 
 	pDirect3D9Device->CreateVertexDeclaration(VertexPosElements, &CVertex::Decl);
+
+   // -------------------------------------------------------------------------
+   // Water surface: resting x and z and texture coordinates in stream 0,
+   // the height, any choppy offsets and the normal in stream 1.
+   // -------------------------------------------------------------------------
+   for (int nWave = 0; nWave < WATER_WAVE_FORMAT_COUNT; nWave++)
+   {
+      for (int nNormal = 0; nNormal < WATER_NORMAL_FORMAT_COUNT; nNormal++)
+      {
+         for (int nChoppy = 0; nChoppy < 2; nChoppy++)
+         {
+            WaterDynamicLayout layout;
+            GetWaterDynamicLayout(nWave, nNormal, nChoppy != 0, layout);
+
+            D3DVERTEXELEMENT9 WaterElements[] = 
+            {
+               {0, 0,  D3DDECLTYPE_FLOAT2, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_POSITION, 0},
+               {0, 8,  D3DDECLTYPE_FLOAT2, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_TEXCOORD, 0},
+               {1, 0,  GetWaterDeclType(layout.nWaveElement), D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_POSITION, 1},
+               {1, (WORD)layout.nNormalOffset, GetWaterDeclType(layout.nNormalElement), D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_NORMAL, 0},
+               D3DDECL_END()
+            };
+
+            // -------------------------------------------------------------------------
+            // A normal in the wave element's spare component has no
+            // element of its own.
+            // -------------------------------------------------------------------------
+            if (layout.nNormalElement == WATER_ELEMENT_NONE)
+            {
+               D3DVERTEXELEMENT9 end = D3DDECL_END();
+               WaterElements[3] = end;
+            }
+
+            if (FAILED(pDirect3D9Device->CreateVertexDeclaration(WaterElements, &CWaterVertex::Decls[nWave][nNormal][nChoppy])))
+            {
+               CWaterVertex::Decls[nWave][nNormal][nChoppy] = NULL;
+            }
+         }
+      }
+   }
 }
 
 void DestroyVertexDeclarations()
 {
 	CVertex::Decl->Release();
-}
\ No newline at end of file
+
+   for (int nWave = 0; nWave < WATER_WAVE_FORMAT_COUNT; nWave++)
+   {
+      for (int nNormal = 0; nNormal < WATER_NORMAL_FORMAT_COUNT; nNormal++)
+      {
+         for (int nChoppy = 0; nChoppy < 2; nChoppy++)
+         {
+            if (CWaterVertex::Decls[nWave][nNormal][nChoppy] != NULL)
+            {
+               CWaterVertex::Decls[nWave][nNormal][nChoppy]->Release();
+               CWaterVertex::Decls[nWave][nNormal][nChoppy] = NULL;
+            }
+         }
+      }
+   }
+}
@@ -5,6 +5,7 @@
 #include <d3d9.h>
 #include <d3dx9.h>
 //#include <dxerr9.h>
+#include "WaterVertexStreams.h"
 
 using namespace std;
 
@@ -24,3 +25,15 @@ public:
 	static IDirect3DVertexDeclaration9* Decl;
 };
 
+// -------------------------------------------------------------------------
+// The water surface's two streams, see WaterVertexStreams.h: stream 0 of
+// WaterStaticVertex, and stream 1 in the layout GetWaterDynamicLayout gives
+// for a wave and normal format, without and with choppiness. A
+// declaration the device cannot take, for want of the FLOAT16, SHORT2N or
+// UBYTE4N types, is NULL.
+// -------------------------------------------------------------------------
+class CWaterVertex
+{
+public:
+   static IDirect3DVertexDeclaration9* Decls[WATER_WAVE_FORMAT_COUNT][WATER_NORMAL_FORMAT_COUNT][2];
+};
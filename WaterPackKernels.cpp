@@ -0,0 +1,548 @@
+#include <math.h>
+#include <string.h>
+#include "WaterPackKernels.h"
+#include "CpuFeatures.h"
+
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#define WATER_PACK_KERNELS_SSE2
+#if _MSC_VER >= 1700
+#define WATER_PACK_KERNELS_AVX2
+#endif
+#define WATER_PACK_TARGET_AVX2
+#elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define WATER_PACK_KERNELS_SSE2
+#define WATER_PACK_KERNELS_AVX2
+#define WATER_PACK_TARGET_AVX2 __attribute__((target("avx2,f16c")))
+#endif
+
+#ifdef WATER_PACK_KERNELS_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef WATER_PACK_KERNELS_AVX2
+#include <immintrin.h>
+#endif
+
+#define WATER_PACK_SIGN_BIT            0x80000000u
+
+// -------------------------------------------------------------------------
+// Half float conversions.
+// -------------------------------------------------------------------------
+static unsigned int GetFloatBits(float fValue)
+{
+   unsigned int nBits;
+   memcpy(&nBits, &fValue, sizeof(nBits));
+   return nBits;
+}
+
+static float GetBitsFloat(unsigned int nBits)
+{
+   float fValue;
+   memcpy(&fValue, &nBits, sizeof(fValue));
+   return fValue;
+}
+
+unsigned short FloatToHalf(float fValue)
+{
+   unsigned int nBits = GetFloatBits(fValue);
+   unsigned int nSign = (nBits >> 16) & 0x8000;
+   unsigned int nMagnitude = nBits & 0x7FFFFFFF;
+
+   // -------------------------------------------------------------------------
+   // Infinities, and NaNs made quiet with the top of their payload.
+   // -------------------------------------------------------------------------
+   if (nMagnitude >= 0x7F800000)
+   {
+      unsigned int nNaN = (nMagnitude > 0x7F800000) ? (0x200 | ((nMagnitude >> 13) & 0x3FF)) : 0;
+      return (unsigned short)(nSign | 0x7C00 | nNaN);
+   }
+
+   // -------------------------------------------------------------------------
+   // 65520 and above round to infinity.
+   // -------------------------------------------------------------------------
+   if (nMagnitude >= 0x477FF000)
+   {
+      return (unsigned short)(nSign | 0x7C00);
+   }
+
+   unsigned int nHalf;
+   unsigned int nRemainder;
+   unsigned int nTie;
+
+   if (nMagnitude >= 0x38800000)
+   {
+      // -------------------------------------------------------------------------
+      // Normal halves: rebias the exponent and drop 13 mantissa bits.
+      // -------------------------------------------------------------------------
+      nHalf = (nMagnitude - 0x38000000) >> 13;
+      nRemainder = nMagnitude & 0x1FFF;
+      nTie = 0x1000;
+   }
+   else
+   {
+      // -------------------------------------------------------------------------
+      // Subnormal halves count units of 2^-24; below 2^-25 that is 0.
+      // -------------------------------------------------------------------------
+      int nShift = 126 - (int)(nMagnitude >> 23);
+
+      if (nShift > 24)
+      {
+         return (unsigned short)nSign;
+      }
+
+      unsigned int nMantissa = (nMagnitude & 0x7FFFFF) | 0x800000;
+      nHalf = nMantissa >> nShift;
+      nRemainder = nMantissa & ((1u << nShift) - 1);
+      nTie = 1u << (nShift - 1);
+   }
+
+   if (nRemainder > nTie || (nRemainder == nTie && (nHalf & 1) != 0))
+   {
+      nHalf++;
+   }
+
+   return (unsigned short)(nSign | nHalf);
+}
+
+float HalfToFloat(unsigned short nHalf)
+{
+   unsigned int nSign = (unsigned int)(nHalf & 0x8000) << 16;
+   unsigned int nExponent = (nHalf >> 10) & 0x1F;
+   unsigned int nMantissa = nHalf & 0x3FF;
+
+   if (nExponent == 0x1F)
+   {
+      unsigned int nNaN = (nMantissa != 0) ? (0x400000 | (nMantissa << 13)) : 0;
+      return GetBitsFloat(nSign | 0x7F800000 | nNaN);
+   }
+
+   if (nExponent == 0)
+   {
+      float fValue = (float)nMantissa * (1.0f / 16777216.0f);
+      return (nSign != 0) ? -fValue : fValue;
+   }
+
+   return GetBitsFloat(nSign | ((nExponent + 112) << 23) | (nMantissa << 13));
+}
+
+// -------------------------------------------------------------------------
+// Scalar Kernels
+// -------------------------------------------------------------------------
+static short QuantizeValue(float fValue, float fBias, float fInverseScale, float fMin, float fMax)
+{
+   float t = (fValue - fBias) * fInverseScale;
+   t = (t > fMin) ? t : fMin;
+   t = (t < fMax) ? t : fMax;
+   return (short)(int)floorf(t + 0.5f);
+}
+
+static void FloatToHalf_Scalar(const float* pInput, int nCount, unsigned short* pOutput)
+{
+   for (int i = 0; i < nCount; i++)
+   {
+      pOutput[i] = FloatToHalf(pInput[i]);
+   }
+}
+
+static void Quantize_Scalar(const float* pInput,
+                            int nCount,
+                            float fBias,
+                            float fInverseScale,
+                            float fMin,
+                            float fMax,
+                            short* pOutput)
+{
+   for (int i = 0; i < nCount; i++)
+   {
+      pOutput[i] = QuantizeValue(pInput[i], fBias, fInverseScale, fMin, fMax);
+   }
+}
+
+static void OctahedralBins_Scalar(const float* pX,
+                                  const float* pY,
+                                  const float* pZ,
+                                  int i0,
+                                  int nCount,
+                                  float* pU,
+                                  float* pV)
+{
+   for (int i = i0; i < nCount; i++)
+   {
+      float fInverse = 1.0f / ((fabsf(pX[i]) + fabsf(pY[i])) + fabsf(pZ[i]));
+      float u = pX[i] * fInverse;
+      float v = pZ[i] * fInverse;
+
+      if (pY[i] < 0.0f)
+      {
+         float fFoldU = 1.0f - fabsf(v);
+         float fFoldV = 1.0f - fabsf(u);
+         u = (u < 0.0f) ? -fFoldU : fFoldU;
+         v = (v < 0.0f) ? -fFoldV : fFoldV;
+      }
+
+      pU[i] = u;
+      pV[i] = v;
+   }
+}
+
+static void Octahedral_Scalar(const float* pX,
+                              const float* pY,
+                              const float* pZ,
+                              int nCount,
+                              float* pU,
+                              float* pV)
+{
+   OctahedralBins_Scalar(pX, pY, pZ, 0, nCount, pU, pV);
+}
+
+static void NormalColorBins_Scalar(const float* pX,
+                                   const float* pY,
+                                   const float* pZ,
+                                   int i0,
+                                   int nCount,
+                                   unsigned int* pOutput)
+{
+   for (int i = i0; i < nCount; i++)
+   {
+      unsigned int nRed = (unsigned int)QuantizeValue(pX[i], -1.0f, 127.5f, 0.0f, 255.0f);
+      unsigned int nGreen = (unsigned int)QuantizeValue(pY[i], -1.0f, 127.5f, 0.0f, 255.0f);
+      unsigned int nBlue = (unsigned int)QuantizeValue(pZ[i], -1.0f, 127.5f, 0.0f, 255.0f);
+
+      pOutput[i] = 0xFF000000u | (nRed << 16) | (nGreen << 8) | nBlue;
+   }
+}
+
+static void NormalColor_Scalar(const float* pX,
+                               const float* pY,
+                               const float* pZ,
+                               int nCount,
+                               unsigned int* pOutput)
+{
+   NormalColorBins_Scalar(pX, pY, pZ, 0, nCount, pOutput);
+}
+
+static void Range_Scalar(const float* pInput, int nCount, float& fMin, float& fMax)
+{
+   float fLow = pInput[0];
+   float fHigh = pInput[0];
+
+   for (int i = 1; i < nCount; i++)
+   {
+      fLow = (pInput[i] < fLow) ? pInput[i] : fLow;
+      fHigh = (pInput[i] > fHigh) ? pInput[i] : fHigh;
+   }
+
+   fMin = fLow;
+   fMax = fHigh;
+}
+
+#ifdef WATER_PACK_KERNELS_SSE2
+// -------------------------------------------------------------------------
+// SSE2 Kernels: four values at a time.
+// -------------------------------------------------------------------------
+static inline __m128i Floor_SSE2(__m128 x)
+{
+   __m128i r = _mm_cvttps_epi32(x);
+   __m128 vTruncated = _mm_cvtepi32_ps(r);
+   return _mm_add_epi32(r, _mm_castps_si128(_mm_cmpgt_ps(vTruncated, x)));
+}
+
+static inline __m128i Quantize_SSE2(__m128 x, __m128 vBias, __m128 vInverseScale, __m128 vMin, __m128 vMax)
+{
+   __m128 t = _mm_mul_ps(_mm_sub_ps(x, vBias), vInverseScale);
+   t = _mm_min_ps(_mm_max_ps(t, vMin), vMax);
+   return Floor_SSE2(_mm_add_ps(t, _mm_set1_ps(0.5f)));
+}
+
+static void Quantize_SSE2(const float* pInput,
+                          int nCount,
+                          float fBias,
+                          float fInverseScale,
+                          float fMin,
+                          float fMax,
+                          short* pOutput)
+{
+   __m128 vBias = _mm_set1_ps(fBias);
+   __m128 vInverseScale = _mm_set1_ps(fInverseScale);
+   __m128 vMin = _mm_set1_ps(fMin);
+   __m128 vMax = _mm_set1_ps(fMax);
+
+   int i = 0;
+   for (; i + 8 <= nCount; i += 8)
+   {
+      __m128i vLow = Quantize_SSE2(_mm_loadu_ps(pInput + i), vBias, vInverseScale, vMin, vMax);
+      __m128i vHigh = Quantize_SSE2(_mm_loadu_ps(pInput + i + 4), vBias, vInverseScale, vMin, vMax);
+      _mm_storeu_si128((__m128i*)(pOutput + i), _mm_packs_epi32(vLow, vHigh));
+   }
+
+   for (; i < nCount; i++)
+   {
+      pOutput[i] = QuantizeValue(pInput[i], fBias, fInverseScale, fMin, fMax);
+   }
+}
+
+static void Octahedral_SSE2(const float* pX,
+                            const float* pY,
+                            const float* pZ,
+                            int nCount,
+                            float* pU,
+                            float* pV)
+{
+   __m128 vSign = _mm_castsi128_ps(_mm_set1_epi32((int)WATER_PACK_SIGN_BIT));
+   __m128 vZero = _mm_setzero_ps();
+   __m128 vOne = _mm_set1_ps(1.0f);
+
+   int i = 0;
+   for (; i + 4 <= nCount; i += 4)
+   {
+      __m128 x = _mm_loadu_ps(pX + i);
+      __m128 y = _mm_loadu_ps(pY + i);
+      __m128 z = _mm_loadu_ps(pZ + i);
+
+      __m128 vSum = _mm_add_ps(_mm_add_ps(_mm_andnot_ps(vSign, x), _mm_andnot_ps(vSign, y)), _mm_andnot_ps(vSign, z));
+      __m128 vInverse = _mm_div_ps(vOne, vSum);
+      __m128 u = _mm_mul_ps(x, vInverse);
+      __m128 v = _mm_mul_ps(z, vInverse);
+
+      __m128 vFoldU = _mm_sub_ps(vOne, _mm_andnot_ps(vSign, v));
+      __m128 vFoldV = _mm_sub_ps(vOne, _mm_andnot_ps(vSign, u));
+      vFoldU = _mm_xor_ps(vFoldU, _mm_and_ps(_mm_cmplt_ps(u, vZero), vSign));
+      vFoldV = _mm_xor_ps(vFoldV, _mm_and_ps(_mm_cmplt_ps(v, vZero), vSign));
+
+      __m128 vLower = _mm_cmplt_ps(y, vZero);
+      _mm_storeu_ps(pU + i, _mm_or_ps(_mm_and_ps(vLower, vFoldU), _mm_andnot_ps(vLower, u)));
+      _mm_storeu_ps(pV + i, _mm_or_ps(_mm_and_ps(vLower, vFoldV), _mm_andnot_ps(vLower, v)));
+   }
+
+   OctahedralBins_Scalar(pX, pY, pZ, i, nCount, pU, pV);
+}
+
+static void NormalColor_SSE2(const float* pX,
+                             const float* pY,
+                             const float* pZ,
+                             int nCount,
+                             unsigned int* pOutput)
+{
+   __m128 vBias = _mm_set1_ps(-1.0f);
+   __m128 vInverseScale = _mm_set1_ps(127.5f);
+   __m128 vMin = _mm_setzero_ps();
+   __m128 vMax = _mm_set1_ps(255.0f);
+   __m128i vAlpha = _mm_set1_epi32((int)0xFF000000u);
+
+   int i = 0;
+   for (; i + 4 <= nCount; i += 4)
+   {
+      __m128i vRed = Quantize_SSE2(_mm_loadu_ps(pX + i), vBias, vInverseScale, vMin, vMax);
+      __m128i vGreen = Quantize_SSE2(_mm_loadu_ps(pY + i), vBias, vInverseScale, vMin, vMax);
+      __m128i vBlue = Quantize_SSE2(_mm_loadu_ps(pZ + i), vBias, vInverseScale, vMin, vMax);
+
+      __m128i vColor = _mm_or_si128(_mm_or_si128(vAlpha, _mm_slli_epi32(vRed, 16)),
+         _mm_or_si128(_mm_slli_epi32(vGreen, 8), vBlue));
+      _mm_storeu_si128((__m128i*)(pOutput + i), vColor);
+   }
+
+   NormalColorBins_Scalar(pX, pY, pZ, i, nCount, pOutput);
+}
+
+static void Range_SSE2(const float* pInput, int nCount, float& fMin, float& fMax)
+{
+   if (nCount < 4)
+   {
+      Range_Scalar(pInput, nCount, fMin, fMax);
+      return;
+   }
+
+   __m128 vLow = _mm_loadu_ps(pInput);
+   __m128 vHigh = vLow;
+
+   int i = 4;
+   for (; i + 4 <= nCount; i += 4)
+   {
+      __m128 x = _mm_loadu_ps(pInput + i);
+      vLow = _mm_min_ps(vLow, x);
+      vHigh = _mm_max_ps(vHigh, x);
+   }
+
+   float afLow[4];
+   float afHigh[4];
+   _mm_storeu_ps(afLow, vLow);
+   _mm_storeu_ps(afHigh, vHigh);
+
+   float fLow = afLow[0];
+   float fHigh = afHigh[0];
+
+   for (int j = 1; j < 4; j++)
+   {
+      fLow = (afLow[j] < fLow) ? afLow[j] : fLow;
+      fHigh = (afHigh[j] > fHigh) ? afHigh[j] : fHigh;
+   }
+
+   for (; i < nCount; i++)
+   {
+      fLow = (pInput[i] < fLow) ? pInput[i] : fLow;
+      fHigh = (pInput[i] > fHigh) ? pInput[i] : fHigh;
+   }
+
+   fMin = fLow;
+   fMax = fHigh;
+}
+#endif
+
+#ifdef WATER_PACK_KERNELS_AVX2
+// -------------------------------------------------------------------------
+// AVX2 Kernels: eight values at a time, and the F16C half conversions.
+// -------------------------------------------------------------------------
+WATER_PACK_TARGET_AVX2
+static void FloatToHalf_AVX2(const float* pInput, int nCount, unsigned short* pOutput)
+{
+   int i = 0;
+   for (; i + 8 <= nCount; i += 8)
+   {
+      __m128i vHalves = _mm256_cvtps_ph(_mm256_loadu_ps(pInput + i), 0);
+      _mm_storeu_si128((__m128i*)(pOutput + i), vHalves);
+   }
+
+   for (; i < nCount; i++)
+   {
+      pOutput[i] = FloatToHalf(pInput[i]);
+   }
+}
+
+WATER_PACK_TARGET_AVX2
+static inline __m256i Quantize_AVX2(__m256 x, __m256 vBias, __m256 vInverseScale, __m256 vMin, __m256 vMax)
+{
+   __m256 t = _mm256_mul_ps(_mm256_sub_ps(x, vBias), vInverseScale);
+   t = _mm256_min_ps(_mm256_max_ps(t, vMin), vMax);
+   return _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_add_ps(t, _mm256_set1_ps(0.5f))));
+}
+
+WATER_PACK_TARGET_AVX2
+static void Quantize_AVX2(const float* pInput,
+                          int nCount,
+                          float fBias,
+                          float fInverseScale,
+                          float fMin,
+                          float fMax,
+                          short* pOutput)
+{
+   __m256 vBias = _mm256_set1_ps(fBias);
+   __m256 vInverseScale = _mm256_set1_ps(fInverseScale);
+   __m256 vMin = _mm256_set1_ps(fMin);
+   __m256 vMax = _mm256_set1_ps(fMax);
+
+   int i = 0;
+   for (; i + 16 <= nCount; i += 16)
+   {
+      __m256i vLow = Quantize_AVX2(_mm256_loadu_ps(pInput + i), vBias, vInverseScale, vMin, vMax);
+      __m256i vHigh = Quantize_AVX2(_mm256_loadu_ps(pInput + i + 8), vBias, vInverseScale, vMin, vMax);
+
+      // -------------------------------------------------------------------------
+      // packs works within each 128-bit lane; put the quarters back in order.
+      // -------------------------------------------------------------------------
+      __m256i vPacked = _mm256_permute4x64_epi64(_mm256_packs_epi32(vLow, vHigh), 0xD8);
+      _mm256_storeu_si256((__m256i*)(pOutput + i), vPacked);
+   }
+
+   for (; i < nCount; i++)
+   {
+      pOutput[i] = QuantizeValue(pInput[i], fBias, fInverseScale, fMin, fMax);
+   }
+}
+
+WATER_PACK_TARGET_AVX2
+static void Octahedral_AVX2(const float* pX,
+                            const float* pY,
+                            const float* pZ,
+                            int nCount,
+                            float* pU,
+                            float* pV)
+{
+   __m256 vSign = _mm256_castsi256_ps(_mm256_set1_epi32((int)WATER_PACK_SIGN_BIT));
+   __m256 vZero = _mm256_setzero_ps();
+   __m256 vOne = _mm256_set1_ps(1.0f);
+
+   int i = 0;
+   for (; i + 8 <= nCount; i += 8)
+   {
+      __m256 x = _mm256_loadu_ps(pX + i);
+      __m256 y = _mm256_loadu_ps(pY + i);
+      __m256 z = _mm256_loadu_ps(pZ + i);
+
+      __m256 vSum = _mm256_add_ps(_mm256_add_ps(_mm256_andnot_ps(vSign, x), _mm256_andnot_ps(vSign, y)), _mm256_andnot_ps(vSign, z));
+      __m256 vInverse = _mm256_div_ps(vOne, vSum);
+      __m256 u = _mm256_mul_ps(x, vInverse);
+      __m256 v = _mm256_mul_ps(z, vInverse);
+
+      __m256 vFoldU = _mm256_sub_ps(vOne, _mm256_andnot_ps(vSign, v));
+      __m256 vFoldV = _mm256_sub_ps(vOne, _mm256_andnot_ps(vSign, u));
+      vFoldU = _mm256_xor_ps(vFoldU, _mm256_and_ps(_mm256_cmp_ps(u, vZero, _CMP_LT_OQ), vSign));
+      vFoldV = _mm256_xor_ps(vFoldV, _mm256_and_ps(_mm256_cmp_ps(v, vZero, _CMP_LT_OQ), vSign));
+
+      __m256 vLower = _mm256_cmp_ps(y, vZero, _CMP_LT_OQ);
+      _mm256_storeu_ps(pU + i, _mm256_blendv_ps(u, vFoldU, vLower));
+      _mm256_storeu_ps(pV + i, _mm256_blendv_ps(v, vFoldV, vLower));
+   }
+
+   OctahedralBins_Scalar(pX, pY, pZ, i, nCount, pU, pV);
+}
+
+WATER_PACK_TARGET_AVX2
+static void NormalColor_AVX2(const float* pX,
+                             const float* pY,
+                             const float* pZ,
+                             int nCount,
+                             unsigned int* pOutput)
+{
+   __m256 vBias = _mm256_set1_ps(-1.0f);
+   __m256 vInverseScale = _mm256_set1_ps(127.5f);
+   __m256 vMin = _mm256_setzero_ps();
+   __m256 vMax = _mm256_set1_ps(255.0f);
+   __m256i vAlpha = _mm256_set1_epi32((int)0xFF000000u);
+
+   int i = 0;
+   for (; i + 8 <= nCount; i += 8)
+   {
+      __m256i vRed = Quantize_AVX2(_mm256_loadu_ps(pX + i), vBias, vInverseScale, vMin, vMax);
+      __m256i vGreen = Quantize_AVX2(_mm256_loadu_ps(pY + i), vBias, vInverseScale, vMin, vMax);
+      __m256i vBlue = Quantize_AVX2(_mm256_loadu_ps(pZ + i), vBias, vInverseScale, vMin, vMax);
+
+      __m256i vColor = _mm256_or_si256(_mm256_or_si256(vAlpha, _mm256_slli_epi32(vRed, 16)),
+         _mm256_or_si256(_mm256_slli_epi32(vGreen, 8), vBlue));
+      _mm256_storeu_si256((__m256i*)(pOutput + i), vColor);
+   }
+
+   NormalColorBins_Scalar(pX, pY, pZ, i, nCount, pOutput);
+}
+#endif
+
+void GetWaterPackKernels(int nSimdLevel, WaterPackKernelTable& kernels)
+{
+   kernels.nSimdLevel = SIMD_LEVEL_SCALAR;
+   kernels.pfnFloatToHalf = FloatToHalf_Scalar;
+   kernels.pfnQuantize = Quantize_Scalar;
+   kernels.pfnOctahedral = Octahedral_Scalar;
+   kernels.pfnNormalColor = NormalColor_Scalar;
+   kernels.pfnRange = Range_Scalar;
+
+#ifdef WATER_PACK_KERNELS_SSE2
+   if (nSimdLevel >= SIMD_LEVEL_SSE2)
+   {
+      kernels.nSimdLevel = SIMD_LEVEL_SSE2;
+      kernels.pfnQuantize = Quantize_SSE2;
+      kernels.pfnOctahedral = Octahedral_SSE2;
+      kernels.pfnNormalColor = NormalColor_SSE2;
+      kernels.pfnRange = Range_SSE2;
+   }
+#endif
+
+#ifdef WATER_PACK_KERNELS_AVX2
+   if (nSimdLevel >= SIMD_LEVEL_AVX2)
+   {
+      kernels.nSimdLevel = SIMD_LEVEL_AVX2;
+      kernels.pfnFloatToHalf = FloatToHalf_AVX2;
+      kernels.pfnQuantize = Quantize_AVX2;
+      kernels.pfnOctahedral = Octahedral_AVX2;
+      kernels.pfnNormalColor = NormalColor_AVX2;
+   }
+#endif
+}
@@ -0,0 +1,96 @@
+// -------------------------------------------------------------------------
+// Sean Janis
+// spjanis@gmail.com
+// Water Simulations
+//
+// WaterPackKernels
+//       Conversions behind the compact encodings of the water surface's
+//       dynamic vertex stream, see WaterVertexStreams.h: floats to IEEE
+//       half floats, floats to 16-bit integers with a scale and bias,
+//       normals to octahedral coordinates and to D3DCOLORs, and the range
+//       of a map. Each works on plain arrays and has a scalar version and
+//       SIMD ones picked at runtime like the spectrum kernels; the half
+//       floats use F16C, which the AVX2 level implies, and fall back to the
+//       scalar conversion below it.
+//
+//       All versions give bit-identical results: the scalar code rounds
+//       exactly as the vector instructions do.
+// -------------------------------------------------------------------------
+#pragma once
+
+// -------------------------------------------------------------------------
+// pOutput[i] = the half float nearest pInput[i], ties to even. Overflow
+// gives infinity and NaNs stay quiet NaNs, as F16C does.
+// -------------------------------------------------------------------------
+typedef void (*WaterFloatToHalfFunc)(
+   const float* pInput,
+   int nCount,
+   unsigned short* pOutput);
+
+// -------------------------------------------------------------------------
+// pOutput[i] = floor(clamp((pInput[i] - fBias) * fInverseScale, fMin,
+// fMax) + 0.5), for fMin and fMax within the range of a short.
+// -------------------------------------------------------------------------
+typedef void (*WaterQuantizeFunc)(
+   const float* pInput,
+   int nCount,
+   float fBias,
+   float fInverseScale,
+   float fMin,
+   float fMax,
+   short* pOutput);
+
+// -------------------------------------------------------------------------
+// Octahedral coordinates (pU[i], pV[i]) in [-1, 1] of the unit vectors
+// (pX[i], pY[i], pZ[i]), y being the axis of the upper hemisphere: x and z
+// divided by |x| + |y| + |z|, folded over the diagonals when y < 0.
+// -------------------------------------------------------------------------
+typedef void (*WaterOctahedralFunc)(
+   const float* pX,
+   const float* pY,
+   const float* pZ,
+   int nCount,
+   float* pU,
+   float* pV);
+
+// -------------------------------------------------------------------------
+// D3DCOLORs of the unit vectors, x in red, y in green and z in blue, each
+// component quantized from [-1, 1] to [0, 255] as WaterQuantizeFunc would
+// with fBias = -1 and fInverseScale = 127.5.
+// -------------------------------------------------------------------------
+typedef void (*WaterNormalColorFunc)(
+   const float* pX,
+   const float* pY,
+   const float* pZ,
+   int nCount,
+   unsigned int* pOutput);
+
+// -------------------------------------------------------------------------
+// Smallest and largest of nCount > 0 values.
+// -------------------------------------------------------------------------
+typedef void (*WaterRangeFunc)(
+   const float* pInput,
+   int nCount,
+   float& fMin,
+   float& fMax);
+
+struct WaterPackKernelTable
+{
+   int nSimdLevel;
+   WaterFloatToHalfFunc pfnFloatToHalf;
+   WaterQuantizeFunc pfnQuantize;
+   WaterOctahedralFunc pfnOctahedral;
+   WaterNormalColorFunc pfnNormalColor;
+   WaterRangeFunc pfnRange;
+};
+
+// -------------------------------------------------------------------------
+// Fills the table with the best kernels available at or below nSimdLevel.
+// -------------------------------------------------------------------------
+void GetWaterPackKernels(int nSimdLevel, WaterPackKernelTable& kernels);
+
+// -------------------------------------------------------------------------
+// Scalar conversions of a single value, the same as the kernels'.
+// -------------------------------------------------------------------------
+unsigned short FloatToHalf(float fValue);
+float HalfToFloat(unsigned short nHalf);
@@ -35,6 +35,8 @@ CDXUTDialog                 g_HUD;                  // dialog for standard contr
 CDXUTDialog                 g_WaterSimulationsUI;             // dialog for sample specific controls
 IDirect3DDevice9*           g_pDirect3DDevice9 = NULL;
 bool                        g_blWireframeMode = 0;
+int                         g_nFFTSize = OCEAN_FFT_SIZE; // Set with -fftsize:N
+char                        g_csBakedAnimation[MAX_PATH] = ""; // Set with -bake:FILE
 
 // -------------------------------------------------------------------------------------
 // Demo Controls
@@ -65,6 +67,13 @@ CLandEnvironment* g_pLandEnvironment;
 
 #define IDC_CHECK_ENABLE_GERSTNER_WAVES            14
 
+#define IDC_STATIC_FFT_SIZE_DESC                   15
+#define IDC_COMBO_FFT_SIZE                         16
+
+#define IDC_STATIC_CHOPPINESS_DESC                 17
+#define IDC_STATIC_CHOPPINESS_VALUE                18
+#define IDC_SLIDER_CHOPPINESS                      19
+
 //--------------------------------------------------------------------------------------
 // Forward declarations 
 //--------------------------------------------------------------------------------------
@@ -81,6 +90,7 @@ void CALLBACK OnLostDevice(void* pUserContext);
 void CALLBACK OnDestroyDevice(void* pUserContext);
 
 void InitApp();
+void ParseCommandLine();
 void RenderText();
 
 //--------------------------------------------------------------------------------------
@@ -110,6 +120,7 @@ INT WINAPI wWinMain( HINSTANCE, HINSTANCE, LPWSTR, int )
     DXUTSetCallbackDeviceChanging(ModifyDeviceSettings);
 
     DXUTSetCursorSettings( true, true );
+    ParseCommandLine();
     InitApp();
     DXUTInit(true, true); // Parse the command line and show msgboxes
     DXUTSetHotkeyHandling( true, true, true );
@@ -154,6 +165,56 @@ void InitApp()
    g_WaterSimulationsUI.AddStatic(IDC_STATIC_GRAVITY_CONSTANT_VALUE, L"0.00", 295, 101, 95, 30);
 
    g_WaterSimulationsUI.AddCheckBox(IDC_CHECK_ENABLE_GERSTNER_WAVES, L"Enable Random Gerstner Waves", 10, 143, 350, 16, false, L'C', false);
+
+   // -------------------------------------------------------------------------
+   // FFT resolution: the powers of two plus a few mixed-radix sizes in
+   // between. Any other size can still be given with -fftsize:N.
+   // -------------------------------------------------------------------------
+   static const int anFFTSizes[] = 
+   { 
+      16, 24, 32, 48, 64, 96, 100, 128, 160, 192, 256, 384, 512, 768, 1024, 1536, 2048 
+   };
+
+   CDXUTComboBox* pFFTSizeCombo = NULL;
+   g_WaterSimulationsUI.AddStatic(IDC_STATIC_FFT_SIZE_DESC, L"FFT Size:", 8, 163, 95, 30);
+   g_WaterSimulationsUI.AddComboBox(IDC_COMBO_FFT_SIZE, 110, 167, 100, 24, 0, false, &pFFTSizeCombo);
+
+   for (int i = 0; i < (int)(sizeof(anFFTSizes) / sizeof(anFFTSizes[0])); i++)
+   {
+      WCHAR wszSize[32];
+      StringCchPrintf(wszSize, 32, L"%d x %d", anFFTSizes[i], anFFTSizes[i]);
+      pFFTSizeCombo->AddItem(wszSize, (void*)(INT_PTR)anFFTSizes[i]);
+   }
+
+   // -------------------------------------------------------------------------
+   // Choppiness in tenths, 0.0 to 2.0.
+   // -------------------------------------------------------------------------
+   g_WaterSimulationsUI.AddStatic(IDC_STATIC_CHOPPINESS_DESC, L"Choppiness:", 8, 196, 95, 30);
+   g_WaterSimulationsUI.AddSlider(IDC_SLIDER_CHOPPINESS, 110, 199, 200, 24, 0, 20, 10, false);
+   g_WaterSimulationsUI.AddStatic(IDC_STATIC_CHOPPINESS_VALUE, L"0.00", 295, 196, 95, 30);
+}
+
+//--------------------------------------------------------------------------------------
+// Reads the application's own options. DXUT ignores the ones it does not know.
+//
+//    -fftsize:N     FFT resolution of the water surface (16 to 2048).
+//    -bake:FILE     Play a baked animation instead of simulating.
+//--------------------------------------------------------------------------------------
+void ParseCommandLine()
+{
+   const WCHAR* wszOption = wcsstr(GetCommandLineW(), L"-fftsize:");
+   if (wszOption != NULL)
+   {
+      g_nFFTSize = _wtoi(wszOption + wcslen(L"-fftsize:"));
+   }
+
+   wszOption = wcsstr(GetCommandLineW(), L"-bake:");
+   if (wszOption != NULL)
+   {
+      wszOption += wcslen(L"-bake:");
+      int nLength = (int)wcscspn(wszOption, L" \t");
+      WideCharToMultiByte(CP_ACP, 0, wszOption, nLength, g_csBakedAnimation, MAX_PATH - 1, NULL, NULL);
+   }
 }
 
 
@@ -182,6 +243,15 @@ bool CALLBACK IsDeviceAcceptable( D3DCAPS9* pCaps, D3DFORMAT AdapterFormat,
       return false;
    }
 
+   // -------------------------------------------------------------------------
+   // Must take stream offsets, as the water surface draws each frame from
+   // its own span of the dynamic vertex buffer.
+   // -------------------------------------------------------------------------
+   if ((pCaps->DevCaps2 & D3DDEVCAPS2_STREAMOFFSET) == 0)
+   {
+      return false;
+   }
+
    return true;
 }
 
@@ -295,8 +365,14 @@ HRESULT CALLBACK OnCreateDevice( IDirect3DDevice9* pd3dDevice, const D3DSURFACE_
       WATER_SURFACE_HEIGHT, 
       WATER_SURFACE_DX, 
       WATER_SURFACE_DZ);
+   g_pWaterSurface->SetFFTSize(g_nFFTSize);
    g_pWaterSurface->Init();
 
+   if (g_csBakedAnimation[0] != '\0')
+   {
+      g_pWaterSurface->SetBakedAnimation(g_csBakedAnimation);
+   }
+
    // -------------------------------------------------------------------------
    // Initialize Surrounding Land Environment
    // -------------------------------------------------------------------------
@@ -332,6 +408,14 @@ HRESULT CALLBACK OnCreateDevice( IDirect3DDevice9* pd3dDevice, const D3DSURFACE_
    bool blEnableGerstnerWaves = g_pWaterSurface->GetEnableGerstnerWaves();
    g_WaterSimulationsUI.GetCheckBox(IDC_CHECK_ENABLE_GERSTNER_WAVES)->SetChecked(blEnableGerstnerWaves);
 
+   int nFFTSize = g_pWaterSurface->GetFFTSize();
+   g_WaterSimulationsUI.GetComboBox(IDC_COMBO_FFT_SIZE)->SetSelectedByData((void*)(INT_PTR)nFFTSize);
+
+   float fChoppiness = g_pWaterSurface->GetChoppiness();
+   g_WaterSimulationsUI.GetSlider(IDC_SLIDER_CHOPPINESS)->SetValue((int)(fChoppiness * 10.0f + 0.5f));
+   StringCchPrintf(wszOutput, 1024, L"%3.1f", (double)fChoppiness);
+   g_WaterSimulationsUI.GetStatic(IDC_STATIC_CHOPPINESS_VALUE)->SetText(wszOutput);
+
    return S_OK;
 }
 
@@ -358,6 +442,11 @@ HRESULT CALLBACK OnResetDevice(IDirect3DDevice9* pd3dDevice,
       g_pEffect->OnResetDevice();
    }
 
+   if (g_pWaterSurface != NULL)
+   {
+      g_pWaterSurface->OnResetDevice();
+   }
+
    // -------------------------------------------------------------------------
    // Create a sprite to help batch calls when drawing many lines of text
    // -------------------------------------------------------------------------
@@ -639,6 +728,39 @@ void CALLBACK OnGUIEvent(UINT nEvent, int nControlID, CDXUTControl* pControl, vo
          g_pWaterSurface->SetEnableGerstnerWaves(blEnableGerstnerWaves);
       }
       break;
+
+      case IDC_COMBO_FFT_SIZE:
+      {
+         int nFFTSize = (int)(INT_PTR)((CDXUTComboBox*)pControl)->GetSelectedData();
+         if (nFFTSize != g_pWaterSurface->GetFFTSize())
+         {
+            if (g_pWaterSurface->SetFFTSize(nFFTSize))
+            {
+               g_nFFTSize = nFFTSize;
+            }
+            else
+            {
+               // -------------------------------------------------------------------------
+               // The old size is still in effect, so show it again. This
+               // selects it through this handler, where it matches and stops.
+               // -------------------------------------------------------------------------
+               ((CDXUTComboBox*)pControl)->SetSelectedByData((void*)(INT_PTR)g_pWaterSurface->GetFFTSize());
+            }
+         }
+      }
+      break;
+
+      case IDC_SLIDER_CHOPPINESS:
+      {
+         int nSliderValue = ((CDXUTSlider*)pControl)->GetValue();
+         float fChoppiness = (float)nSliderValue / 10.0f;
+
+         StringCchPrintf(wszOutput, 1024, L"%3.1f", (double)fChoppiness);
+         g_WaterSimulationsUI.GetStatic(IDC_STATIC_CHOPPINESS_VALUE)->SetText(wszOutput);
+
+         g_pWaterSurface->SetChoppiness(fChoppiness);
+      }
+      break;
    }
 }
 
@@ -661,6 +783,11 @@ void CALLBACK OnLostDevice(void* pUserContext)
       g_pEffect->OnLostDevice();
    }
 
+   if (g_pWaterSurface != NULL)
+   {
+      g_pWaterSurface->OnLostDevice();
+   }
+
    SAFE_RELEASE(g_pTextSprite);
 }
 
@@ -1,13 +1,12 @@
 #include "DXUT.h"
 #include "WaterSurface.h"
 
-#define PI                                      3.141593
-
 CWaterSurface::CWaterSurface(IDirect3DDevice9* pDirect3D9Device,
                          int nNumRows, 
                          int nNumCols,
                          float fXSpacing,
-                         float fZSpacing) : CAnimationObject(pDirect3D9Device)
+                         float fZSpacing) : CAnimationObject(pDirect3D9Device), 
+                                           m_DynamicSink(pDirect3D9Device)
 {
    m_pDirect3D9Device = pDirect3D9Device;
    m_nNumRows = nNumRows;
@@ -18,8 +17,17 @@ CWaterSurface::CWaterSurface(IDirect3DDevice9* pDirect3D9Device,
 
    m_fXSpacing = fXSpacing;
    m_fZSpacing = fZSpacing;
-
-   m_pVertexBuffer = NULL;
+   m_GridLayout.nRows = m_nNumRows;
+   m_GridLayout.nColumns = m_nNumCols;
+   m_GridLayout.fXSpacing = m_fXSpacing;
+   m_GridLayout.fZSpacing = m_fZSpacing;
+   m_GridLayout.fXOffset = 0.0f;
+   m_GridLayout.fZOffset = 0.0f;
+   m_blChoppyVertices = false;
+   memset(&m_DynamicConstants, 0, sizeof(m_DynamicConstants));
+
+   m_pStaticVertexBuffer = NULL;
+   m_nDynamicOffset = -1;
    m_pIndexBuffer = NULL;
 
    m_vecTexWaterOffset0 = D3DXVECTOR2(0.0f, 0.0f);
@@ -29,10 +37,6 @@ CWaterSurface::CWaterSurface(IDirect3DDevice9* pDirect3D9Device,
    m_vecTexWaterOffset4 = D3DXVECTOR2(0.0f, 0.0f);
    m_vecTexWaterOffset5 = D3DXVECTOR2(0.0f, 0.0f);
 
-   m_fXWindSpeed = 10.0f;
-   m_fZWindSpeed = 10.0f;
-   m_fPhillipsConstant = 0.00008;
-   m_fGravityConstant = 2.0f;
    m_blEnableGerstnerWaves = false;
 
    m_pFX = NULL;   
@@ -44,8 +48,10 @@ CWaterSurface::~CWaterSurface(void)
    // -------------------------------------------------------------------------
    // Free Vertices
    // -------------------------------------------------------------------------
-   m_pVertexBuffer->Release();
-   m_pVertexBuffer = NULL;
+   m_pStaticVertexBuffer->Release();
+   m_pStaticVertexBuffer = NULL;
+
+   m_DynamicRing.Free();
 
    m_pIndexBuffer->Release();
    m_pIndexBuffer = NULL;
@@ -126,10 +132,9 @@ bool CWaterSurface::Init()
    }
 
    // -------------------------------------------------------------------------
-   // Build a Fourier Height Map which will help us statistically compute
-   // height values in our vertex shader at each H(X, T) vertex position.
+   // Precompute the FFT tables and the initial wave spectrum.
    // -------------------------------------------------------------------------
-   if (!LoadInitialFourierHeightMap())
+   if (!m_Ocean.Init())
    {
       return false;
    }
@@ -139,46 +144,42 @@ bool CWaterSurface::Init()
 
 void CWaterSurface::SetXWindSpeed(float fValue)
 {
-   m_fXWindSpeed = fValue;
-   LoadInitialFourierHeightMap();
+   m_Ocean.SetXWindSpeed(fValue);
 }
 
 float CWaterSurface::GetXWindSpeed()
 {
-   return m_fXWindSpeed;
+   return m_Ocean.GetXWindSpeed();
 }
 
 void CWaterSurface::SetZWindSpeed(float fValue)
 {
-   m_fZWindSpeed = fValue;
-   LoadInitialFourierHeightMap();
+   m_Ocean.SetZWindSpeed(fValue);
 }
 
 float CWaterSurface::GetZWindSpeed()
 {
-   return m_fZWindSpeed;
+   return m_Ocean.GetZWindSpeed();
 }
 
 void CWaterSurface::SetPhillipsConstant(float fValue)
 {
-   m_fPhillipsConstant = fValue;
-   LoadInitialFourierHeightMap();
+   m_Ocean.SetPhillipsConstant(fValue);
 }
 
 float CWaterSurface::GetPhillipsConstant()
 {
-   return m_fPhillipsConstant;
+   return m_Ocean.GetPhillipsConstant();
 }
 
 void CWaterSurface::SetGravityConstant(float fValue)
 {
-   m_fGravityConstant = fValue;
-   LoadInitialFourierHeightMap();
+   m_Ocean.SetGravityConstant(fValue);
 }
 
 float CWaterSurface::GetGravityConstant()
 {
-   return m_fGravityConstant;
+   return m_Ocean.GetGravityConstant();
 }
 
 void CWaterSurface::SetEnableGerstnerWaves(bool blValue)
@@ -191,85 +192,317 @@ float CWaterSurface::GetEnableGerstnerWaves()
    return m_blEnableGerstnerWaves;
 }
 
-bool CWaterSurface::BuildGrid()
+void CWaterSurface::SetChoppiness(float fValue)
 {
-   D3DXVECTOR3 vecGridCenter(0, 0, 0);
+   m_Ocean.SetChoppiness(fValue);
+}
 
-	float fWidth = (float)(m_nNumCols - 1) * m_fXSpacing;
-	float fDepth = (float)(m_nNumRows - 1) * m_fZSpacing;
+float CWaterSurface::GetChoppiness()
+{
+   return m_Ocean.GetChoppiness();
+}
+
+void CWaterSurface::SetSeed(unsigned int nSeed)
+{
+   m_Ocean.SetSeed(nSeed);
+}
+
+unsigned int CWaterSurface::GetSeed()
+{
+   return m_Ocean.GetSeed();
+}
+
+bool CWaterSurface::SetSpectrumModel(int nModel)
+{
+   return m_Ocean.SetSpectrumModel(nModel);
+}
+
+int CWaterSurface::GetSpectrumModel()
+{
+   return m_Ocean.GetSpectrumModel();
+}
+
+bool CWaterSurface::SetSpreading(int nSpreading)
+{
+   return m_Ocean.SetSpreading(nSpreading);
+}
+
+int CWaterSurface::GetSpreading()
+{
+   return m_Ocean.GetSpreading();
+}
+
+bool CWaterSurface::SetSpectrumEvaluation(int nMode)
+{
+   return m_Ocean.SetSpectrumEvaluation(nMode);
+}
+
+int CWaterSurface::GetSpectrumEvaluation()
+{
+   return m_Ocean.GetSpectrumEvaluation();
+}
+
+void CWaterSurface::SetFetch(float fValue)
+{
+   m_Ocean.SetFetch(fValue);
+}
+
+float CWaterSurface::GetFetch()
+{
+   return m_Ocean.GetFetch();
+}
+
+void CWaterSurface::SetDepth(float fValue)
+{
+   m_Ocean.SetDepth(fValue);
+}
+
+float CWaterSurface::GetDepth()
+{
+   return m_Ocean.GetDepth();
+}
+
+void CWaterSurface::SetPeakEnhancement(float fValue)
+{
+   m_Ocean.SetPeakEnhancement(fValue);
+}
+
+float CWaterSurface::GetPeakEnhancement()
+{
+   return m_Ocean.GetPeakEnhancement();
+}
+
+void CWaterSurface::SetSpreadingExponent(float fValue)
+{
+   m_Ocean.SetSpreadingExponent(fValue);
+}
+
+float CWaterSurface::GetSpreadingExponent()
+{
+   return m_Ocean.GetSpreadingExponent();
+}
+
+void CWaterSurface::SetLoopPeriod(float fSeconds)
+{
+   m_Ocean.SetLoopPeriod(fSeconds);
+}
+
+float CWaterSurface::GetLoopPeriod()
+{
+   return m_Ocean.GetLoopPeriod();
+}
+
+void CWaterSurface::SetFrameCache(int nFrames, int nFormat)
+{
+   m_Ocean.SetFrameCache(nFrames, nFormat);
+}
+
+int CWaterSurface::GetFrameCacheFrames()
+{
+   return m_Ocean.GetFrameCacheFrames();
+}
+
+int CWaterSurface::GetFrameCacheFormat()
+{
+   return m_Ocean.GetFrameCacheFormat();
+}
+
+bool CWaterSurface::SetBakedAnimation(const char* pPath)
+{
+   m_BakedAnimation.Close();
+
+   if (pPath == NULL)
+   {
+      return true;
+   }
+
+   // -------------------------------------------------------------------------
+   // The normals need the slope maps, so a bake of heights alone will not
+   // do.
+   // -------------------------------------------------------------------------
+   if (!m_BakedAnimation.Open(pPath) ||
+       m_BakedAnimation.GetHeader().nFields < OCEAN_FIELD_DISPLACEMENT_X)
+   {
+      m_BakedAnimation.Close();
+      return false;
+   }
+
+   m_BakedAnimation.SetThreadPool(&m_Ocean.GetThreadPool());
+   return true;
+}
+
+bool CWaterSurface::IsPlayingBakedAnimation()
+{
+   return m_BakedAnimation.IsOpen();
+}
+
+void CWaterSurface::SetFFTThreadCount(int nThreads)
+{
+   m_Ocean.SetFFTThreadCount(nThreads);
+}
+
+int CWaterSurface::GetFFTThreadCount()
+{
+   return m_Ocean.GetFFTThreadCount();
+}
+
+bool CWaterSurface::SetFFTSize(int nSize)
+{
+   return m_Ocean.SetFFTSize(nSize);
+}
+
+int CWaterSurface::GetFFTSize()
+{
+   return m_Ocean.GetFFTSize();
+}
+
+bool CWaterSurface::SetVertexFormat(int nWaveFormat, int nNormalFormat)
+{
+   if (nWaveFormat < 0 || nWaveFormat >= WATER_WAVE_FORMAT_COUNT ||
+       nNormalFormat < 0 || nNormalFormat >= WATER_NORMAL_FORMAT_COUNT)
+   {
+      return false;
+   }
 
    // -------------------------------------------------------------------------
-   // Initialize Height Map
+   // Both layouts must be drawable, since the next frame may switch
+   // between them.
    // -------------------------------------------------------------------------
-   for (int x = 0; x < WATER_SURFACE_WIDTH; x++)
+   if (CWaterVertex::Decls[nWaveFormat][nNormalFormat][0] == NULL ||
+       CWaterVertex::Decls[nWaveFormat][nNormalFormat][1] == NULL)
+   {
+      return false;
+   }
+
+   return m_VertexPacker.SetFormat(nWaveFormat, nNormalFormat);
+}
+
+int CWaterSurface::GetWaveFormat()
+{
+   return m_VertexPacker.GetWaveFormat();
+}
+
+int CWaterSurface::GetNormalFormat()
+{
+   return m_VertexPacker.GetNormalFormat();
+}
+
+void CWaterSurface::OnLostDevice()
+{
+   m_DynamicRing.Free();
+   m_nDynamicOffset = -1;
+}
+
+bool CWaterSurface::OnResetDevice()
+{
+   if (m_DynamicRing.GetCapacity() > 0 || m_pStaticVertexBuffer == NULL)
+   {
+      return true;
+   }
+
+   return CreateDynamicRing();
+}
+
+const UploadRingStats& CWaterSurface::GetUploadStats()
+{
+   return m_DynamicRing.GetStats();
+}
+
+// -------------------------------------------------------------------------
+// Writes the grid's triangles, two per quad, as 16 or 32-bit indices.
+// -------------------------------------------------------------------------
+template <class T>
+static void BuildGridIndices(T* pIndices, int nNumRows, int nNumCols)
+{
+   int k = 0;
+   for (int i = 0; i < nNumRows - 1; ++i)
    {
-      for (int z = 0; z < WATER_SURFACE_HEIGHT; z++)
+      for (int j = 0; j < nNumCols - 1; ++j)
       {
-         m_VertexHeightMap[x][z] = 0.0f;
+         pIndices[k]     = (T)(  i   * nNumCols + j);
+         pIndices[k + 1] = (T)(  i   * nNumCols + j + 1);
+         pIndices[k + 2] = (T)((i+1) * nNumCols + j);
+
+         pIndices[k + 3] = (T)((i+1) * nNumCols + j);
+         pIndices[k + 4] = (T)(  i   * nNumCols + j + 1);
+         pIndices[k + 5] = (T)((i+1) * nNumCols + j + 1);
+
+         // Next Quad
+         k += 6;
       }
-   } 
+   }
+}
 
-	// -------------------------------------------------------------------------
-   // Build the Vertices in a row-by-row, top-down fashion.
-   // -------------------------------------------------------------------------
-	m_Vertices.resize(m_nNumGridVertices);
+bool CWaterSurface::BuildGrid()
+{
+	float fWidth = (float)(m_nNumCols - 1) * m_fXSpacing;
+	float fDepth = (float)(m_nNumRows - 1) * m_fZSpacing;
 
    // -------------------------------------------------------------------------
 	// Offsets to translate grid from quadrant 4 to center of 
 	// coordinate system.
    // -------------------------------------------------------------------------
-	float fXOffset = -fWidth * 0.5f; 
-	float fZOffset = fDepth * 0.5f;
+	m_GridLayout.fXOffset = -fWidth * 0.5f; 
+	m_GridLayout.fZOffset = fDepth * 0.5f;
 
-	int k = 0;
-	for (float i = 0; i < m_nNumRows; ++i)
-	{
-		for (float j = 0; j < m_nNumCols; ++j)
-		{
-         // -------------------------------------------------------------------------
-			// Negate the depth coordinate to put in quadrant four.  
-			// Then offset to center about coordinate system.
-         // -------------------------------------------------------------------------
-			m_Vertices[k].x =  j * m_fXSpacing + fXOffset;
-			m_Vertices[k].z = -i * m_fZSpacing + fZOffset;
-			m_Vertices[k].y =  0.0f;
-
-			k++; // Next Vertex
-		}
-	}
+   // -------------------------------------------------------------------------
+   // Grids with more vertices than a 16-bit index can address use 32-bit
+   // indices.
+   // -------------------------------------------------------------------------
+   bool blIndex32 = (m_nNumGridVertices > 0xFFFF);
+   int nNumIndices = m_nNumGridTriangles * 3;
+   size_t nIndexBytes = nNumIndices * (blIndex32 ? sizeof(DWORD) : sizeof(WORD));
+
+   // -------------------------------------------------------------------------
+   // Stage the static vertices and the indices in one arena, each a
+   // contiguous span in the device's format, so the uploads are plain
+   // copies. The arena goes as soon as they are on the device.
+   // -------------------------------------------------------------------------
+   if (!m_VertexPacker.Init(m_GridLayout))
+   {
+      return false;
+   }
+
+   CLinearArena staging;
+
+   if (!staging.Init(
+      CLinearArena::GetSpanBytes<WaterStaticVertex>(m_nNumGridVertices) + 
+      CLinearArena::GetSpanBytes<unsigned char>((int)nIndexBytes)))
+   {
+      return false;
+   }
+
+   WaterStaticVertex* pStaticVertices = staging.Allocate<WaterStaticVertex>(m_nNumGridVertices);
+   void* pIndices = staging.Allocate<unsigned char>((int)nIndexBytes);
+
+	// -------------------------------------------------------------------------
+   // Build the Vertices in a row-by-row, top-down fashion.
+   // -------------------------------------------------------------------------
+   PackWaterStaticVertices(m_GridLayout, 0.20f, pStaticVertices);
 
 	// -------------------------------------------------------------------------
    // Build the Grid Triangle Indices
    // -------------------------------------------------------------------------
-	m_Indices.resize(m_nNumGridTriangles * 3);
-	 
-	k = 0;
-	for(DWORD i = 0; i < (DWORD)m_nNumRows - 1; ++i)
-	{
-		for (DWORD j = 0; j < (DWORD)m_nNumCols - 1; ++j)
-		{
-         m_Indices[k]     =   i   * m_nNumCols + j;
-			m_Indices[k + 1] =   i   * m_nNumCols + j + 1;
-			m_Indices[k + 2] = (i+1) * m_nNumCols + j;
-					
-			m_Indices[k + 3] = (i+1) * m_nNumCols + j;
-			m_Indices[k + 4] =   i   * m_nNumCols + j + 1;
-			m_Indices[k + 5] = (i+1) * m_nNumCols + j + 1;
-
-			// Next Quad
-			k += 6;
-		}
-	}
+   if (blIndex32)
+   {
+      BuildGridIndices((DWORD*)pIndices, m_nNumRows, m_nNumCols);
+   }
+   else
+   {
+      BuildGridIndices((WORD*)pIndices, m_nNumRows, m_nNumCols);
+   }
 	 
    // -------------------------------------------------------------------------
-   // Create the Grid Vertices on the Direct3D Device.
+   // Create the static Grid Vertices on the Direct3D Device, written once
+   // here. The dynamic vertices go through the upload ring, see
+   // CreateDynamicRing.
    // -------------------------------------------------------------------------
 	if (S_OK != m_pDirect3D9Device->CreateVertexBuffer(
-      m_nNumGridVertices * sizeof(CVertex), 
+      m_nNumGridVertices * sizeof(WaterStaticVertex), 
 		D3DUSAGE_WRITEONLY, 
       0, 
       D3DPOOL_MANAGED, 
-      &m_pVertexBuffer, 
+      &m_pStaticVertexBuffer, 
       0))
    {
       return false;
@@ -279,9 +512,9 @@ bool CWaterSurface::BuildGrid()
    // Create the Grid Indices on the Direct3D Device.
    // -------------------------------------------------------------------------
 	if (S_OK != m_pDirect3D9Device->CreateIndexBuffer(
-      m_nNumGridTriangles * 3 * sizeof(WORD), 
+      (UINT)nIndexBytes, 
 		D3DUSAGE_WRITEONLY, 
-      D3DFMT_INDEX16, 
+      blIndex32 ? D3DFMT_INDEX32 : D3DFMT_INDEX16, 
       D3DPOOL_MANAGED, 
       &m_pIndexBuffer, 
       0))
@@ -290,42 +523,68 @@ bool CWaterSurface::BuildGrid()
    }
 
    // -------------------------------------------------------------------------
-   // Write the Vertex Buffer to Memory.
+   // Write the Vertex Buffers to Memory.
+   // -------------------------------------------------------------------------
+   void* pVertexData = 0;
+	m_pStaticVertexBuffer->Lock(0, 0, &pVertexData, 0);
+   memcpy(pVertexData, pStaticVertices, m_nNumGridVertices * sizeof(WaterStaticVertex));
+	m_pStaticVertexBuffer->Unlock();
+
+   // -------------------------------------------------------------------------
+   // Write the Index Buffer to Memory.
    // -------------------------------------------------------------------------
-   CVertex* pVertex = 0;
-	m_pVertexBuffer->Lock(0, 0, (void**)&pVertex, 0);
+   void* pIndexData = 0;
+	m_pIndexBuffer->Lock(0, 0, &pIndexData, 0);
+   memcpy(pIndexData, pIndices, nIndexBytes);
+	m_pIndexBuffer->Unlock();
 
-   int nXIndex = 0;
-   int nZIndex = 0;
-   float fTexScale = 0.02f;
+   staging.Free();
 
-	for (DWORD i = 0; i < m_nNumGridVertices; i++)
+   if (!CreateDynamicRing())
    {
-      nXIndex = i / m_nNumRows;
-      nZIndex = i % m_nNumCols;
- 
-      pVertex[i] = CVertex(
-         D3DXVECTOR3(m_Vertices[i].x, m_Vertices[i].y, m_Vertices[i].z), 
-         D3DXVECTOR3(0, 1, 0), // Default Normal Vector (before animation).
-         D3DXVECTOR2((float)nZIndex, (float)nXIndex) * fTexScale
-         );
+      return false;
    }
 
-	m_pVertexBuffer->Unlock();
+   return true;
+}
 
+bool CWaterSurface::CreateDynamicRing()
+{
    // -------------------------------------------------------------------------
-   // Write the Index Buffer to Memory.
+   // Room for WATER_DYNAMIC_RING_FRAMES frames in the largest layout any
+   // encoding takes, so the GPU can be that far behind before a discard.
+   // The surface is flat until the first Update.
    // -------------------------------------------------------------------------
-   WORD* pIndices = 0;
-	m_pIndexBuffer->Lock(0, 0, (void**)&pIndices, 0);
+   if (!m_DynamicRing.Init(&m_DynamicSink, WATER_DYNAMIC_RING_FRAMES * m_nNumGridVertices * WATER_DYNAMIC_VERTEX_MAX_SIZE))
+   {
+      return false;
+   }
+
+   WaterFieldFrame flatFrame;
+   memset(&flatFrame, 0, sizeof(flatFrame));
+   return WriteDynamicVertices(flatFrame);
+}
+
+bool CWaterSurface::WriteDynamicVertices(const WaterFieldFrame& frame)
+{
+   bool blChoppy = IsWaterFrameChoppy(frame);
+
+   WaterDynamicLayout layout;
+   GetWaterDynamicLayout(m_VertexPacker.GetWaveFormat(), m_VertexPacker.GetNormalFormat(), blChoppy, layout);
+
+   int nOffset = 0;
+   void* pVertexData = m_DynamicRing.Lock(m_nNumGridVertices * layout.nSize, nOffset);
 
-	for (DWORD i = 0; i < m_nNumGridTriangles * 3; i++)
+   if (pVertexData == NULL)
    {
-		pIndices[i] = (WORD)m_Indices[i];
+      return false;
    }
 
-	m_pIndexBuffer->Unlock();
+   m_VertexPacker.Pack(frame, pVertexData, m_DynamicConstants);
+   m_DynamicRing.Unlock();
 
+   m_blChoppyVertices = blChoppy;
+   m_nDynamicOffset = nOffset;
    return true;
 }
 
@@ -379,10 +638,16 @@ bool CWaterSurface::LoadShadingFX()
    // -------------------------------------------------------------------------
    // Obtain Shading Handles
    // -------------------------------------------------------------------------
-   m_hParam_FastFourierWavesTechnique = m_pFX->GetTechniqueByName("FastFourierWavesTechnique");   
+   m_ahFastFourierWavesTechniques[WATER_NORMAL_DECODE_VECTOR] = m_pFX->GetTechniqueByName("FastFourierWavesVectorTechnique");
+   m_ahFastFourierWavesTechniques[WATER_NORMAL_DECODE_OCTAHEDRAL] = m_pFX->GetTechniqueByName("FastFourierWavesOctahedralTechnique");
+   m_ahFastFourierWavesTechniques[WATER_NORMAL_DECODE_SPARE] = m_pFX->GetTechniqueByName("FastFourierWavesSpareTechnique");
 	m_hParam_WVP = m_pFX->GetParameterByName(0, "g_WVP");
    m_hParam_WorldInverseTranspose = m_pFX->GetParameterByName(0, "g_WorldInverseTranspose");
    m_hParam_Time = m_pFX->GetParameterByName(0, "g_Time");
+   m_hParam_WaveScale = m_pFX->GetParameterByName(0, "g_WaveScale");
+   m_hParam_WaveBias = m_pFX->GetParameterByName(0, "g_WaveBias");
+   m_hParam_NormalScaleBias = m_pFX->GetParameterByName(0, "g_NormalScaleBias");
+   m_hParam_SpareMask = m_pFX->GetParameterByName(0, "g_SpareMask");
    m_hParam_EnableGerstnerWaves = m_pFX->GetParameterByName(0, "g_EnableGerstnerWaves");
    m_hGerstnerWaves = m_pFX->GetParameterByName(0, "g_GerstnerWaves");
    
@@ -503,23 +768,23 @@ void CWaterSurface::SetCamera(CFirstPersonCamera& camera)
    m_Camera.SetViewParams(&vecEye, &vecAt);
 }
 
-void CWaterSurface::Update(float fCurrentTime, bool blMoveObject)
+void CWaterSurface::Update(double dCurrentTime, bool blMoveObject)
 {
    D3DXVECTOR3 vecEyePos = *m_Camera.GetEyePt();
    m_pFX->SetValue(m_hParam_EyePos, &vecEyePos, sizeof(D3DXVECTOR3));
-   m_pFX->SetFloat(m_hParam_Time, fCurrentTime);    
+   m_pFX->SetFloat(m_hParam_Time, (float)dCurrentTime);    
    m_pFX->SetBool(m_hParam_EnableGerstnerWaves, (BOOL)m_blEnableGerstnerWaves);    
 
    // -------------------------------------------------------------------------
    // Update the Texture Offsets that will create a scrolling Animation in
    // the Pixel Shader.
    // -------------------------------------------------------------------------
-   m_vecTexWaterOffset0 += D3DXVECTOR2(0.11f, 0.05f) * (0.0002 * fCurrentTime);  
-	m_vecTexWaterOffset1 += D3DXVECTOR2(0.05f, -0.1f) * (0.0004 * fCurrentTime);
-   m_vecTexWaterOffset2 += D3DXVECTOR2(0.25f, 0.15f) * (0.0001 * fCurrentTime);
-   m_vecTexWaterOffset3 += D3DXVECTOR2(0.35f, 0.2f) * (0.0002 * fCurrentTime);
-   m_vecTexWaterOffset4 += D3DXVECTOR2(0.05f, 0.8f) * (0.0005 * fCurrentTime);
-   m_vecTexWaterOffset5 += D3DXVECTOR2(0.15f, 0.5f) * (0.0001 * fCurrentTime); 
+   m_vecTexWaterOffset0 += D3DXVECTOR2(0.11f, 0.05f) * (float)(0.0002 * dCurrentTime);  
+	m_vecTexWaterOffset1 += D3DXVECTOR2(0.05f, -0.1f) * (float)(0.0004 * dCurrentTime);
+   m_vecTexWaterOffset2 += D3DXVECTOR2(0.25f, 0.15f) * (float)(0.0001 * dCurrentTime);
+   m_vecTexWaterOffset3 += D3DXVECTOR2(0.35f, 0.2f) * (float)(0.0002 * dCurrentTime);
+   m_vecTexWaterOffset4 += D3DXVECTOR2(0.05f, 0.8f) * (float)(0.0005 * dCurrentTime);
+   m_vecTexWaterOffset5 += D3DXVECTOR2(0.15f, 0.5f) * (float)(0.0001 * dCurrentTime); 
 
    // -------------------------------------------------------------------------
    // Update Shader Offsets
@@ -597,49 +862,107 @@ void CWaterSurface::Update(float fCurrentTime, bool blMoveObject)
 
    // -------------------------------------------------------------------------
    // Perform the Inverse Fast Fourier Transform to go from the Frequency
-   // domain to the Spatial Domain. This will give us our Wave Heights.
+   // domain to the Spatial Domain. This will give us our Wave Heights. A
+   // baked animation already holds them, frame by frame. An ocean that lost
+   // its maps to a failed resize leaves the water flat.
    // -------------------------------------------------------------------------
-   UpdateFourierHeightMap(fCurrentTime); 
+   const float* apMaps[OCEAN_FIELD_COUNT] = { 0 };
+   int nMapWidth = 0;
+   int nMapHeight = 0;
+   int nFields = 0;
+   float fChoppiness = 0.0f;
 
    // -------------------------------------------------------------------------
-   // Write the updated Vertex Buffer to Memory.
+   // A compressed frame that fails to decode is corrupt, and the bake is
+   // dropped for the live simulation.
    // -------------------------------------------------------------------------
-   float fYHeightValue = 0.0f;
-   float fTexScale = 0.20f;
-   int nXIndex = 0;
-   int nZIndex = 0;
+   if (m_BakedAnimation.IsOpen() &&
+       !m_BakedAnimation.GetFrame(m_BakedAnimation.GetFrameIndex(dCurrentTime), apMaps))
+   {
+      m_BakedAnimation.Close();
+   }
 
-   CVertex* pVertex = 0;
-	m_pVertexBuffer->Lock(0, 0, (void**)&pVertex, 0);
+   if (m_BakedAnimation.IsOpen())
+   {
+      const OceanBakeHeader& header = m_BakedAnimation.GetHeader();
 
-	for (DWORD i = 0; i < m_nNumGridVertices; i++)
+      nMapWidth = header.nWidth;
+      nMapHeight = header.nHeight;
+      nFields = header.nFields;
+      fChoppiness = (nFields == OCEAN_FIELD_COUNT) ? header.fChoppiness : 0.0f;
+   }
+   else if (m_Ocean.IsValid())
    {
-      nXIndex = i / WATER_SURFACE_HEIGHT;
-      nZIndex = i % WATER_SURFACE_WIDTH;
+      m_Ocean.Update(dCurrentTime); 
+
+      nMapWidth = m_Ocean.GetFFTSize();
+      nMapHeight = m_Ocean.GetFFTSize();
+      nFields = m_Ocean.GetActiveFieldCount();
+      fChoppiness = m_Ocean.GetChoppiness();
+
+      for (int f = 0; f < nFields; f++)
+      {
+         apMaps[f] = m_Ocean.GetField(f);
+      }
+   }
 
-      fYHeightValue = m_VertexHeightMap[nXIndex][nZIndex];
+   // -------------------------------------------------------------------------
+   // Write the updated heights and normals to the dynamic stream in its
+   // current encoding. The static stream keeps the resting positions and
+   // texture coordinates.
+   // -------------------------------------------------------------------------
+   WaterFieldFrame frame;
+   memset(&frame, 0, sizeof(frame));
 
-      pVertex[i] = CVertex(
-         D3DXVECTOR3(m_Vertices[i].x, fYHeightValue, m_Vertices[i].z), 
-         D3DXVECTOR3(0, 1, 0), // Default Normal Vector (before animation).
-         D3DXVECTOR2((float)nZIndex, (float)nXIndex) * fTexScale
-         );
+   for (int f = 0; f < nFields; f++)
+   {
+      frame.apMaps[f] = apMaps[f];
    }
 
-	m_pVertexBuffer->Unlock();
+   frame.nWidth = nMapWidth;
+   frame.nHeight = nMapHeight;
+   frame.nFields = nFields;
+   frame.fChoppiness = fChoppiness;
+
+   WriteDynamicVertices(frame);
 }
 
 void CWaterSurface::Draw(D3DXMATRIX& projectionMatrix,
                          D3DXMATRIX& viewMatrix)
 {
-	m_pDirect3D9Device->SetStreamSource(0, m_pVertexBuffer, 0, sizeof(CVertex));
+   // -------------------------------------------------------------------------
+   // Nothing to draw until the dynamic stream has been written, e.g. after
+   // the device was lost.
+   // -------------------------------------------------------------------------
+   if (m_nDynamicOffset < 0)
+   {
+      return;
+   }
+
+   int nWaveFormat = m_VertexPacker.GetWaveFormat();
+   int nNormalFormat = m_VertexPacker.GetNormalFormat();
+   WaterDynamicLayout layout;
+   GetWaterDynamicLayout(nWaveFormat, nNormalFormat, m_blChoppyVertices, layout);
+
+	m_pDirect3D9Device->SetStreamSource(0, m_pStaticVertexBuffer, 0, sizeof(WaterStaticVertex));
+	m_pDirect3D9Device->SetStreamSource(1, m_DynamicSink.GetBuffer(), m_nDynamicOffset, layout.nSize);
 	m_pDirect3D9Device->SetIndices(m_pIndexBuffer);
-   m_pDirect3D9Device->SetVertexDeclaration(CVertex::Decl);
+   m_pDirect3D9Device->SetVertexDeclaration(CWaterVertex::Decls[nWaveFormat][nNormalFormat][m_blChoppyVertices ? 1 : 0]);
 
    // -------------------------------------------------------------------------
-   // Draw the animation objects while using the FX Shader file.
+   // How to decode the dynamic stream's last frame.
    // -------------------------------------------------------------------------
-	m_pFX->SetTechnique(m_hParam_FastFourierWavesTechnique);
+   float afNormalScaleBias[2] = { m_DynamicConstants.fNormalScale, m_DynamicConstants.fNormalBias };
+   m_pFX->SetValue(m_hParam_WaveScale, m_DynamicConstants.afWaveScale, sizeof(m_DynamicConstants.afWaveScale));
+   m_pFX->SetValue(m_hParam_WaveBias, m_DynamicConstants.afWaveBias, sizeof(m_DynamicConstants.afWaveBias));
+   m_pFX->SetValue(m_hParam_NormalScaleBias, afNormalScaleBias, sizeof(afNormalScaleBias));
+   m_pFX->SetValue(m_hParam_SpareMask, m_DynamicConstants.afSpareMask, sizeof(m_DynamicConstants.afSpareMask));
+
+   // -------------------------------------------------------------------------
+   // Draw the animation objects while using the FX Shader file, with the
+   // technique that decodes the frame's normals.
+   // -------------------------------------------------------------------------
+	m_pFX->SetTechnique(m_ahFastFourierWavesTechniques[m_DynamicConstants.nNormalDecode]);
 
    // -------------------------------------------------------------------------
    // Set the Lighting Effects.
@@ -679,325 +1002,11 @@ void CWaterSurface::Draw(D3DXMATRIX& projectionMatrix,
 	}
 
 	m_pFX->End(); 
-}
-
-bool CWaterSurface::LoadInitialFourierHeightMap()
-{
-   KWaveVector vecKWaveVector;
 
-   float fGaussian1 = 0.0f;
-   float fGaussian2 = 0.0f;
-
-   float fInverseRoot = (float)1 / (float)sqrt((float)2);
-   float fPhillipsSpectrum = 0.0f;
-
-   int nHalfGridWidth = WATER_SURFACE_WIDTH / 2;
-   int nHalfGridHeight = WATER_SURFACE_HEIGHT / 2; 
-
-   // -------------------------------------------------------------------------
-   // Build a Fourier Height Map which will help us statistically compute
-   // height values in our vertex shader at each H(X, T) vertex position.
-   // -------------------------------------------------------------------------
-   for (int x = 0; x < WATER_SURFACE_WIDTH; x++)
-   {
-      for (int z = 0; z < WATER_SURFACE_HEIGHT; z++)
-      {
-         // -------------------------------------------------------------------------
-         // At each iteration stage, generate a 2D component vector that will be used
-         // to calculate the Phillips Spectrum. Ensure that the vecKBounded's values
-         // are within the (-N/2 <= n < N/2) or (-M/2 <= m < M/2) constraints as
-         // specified by Tessendorf's paper.
-         // -------------------------------------------------------------------------
-         vecKWaveVector.fX = (2 * PI * x) / WATER_SURFACE_WIDTH;
-         vecKWaveVector.fZ = (2 * PI * z) / WATER_SURFACE_HEIGHT; 
-
-         // -------------------------------------------------------------------------
-         // Once we compute the Fourier Height Map, we will later use the K-Wave
-         // Vector and each's respective Angular Frequency to animate the wave.
-         // -------------------------------------------------------------------------
-         float fKVectorDistance = sqrt(vecKWaveVector.fX * vecKWaveVector.fX + vecKWaveVector.fZ * vecKWaveVector.fZ);
-         m_AngularFreqs[x][z] = sqrt(fKVectorDistance * m_fGravityConstant);
-         m_KWaveVectors[x][z] = vecKWaveVector;
-
-         // -------------------------------------------------------------------------
-         // Generate Gaussian Random Numbers for the Phillips Spectrum formula. These
-         // Gaussian Random Numbers tend to follow the experimental data on ocean
-         // waves.
-         // -------------------------------------------------------------------------
-         GetGaussian(fGaussian1, fGaussian2);
-
-         // -------------------------------------------------------------------------
-         // Calculate a wave spectrum based from Phillips Spectrum which is a useful
-         // model for wind-driven waves. 
-         // -------------------------------------------------------------------------
-         fPhillipsSpectrum = GetPhillipsSpectrum(vecKWaveVector);
-
-         if (fKVectorDistance == 0)
-         {
-            fPhillipsSpectrum = 0;
-         }
-
-         // -------------------------------------------------------------------------
-         // Store the Results in the Fourier Height Map for later inverse transforms.
-         // -------------------------------------------------------------------------
-         m_InitialHeightMap[x][z].fReal = fInverseRoot * fGaussian1 * sqrt(fPhillipsSpectrum);
-         m_InitialHeightMap[x][z].fImaginary = fInverseRoot * fGaussian2 * sqrt(fPhillipsSpectrum);
-      }
-   }
-
-   return true;
-}
-
-void CWaterSurface::UpdateFourierHeightMap(float fCurrentTime)
-{
-   // -------------------------------------------------------------------------
-   // Given a set of angular frequencies, perform the inverse Fast Fourier 
-   // animation by iterating over the h0 Height Map.
-   // -------------------------------------------------------------------------
-   for (int x = 0; x < WATER_SURFACE_WIDTH; x++)
-   {
-      for (int z = 0; z < WATER_SURFACE_HEIGHT; z++)
-      {
-         float fAngularFreq = m_AngularFreqs[x][z] * fCurrentTime;
-         float fAngularSine = sin(fAngularFreq);
-         float fAngularCosine = cos(fAngularFreq);   
-         
-         // -------------------------------------------------------------------------
-         // Convert from Fourier Space to the Spatial Domain by combining the effects
-         // of the each sinus waveform to get a surface height.
-         //
-         // Trying to compute: h0(k)exp{iw(k)t} + h0(-k)exp{-iw(k)t}
-         // exp{iwkt} can be represented as: cos(wkt) + sin(-wkt)
-         // -------------------------------------------------------------------------
-         m_FourierHeightMap[x][z].fReal = 
-            m_InitialHeightMap[x][z].fReal * fAngularCosine +
-            m_InitialHeightMap[x][z].fImaginary * fAngularSine +
-            m_InitialHeightMap[WATER_SURFACE_WIDTH - x - 1][WATER_SURFACE_HEIGHT - z - 1].fReal * fAngularCosine -
-            m_InitialHeightMap[WATER_SURFACE_WIDTH - x - 1][WATER_SURFACE_HEIGHT - z - 1].fImaginary * fAngularSine;
-
-         m_FourierHeightMap[x][z].fImaginary = 
-            m_InitialHeightMap[x][z].fImaginary * fAngularCosine +
-            m_InitialHeightMap[x][z].fReal * fAngularSine - 
-            m_InitialHeightMap[WATER_SURFACE_WIDTH - x - 1][WATER_SURFACE_HEIGHT - z - 1].fImaginary * fAngularCosine -
-            m_InitialHeightMap[WATER_SURFACE_WIDTH - x - 1][WATER_SURFACE_HEIGHT - z - 1].fReal * fAngularSine;
-      }
-   }   
-
-   // -------------------------------------------------------------------------
-   // Perform an inverse Fourier Transform to get height map values.
-   // -------------------------------------------------------------------------
-   FFT2D();
-
-   // -------------------------------------------------------------------------
-   // Store the Height Map values in a simple float matrix.
-   // -------------------------------------------------------------------------
-   int nHeightMapIndex = 0;
-   for (int x = 0; x < WATER_SURFACE_WIDTH; x++)
-   {
-      for (int z = 0; z < WATER_SURFACE_HEIGHT; z++)
-      {
-         m_VertexHeightMap[x][z] = m_FourierHeightMap[x][z].fReal /= 5.0f;
-      }  
-   }    
-}
-
-int CWaterSurface::FFT2D()
-{
-   int i,j;
-   int m,twopm; 
-   float *real,*imag; 
-
-   /* Transform the rows */
-   real = (float *)malloc(WATER_SURFACE_WIDTH * sizeof(float));
-   imag = (float *)malloc(WATER_SURFACE_HEIGHT * sizeof(float));
-   if (real == NULL || imag == NULL)
-      return(FALSE);
-   if (!Powerof2(WATER_SURFACE_WIDTH,&m,&twopm) || twopm != WATER_SURFACE_WIDTH)
-      return(FALSE);
-   for (j=0;j<WATER_SURFACE_HEIGHT;j++) {
-      for (i=0;i<WATER_SURFACE_WIDTH;i++) {
-         real[i] = m_FourierHeightMap[i][j].fReal;
-         imag[i] = m_FourierHeightMap[i][j].fImaginary;
-      }
-      FFT(-1,m,real,imag);
-      for (i=0;i<WATER_SURFACE_WIDTH;i++) {
-         m_FourierHeightMap[i][j].fReal = real[i];
-         m_FourierHeightMap[i][j].fImaginary = imag[i];
-      }
-   }
-   free(real);
-   free(imag);
-
-   /* Transform the columns */
-   real = (float *)malloc(WATER_SURFACE_HEIGHT * sizeof(float));
-   imag = (float *)malloc(WATER_SURFACE_HEIGHT * sizeof(float));
-   if (real == NULL || imag == NULL)
-      return(FALSE);
-   if (!Powerof2(WATER_SURFACE_HEIGHT,&m,&twopm) || twopm != WATER_SURFACE_HEIGHT)
-      return(FALSE);
-   for (i=0;i<WATER_SURFACE_WIDTH;i++) {
-      for (j=0;j<WATER_SURFACE_HEIGHT;j++) {
-         real[j] = m_FourierHeightMap[i][j].fReal;
-         imag[j] = m_FourierHeightMap[i][j].fImaginary;
-      }
-      FFT(-1,m,real,imag);
-      for (j=0;j<WATER_SURFACE_HEIGHT;j++) {
-         m_FourierHeightMap[i][j].fReal = real[j];
-         m_FourierHeightMap[i][j].fImaginary = imag[j];
-      }
-   }
-   free(real);
-   free(imag);
-
-   return(TRUE);
-}
-
-int CWaterSurface::FFT(int dir,int m,float *x,float *y)
-{
-   long nn,i,i1,j,k,i2,l,l1,l2;
-   double c1,c2,tx,ty,t1,t2,u1,u2,z;
-
-   /* Calculate the number of points 
-   nn = 1;
-   for (i=0;i<m;i++)
-      nn *= 2;
-	*/
-	nn = 1 << m;
-
-   /* Do the bit reversal */
-   i2 = nn >> 1;
-   j = 0;
-   for (i=0;i<nn-1;i++) {
-      if (i < j) {
-         tx = x[i];
-         ty = y[i];
-         x[i] = x[j];
-         y[i] = y[j];
-         x[j] = tx;
-         y[j] = ty;
-      }
-      k = i2;
-      while (k <= j) {
-         j -= k;
-         k >>= 1;
-      }
-      j += k;
-   }
-
-   /* Compute the FFT */
-   c1 = -1.0;
-   c2 = 0.0;
-   l2 = 1;
-   for (l=0;l<m;l++) {
-      l1 = l2;
-      l2 <<= 1;
-      u1 = 1.0;
-      u2 = 0.0;
-      for (j=0;j<l1;j++) {
-         for (i=j;i<nn;i+=l2) {
-            i1 = i + l1;
-            t1 = u1 * x[i1] - u2 * y[i1];
-            t2 = u1 * y[i1] + u2 * x[i1];
-            x[i1] = x[i] - t1;
-            y[i1] = y[i] - t2;
-            x[i] += t1;
-            y[i] += t2;
-         }
-         z =  u1 * c1 - u2 * c2;
-         u2 = u1 * c2 + u2 * c1;
-         u1 = z;
-      }
-      c2 = sqrt((1.0 - c1) / 2.0);
-      if (dir == 1)
-         c2 = -c2;
-      c1 = sqrt((1.0 + c1) / 2.0);
-   }
-
-   /* Scaling for forward transform */
-   if (dir == 1) {
-      for (i=0;i<nn;i++) {
-         x[i] /= (float)nn;
-         y[i] /= (float)nn;
-      }
-   }
-
-   return(TRUE);
-}
-
-int CWaterSurface::Powerof2(int n,int *m,int *twopm)
-{
-	if (n <= 1) {
-		*m = 0;
-		*twopm = 1;
-		return(FALSE);
-	}
-
-   *m = 1;
-   *twopm = 2;
-   do {
-      (*m)++;
-      (*twopm) *= 2;
-   } while (2*(*twopm) <= n);
-
-   if (*twopm != n) 
-		return(FALSE);
-	else
-		return(TRUE);
-}
-
-void CWaterSurface::GetGaussian(float& fGaussian1, float& fGaussian2)
-{
    // -------------------------------------------------------------------------
-   // Generate pseudo-random numbers with mean 0 and standard deviation 1.
+   // Fence off this frame's dynamic vertices; the ring reuses their space
+   // once the GPU is past them.
    // -------------------------------------------------------------------------
-   float x1, x2, w;
-   do 
-   {
-      x1 = 2.0 * ((float)rand()/(float)RAND_MAX) - 1.0;
-      x2 = 2.0 * ((float)rand()/(float)RAND_MAX) - 1.0;
-      w = x1 * x1 + x2 * x2;
-   } while (w >= 1.0);
-
-   w = (float)sqrt((-2.0 * log(w)) / w);
-   fGaussian1 = x1 * w;
-   fGaussian2 = x2 * w;
+   m_DynamicRing.EndFrame();
 }
 
-float CWaterSurface::GetPhillipsSpectrum(KWaveVector vecKBounded)
-{   
-   // -------------------------------------------------------------------------
-   // Wind Direction
-   // -------------------------------------------------------------------------
-   KWaveVector vecWindSpeed;
-   vecWindSpeed.fX = m_fXWindSpeed;
-   vecWindSpeed.fZ = m_fZWindSpeed;
-
-   // -------------------------------------------------------------------------
-   // Represents the largest possible waves arising from a continuous wind of
-   // speed V (or vecWindSpeed).
-   // -------------------------------------------------------------------------
-   float fWindspeedGravity = (
-      (vecWindSpeed.fX * vecWindSpeed.fX) + 
-      (vecWindSpeed.fZ * vecWindSpeed.fZ)) / m_fGravityConstant;
-
-   float fKSquared = (vecKBounded.fX * vecKBounded.fX) + (vecKBounded.fZ * vecKBounded.fZ);
-   float fKSquaredWindspeed = fKSquared * fWindspeedGravity * fWindspeedGravity;
-   
-   // -------------------------------------------------------------------------
-   // Eliminates waves that move perpendicular to the wind direction.
-   // -------------------------------------------------------------------------
-   float fPerpendWaveEliminator = 
-      (vecKBounded.fX * vecWindSpeed.fX) +
-      (vecKBounded.fZ * vecWindSpeed.fZ);
-
-   // -------------------------------------------------------------------------
-   // Compute the Phillips Spectrum variable which is used for modeling
-   // realistic waves.
-   // -------------------------------------------------------------------------
-   float fPhillipsSpectrum = 
-      m_fPhillipsConstant 
-      * ((exp(-1 / fKSquaredWindspeed)) / (fKSquared * fKSquared))  
-      * (fPerpendWaveEliminator * fPerpendWaveEliminator);
-
-   return fPhillipsSpectrum;
-}
@@ -3,6 +3,16 @@ uniform extern float4x4 g_World; // Needed for specular calculation.
 uniform extern float g_Time;
 uniform extern bool g_EnableGerstnerWaves = false;
 
+// -------------------------------------------------------------------------
+// Decoding of the dynamic vertex stream, see WaterDynamicConstants in
+// WaterVertexStreams.h: the wave is scaled and biased per component. How
+// the normal is decoded is fixed per technique, see the end of the file.
+// -------------------------------------------------------------------------
+uniform extern float3 g_WaveScale = { 1.0f, 1.0f, 1.0f };
+uniform extern float3 g_WaveBias = { 0.0f, 0.0f, 0.0f };
+uniform extern float2 g_NormalScaleBias = { 2.0f, -1.0f };
+uniform extern float4 g_SpareMask = { 0.0f, 0.0f, 0.0f, 0.0f };
+
 // -------------------------------------------------------------------------
 // Needed to transform vertex normals into world space
 // as lighting vectors are in a specific coordinate system.
@@ -200,12 +210,64 @@ float3 GetWaveVertexNormal(float3 posL)
 	return vec_cross;
 }
 
-OutputVS Phong_VS(float3 posL : POSITION0,
-                  float3 normalL : NORMAL0,
-                  float2 tex0: TEXCOORD0)
+// -------------------------------------------------------------------------
+// Unit vector of octahedral coordinates in [-1, 1], y being the axis of
+// the upper hemisphere, unfolded over the diagonals below it.
+// -------------------------------------------------------------------------
+float3 DecodeOctahedralNormal(float2 oct)
+{
+	float3 normal = float3(oct.x, 1.0f - abs(oct.x) - abs(oct.y), oct.y);
+	
+	if (normal.y < 0.0f)
+	{
+		float2 signs = float2(oct.x >= 0.0f ? 1.0f : -1.0f, oct.y >= 0.0f ? 1.0f : -1.0f);
+		normal.xz = (1.0f - abs(oct.yx)) * signs;
+	}
+	
+	return normalize(normal);
+}
+
+// -------------------------------------------------------------------------
+// Stream 0 holds the resting x and z and the texture coordinates, stream 1
+// the wave: its height, the choppy x and z offsets (0 when the stream
+// only carries the height) and the normal. nNormalDecode is a
+// WATER_NORMAL_DECODE_* value: the normal comes straight from its element
+// (0), as octahedral coordinates from it (1) or as octahedral bytes from
+// the wave's spare component (2). It is a compile-time constant, so each
+// shader holds only its own decode.
+// -------------------------------------------------------------------------
+OutputVS Phong_VS(float2 restXZ : POSITION0,
+                  float4 wave : POSITION1,
+                  float4 normalPacked : NORMAL0,
+                  float2 tex0: TEXCOORD0,
+                  uniform int nNormalDecode)
 {
 	OutputVS outVS = (OutputVS)0;
 	
+	float3 waveL = wave.xyz * g_WaveScale + g_WaveBias;
+	float3 posL = float3(restXZ.x + waveL.y, waveL.x, restXZ.y + waveL.z);
+	float3 normalL;
+	
+	if (nNormalDecode == 0)
+	{
+		normalL = normalPacked.xyz * g_NormalScaleBias.x + g_NormalScaleBias.y;
+	}
+	else if (nNormalDecode == 1)
+	{
+		normalL = DecodeOctahedralNormal(normalPacked.xy * g_NormalScaleBias.x + g_NormalScaleBias.y);
+	}
+	else
+	{
+		// -------------------------------------------------------------------------
+		// The spare short holds the u byte low and the v byte high.
+		// -------------------------------------------------------------------------
+		float fSpare = dot(wave, g_SpareMask);
+		fSpare += (fSpare < 0.0f) ? 65536.0f : 0.0f;
+		float fHigh = floor(fSpare / 256.0f);
+		float2 octBytes = float2(fSpare - fHigh * 256.0f, fHigh);
+		normalL = DecodeOctahedralNormal(octBytes * g_NormalScaleBias.x + g_NormalScaleBias.y);
+	}
+	
 	if (g_EnableGerstnerWaves == true)
 	{
 		posL = ComputeGerstnerWaves(posL);
@@ -253,8 +315,6 @@ float4 Phong_PS(float3 normalW : TEXCOORD0,
                 ) : COLOR
 {
 	normalW = normalize(normalW);
-	normalW.x = 0;
-	normalW.z = 0;
 	
 	// -------------------------------------------------------------------------
 	// Compute Specular Lighting
@@ -302,14 +362,17 @@ float4 Phong_PS(float3 normalW : TEXCOORD0,
    return float4(waterPixel0 + waterPixel1 + waterPixel2 + color, g_DiffuseMtrl.a);
 }
 
-technique FastFourierWavesTechnique
+// -------------------------------------------------------------------------
+// One technique per WATER_NORMAL_DECODE_* value, in that order.
+// -------------------------------------------------------------------------
+technique FastFourierWavesVectorTechnique
 {
 	pass P0
 	{
 		// ----------------------------------------------------------------------
 		// Specify the vertex and pixel shader associated with this pass.
 		// ----------------------------------------------------------------------
-		vertexShader = compile vs_2_0 Phong_VS();
+		vertexShader = compile vs_2_0 Phong_VS(0);
 		pixelShader  = compile ps_2_0 Phong_PS();
 
 		// ----------------------------------------------------------------------
@@ -320,3 +383,29 @@ technique FastFourierWavesTechnique
 	   DestBlend = InvSrcAlpha;
 	}
 }
+
+technique FastFourierWavesOctahedralTechnique
+{
+	pass P0
+	{
+		vertexShader = compile vs_2_0 Phong_VS(1);
+		pixelShader  = compile ps_2_0 Phong_PS();
+
+		AlphaBlendEnable = true;
+	   SrcBlend = SrcAlpha;
+	   DestBlend = InvSrcAlpha;
+	}
+}
+
+technique FastFourierWavesSpareTechnique
+{
+	pass P0
+	{
+		vertexShader = compile vs_2_0 Phong_VS(2);
+		pixelShader  = compile ps_2_0 Phong_PS();
+
+		AlphaBlendEnable = true;
+	   SrcBlend = SrcAlpha;
+	   DestBlend = InvSrcAlpha;
+	}
+}
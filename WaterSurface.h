@@ -5,12 +5,13 @@
 //
 // CWaterSurface
 //       Defines a grid container class for simulating a Water Surface using
-//       Inverse Fast Fourier Transforms, Gerstner Waves and Texturing.
+//       Inverse Fast Fourier Transforms, Gerstner Waves and Texturing. The
+//       wave fields come from a COceanSimulation and are resampled onto the
+//       render grid every frame.
 // -------------------------------------------------------------------------
 #pragma once
 
 #include <string>
-#include <deque>
 #include <d3d9.h>
 #include <d3dx9.h>
 //#include <dxerr9.h>
@@ -19,17 +20,29 @@
 
 #include "Vertex.h"
 #include "AnimationObject.h"
-#include "ComplexNumber.h"
-#include "KWaveVector.h"
 #include "GerstnerWave.h"
+#include "OceanSimulation.h"
+#include "OceanBake.h"
+#include "LinearArena.h"
+#include "WaterVertexStreams.h"
+#include "D3DUploadSink.h"
 
 using namespace std;
 
+// -------------------------------------------------------------------------
+// Default render grid. The FFT resolution is set separately at runtime and
+// the height field is resampled onto the grid.
+// -------------------------------------------------------------------------
 #define WATER_SURFACE_WIDTH           64
 #define WATER_SURFACE_HEIGHT          64
 #define WATER_SURFACE_DX              10.05
 #define WATER_SURFACE_DZ              10.05 
 
+// -------------------------------------------------------------------------
+// Frames of dynamic vertices the upload ring holds.
+// -------------------------------------------------------------------------
+#define WATER_DYNAMIC_RING_FRAMES     3
+
 class CWaterSurface : public CAnimationObject
 {
 public:
@@ -46,7 +59,7 @@ public:
    // -------------------------------------------------------------------------
    // Animation Object Interface Methods
    // -------------------------------------------------------------------------
-   virtual void Update(float fCurrentTime, bool blMoveObject = false);
+   virtual void Update(double dCurrentTime, bool blMoveObject = false);
    virtual void Draw(
       D3DXMATRIX& projectionMatrix,
       D3DXMATRIX& viewMatrix);
@@ -71,6 +84,95 @@ public:
    void SetEnableGerstnerWaves(bool blValue);
    float GetEnableGerstnerWaves();
 
+   // -------------------------------------------------------------------------
+   // Scale of the horizontal displacement that sharpens wave crests. 0 turns
+   // it off and skips its two transforms.
+   // -------------------------------------------------------------------------
+   void SetChoppiness(float fValue);
+   float GetChoppiness();
+
+   // -------------------------------------------------------------------------
+   // Seed of the ocean's random spectrum. The same seed gives the same
+   // ocean on every machine, see COceanSimulation::SetSeed.
+   // -------------------------------------------------------------------------
+   void SetSeed(unsigned int nSeed);
+   unsigned int GetSeed();
+
+   // -------------------------------------------------------------------------
+   // Spectrum model, spreading and sea state, see SpectrumModel.h and
+   // COceanSimulation::SetSpectrumModel.
+   // -------------------------------------------------------------------------
+   bool SetSpectrumModel(int nModel);
+   int GetSpectrumModel();
+
+   bool SetSpreading(int nSpreading);
+   int GetSpreading();
+
+   bool SetSpectrumEvaluation(int nMode);
+   int GetSpectrumEvaluation();
+
+   void SetFetch(float fValue);
+   float GetFetch();
+
+   void SetDepth(float fValue);
+   float GetDepth();
+
+   void SetPeakEnhancement(float fValue);
+   float GetPeakEnhancement();
+
+   void SetSpreadingExponent(float fValue);
+   float GetSpreadingExponent();
+
+   // -------------------------------------------------------------------------
+   // Looping ocean and its cached frames, see
+   // COceanSimulation::SetLoopPeriod.
+   // -------------------------------------------------------------------------
+   void SetLoopPeriod(float fSeconds);
+   float GetLoopPeriod();
+
+   void SetFrameCache(int nFrames, int nFormat);
+   int GetFrameCacheFrames();
+   int GetFrameCacheFormat();
+
+   // -------------------------------------------------------------------------
+   // Plays the frames of a baked animation, see OceanBake.h, in place of the
+   // simulation; NULL goes back to simulating. Returns false, and keeps
+   // simulating, if pPath is not a bake with at least the slope maps.
+   // -------------------------------------------------------------------------
+   bool SetBakedAnimation(const char* pPath);
+   bool IsPlayingBakedAnimation();
+
+   void SetFFTThreadCount(int nThreads);
+   int GetFFTThreadCount();
+
+   // -------------------------------------------------------------------------
+   // Resolution of the simulated height field, see
+   // COceanSimulation::SetFFTSize. It can differ from the render grid.
+   // -------------------------------------------------------------------------
+   bool SetFFTSize(int nSize);
+   int GetFFTSize();
+
+   // -------------------------------------------------------------------------
+   // Encodings of the dynamic vertex stream, WATER_WAVE_* and
+   // WATER_NORMAL_*, see WaterVertexStreams.h. Returns false, and keeps the
+   // current ones, if the device has no declaration for them.
+   // -------------------------------------------------------------------------
+   bool SetVertexFormat(int nWaveFormat, int nNormalFormat);
+   int GetWaveFormat();
+   int GetNormalFormat();
+
+   // -------------------------------------------------------------------------
+   // The dynamic vertices live in a default pool buffer, which goes with a
+   // lost device and comes back, flat until the next Update, on reset.
+   // -------------------------------------------------------------------------
+   void OnLostDevice();
+   bool OnResetDevice();
+
+   // -------------------------------------------------------------------------
+   // Locks and bytes of the dynamic vertex uploads, see CUploadRing.
+   // -------------------------------------------------------------------------
+   const UploadRingStats& GetUploadStats();
+
 protected:
    //--------------------------------------------------------------------------
    // Initialization Methods
@@ -80,29 +182,18 @@ protected:
    virtual bool LoadShadingFX();
    virtual bool LoadTextureFiles();
    virtual bool CreateLighting();
-
-   //--------------------------------------------------------------------------
-   // Basically, create a wave field having the same spectrum as the ocean and
-   // then transform it to the spatial domain by an inverse Fast Fourier
-   // Transform. The Transformation will occur within the vertex shader.
-   //--------------------------------------------------------------------------
-   virtual bool LoadInitialFourierHeightMap();
-   virtual void UpdateFourierHeightMap(float fCurrentTime);
+   virtual bool CreateDynamicRing();
 
    // -------------------------------------------------------------------------
-   // Fast Fourier Helper Methods
+   // Packs a frame into the next span of the upload ring.
    // -------------------------------------------------------------------------
-   int FFT2D();
-   int FFT(int dir,int m,float *x,float *y);
-   int Powerof2(int n,int *m,int *twopm);
-   void GetGaussian(float& fGaussian1, float& fGaussian2);
-   float GetPhillipsSpectrum(KWaveVector vecKBounded);
+   bool WriteDynamicVertices(const WaterFieldFrame& frame);
 
 protected:
    // -------------------------------------------------------------------------
    // DirectX Data
    // -------------------------------------------------------------------------
-   IDirect3DVertexBuffer9* m_pVertexBuffer;
+   IDirect3DVertexBuffer9* m_pStaticVertexBuffer;
 	IDirect3DIndexBuffer9* m_pIndexBuffer;
    CFirstPersonCamera m_Camera;
 
@@ -117,27 +208,31 @@ protected:
    float m_fXSpacing;
    float m_fZSpacing;
 
-   deque<D3DXVECTOR3> m_Vertices;
-	deque<DWORD> m_Indices;
+   // -------------------------------------------------------------------------
+   // The grid's resting layout, centred on the origin, whether the
+   // dynamic stream was last written in the choppy layout, its packer and
+   // the constants the shader decodes the last frame with.
+   // -------------------------------------------------------------------------
+   WaterGridLayout m_GridLayout;
+   bool m_blChoppyVertices;
+   CWaterVertexPacker m_VertexPacker;
+   WaterDynamicConstants m_DynamicConstants;
 
    // -------------------------------------------------------------------------
-   // Water Parameters
+   // The dynamic stream's buffer, the ring that streams each frame into it
+   // and where the last frame starts, -1 when there is none.
    // -------------------------------------------------------------------------
-   float m_fXWindSpeed;
-   float m_fZWindSpeed;
-   float m_fPhillipsConstant;
-   float m_fGravityConstant;
+   CD3DUploadSink m_DynamicSink;
+   CUploadRing m_DynamicRing;
+   int m_nDynamicOffset;
 
-protected:
    // -------------------------------------------------------------------------
-   // Fourier Height Map Data (Computed at each iteration).
-   // -------------------------------------------------------------------------   
-   ComplexNumber m_InitialHeightMap[WATER_SURFACE_WIDTH][WATER_SURFACE_HEIGHT];
-   ComplexNumber m_FourierHeightMap[WATER_SURFACE_WIDTH][WATER_SURFACE_HEIGHT];
-   float m_VertexHeightMap[WATER_SURFACE_WIDTH][WATER_SURFACE_HEIGHT];
+   // Wave spectrum, its FFT and the resulting spatial fields.
+   // -------------------------------------------------------------------------
+   COceanSimulation m_Ocean;
+   COceanBakeReader m_BakedAnimation;
 
-   KWaveVector m_KWaveVectors[WATER_SURFACE_WIDTH][WATER_SURFACE_HEIGHT];
-   float m_AngularFreqs[WATER_SURFACE_WIDTH][WATER_SURFACE_HEIGHT];
+protected:
 
 protected:
    // -------------------------------------------------------------------------
@@ -155,8 +250,12 @@ protected:
    ID3DXEffect* m_pFX;
 	D3DXHANDLE m_hParam_WVP;
    D3DXHANDLE m_hParam_WorldInverseTranspose;
-   D3DXHANDLE m_hParam_FastFourierWavesTechnique;
+   D3DXHANDLE m_ahFastFourierWavesTechniques[WATER_NORMAL_DECODE_COUNT];
    D3DXHANDLE m_hParam_Time;
+   D3DXHANDLE m_hParam_WaveScale;
+   D3DXHANDLE m_hParam_WaveBias;
+   D3DXHANDLE m_hParam_NormalScaleBias;
+   D3DXHANDLE m_hParam_SpareMask;
    
    //--------------------------------------------------------------------------
    // Lighting
@@ -0,0 +1,644 @@
+#include <math.h>
+#include <string.h>
+#include "WaterVertexStreams.h"
+#include "CpuFeatures.h"
+
+// -------------------------------------------------------------------------
+// Planes of the row scratch: the floats of a row's vertices, and their
+// encodings, the three wave components first.
+// -------------------------------------------------------------------------
+#define WATER_ROW_HEIGHT               0
+#define WATER_ROW_OFFSET_X             1
+#define WATER_ROW_OFFSET_Z             2
+#define WATER_ROW_NORMAL_X             3
+#define WATER_ROW_NORMAL_Y             4
+#define WATER_ROW_NORMAL_Z             5
+#define WATER_ROW_OCTAHEDRAL_U         6
+#define WATER_ROW_OCTAHEDRAL_V         7
+#define WATER_ROW_COUNT                8
+
+#define WATER_WORDS_WAVE               0
+#define WATER_WORDS_OCTAHEDRAL_U       3
+#define WATER_WORDS_OCTAHEDRAL_V       4
+#define WATER_WORDS_OCTAHEDRAL_8       5
+#define WATER_WORDS_COLOR              6
+#define WATER_WORDS_COUNT              7
+
+#define WATER_INT16_MAX                32767
+#define WATER_RADIANS_TO_DEGREES       57.295779513082320876f
+
+bool IsWaterFrameChoppy(const WaterFieldFrame& frame)
+{
+   return frame.nFields == OCEAN_FIELD_COUNT && frame.fChoppiness != 0.0f;
+}
+
+void GetWaterDynamicLayout(int nWaveFormat, int nNormalFormat, bool blChoppy, WaterDynamicLayout& layout)
+{
+   int nWaveSize = 0;
+
+   switch (nWaveFormat)
+   {
+      case WATER_WAVE_FLOAT16:
+         layout.nWaveElement = blChoppy ? WATER_ELEMENT_FLOAT16_4 : WATER_ELEMENT_FLOAT16_2;
+         nWaveSize = blChoppy ? 8 : 4;
+         break;
+
+      case WATER_WAVE_INT16:
+         layout.nWaveElement = blChoppy ? WATER_ELEMENT_SHORT4 : WATER_ELEMENT_SHORT2;
+         nWaveSize = blChoppy ? 8 : 4;
+         break;
+
+      default:
+         layout.nWaveElement = blChoppy ? WATER_ELEMENT_FLOAT3 : WATER_ELEMENT_FLOAT1;
+         nWaveSize = blChoppy ? 12 : 4;
+         break;
+   }
+
+   layout.nNormalOffset = nWaveSize;
+   layout.nSize = nWaveSize + 4;
+
+   switch (nNormalFormat)
+   {
+      case WATER_NORMAL_OCT16:
+         layout.nNormalElement = WATER_ELEMENT_SHORT2N;
+         break;
+
+      case WATER_NORMAL_OCT8:
+         if (nWaveFormat == WATER_WAVE_INT16)
+         {
+            layout.nNormalElement = WATER_ELEMENT_NONE;
+            layout.nSize = nWaveSize;
+         }
+         else
+         {
+            layout.nNormalElement = WATER_ELEMENT_UBYTE4N;
+         }
+         break;
+
+      default:
+         layout.nNormalElement = WATER_ELEMENT_D3DCOLOR;
+         break;
+   }
+}
+
+void PackWaterStaticVertices(const WaterGridLayout& grid, float fTexScale, WaterStaticVertex* pOutput)
+{
+   int k = 0;
+   for (int i = 0; i < grid.nRows; i++)
+   {
+      // -------------------------------------------------------------------------
+      // Negate the depth coordinate to put in quadrant four.
+      // Then offset to center about coordinate system.
+      // -------------------------------------------------------------------------
+      float fRestZ = -(float)i * grid.fZSpacing + grid.fZOffset;
+
+      for (int j = 0; j < grid.nColumns; j++, k++)
+      {
+         pOutput[k].fRestX = (float)j * grid.fXSpacing + grid.fXOffset;
+         pOutput[k].fRestZ = fRestZ;
+         pOutput[k].fTexU = (float)j * fTexScale;
+         pOutput[k].fTexV = (float)i * fTexScale;
+      }
+   }
+}
+
+// -------------------------------------------------------------------------
+// The unit vector with octahedral coordinates (u, v), as the shader
+// decodes it.
+// -------------------------------------------------------------------------
+static void DecodeOctahedral(float u, float v, float afNormal[3])
+{
+   float x = u;
+   float y = 1.0f - fabsf(u) - fabsf(v);
+   float z = v;
+
+   if (y < 0.0f)
+   {
+      x = (u < 0.0f) ? -(1.0f - fabsf(v)) : (1.0f - fabsf(v));
+      z = (v < 0.0f) ? -(1.0f - fabsf(u)) : (1.0f - fabsf(u));
+   }
+
+   float fInverseLength = 1.0f / sqrtf(x * x + y * y + z * z);
+   afNormal[0] = x * fInverseLength;
+   afNormal[1] = y * fInverseLength;
+   afNormal[2] = z * fInverseLength;
+}
+
+CWaterVertexPacker::CWaterVertexPacker()
+{
+   memset(&m_Grid, 0, sizeof(m_Grid));
+   m_nWaveFormat = WATER_WAVE_FLOAT32;
+   m_nNormalFormat = WATER_NORMAL_COLOR;
+   m_nWordPitch = 0;
+   GetWaterPackKernels(SIMD_LEVEL_SCALAR, m_Kernels);
+}
+
+CWaterVertexPacker::~CWaterVertexPacker()
+{
+}
+
+bool CWaterVertexPacker::Init(const WaterGridLayout& grid)
+{
+   m_Grid = grid;
+   GetWaterPackKernels(GetSimdLevel(), m_Kernels);
+
+   if (!m_RowValues.Allocate(WATER_ROW_COUNT, grid.nColumns))
+   {
+      return false;
+   }
+
+   m_nWordPitch = 2 * m_RowValues.GetPitch();
+
+   return m_RowWords.Allocate(WATER_WORDS_COUNT * m_nWordPitch) &&
+          m_RowVertices.Allocate(grid.nColumns * WATER_DYNAMIC_VERTEX_MAX_SIZE);
+}
+
+bool CWaterVertexPacker::SetFormat(int nWaveFormat, int nNormalFormat)
+{
+   if (nWaveFormat < 0 || nWaveFormat >= WATER_WAVE_FORMAT_COUNT ||
+       nNormalFormat < 0 || nNormalFormat >= WATER_NORMAL_FORMAT_COUNT)
+   {
+      return false;
+   }
+
+   m_nWaveFormat = nWaveFormat;
+   m_nNormalFormat = nNormalFormat;
+   return true;
+}
+
+int CWaterVertexPacker::GetWaveFormat() const
+{
+   return m_nWaveFormat;
+}
+
+int CWaterVertexPacker::GetNormalFormat() const
+{
+   return m_nNormalFormat;
+}
+
+void CWaterVertexPacker::SampleRow(const WaterFieldFrame& frame, int nRow)
+{
+   float afFields[OCEAN_FIELD_COUNT] = { 0.0f };
+
+   float* pHeight = m_RowValues.GetRow(WATER_ROW_HEIGHT);
+   float* pOffsetX = m_RowValues.GetRow(WATER_ROW_OFFSET_X);
+   float* pOffsetZ = m_RowValues.GetRow(WATER_ROW_OFFSET_Z);
+   float* pNormalX = m_RowValues.GetRow(WATER_ROW_NORMAL_X);
+   float* pNormalY = m_RowValues.GetRow(WATER_ROW_NORMAL_Y);
+   float* pNormalZ = m_RowValues.GetRow(WATER_ROW_NORMAL_Z);
+
+   // -------------------------------------------------------------------------
+   // The simulated patch spans the whole grid. When the two resolutions
+   // match, every vertex sits exactly on a height sample.
+   // -------------------------------------------------------------------------
+   bool blSameResolution = (frame.nWidth == m_Grid.nRows && frame.nHeight == m_Grid.nColumns);
+   float fXStep = (float)frame.nWidth / (float)m_Grid.nRows;
+   float fZStep = (float)frame.nHeight / (float)m_Grid.nColumns;
+
+   // -------------------------------------------------------------------------
+   // World distance between neighbouring FFT samples, to turn the per-sample
+   // slopes into world slopes. FFT x runs along world -z and FFT z along
+   // world +x.
+   // -------------------------------------------------------------------------
+   float fSampleDX = m_Grid.fXSpacing * (float)m_Grid.nColumns / (float)frame.nHeight;
+   float fSampleDZ = m_Grid.fZSpacing * (float)m_Grid.nRows / (float)frame.nWidth;
+
+   for (int nZIndex = 0; nZIndex < m_Grid.nColumns; nZIndex++)
+   {
+      for (int f = 0; f < frame.nFields; f++)
+      {
+         if (blSameResolution)
+         {
+            afFields[f] = frame.apMaps[f][nRow * frame.nHeight + nZIndex];
+         }
+         else
+         {
+            afFields[f] = COceanSimulation::SampleMap(frame.apMaps[f], frame.nWidth, frame.nHeight, nRow * fXStep, nZIndex * fZStep);
+         }
+      }
+
+      // -------------------------------------------------------------------------
+      // The surface normal is (-dh/dx, 1, -dh/dz) in world axes.
+      // -------------------------------------------------------------------------
+      float fNormalX = -afFields[OCEAN_FIELD_SLOPE_Z] / fSampleDX;
+      float fNormalZ = afFields[OCEAN_FIELD_SLOPE_X] / fSampleDZ;
+      float fInverseLength = 1.0f / sqrtf(fNormalX * fNormalX + 1.0f + fNormalZ * fNormalZ);
+
+      // -------------------------------------------------------------------------
+      // Choppy waves: pull each vertex horizontally towards the crests.
+      // -------------------------------------------------------------------------
+      pHeight[nZIndex] = afFields[OCEAN_FIELD_HEIGHT];
+      pOffsetX[nZIndex] = frame.fChoppiness * afFields[OCEAN_FIELD_DISPLACEMENT_Z];
+      pOffsetZ[nZIndex] = -frame.fChoppiness * afFields[OCEAN_FIELD_DISPLACEMENT_X];
+      pNormalX[nZIndex] = fNormalX * fInverseLength;
+      pNormalY[nZIndex] = fInverseLength;
+      pNormalZ[nZIndex] = fNormalZ * fInverseLength;
+   }
+}
+
+void CWaterVertexPacker::SetWaveRange(int nComponent, float fMin, float fMax, WaterDynamicConstants& constants)
+{
+   // -------------------------------------------------------------------------
+   // Spread the range over the whole 16 bits, centred on the bias.
+   // -------------------------------------------------------------------------
+   constants.afWaveBias[nComponent] = 0.5f * (fMin + fMax);
+   constants.afWaveScale[nComponent] = (fMax - fMin) / (2.0f * WATER_INT16_MAX);
+}
+
+void CWaterVertexPacker::EncodeRow(bool blChoppy, const WaterDynamicConstants& constants)
+{
+   int nCount = m_Grid.nColumns;
+   int nComponents = blChoppy ? 3 : 1;
+
+   for (int k = 0; k < nComponents; k++)
+   {
+      const float* pValues = m_RowValues.GetRow(WATER_ROW_HEIGHT + k);
+      unsigned short* pWords = m_RowWords.GetData() + (WATER_WORDS_WAVE + k) * m_nWordPitch;
+
+      if (m_nWaveFormat == WATER_WAVE_FLOAT16)
+      {
+         m_Kernels.pfnFloatToHalf(pValues, nCount, pWords);
+      }
+      else if (m_nWaveFormat == WATER_WAVE_INT16)
+      {
+         float fScale = constants.afWaveScale[k];
+         float fInverseScale = (fScale > 0.0f) ? 1.0f / fScale : 0.0f;
+
+         m_Kernels.pfnQuantize(pValues, nCount, constants.afWaveBias[k], fInverseScale,
+            -(float)WATER_INT16_MAX, (float)WATER_INT16_MAX, (short*)pWords);
+      }
+   }
+
+   const float* pNormalX = m_RowValues.GetRow(WATER_ROW_NORMAL_X);
+   const float* pNormalY = m_RowValues.GetRow(WATER_ROW_NORMAL_Y);
+   const float* pNormalZ = m_RowValues.GetRow(WATER_ROW_NORMAL_Z);
+
+   if (m_nNormalFormat == WATER_NORMAL_COLOR)
+   {
+      m_Kernels.pfnNormalColor(pNormalX, pNormalY, pNormalZ, nCount,
+         (unsigned int*)(m_RowWords.GetData() + WATER_WORDS_COLOR * m_nWordPitch));
+      return;
+   }
+
+   float* pU = m_RowValues.GetRow(WATER_ROW_OCTAHEDRAL_U);
+   float* pV = m_RowValues.GetRow(WATER_ROW_OCTAHEDRAL_V);
+   short* pWordsU = (short*)(m_RowWords.GetData() + WATER_WORDS_OCTAHEDRAL_U * m_nWordPitch);
+   short* pWordsV = (short*)(m_RowWords.GetData() + WATER_WORDS_OCTAHEDRAL_V * m_nWordPitch);
+
+   m_Kernels.pfnOctahedral(pNormalX, pNormalY, pNormalZ, nCount, pU, pV);
+
+   if (m_nNormalFormat == WATER_NORMAL_OCT16)
+   {
+      m_Kernels.pfnQuantize(pU, nCount, 0.0f, (float)WATER_INT16_MAX, -(float)WATER_INT16_MAX, (float)WATER_INT16_MAX, pWordsU);
+      m_Kernels.pfnQuantize(pV, nCount, 0.0f, (float)WATER_INT16_MAX, -(float)WATER_INT16_MAX, (float)WATER_INT16_MAX, pWordsV);
+      return;
+   }
+
+   // -------------------------------------------------------------------------
+   // 8 bits: [-1, 1] to [0, 255], u in the low byte and v in the high one.
+   // -------------------------------------------------------------------------
+   unsigned short* pBytes = m_RowWords.GetData() + WATER_WORDS_OCTAHEDRAL_8 * m_nWordPitch;
+
+   m_Kernels.pfnQuantize(pU, nCount, -1.0f, 127.5f, 0.0f, 255.0f, pWordsU);
+   m_Kernels.pfnQuantize(pV, nCount, -1.0f, 127.5f, 0.0f, 255.0f, pWordsV);
+
+   for (int i = 0; i < nCount; i++)
+   {
+      pBytes[i] = (unsigned short)(pWordsU[i] | (pWordsV[i] << 8));
+   }
+}
+
+int CWaterVertexPacker::Pack(const WaterFieldFrame& frame, void* pOutput, WaterDynamicConstants& constants)
+{
+   bool blChoppy = IsWaterFrameChoppy(frame);
+
+   WaterDynamicLayout layout;
+   GetWaterDynamicLayout(m_nWaveFormat, m_nNormalFormat, blChoppy, layout);
+
+   // -------------------------------------------------------------------------
+   // Wave decoding. Without choppiness the offsets' scale is 0, which also
+   // hides whatever is in the spare component.
+   // -------------------------------------------------------------------------
+   for (int k = 0; k < 3; k++)
+   {
+      constants.afWaveScale[k] = (k == 0 || blChoppy) ? 1.0f : 0.0f;
+      constants.afWaveBias[k] = 0.0f;
+   }
+
+   if (m_nWaveFormat == WATER_WAVE_INT16)
+   {
+      int nPoints = frame.nWidth * frame.nHeight;
+      float fMin = 0.0f;
+      float fMax = 0.0f;
+
+      // -------------------------------------------------------------------------
+      // Resampled vertices stay within the range of the samples, so the
+      // maps' ranges are the frame's. The offsets are the displacements
+      // times the choppiness.
+      // -------------------------------------------------------------------------
+      if (frame.nFields > 0)
+      {
+         m_Kernels.pfnRange(frame.apMaps[OCEAN_FIELD_HEIGHT], nPoints, fMin, fMax);
+      }
+      SetWaveRange(0, fMin, fMax, constants);
+
+      if (blChoppy)
+      {
+         m_Kernels.pfnRange(frame.apMaps[OCEAN_FIELD_DISPLACEMENT_Z], nPoints, fMin, fMax);
+         float fLow = frame.fChoppiness * fMin;
+         float fHigh = frame.fChoppiness * fMax;
+         SetWaveRange(1, (fLow < fHigh) ? fLow : fHigh, (fLow < fHigh) ? fHigh : fLow, constants);
+
+         m_Kernels.pfnRange(frame.apMaps[OCEAN_FIELD_DISPLACEMENT_X], nPoints, fMin, fMax);
+         fLow = -frame.fChoppiness * fMin;
+         fHigh = -frame.fChoppiness * fMax;
+         SetWaveRange(2, (fLow < fHigh) ? fLow : fHigh, (fLow < fHigh) ? fHigh : fLow, constants);
+      }
+   }
+
+   // -------------------------------------------------------------------------
+   // Normal decoding.
+   // -------------------------------------------------------------------------
+   for (int k = 0; k < 4; k++)
+   {
+      constants.afSpareMask[k] = 0.0f;
+   }
+
+   if (m_nNormalFormat == WATER_NORMAL_COLOR)
+   {
+      constants.nNormalDecode = WATER_NORMAL_DECODE_VECTOR;
+      constants.fNormalScale = 2.0f;
+      constants.fNormalBias = -1.0f;
+   }
+   else if (m_nNormalFormat == WATER_NORMAL_OCT16)
+   {
+      constants.nNormalDecode = WATER_NORMAL_DECODE_OCTAHEDRAL;
+      constants.fNormalScale = 1.0f;
+      constants.fNormalBias = 0.0f;
+   }
+   else if (layout.nNormalElement == WATER_ELEMENT_NONE)
+   {
+      constants.nNormalDecode = WATER_NORMAL_DECODE_SPARE;
+      constants.fNormalScale = 1.0f / 127.5f;
+      constants.fNormalBias = -1.0f;
+      constants.afSpareMask[blChoppy ? 3 : 1] = 1.0f;
+   }
+   else
+   {
+      constants.nNormalDecode = WATER_NORMAL_DECODE_OCTAHEDRAL;
+      constants.fNormalScale = 2.0f;
+      constants.fNormalBias = -1.0f;
+   }
+
+   // -------------------------------------------------------------------------
+   // Where each 16-bit word of a vertex comes from: a plane of the row
+   // scratch, read every nStep words, or nowhere for a zero.
+   // -------------------------------------------------------------------------
+   const unsigned short* apSources[WATER_DYNAMIC_VERTEX_MAX_SIZE / 2] = { 0 };
+   int anSteps[WATER_DYNAMIC_VERTEX_MAX_SIZE / 2] = { 0 };
+   int nWords = layout.nSize / 2;
+   int nComponents = blChoppy ? 3 : 1;
+
+   for (int k = 0; k < nComponents; k++)
+   {
+      if (m_nWaveFormat == WATER_WAVE_FLOAT32)
+      {
+         const unsigned short* pFloats = (const unsigned short*)m_RowValues.GetRow(WATER_ROW_HEIGHT + k);
+         apSources[2 * k] = pFloats;
+         apSources[2 * k + 1] = pFloats + 1;
+         anSteps[2 * k] = 2;
+         anSteps[2 * k + 1] = 2;
+      }
+      else
+      {
+         apSources[k] = m_RowWords.GetData() + (WATER_WORDS_WAVE + k) * m_nWordPitch;
+         anSteps[k] = 1;
+      }
+   }
+
+   int nNormalWord = layout.nNormalOffset / 2;
+
+   switch (layout.nNormalElement)
+   {
+      case WATER_ELEMENT_NONE:
+         apSources[blChoppy ? 3 : 1] = m_RowWords.GetData() + WATER_WORDS_OCTAHEDRAL_8 * m_nWordPitch;
+         anSteps[blChoppy ? 3 : 1] = 1;
+         break;
+
+      case WATER_ELEMENT_D3DCOLOR:
+         apSources[nNormalWord] = m_RowWords.GetData() + WATER_WORDS_COLOR * m_nWordPitch;
+         apSources[nNormalWord + 1] = apSources[nNormalWord] + 1;
+         anSteps[nNormalWord] = 2;
+         anSteps[nNormalWord + 1] = 2;
+         break;
+
+      case WATER_ELEMENT_SHORT2N:
+         apSources[nNormalWord] = m_RowWords.GetData() + WATER_WORDS_OCTAHEDRAL_U * m_nWordPitch;
+         apSources[nNormalWord + 1] = m_RowWords.GetData() + WATER_WORDS_OCTAHEDRAL_V * m_nWordPitch;
+         anSteps[nNormalWord] = 1;
+         anSteps[nNormalWord + 1] = 1;
+         break;
+
+      case WATER_ELEMENT_UBYTE4N:
+         apSources[nNormalWord] = m_RowWords.GetData() + WATER_WORDS_OCTAHEDRAL_8 * m_nWordPitch;
+         anSteps[nNormalWord] = 1;
+         break;
+   }
+
+   // -------------------------------------------------------------------------
+   // Row by row: sample, encode, interleave in the scratch and copy the
+   // row out in one go, so the vertex buffer only sees whole sequential
+   // writes.
+   // -------------------------------------------------------------------------
+   int nCount = m_Grid.nColumns;
+   int nRowBytes = nCount * layout.nSize;
+   unsigned short* pRow = (unsigned short*)m_RowVertices.GetData();
+
+   for (int nRow = 0; nRow < m_Grid.nRows; nRow++)
+   {
+      SampleRow(frame, nRow);
+      EncodeRow(blChoppy, constants);
+
+      for (int w = 0; w < nWords; w++)
+      {
+         const unsigned short* pSource = apSources[w];
+         int nStep = anSteps[w];
+
+         if (pSource == NULL)
+         {
+            for (int i = 0; i < nCount; i++)
+            {
+               pRow[i * nWords + w] = 0;
+            }
+         }
+         else
+         {
+            for (int i = 0; i < nCount; i++)
+            {
+               pRow[i * nWords + w] = pSource[i * nStep];
+            }
+         }
+      }
+
+      memcpy((unsigned char*)pOutput + nRow * nRowBytes, pRow, nRowBytes);
+   }
+
+   return m_Grid.nRows * nRowBytes;
+}
+
+void CWaterVertexPacker::MeasureError(const WaterFieldFrame& frame,
+                                      const void* pPacked,
+                                      const WaterDynamicConstants& constants,
+                                      WaterPackingError& error)
+{
+   bool blChoppy = IsWaterFrameChoppy(frame);
+
+   WaterDynamicLayout layout;
+   GetWaterDynamicLayout(m_nWaveFormat, m_nNormalFormat, blChoppy, layout);
+
+   double dSquares = 0.0;
+   memset(&error, 0, sizeof(error));
+
+   const unsigned char* pVertex = (const unsigned char*)pPacked;
+
+   for (int nRow = 0; nRow < m_Grid.nRows; nRow++)
+   {
+      SampleRow(frame, nRow);
+
+      for (int i = 0; i < m_Grid.nColumns; i++, pVertex += layout.nSize)
+      {
+         // -------------------------------------------------------------------------
+         // The wave element as the vertex shader receives it.
+         // -------------------------------------------------------------------------
+         float afWave[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+         int nWaveComponents = 0;
+
+         switch (layout.nWaveElement)
+         {
+            case WATER_ELEMENT_FLOAT1:
+            case WATER_ELEMENT_FLOAT3:
+               nWaveComponents = (layout.nWaveElement == WATER_ELEMENT_FLOAT3) ? 3 : 1;
+               memcpy(afWave, pVertex, nWaveComponents * sizeof(float));
+               break;
+
+            case WATER_ELEMENT_FLOAT16_2:
+            case WATER_ELEMENT_FLOAT16_4:
+               nWaveComponents = (layout.nWaveElement == WATER_ELEMENT_FLOAT16_4) ? 4 : 2;
+               for (int k = 0; k < nWaveComponents; k++)
+               {
+                  unsigned short nHalf;
+                  memcpy(&nHalf, pVertex + 2 * k, sizeof(nHalf));
+                  afWave[k] = HalfToFloat(nHalf);
+               }
+               break;
+
+            case WATER_ELEMENT_SHORT2:
+            case WATER_ELEMENT_SHORT4:
+               nWaveComponents = (layout.nWaveElement == WATER_ELEMENT_SHORT4) ? 4 : 2;
+               for (int k = 0; k < nWaveComponents; k++)
+               {
+                  short nValue;
+                  memcpy(&nValue, pVertex + 2 * k, sizeof(nValue));
+                  afWave[k] = (float)nValue;
+               }
+               break;
+         }
+
+         float afDecoded[3];
+         for (int k = 0; k < 3; k++)
+         {
+            afDecoded[k] = afWave[k] * constants.afWaveScale[k] + constants.afWaveBias[k];
+         }
+
+         float fHeightError = fabsf(afDecoded[0] - m_RowValues.GetRow(WATER_ROW_HEIGHT)[i]);
+         error.fMaxHeightError = (fHeightError > error.fMaxHeightError) ? fHeightError : error.fMaxHeightError;
+         dSquares += (double)fHeightError * fHeightError;
+
+         if (blChoppy)
+         {
+            for (int k = 1; k < 3; k++)
+            {
+               float fOffsetError = fabsf(afDecoded[k] - m_RowValues.GetRow(WATER_ROW_HEIGHT + k)[i]);
+               error.fMaxOffsetError = (fOffsetError > error.fMaxOffsetError) ? fOffsetError : error.fMaxOffsetError;
+            }
+         }
+
+         // -------------------------------------------------------------------------
+         // The normal element, or the spare component's two bytes.
+         // -------------------------------------------------------------------------
+         const unsigned char* pNormal = pVertex + layout.nNormalOffset;
+         float afStored[3] = { 0.0f, 0.0f, 0.0f };
+
+         switch (layout.nNormalElement)
+         {
+            case WATER_ELEMENT_D3DCOLOR:
+            {
+               unsigned int nColor;
+               memcpy(&nColor, pNormal, sizeof(nColor));
+               afStored[0] = (float)((nColor >> 16) & 0xFF) / 255.0f;
+               afStored[1] = (float)((nColor >> 8) & 0xFF) / 255.0f;
+               afStored[2] = (float)(nColor & 0xFF) / 255.0f;
+               break;
+            }
+
+            case WATER_ELEMENT_SHORT2N:
+               for (int k = 0; k < 2; k++)
+               {
+                  short nValue;
+                  memcpy(&nValue, pNormal + 2 * k, sizeof(nValue));
+                  afStored[k] = (float)nValue / (float)WATER_INT16_MAX;
+                  afStored[k] = (afStored[k] > -1.0f) ? afStored[k] : -1.0f;
+               }
+               break;
+
+            case WATER_ELEMENT_UBYTE4N:
+               afStored[0] = (float)pNormal[0] / 255.0f;
+               afStored[1] = (float)pNormal[1] / 255.0f;
+               break;
+
+            case WATER_ELEMENT_NONE:
+            {
+               float fSpare = 0.0f;
+               for (int k = 0; k < 4; k++)
+               {
+                  fSpare += afWave[k] * constants.afSpareMask[k];
+               }
+
+               fSpare += (fSpare < 0.0f) ? 65536.0f : 0.0f;
+               afStored[1] = floorf(fSpare / 256.0f);
+               afStored[0] = fSpare - afStored[1] * 256.0f;
+               break;
+            }
+         }
+
+         float afNormal[3];
+         for (int k = 0; k < 3; k++)
+         {
+            afNormal[k] = afStored[k] * constants.fNormalScale + constants.fNormalBias;
+         }
+
+         if (constants.nNormalDecode == WATER_NORMAL_DECODE_VECTOR)
+         {
+            float fInverseLength = 1.0f / sqrtf(afNormal[0] * afNormal[0] + afNormal[1] * afNormal[1] + afNormal[2] * afNormal[2]);
+            for (int k = 0; k < 3; k++)
+            {
+               afNormal[k] *= fInverseLength;
+            }
+         }
+         else
+         {
+            DecodeOctahedral(afNormal[0], afNormal[1], afNormal);
+         }
+
+         float fCosine =
+            afNormal[0] * m_RowValues.GetRow(WATER_ROW_NORMAL_X)[i] +
+            afNormal[1] * m_RowValues.GetRow(WATER_ROW_NORMAL_Y)[i] +
+            afNormal[2] * m_RowValues.GetRow(WATER_ROW_NORMAL_Z)[i];
+         float fDegrees = acosf((fCosine < 1.0f) ? fCosine : 1.0f) * WATER_RADIANS_TO_DEGREES;
+         error.fMaxNormalDegrees = (fDegrees > error.fMaxNormalDegrees) ? fDegrees : error.fMaxNormalDegrees;
+      }
+   }
+
+   int nVertices = m_Grid.nRows * m_Grid.nColumns;
+   error.fRmsHeightError = (nVertices > 0) ? (float)sqrt(dSquares / nVertices) : 0.0f;
+}
@@ -0,0 +1,238 @@
+// -------------------------------------------------------------------------
+// Sean Janis
+// spjanis@gmail.com
+// Water Simulations
+//
+// WaterVertexStreams
+//       CPU side of the water surface's two vertex streams. Stream 0 holds
+//       what never changes, each vertex's resting x and z and its texture
+//       coordinates, and is written once. Stream 1 holds what the waves
+//       move: the height, with the choppy horizontal offsets when there are
+//       any, and the normal. Only stream 1 is written every frame.
+//
+//       Stream 1 has a wave element and a normal element, each in one of a
+//       few encodings:
+//
+//          wave     WATER_WAVE_FLOAT32   floats
+//                   WATER_WAVE_FLOAT16   IEEE half floats
+//                   WATER_WAVE_INT16     shorts, with a scale and bias per
+//                                        frame and component
+//          normal   WATER_NORMAL_COLOR   x, y and z in a D3DCOLOR
+//                   WATER_NORMAL_OCT16   octahedral, 2 x 16 bits
+//                   WATER_NORMAL_OCT8    octahedral, 2 x 8 bits
+//
+//       Vertex elements come in multiples of 4 bytes, so the 16-bit wave
+//       encodings leave a spare 16 bits: an 8-bit octahedral normal rides
+//       in it with WATER_WAVE_INT16 and needs no element of its own. Bytes
+//       per vertex, without and with choppiness:
+//
+//                      COLOR    OCT16    OCT8
+//             FLOAT32  8, 16    8, 16    8, 16
+//             FLOAT16  8, 12    8, 12    8, 12
+//             INT16    8, 12    8, 12    4, 8
+//
+//       against the 32 of a whole CVertex. The shader decodes any of them
+//       from the WaterDynamicConstants of the frame.
+//
+//       Nothing here touches Direct3D: the packer writes into any memory,
+//       a locked vertex buffer or a plain array, so it runs headless, and
+//       MeasureError decodes what it wrote the way the shader does.
+// -------------------------------------------------------------------------
+#pragma once
+
+#include "OceanSimulation.h"
+#include "Field2D.h"
+#include "WaterPackKernels.h"
+
+#define WATER_WAVE_FLOAT32             0
+#define WATER_WAVE_FLOAT16             1
+#define WATER_WAVE_INT16               2
+#define WATER_WAVE_FORMAT_COUNT        3
+
+#define WATER_NORMAL_COLOR             0
+#define WATER_NORMAL_OCT16             1
+#define WATER_NORMAL_OCT8              2
+#define WATER_NORMAL_FORMAT_COUNT      3
+
+#define WATER_DYNAMIC_VERTEX_MAX_SIZE  16
+
+// -------------------------------------------------------------------------
+// Vertex element types of stream 1, named after the D3DDECLTYPE each maps
+// to. NONE marks a normal kept in the wave element's spare component.
+// -------------------------------------------------------------------------
+#define WATER_ELEMENT_NONE             0
+#define WATER_ELEMENT_FLOAT1           1
+#define WATER_ELEMENT_FLOAT3           2
+#define WATER_ELEMENT_FLOAT16_2        3
+#define WATER_ELEMENT_FLOAT16_4        4
+#define WATER_ELEMENT_SHORT2           5
+#define WATER_ELEMENT_SHORT4           6
+#define WATER_ELEMENT_D3DCOLOR         7
+#define WATER_ELEMENT_SHORT2N          8
+#define WATER_ELEMENT_UBYTE4N          9
+
+// -------------------------------------------------------------------------
+// How the shader gets the normal: straight from the normal element, from
+// octahedral coordinates in it, or from octahedral bytes in the wave
+// element's spare component. Each has its own technique in
+// WaterSurface.fx.
+// -------------------------------------------------------------------------
+#define WATER_NORMAL_DECODE_VECTOR     0
+#define WATER_NORMAL_DECODE_OCTAHEDRAL 1
+#define WATER_NORMAL_DECODE_SPARE      2
+#define WATER_NORMAL_DECODE_COUNT      3
+
+// -------------------------------------------------------------------------
+// Stream 0, one per grid vertex.
+// -------------------------------------------------------------------------
+struct WaterStaticVertex
+{
+   float fRestX;
+   float fRestZ;
+   float fTexU;
+   float fTexV;
+};
+
+// -------------------------------------------------------------------------
+// Stream 1: nSize bytes a vertex, the wave element first, then the normal
+// element at nNormalOffset unless it is WATER_ELEMENT_NONE. The wave
+// element holds the height, then with choppiness the x and z offsets;
+// components a declaration adds or leaves spare read as 0.
+// -------------------------------------------------------------------------
+struct WaterDynamicLayout
+{
+   int nSize;
+   int nWaveElement;
+   int nNormalElement;
+   int nNormalOffset;
+};
+
+// -------------------------------------------------------------------------
+// What the shader needs to decode a frame of stream 1: the height and the
+// x and z offsets are wave.xyz * afWaveScale + afWaveBias, and the normal
+// or its octahedral coordinates are the stored values * fNormalScale +
+// fNormalBias, the spare component being dot(wave, afSpareMask).
+// -------------------------------------------------------------------------
+struct WaterDynamicConstants
+{
+   float afWaveScale[3];
+   float afWaveBias[3];
+   int nNormalDecode;
+   float fNormalScale;
+   float fNormalBias;
+   float afSpareMask[4];
+};
+
+// -------------------------------------------------------------------------
+// The render grid: nRows rows of nColumns vertices, row i and column j
+// resting at (j * fXSpacing + fXOffset, 0, -i * fZSpacing + fZOffset).
+// -------------------------------------------------------------------------
+struct WaterGridLayout
+{
+   int nRows;
+   int nColumns;
+   float fXSpacing;
+   float fZSpacing;
+   float fXOffset;
+   float fZOffset;
+};
+
+// -------------------------------------------------------------------------
+// One frame of wave fields, nFields maps of nWidth rows of nHeight
+// samples in OCEAN_FIELD_* order, as COceanSimulation::GetField or a
+// baked frame hands them out. The maps span the whole grid whatever
+// their resolution. Fewer than OCEAN_FIELD_COUNT maps means no
+// choppiness; none at all gives a flat surface.
+// -------------------------------------------------------------------------
+struct WaterFieldFrame
+{
+   const float* apMaps[OCEAN_FIELD_COUNT];
+   int nWidth;
+   int nHeight;
+   int nFields;
+   float fChoppiness;
+};
+
+// -------------------------------------------------------------------------
+// Differences between decoded vertices and the floats they were packed
+// from: heights and offsets in world units, normals in degrees.
+// -------------------------------------------------------------------------
+struct WaterPackingError
+{
+   float fMaxHeightError;
+   float fRmsHeightError;
+   float fMaxOffsetError;
+   float fMaxNormalDegrees;
+};
+
+// -------------------------------------------------------------------------
+// Whether a frame needs the x and z offsets in stream 1.
+// -------------------------------------------------------------------------
+bool IsWaterFrameChoppy(const WaterFieldFrame& frame);
+
+void GetWaterDynamicLayout(int nWaveFormat, int nNormalFormat, bool blChoppy, WaterDynamicLayout& layout);
+
+// -------------------------------------------------------------------------
+// Writes stream 0, nRows * nColumns vertices row by row, texture
+// coordinates (j, i) * fTexScale.
+// -------------------------------------------------------------------------
+void PackWaterStaticVertices(const WaterGridLayout& grid, float fTexScale, WaterStaticVertex* pOutput);
+
+class CWaterVertexPacker
+{
+public:
+   CWaterVertexPacker();
+   virtual ~CWaterVertexPacker();
+
+   // -------------------------------------------------------------------------
+   // Sets up for a grid, with the kernels of the current SIMD level.
+   // Returns false if the row scratch cannot be allocated.
+   // -------------------------------------------------------------------------
+   bool Init(const WaterGridLayout& grid);
+
+   // -------------------------------------------------------------------------
+   // WATER_WAVE_* and WATER_NORMAL_* encodings, FLOAT32 and COLOR at
+   // first. Returns false, and keeps the current ones, if either is out of
+   // range.
+   // -------------------------------------------------------------------------
+   bool SetFormat(int nWaveFormat, int nNormalFormat);
+   int GetWaveFormat() const;
+   int GetNormalFormat() const;
+
+   // -------------------------------------------------------------------------
+   // Writes stream 1 for a frame in the layout GetWaterDynamicLayout gives
+   // for the current formats and IsWaterFrameChoppy, fills in the
+   // constants to decode it and returns the bytes written.
+   // -------------------------------------------------------------------------
+   int Pack(const WaterFieldFrame& frame, void* pOutput, WaterDynamicConstants& constants);
+
+   // -------------------------------------------------------------------------
+   // Decodes pPacked, which Pack wrote for the same frame, as the shader
+   // would and compares it with the floats.
+   // -------------------------------------------------------------------------
+   void MeasureError(
+      const WaterFieldFrame& frame,
+      const void* pPacked,
+      const WaterDynamicConstants& constants,
+      WaterPackingError& error);
+
+protected:
+   void SampleRow(const WaterFieldFrame& frame, int nRow);
+   void EncodeRow(bool blChoppy, const WaterDynamicConstants& constants);
+   void SetWaveRange(int nComponent, float fMin, float fMax, WaterDynamicConstants& constants);
+
+   WaterGridLayout m_Grid;
+   int m_nWaveFormat;
+   int m_nNormalFormat;
+   WaterPackKernelTable m_Kernels;
+
+   // -------------------------------------------------------------------------
+   // One row at a time: its floats, one WATER_ROW_* plane each, their
+   // encodings, one WATER_WORDS_* plane of up to two shorts a vertex each,
+   // and the interleaved vertices, copied out whole.
+   // -------------------------------------------------------------------------
+   CRealField2D m_RowValues;
+   CAlignedBuffer<unsigned short> m_RowWords;
+   int m_nWordPitch;
+   CAlignedBuffer<unsigned char> m_RowVertices;
+};